@@ -0,0 +1,141 @@
+#include "RobotSim.h"
+
+#include <math.h>
+
+// sub steps of the kinematics per controller step
+#define ROBOT_SIM_NUM_OF_SUB_STEPS 4
+// the start line is only counted after this distance, so the start itself is not a lap
+#define ROBOT_SIM_LAP_DISTANCE_MIN 1.0f
+// half width of the start line
+#define ROBOT_SIM_START_LINE_HALF_WIDTH 0.15f
+
+RobotSim::RobotSim(const Track& track, const RobotParams& robot_params, const CntrlParams& cntrl_params)
+    : m_track(track)
+    , m_robot_params(robot_params)
+    , m_cntrl_params(cntrl_params)
+{
+}
+
+RobotSim::Result RobotSim::run(int num_of_laps, float time_max, float lost_time_max, FILE* trajectory)
+{
+    const RobotParams& rp = m_robot_params;
+    const CntrlParams& cp = m_cntrl_params;
+
+    LineFollowerCntrl cntrl(rp.bar_dist, rp.d_wheel, rp.b_wheel, rp.max_motor_vel_rps, rp.Ts);
+    cntrl.setRotationalVelocityGain(cp.Kp, cp.Kp_nl);
+    cntrl.setMaxWheelVelocityRPS(cp.wheel_vel_max_rps);
+    cntrl.enableLineTracker(cp.use_line_tracker);
+    cntrl.enableSpeedScheduling(cp.use_speed_scheduling);
+    cntrl.setSpeedSchedulingLimits(cp.acc_lat_max, cp.acc_max, cp.dec_max);
+    cntrl.enableLapProfile(cp.use_lap_profile);
+    cntrl.startLap();
+
+    Result result;
+    Track::Pose pose = m_track.getStartPose();
+    const Track::Pose start = pose;
+    const float start_dir_x = cosf(start.heading), start_dir_y = sinf(start.heading);
+
+    const float r_wheel = 0.5f * rp.d_wheel;
+    const float dt = rp.Ts / ROBOT_SIM_NUM_OF_SUB_STEPS;
+    const float motor_coeff = (rp.motor_tau > 0.0f) ? 1.0f - expf(-dt / rp.motor_tau) : 1.0f;
+    const int setpoint_divider = (rp.setpoint_period > rp.Ts) ? static_cast<int>(rp.setpoint_period / rp.Ts + 0.5f) : 1;
+
+    // setpoints and actual velocities of the motors in rps, M1 is right, M2 is left
+    float setpoint_right = 0.0f, setpoint_left = 0.0f;
+    float vel_right = 0.0f, vel_left = 0.0f;
+
+    float lost_time = 0.0f;
+    float lap_distance = 0.0f;
+    float lap_start_time = 0.0f;
+    float start_line_last = 0.0f;
+    double error_sq_sum = 0.0;
+    long num_of_steps = 0;
+
+    for (long k = 0; ; k++) {
+        const float time = k * rp.Ts;
+        if (time >= time_max)
+            break;
+
+        // controller step with the virtual sensor bar
+        const uint8_t raw = readSensorBar(pose);
+        cntrl.update(raw);
+        if ((k % setpoint_divider) == 0) {
+            setpoint_right = cntrl.getRightWheelVelocity();
+            setpoint_left = cntrl.getLeftWheelVelocity();
+        }
+
+        lost_time = (raw == 0) ? lost_time + rp.Ts : 0.0f;
+        if (lost_time > lost_time_max)
+            break;
+
+        // motors and kinematics
+        float v = 0.0f, w = 0.0f;
+        for (int i = 0; i < ROBOT_SIM_NUM_OF_SUB_STEPS; i++) {
+            vel_right += motor_coeff * (setpoint_right - vel_right);
+            vel_left += motor_coeff * (setpoint_left - vel_left);
+            vel_right = fmaxf(-rp.max_motor_vel_rps, fminf(rp.max_motor_vel_rps, vel_right));
+            vel_left = fmaxf(-rp.max_motor_vel_rps, fminf(rp.max_motor_vel_rps, vel_left));
+
+            const float wheel_right = 2.0f * M_PIf * vel_right;
+            const float wheel_left = 2.0f * M_PIf * vel_left;
+            v = 0.5f * r_wheel * (wheel_right + wheel_left);
+            w = r_wheel / rp.b_wheel * (wheel_right - wheel_left);
+
+            // exact integration along the arc (midpoint heading)
+            const float heading_mid = pose.heading + 0.5f * w * dt;
+            pose.x += v * dt * cosf(heading_mid);
+            pose.y += v * dt * sinf(heading_mid);
+            pose.heading += w * dt;
+            lap_distance += fabsf(v) * dt;
+        }
+
+        const float error = m_track.getDistance(pose.x, pose.y);
+        error_sq_sum += static_cast<double>(error) * error;
+        result.error_max = fmaxf(result.error_max, error);
+        num_of_steps++;
+
+        if (trajectory)
+            fprintf(trajectory, "%.4f, %.5f, %.5f, %.5f, %.4f, %.4f, %u, %.5f\n",
+                    time + rp.Ts, pose.x, pose.y, pose.heading, v, w, raw, error);
+
+        // lap detection, the wheel axis crosses the start line in driving direction
+        const float dx = pose.x - start.x, dy = pose.y - start.y;
+        const float start_line = dx * start_dir_x + dy * start_dir_y;
+        const float lateral = -dx * start_dir_y + dy * start_dir_x;
+        if ((start_line_last < 0.0f) && (start_line >= 0.0f) &&
+            (fabsf(lateral) < ROBOT_SIM_START_LINE_HALF_WIDTH) && (lap_distance > ROBOT_SIM_LAP_DISTANCE_MIN)) {
+            result.lap_times.push_back(time + rp.Ts - lap_start_time);
+            lap_start_time = time + rp.Ts;
+            lap_distance = 0.0f;
+            cntrl.startLap();
+            if (++result.num_of_laps >= num_of_laps) {
+                result.completed = true;
+                result.time = time + rp.Ts;
+                break;
+            }
+        }
+        start_line_last = start_line;
+        result.time = time + rp.Ts;
+    }
+
+    if (num_of_steps > 0)
+        result.error_rms = static_cast<float>(sqrt(error_sq_sum / num_of_steps));
+
+    return result;
+}
+
+uint8_t RobotSim::readSensorBar(const Track::Pose& pose) const
+{
+    const float c = cosf(pose.heading), s = sinf(pose.heading);
+    const float bar_x = pose.x + m_robot_params.bar_dist * c;
+    const float bar_y = pose.y + m_robot_params.bar_dist * s;
+
+    uint8_t raw = 0;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        // bit 0 is the rightmost led, lateral position positive to the left
+        const float lateral = (static_cast<float>(bit) - 3.5f) * m_robot_params.led_pitch;
+        if (m_track.isOnLine(bar_x - lateral * s, bar_y + lateral * c))
+            raw |= (1 << bit);
+    }
+    return raw;
+}
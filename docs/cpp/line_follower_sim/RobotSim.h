@@ -0,0 +1,79 @@
+/**
+ * @file RobotSim.h
+ * @brief Defines the RobotSim class, a differential drive robot with a virtual sensor bar.
+ *
+ * The RobotSim class runs the LineFollowerCntrl (the same code that runs in the LineFollower
+ * thread on the robot) against a simulated robot on a Track:
+ * - the virtual sensor bar has 8 leds at the distance bar_dist in front of the wheel axis,
+ *   bit 0 is the rightmost led, a led is active if it is above the line
+ * - the wheel velocity setpoints are sampled with the period of the main task (the example
+ *   main updates the motors every 20 ms) and the speed controlled motors follow them as
+ *   first order systems, saturated at the max. motor velocity
+ * - the robot kinematics use the same d_wheel and b_wheel as the controller
+ *
+ * A run ends after the given number of laps (the wheel axis crosses the start line), if the
+ * line was lost for longer than lost_time_max or if time_max is reached.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef ROBOT_SIM_H_
+#define ROBOT_SIM_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "LineFollowerCntrl.h"
+#include "Track.h"
+
+class RobotSim
+{
+public:
+    struct RobotParams {
+        float bar_dist{0.118f};             // m
+        float d_wheel{0.035f};              // m
+        float b_wheel{0.1518f};             // m
+        float max_motor_vel_rps{3.0f};      // 78:1 gear, 180 rpm at 12 V
+        float motor_tau{0.03f};             // time constant of the speed controlled motors in sec
+        float setpoint_period{0.02f};       // period the motor setpoints are updated in sec
+        float led_pitch{2.0f * 0.0445f / 7.0f};
+        float Ts{0.004f};                   // SensorBar::PERIOD_MUS
+    };
+
+    struct CntrlParams {
+        float Kp{2.0f};
+        float Kp_nl{17.0f};
+        float wheel_vel_max_rps{3.0f};
+        bool use_line_tracker{false};
+        bool use_speed_scheduling{false};
+        float acc_lat_max{2.0f};
+        float acc_max{2.0f};
+        float dec_max{4.0f};
+        bool use_lap_profile{false};
+    };
+
+    struct Result {
+        bool completed{false};         // all laps driven without losing the line
+        int num_of_laps{0};
+        std::vector<float> lap_times;  // sec
+        float time{0.0f};              // simulated time in sec
+        float error_rms{0.0f};         // tracking error of the wheel axis in m
+        float error_max{0.0f};
+    };
+
+    explicit RobotSim(const Track& track, const RobotParams& robot_params, const CntrlParams& cntrl_params);
+    ~RobotSim() = default;
+
+    // trajectory is optional, one csv line (time, x, y, heading, v, w, raw, error) per step
+    Result run(int num_of_laps, float time_max = 120.0f, float lost_time_max = 0.5f, FILE* trajectory = nullptr);
+
+private:
+    const Track& m_track;
+    RobotParams m_robot_params;
+    CntrlParams m_cntrl_params;
+
+    uint8_t readSensorBar(const Track::Pose& pose) const;
+};
+
+#endif /* ROBOT_SIM_H_ */
@@ -0,0 +1,197 @@
+#include "Track.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+
+// distance to the line is only computed in a band around the line, the sensor bar does not
+// see anything further away anyway
+#define TRACK_DISTANCE_BAND 0.15f
+
+bool Track::loadPolyline(const std::string& file_name, float line_width, float resolution)
+{
+    std::ifstream file(file_name);
+    if (!file) {
+        printf("Track: could not open %s\n", file_name.c_str());
+        return false;
+    }
+
+    std::vector<float> xs, ys;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream iss(line);
+        float x, y;
+        if (iss >> x >> y) {
+            xs.push_back(x);
+            ys.push_back(y);
+        }
+    }
+    const size_t num_of_points = xs.size();
+    if (num_of_points < 3) {
+        printf("Track: %s needs at least 3 points\n", file_name.c_str());
+        return false;
+    }
+
+    m_resolution = resolution;
+    m_x_min = *std::min_element(xs.begin(), xs.end()) - TRACK_DISTANCE_BAND;
+    m_y_min = *std::min_element(ys.begin(), ys.end()) - TRACK_DISTANCE_BAND;
+    const float x_max = *std::max_element(xs.begin(), xs.end()) + TRACK_DISTANCE_BAND;
+    const float y_max = *std::max_element(ys.begin(), ys.end()) + TRACK_DISTANCE_BAND;
+    m_cols = static_cast<int>(ceilf((x_max - m_x_min) / m_resolution)) + 1;
+    m_rows = static_cast<int>(ceilf((y_max - m_y_min) / m_resolution)) + 1;
+    m_distance_max = TRACK_DISTANCE_BAND;
+    m_distance.assign(static_cast<size_t>(m_cols) * m_rows, m_distance_max);
+    m_on_line.assign(static_cast<size_t>(m_cols) * m_rows, 0);
+
+    // distance of every cell in the bounding box of a segment (plus the band) to the segment
+    m_length = 0.0f;
+    for (size_t i = 0; i < num_of_points; i++) {
+        const float ax = xs[i], ay = ys[i];
+        const float bx = xs[(i + 1) % num_of_points], by = ys[(i + 1) % num_of_points];
+        const float dx = bx - ax, dy = by - ay;
+        const float len_sq = dx * dx + dy * dy;
+        m_length += sqrtf(len_sq);
+
+        const int c0 = std::max(0, static_cast<int>((std::min(ax, bx) - TRACK_DISTANCE_BAND - m_x_min) / m_resolution));
+        const int c1 = std::min(m_cols - 1, static_cast<int>((std::max(ax, bx) + TRACK_DISTANCE_BAND - m_x_min) / m_resolution) + 1);
+        const int r0 = std::max(0, static_cast<int>((std::min(ay, by) - TRACK_DISTANCE_BAND - m_y_min) / m_resolution));
+        const int r1 = std::min(m_rows - 1, static_cast<int>((std::max(ay, by) + TRACK_DISTANCE_BAND - m_y_min) / m_resolution) + 1);
+        for (int r = r0; r <= r1; r++) {
+            const float py = m_y_min + r * m_resolution;
+            for (int c = c0; c <= c1; c++) {
+                const float px = m_x_min + c * m_resolution;
+                float t = (len_sq > 0.0f) ? ((px - ax) * dx + (py - ay) * dy) / len_sq : 0.0f;
+                t = std::min(1.0f, std::max(0.0f, t));
+                const float ex = px - (ax + t * dx), ey = py - (ay + t * dy);
+                const float dist = sqrtf(ex * ex + ey * ey);
+                float& cell = m_distance[static_cast<size_t>(r) * m_cols + c];
+                cell = std::min(cell, dist);
+            }
+        }
+    }
+    for (size_t i = 0; i < m_distance.size(); i++)
+        m_on_line[i] = m_distance[i] <= 0.5f * line_width;
+
+    m_start.x = xs[0];
+    m_start.y = ys[0];
+    m_start.heading = atan2f(ys[1] - ys[0], xs[1] - xs[0]);
+
+    return true;
+}
+
+bool Track::loadBitmap(const std::string& file_name, float resolution, const Pose& start)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file) {
+        printf("Track: could not open %s\n", file_name.c_str());
+        return false;
+    }
+
+    // pgm header, comments start with #
+    std::string magic;
+    file >> magic;
+    int header[3];
+    for (int i = 0; i < 3; i++) {
+        file >> std::ws;
+        while (file.peek() == '#') {
+            std::string comment;
+            std::getline(file, comment);
+            file >> std::ws;
+        }
+        file >> header[i];
+    }
+    const int cols = header[0], rows = header[1], max_val = header[2];
+    if (((magic != "P2") && (magic != "P5")) || (cols <= 0) || (rows <= 0) || (max_val <= 0) || (max_val > 255)) {
+        printf("Track: %s is not an 8 bit pgm file\n", file_name.c_str());
+        return false;
+    }
+    file.get();
+
+    m_resolution = resolution;
+    m_x_min = 0.0f;
+    m_y_min = 0.0f;
+    m_cols = cols;
+    m_rows = rows;
+    m_on_line.assign(static_cast<size_t>(cols) * rows, 0);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            int val;
+            if (magic == "P5") {
+                val = file.get();
+            } else {
+                file >> val;
+            }
+            if (!file) {
+                printf("Track: %s is truncated\n", file_name.c_str());
+                return false;
+            }
+            // image row 0 is the top, the grid row 0 is at y = 0
+            m_on_line[static_cast<size_t>(rows - 1 - r) * cols + c] = val < max_val / 2;
+        }
+    }
+
+    // two pass chamfer distance transform (3-4 weights) to the nearest line pixel
+    const float inf = 1.0e9f;
+    m_distance.assign(m_on_line.size(), inf);
+    for (size_t i = 0; i < m_on_line.size(); i++)
+        if (m_on_line[i])
+            m_distance[i] = 0.0f;
+    auto relax = [&](int r, int c, int dr, int dc, float w) {
+        const int rr = r + dr, cc = c + dc;
+        if ((rr < 0) || (rr >= m_rows) || (cc < 0) || (cc >= m_cols))
+            return;
+        float& cell = m_distance[static_cast<size_t>(r) * m_cols + c];
+        cell = std::min(cell, m_distance[static_cast<size_t>(rr) * m_cols + cc] + w);
+    };
+    for (int r = 0; r < m_rows; r++) {
+        for (int c = 0; c < m_cols; c++) {
+            relax(r, c, -1, -1, 4.0f);
+            relax(r, c, -1, 0, 3.0f);
+            relax(r, c, -1, 1, 4.0f);
+            relax(r, c, 0, -1, 3.0f);
+        }
+    }
+    for (int r = m_rows - 1; r >= 0; r--) {
+        for (int c = m_cols - 1; c >= 0; c--) {
+            relax(r, c, 1, 1, 4.0f);
+            relax(r, c, 1, 0, 3.0f);
+            relax(r, c, 1, -1, 4.0f);
+            relax(r, c, 0, 1, 3.0f);
+        }
+    }
+    m_distance_max = TRACK_DISTANCE_BAND;
+    for (float& cell : m_distance)
+        cell = std::min(cell / 3.0f * m_resolution, m_distance_max);
+
+    m_start = start;
+    m_length = 0.0f;
+
+    return true;
+}
+
+bool Track::isOnLine(float x, float y) const
+{
+    int idx;
+    return cellIndex(x, y, idx) && m_on_line[idx];
+}
+
+float Track::getDistance(float x, float y) const
+{
+    int idx;
+    return cellIndex(x, y, idx) ? m_distance[idx] : m_distance_max;
+}
+
+bool Track::cellIndex(float x, float y, int& idx) const
+{
+    const int c = static_cast<int>(floorf((x - m_x_min) / m_resolution + 0.5f));
+    const int r = static_cast<int>(floorf((y - m_y_min) / m_resolution + 0.5f));
+    if ((c < 0) || (c >= m_cols) || (r < 0) || (r >= m_rows))
+        return false;
+    idx = r * m_cols + c;
+    return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file Track.h
+ * @brief Defines the Track class, the line of the line follower simulator.
+ *
+ * A track is either loaded from a polyline (csv, one "x, y" point in meters per line, the
+ * polyline is closed automatically) or from a bitmap (pgm, dark pixels are the line). Both are
+ * converted to a grid that stores, for every cell, if it is on the line and the distance to the
+ * line, so that the simulator only needs a lookup per led and step.
+ *
+ * For polylines the distance is measured to the center of the line and the start pose is the
+ * first point heading towards the second point. For bitmaps the distance is measured to the
+ * nearest line pixel and the start pose has to be given.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef TRACK_H_
+#define TRACK_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Track
+{
+public:
+    struct Pose {
+        float x{0.0f};
+        float y{0.0f};
+        float heading{0.0f};
+    };
+
+    Track() = default;
+
+    /**
+     * @param file_name  csv file with the points of the polyline in meters
+     * @param line_width width of the line in meters (black tape is 19 mm)
+     * @param resolution grid resolution in meters
+     */
+    bool loadPolyline(const std::string& file_name, float line_width = 0.019f, float resolution = 0.002f);
+
+    /**
+     * @param file_name  pgm file (P2 or P5), pixels darker than half the max. value are the line
+     * @param resolution size of a pixel in meters
+     * @param start      start pose of the robot (wheel axis)
+     */
+    bool loadBitmap(const std::string& file_name, float resolution, const Pose& start);
+
+    bool isOnLine(float x, float y) const;
+    // distance to the line in meters, saturates at the band that is computed around the line
+    float getDistance(float x, float y) const;
+
+    const Pose& getStartPose() const { return m_start; }
+    float getLength() const { return m_length; }
+
+private:
+    float m_resolution{0.002f};
+    float m_x_min{0.0f};
+    float m_y_min{0.0f};
+    int m_cols{0};
+    int m_rows{0};
+    std::vector<uint8_t> m_on_line;
+    std::vector<float> m_distance;
+    float m_distance_max{0.0f};
+
+    Pose m_start;
+    float m_length{0.0f}; // length of the polyline, 0 for bitmaps
+
+    bool cellIndex(float x, float y, int& idx) const;
+};
+
+#endif /* TRACK_H_ */
@@ -0,0 +1,12 @@
+#!/bin/bash
+# builds the host side line follower simulator, needs g++ with c++17 support
+cd "$(dirname "$0")"
+LIB=../../../lib
+g++ -O2 -std=c++17 -pthread \
+    -I$LIB/LineFollowerCntrl -I$LIB/LineTracker -I$LIB/SpeedScheduler -I$LIB/SensorBar -I$LIB/AvgFilter -I$LIB/eigen-lib \
+    line_follower_sim.cpp RobotSim.cpp Track.cpp \
+    $LIB/LineFollowerCntrl/LineFollowerCntrl.cpp \
+    $LIB/LineTracker/LineTracker.cpp \
+    $LIB/SpeedScheduler/SpeedScheduler.cpp \
+    $LIB/AvgFilter/AvgFilter.cpp \
+    -o line_follower_sim
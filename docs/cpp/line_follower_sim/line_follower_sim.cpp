@@ -0,0 +1,263 @@
+/**
+ * @file line_follower_sim.cpp
+ * @brief Host side line follower simulator and parameter sweep runner.
+ *
+ * Runs the LineFollowerCntrl against a simulated robot on a track, faster than real time. Every
+ * gain can be given as a single value or as a range start:stop:num, all combinations are
+ * simulated in parallel on all cores and the results are written to a csv file, sorted by the
+ * mean lap time. A single combination can write its trajectory.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * # single run with trajectory
+ * ./line_follower_sim tracks/oval.csv --kp 2.4 --kp_nl 20.4 --trajectory trajectory.csv
+ * # sweep, 20 x 20 x 5 gain sets with 3 laps each
+ * ./line_follower_sim tracks/test_track.csv --kp 0.5:5:20 --kp_nl 0:40:20 --vel 1.5:3:5 --laps 3 --out sweep.csv
+ * # bitmap track, 2 mm per pixel, start pose x y heading
+ * ./line_follower_sim track.pgm --bitmap 0.002 0.5 0.3 0.0
+ * ```
+ *
+ * Further options: --tracker (LineTracker), --sched acc_lat_max acc_max dec_max (speed scheduling),
+ * --lap-profile, --robot geometry and max. motor velocity, --tau motor time constant,
+ * --setpoint-period, --threads, --time-max.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RobotSim.h"
+#include "Track.h"
+
+struct Range {
+    float start;
+    float stop;
+    int num;
+
+    float at(int i) const { return (num > 1) ? start + (stop - start) * i / (num - 1) : start; }
+};
+
+struct Job {
+    RobotSim::CntrlParams cntrl_params;
+    RobotSim::Result result;
+};
+
+static bool parseRange(const char* arg, Range& range)
+{
+    // either a single value or start:stop:num
+    if (sscanf(arg, "%f:%f:%d", &range.start, &range.stop, &range.num) == 3)
+        return range.num > 0;
+    if (sscanf(arg, "%f", &range.start) == 1) {
+        range.stop = range.start;
+        range.num = 1;
+        return true;
+    }
+    return false;
+}
+
+static float mean(const std::vector<float>& values)
+{
+    float sum = 0.0f;
+    for (float value : values)
+        sum += value;
+    return values.empty() ? 0.0f : sum / values.size();
+}
+
+static void printUsage()
+{
+    printf("usage: line_follower_sim <track.csv | track.pgm --bitmap res x y heading> [options]\n"
+           "  --kp, --kp_nl, --vel   value or start:stop:num (vel is the max. wheel velocity in rps)\n"
+           "  --laps n               laps per run (default 3)\n"
+           "  --tracker              use the LineTracker\n"
+           "  --sched a_lat a d      speed scheduling with the given limits in m/s^2\n"
+           "  --lap-profile          record the first lap and replay a speed profile\n"
+           "  --robot d b l n        wheel diameter, wheelbase, bar distance in m and max. motor velocity in rps\n"
+           "                         (default 0.035 0.1518 0.118 3.0, 78:1 gear)\n"
+           "  --tau s                motor time constant (default 0.03 s)\n"
+           "  --setpoint-period s    motor setpoint update period (default 0.02 s)\n"
+           "  --width m              line width of polyline tracks (default 0.019 m)\n"
+           "  --time-max s           max. simulated time per run (default 120 s)\n"
+           "  --threads n            number of threads (default all cores)\n"
+           "  --out file             csv with the results (default sweep.csv)\n"
+           "  --trajectory file      trajectory of a single run\n");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    const char* track_file = argv[1];
+    Range kp{2.0f, 2.0f, 1}, kp_nl{17.0f, 17.0f, 1}, vel{3.0f, 3.0f, 1};
+    RobotSim::RobotParams robot_params;
+    RobotSim::CntrlParams cntrl_params;
+    int num_of_laps = 3;
+    float time_max = 120.0f;
+    float line_width = 0.019f;
+    bool is_bitmap = false;
+    float bitmap_resolution = 0.002f;
+    Track::Pose bitmap_start;
+    unsigned num_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string out_file = "sweep.csv";
+    std::string trajectory_file;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_1 = i + 1 < argc;
+        const bool has_3 = i + 3 < argc;
+        const bool has_4 = i + 4 < argc;
+        bool ok = true;
+        if (!strcmp(arg, "--kp") && has_1) {
+            ok = parseRange(argv[++i], kp);
+        } else if (!strcmp(arg, "--kp_nl") && has_1) {
+            ok = parseRange(argv[++i], kp_nl);
+        } else if (!strcmp(arg, "--vel") && has_1) {
+            ok = parseRange(argv[++i], vel);
+        } else if (!strcmp(arg, "--laps") && has_1) {
+            num_of_laps = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--tracker")) {
+            cntrl_params.use_line_tracker = true;
+        } else if (!strcmp(arg, "--sched") && has_3) {
+            cntrl_params.use_speed_scheduling = true;
+            cntrl_params.acc_lat_max = atof(argv[++i]);
+            cntrl_params.acc_max = atof(argv[++i]);
+            cntrl_params.dec_max = atof(argv[++i]);
+        } else if (!strcmp(arg, "--lap-profile")) {
+            cntrl_params.use_lap_profile = true;
+        } else if (!strcmp(arg, "--robot") && has_4) {
+            robot_params.d_wheel = atof(argv[++i]);
+            robot_params.b_wheel = atof(argv[++i]);
+            robot_params.bar_dist = atof(argv[++i]);
+            robot_params.max_motor_vel_rps = atof(argv[++i]);
+        } else if (!strcmp(arg, "--tau") && has_1) {
+            robot_params.motor_tau = atof(argv[++i]);
+        } else if (!strcmp(arg, "--setpoint-period") && has_1) {
+            robot_params.setpoint_period = atof(argv[++i]);
+        } else if (!strcmp(arg, "--width") && has_1) {
+            line_width = atof(argv[++i]);
+        } else if (!strcmp(arg, "--time-max") && has_1) {
+            time_max = atof(argv[++i]);
+        } else if (!strcmp(arg, "--threads") && has_1) {
+            num_of_threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(arg, "--out") && has_1) {
+            out_file = argv[++i];
+        } else if (!strcmp(arg, "--trajectory") && has_1) {
+            trajectory_file = argv[++i];
+        } else if (!strcmp(arg, "--bitmap") && has_4) {
+            is_bitmap = true;
+            bitmap_resolution = atof(argv[++i]);
+            bitmap_start.x = atof(argv[++i]);
+            bitmap_start.y = atof(argv[++i]);
+            bitmap_start.heading = atof(argv[++i]);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            printf("invalid argument %s\n", arg);
+            printUsage();
+            return 1;
+        }
+    }
+
+    Track track;
+    const bool track_ok = is_bitmap ? track.loadBitmap(track_file, bitmap_resolution, bitmap_start)
+                                    : track.loadPolyline(track_file, line_width);
+    if (!track_ok)
+        return 1;
+
+    // all combinations of the gains
+    std::vector<Job> jobs;
+    for (int i = 0; i < kp.num; i++) {
+        for (int j = 0; j < kp_nl.num; j++) {
+            for (int k = 0; k < vel.num; k++) {
+                Job job;
+                job.cntrl_params = cntrl_params;
+                job.cntrl_params.Kp = kp.at(i);
+                job.cntrl_params.Kp_nl = kp_nl.at(j);
+                job.cntrl_params.wheel_vel_max_rps = vel.at(k);
+                jobs.push_back(job);
+            }
+        }
+    }
+
+    // single run with trajectory
+    if ((jobs.size() == 1) && !trajectory_file.empty()) {
+        FILE* trajectory = fopen(trajectory_file.c_str(), "w");
+        if (!trajectory) {
+            printf("could not open %s\n", trajectory_file.c_str());
+            return 1;
+        }
+        fprintf(trajectory, "time, x, y, heading, v, w, raw, error\n");
+        RobotSim sim(track, robot_params, jobs[0].cntrl_params);
+        jobs[0].result = sim.run(num_of_laps, time_max, 0.5f, trajectory);
+        fclose(trajectory);
+    } else {
+        // spread the runs over all cores, every thread takes the next job
+        std::atomic<size_t> next_job{0};
+        auto worker = [&]() {
+            for (size_t idx = next_job++; idx < jobs.size(); idx = next_job++) {
+                RobotSim sim(track, robot_params, jobs[idx].cntrl_params);
+                jobs[idx].result = sim.run(num_of_laps, time_max);
+            }
+        };
+        const auto time_start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < num_of_threads; i++)
+            threads.emplace_back(worker);
+        for (std::thread& thread : threads)
+            thread.join();
+        const double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+        double simulated_time = 0.0;
+        for (const Job& job : jobs)
+            simulated_time += job.result.time;
+        printf("%zu runs on %u threads in %.2f s, %.0f x real time\n",
+               jobs.size(), num_of_threads, elapsed_time, simulated_time / std::max(elapsed_time, 1.0e-9));
+    }
+
+    // completed runs first, then by mean lap time
+    std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+        if (a.result.completed != b.result.completed)
+            return a.result.completed;
+        return mean(a.result.lap_times) < mean(b.result.lap_times);
+    });
+
+    FILE* out = fopen(out_file.c_str(), "w");
+    if (!out) {
+        printf("could not open %s\n", out_file.c_str());
+        return 1;
+    }
+    fprintf(out, "Kp, Kp_nl, wheel_vel_max_rps, completed, num_of_laps, lap_time_mean, lap_time_best, error_rms, error_max\n");
+    for (const Job& job : jobs) {
+        const RobotSim::Result& r = job.result;
+        const float lap_time_best = r.lap_times.empty() ? 0.0f : *std::min_element(r.lap_times.begin(), r.lap_times.end());
+        fprintf(out, "%.4f, %.4f, %.4f, %d, %d, %.4f, %.4f, %.5f, %.5f\n",
+                job.cntrl_params.Kp, job.cntrl_params.Kp_nl, job.cntrl_params.wheel_vel_max_rps,
+                r.completed, r.num_of_laps, mean(r.lap_times), lap_time_best, r.error_rms, r.error_max);
+    }
+    fclose(out);
+
+    // best results
+    printf("   Kp  Kp_nl    vel  laps  lap time  error rms  error max\n");
+    for (size_t i = 0; i < std::min<size_t>(jobs.size(), 10); i++) {
+        const RobotSim::Result& r = jobs[i].result;
+        printf("%5.2f  %5.2f  %5.2f  %4d  %6.3f s  %6.2f mm  %6.2f mm%s\n",
+               jobs[i].cntrl_params.Kp, jobs[i].cntrl_params.Kp_nl, jobs[i].cntrl_params.wheel_vel_max_rps,
+               r.num_of_laps, mean(r.lap_times), 1.0e3f * r.error_rms, 1.0e3f * r.error_max,
+               r.completed ? "" : "  (not completed)");
+    }
+
+    return 0;
+}
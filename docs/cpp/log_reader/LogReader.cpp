@@ -0,0 +1,526 @@
+#include "LogReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LogReader::~LogReader()
+{
+    close();
+}
+
+bool LogReader::open(const std::string& path)
+{
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("LogReader: could not open %s\n", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        printf("LogReader: %s is empty\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        printf("LogReader: mmap of %s failed\n", path.c_str());
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<size_t>(st.st_size);
+    madvise(data, m_size, MADV_SEQUENTIAL);
+
+    // a typed log file starts with the magic of its first block, a plain file with the number of floats
+    uint32_t magic = 0;
+    if (m_size >= sizeof(magic))
+        memcpy(&magic, m_data, sizeof(magic));
+    m_is_plain = (magic != LOG_FORMAT_MAGIC);
+    const bool ok = m_is_plain ? parsePlain() : parseBlocks();
+    if (!ok)
+        close();
+    return ok;
+}
+
+void LogReader::close()
+{
+    if (m_data)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_is_plain = false;
+    m_session = 0;
+    m_channels.clear();
+    m_offsets.clear();
+    m_streams.clear();
+    m_statistics = Statistics();
+    m_decoded.clear();
+    m_times_us.clear();
+    m_record_block_index = SIZE_MAX;
+}
+
+int LogReader::findChannel(const std::string& name) const
+{
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        if (strncmp(m_channels[i].name, name.c_str(), LOG_FORMAT_NAME_SIZE) == 0)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const uint8_t* LogReader::getRecord(size_t record, size_t stream) const
+{
+    // last block with first_record <= record
+    const std::vector<DataBlock>& data_blocks = m_streams[stream].data_blocks;
+    auto it = std::upper_bound(data_blocks.begin(), data_blocks.end(), record,
+                               [](size_t r, const DataBlock& block) { return r < block.first_record; });
+    --it;
+    const size_t offset = (record - it->first_record) * m_streams[stream].record_size;
+    if (it->records)
+        return it->records + offset;
+
+    // a compressed block is decoded once for all its records
+    const size_t block_index = static_cast<size_t>(it - data_blocks.begin());
+    if ((m_record_stream != stream) || (m_record_block_index != block_index)) {
+        m_record_block_index = SIZE_MAX;
+        if (!readBlock(stream, block_index, m_record_block))
+            return nullptr;
+        m_record_stream = stream;
+        m_record_block_index = block_index;
+    }
+    return m_record_block.records + offset;
+}
+
+bool LogReader::readBlock(size_t stream, size_t block, BlockData& data) const
+{
+    const Stream& s = m_streams[stream];
+    const DataBlock& data_block = s.data_blocks[block];
+    data.num_of_records = data_block.num_of_records;
+    data.records = data_block.records;
+    if (!data.records) {
+        // decoded again, only the block index is kept after open()
+        LogDataHeader data_header;
+        const uint8_t* times;
+        uint16_t times_size;
+        const uint8_t* payload;
+        uint16_t payload_size;
+        if (!logParseDataBlock(data_block.block, data_header, times, times_size, payload, payload_size))
+            return false;
+        data.decoded.resize(data_block.num_of_records * s.record_size);
+        if (logDecompressBlock(&m_channels[s.first_channel], static_cast<uint8_t>(s.num_of_channels), payload, payload_size,
+                               data.decoded.data(), data_block.num_of_records) != data_block.num_of_records)
+            return false;
+        data.records = data.decoded.data();
+    }
+    decodeTimes(s, data_block, data);
+    return true;
+}
+
+double LogReader::getValue(size_t record, size_t channel) const
+{
+    return decodeValue(getRecord(record, m_channels[channel].stream), channel);
+}
+
+double LogReader::decodeValue(const uint8_t* record, size_t channel) const
+{
+    const LogChannel& ch = m_channels[channel];
+    const uint8_t* src = record + m_offsets[channel];
+    switch (ch.type) {
+        case LOG_TYPE_INT8: {
+            int8_t val;
+            memcpy(&val, src, sizeof(val));
+            return val * static_cast<double>(ch.scale);
+        }
+        case LOG_TYPE_INT16: {
+            int16_t val;
+            memcpy(&val, src, sizeof(val));
+            return val * static_cast<double>(ch.scale);
+        }
+        case LOG_TYPE_INT32: {
+            int32_t val;
+            memcpy(&val, src, sizeof(val));
+            return val * static_cast<double>(ch.scale);
+        }
+        default: {
+            float val;
+            memcpy(&val, src, sizeof(val));
+            return val * static_cast<double>(ch.scale);
+        }
+    }
+}
+
+std::vector<double> LogReader::getColumn(size_t channel) const
+{
+    const Stream& stream = m_streams[m_channels[channel].stream];
+    std::vector<double> column;
+    column.reserve(stream.num_of_records);
+    BlockData data;
+    for (size_t b = 0; b < stream.data_blocks.size(); b++) {
+        if (!readBlock(m_channels[channel].stream, b, data))
+            data.records = nullptr;
+        for (size_t i = 0; i < stream.data_blocks[b].num_of_records; i++)
+            column.push_back(data.records ? decodeValue(data.records + i * stream.record_size, channel) : 0.0);
+    }
+    return column;
+}
+
+std::vector<double> LogReader::getTimes(size_t stream) const
+{
+    const Stream& s = m_streams[stream];
+    std::vector<double> times;
+    times.reserve(s.num_of_records);
+    BlockData data;
+    for (const DataBlock& block : s.data_blocks) {
+        decodeTimes(s, block, data);
+        times.insert(times.end(), data.times.begin(), data.times.end());
+    }
+    return times;
+}
+
+std::vector<uint64_t> LogReader::getTimesUs(size_t stream) const
+{
+    const Stream& s = m_streams[stream];
+    std::vector<uint64_t> times_us;
+    times_us.reserve(s.num_of_records);
+    BlockData data;
+    for (const DataBlock& block : s.data_blocks) {
+        decodeTimes(s, block, data);
+        times_us.insert(times_us.end(), data.times_us.begin(), data.times_us.end());
+    }
+    return times_us;
+}
+
+void LogReader::decodeTimes(const Stream& stream, const DataBlock& block, BlockData& data) const
+{
+    data.times.resize(block.num_of_records);
+    data.times_us.resize(block.num_of_records);
+    if (block.has_record_times) {
+        if (block.block) {
+            LogDataHeader data_header;
+            const uint8_t* times;
+            uint16_t times_size;
+            const uint8_t* payload;
+            uint16_t payload_size;
+            logParseDataBlock(block.block, data_header, times, times_size, payload, payload_size);
+            decodeRecordTimes(data_header, times, times_size, block.num_of_records, data.times_us);
+        } else {
+            // plain format, every record starts with its time difference, the one of the first record is in block.time_us
+            uint64_t time_us = block.time_us;
+            data.times_us[0] = time_us;
+            for (size_t i = 1; i < block.num_of_records; i++) {
+                uint32_t time_diff_us;
+                memcpy(&time_diff_us, block.records + i * stream.record_size, sizeof(time_diff_us));
+                time_us += time_diff_us;
+                data.times_us[i] = time_us;
+            }
+        }
+        for (size_t i = 0; i < block.num_of_records; i++)
+            data.times[i] = 1.0e-6 * static_cast<double>(data.times_us[i]);
+        return;
+    }
+
+    if (!block.has_time) {
+        for (size_t i = 0; i < block.num_of_records; i++) {
+            const double index = static_cast<double>(block.index) + i;
+            data.times[i] = (stream.rate > 0.0) ? index / stream.rate : index;
+        }
+    } else {
+        for (size_t i = 0; i < block.num_of_records; i++)
+            data.times[i] = 1.0e-6 * (static_cast<double>(block.time_us) + i * block.period_us);
+    }
+    for (size_t i = 0; i < block.num_of_records; i++)
+        data.times_us[i] = static_cast<uint64_t>(llround(1.0e6 * data.times[i]));
+}
+
+void LogReader::setPeriods(Stream& stream)
+{
+    // spacing up to the next block, the record indices include the lost records so this also holds over gaps, the last
+    // block and blocks before a block without time use the spacing of the previous block or the rate from the schema
+    double period_us = (stream.rate > 0.0) ? 1.0e6 / stream.rate : 0.0;
+    for (size_t b = 0; b < stream.data_blocks.size(); b++) {
+        DataBlock& block = stream.data_blocks[b];
+        if (block.has_time && !block.has_record_times && (b + 1 < stream.data_blocks.size())) {
+            const DataBlock& next = stream.data_blocks[b + 1];
+            const uint32_t num_of_periods = next.index - block.index;
+            if (next.has_time && (num_of_periods > 0) && (num_of_periods < 0x80000000UL) && (next.time_us > block.time_us))
+                period_us = static_cast<double>(next.time_us - block.time_us) / num_of_periods;
+        }
+        block.period_us = period_us;
+    }
+}
+
+bool LogReader::hasRecordTimes(size_t stream) const
+{
+    const std::vector<DataBlock>& data_blocks = m_streams[stream].data_blocks;
+    return std::all_of(data_blocks.begin(), data_blocks.end(), [](const DataBlock& block) { return block.has_record_times; });
+}
+
+bool LogReader::parsePlain()
+{
+    const bool has_record_times = (m_data[0] & LOG_FORMAT_PLAIN_TIME_FLAG) != 0;
+    const size_t num_of_floats = m_data[0] & ~LOG_FORMAT_PLAIN_TIME_FLAG;
+    // with record times the header is followed by the time of the first record and every record starts with its time difference
+    const size_t header_size = has_record_times ? 1 + sizeof(uint64_t) : 1;
+    const size_t time_size = has_record_times ? sizeof(uint32_t) : 0;
+    if ((num_of_floats == 0) || (m_size < header_size)) {
+        printf("LogReader: plain file without floats\n");
+        return false;
+    }
+    m_channels.resize(num_of_floats);
+    for (size_t i = 0; i < num_of_floats; i++) {
+        LogChannel& channel = m_channels[i];
+        memset(&channel, 0, sizeof(channel));
+        snprintf(channel.name, LOG_FORMAT_NAME_SIZE, "ch%zu", i);
+        channel.type = LOG_TYPE_FLOAT;
+        channel.scale = 1.0f;
+        m_offsets.push_back(time_size + i * sizeof(float));
+    }
+
+    Stream stream;
+    stream.num_of_channels = num_of_floats;
+    stream.record_size = time_size + num_of_floats * sizeof(float);
+    stream.num_of_records = (m_size - header_size) / stream.record_size;
+    // blocks of LOG_READER_PLAIN_NUM_OF_RECORDS records, with the time of their first record
+    uint64_t time_us = 0;
+    if (has_record_times)
+        memcpy(&time_us, m_data + 1, sizeof(time_us));
+    for (size_t first = 0; first < stream.num_of_records; first += LOG_READER_PLAIN_NUM_OF_RECORDS) {
+        const size_t num_of_records = std::min<size_t>(LOG_READER_PLAIN_NUM_OF_RECORDS, stream.num_of_records - first);
+        const uint8_t* records = m_data + header_size + first * stream.record_size;
+        if (has_record_times) {
+            for (size_t i = (first == 0) ? 0 : first - LOG_READER_PLAIN_NUM_OF_RECORDS + 1; i <= first; i++) {
+                uint32_t time_diff_us;
+                memcpy(&time_diff_us, m_data + header_size + i * stream.record_size, sizeof(time_diff_us));
+                time_us += time_diff_us;
+            }
+        }
+        stream.data_blocks.push_back({records, nullptr, first, num_of_records, 0, static_cast<uint32_t>(first), time_us, 0.0,
+                                      has_record_times, has_record_times});
+    }
+    m_statistics.num_of_skipped_bytes = (m_size - header_size) % stream.record_size;
+    m_streams.push_back(stream);
+    return true;
+}
+
+size_t LogReader::findNextBlock(size_t offset) const
+{
+    const uint8_t magic[4] = {LOG_FORMAT_MAGIC & 0xFF, (LOG_FORMAT_MAGIC >> 8) & 0xFF, (LOG_FORMAT_MAGIC >> 16) & 0xFF, (LOG_FORMAT_MAGIC >> 24) & 0xFF};
+    while (offset + LOG_FORMAT_BLOCK_SIZE <= m_size) {
+        const uint8_t* candidate = static_cast<const uint8_t*>(memchr(m_data + offset, magic[0], m_size - LOG_FORMAT_BLOCK_SIZE + 1 - offset));
+        if (!candidate)
+            break;
+        offset = static_cast<size_t>(candidate - m_data);
+        if ((memcmp(candidate, magic, sizeof(magic)) == 0) && logCheckBlock(candidate))
+            return offset;
+        offset++;
+    }
+    return m_size;
+}
+
+bool LogReader::isZero(size_t offset, size_t size) const
+{
+    for (size_t i = offset; i < offset + size; i++) {
+        if (m_data[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+bool LogReader::parseSchemaBlock(const uint8_t* block, size_t& num_of_channels_received)
+{
+    LogSchemaHeader schema_header;
+    memcpy(&schema_header, block + LOG_FORMAT_BLOCK_HEADER_SIZE, sizeof(schema_header));
+    if (m_channels.empty())
+        m_channels.resize(schema_header.num_of_channels);
+    if ((schema_header.num_of_channels != m_channels.size()) ||
+        (schema_header.first_channel + schema_header.num_of_channels_in_block > m_channels.size()))
+        return false;
+
+    memcpy(&m_channels[schema_header.first_channel],
+           block + LOG_FORMAT_BLOCK_HEADER_SIZE + sizeof(schema_header),
+           schema_header.num_of_channels_in_block * sizeof(LogChannel));
+    num_of_channels_received += schema_header.num_of_channels_in_block;
+
+    if (num_of_channels_received == m_channels.size())
+        return buildStreams();
+    return true;
+}
+
+bool LogReader::buildStreams()
+{
+    // the channels of a stream are contiguous and the streams are numbered in the order of their channels
+    m_offsets.clear();
+    m_streams.clear();
+    for (size_t i = 0; i < m_channels.size(); i++) {
+        const LogChannel& channel = m_channels[i];
+        const uint8_t type_size = logTypeSize(channel.type);
+        if (type_size == 0)
+            return false;
+        if (channel.stream == m_streams.size()) {
+            Stream stream;
+            stream.first_channel = i;
+            stream.rate = channel.rate;
+            m_streams.push_back(stream);
+        } else if (static_cast<size_t>(channel.stream) + 1 != m_streams.size()) {
+            return false;
+        }
+        Stream& stream = m_streams.back();
+        m_offsets.push_back(stream.record_size);
+        stream.record_size += type_size;
+        stream.num_of_channels++;
+    }
+    return !m_streams.empty();
+}
+
+void LogReader::parseDataBlock(const uint8_t* block, const LogBlockHeader& header)
+{
+    if (m_streams.empty()) {
+        // the schema is missing or incomplete, the records can not be decoded
+        m_statistics.num_of_bad_blocks++;
+        return;
+    }
+
+    LogDataHeader data_header;
+    const uint8_t* times;
+    uint16_t times_size;
+    const uint8_t* payload;
+    uint16_t payload_size;
+    const bool has_data_header = (header.version >= 2);
+    if (!logParseDataBlock(block, data_header, times, times_size, payload, payload_size) || (data_header.stream >= m_streams.size())) {
+        m_statistics.num_of_bad_blocks++;
+        return;
+    }
+    Stream& stream = m_streams[data_header.stream];
+
+    const uint8_t* records = payload;
+    size_t num_of_records;
+    if (header.type == LOG_BLOCK_DATA) {
+        num_of_records = payload_size / stream.record_size;
+    } else {
+        // compressed blocks are decoded to count and check their records, readBlock() decodes them again
+        const size_t num_of_records_max = logGetNumOfCompressedRecords(payload, payload_size);
+        m_decoded.resize(num_of_records_max * stream.record_size);
+        num_of_records = logDecompressBlock(&m_channels[stream.first_channel], static_cast<uint8_t>(stream.num_of_channels),
+                                            payload, payload_size, m_decoded.data(), num_of_records_max);
+        if (num_of_records == 0) {
+            m_statistics.num_of_bad_blocks++;
+            return;
+        }
+        records = nullptr;
+        m_statistics.num_of_compressed_blocks++;
+    }
+    if (num_of_records == 0)
+        return;
+
+    // version 1 blocks have no index, their records are consecutive
+    uint32_t index = data_header.first_record;
+    if (!stream.data_blocks.empty()) {
+        const DataBlock& last = stream.data_blocks.back();
+        const uint32_t index_expected = last.index + static_cast<uint32_t>(last.num_of_records);
+        if (!has_data_header)
+            index = index_expected;
+        const uint32_t num_of_lost_records = index - index_expected;
+        if ((num_of_lost_records > 0) && (num_of_lost_records < 0x80000000UL))
+            stream.num_of_lost_records += num_of_lost_records;
+    }
+
+    const bool has_record_times = decodeRecordTimes(data_header, times, times_size, num_of_records, m_times_us);
+    stream.data_blocks.push_back({records, block, stream.num_of_records, num_of_records, header.seq, index, data_header.time_us, 0.0,
+                                  has_data_header, has_record_times});
+    stream.num_of_records += num_of_records;
+}
+
+bool LogReader::decodeRecordTimes(const LogDataHeader& data_header, const uint8_t* times, uint16_t times_size, size_t num_of_records,
+                                  std::vector<uint64_t>& times_us) const
+{
+    // blocks without (valid) record times get their times from decodeTimes()
+    times_us.resize(num_of_records);
+    if (times == nullptr)
+        return false;
+
+    uint64_t time_us = data_header.time_us;
+    times_us[0] = time_us;
+    size_t offset = 0;
+    for (size_t i = 1; i < num_of_records; i++) {
+        uint64_t time_diff_us;
+        const uint8_t size = logReadVarint(times + offset, times_size - offset, time_diff_us);
+        if (size == 0)
+            return false;
+        offset += size;
+        time_us += time_diff_us;
+        times_us[i] = time_us;
+    }
+    return true;
+}
+
+bool LogReader::parseBlocks()
+{
+    size_t num_of_channels_received = 0;
+    bool is_first_block = true;
+    bool has_data = false;
+    uint32_t seq_expected = 0;
+
+    size_t offset = 0;
+    while (offset + LOG_FORMAT_BLOCK_SIZE <= m_size) {
+        const uint8_t* block = m_data + offset;
+        if (!logCheckBlock(block)) {
+            // resynchronise on the next valid block, counted once per corrupt region
+            const size_t next = findNextBlock(offset + 1);
+            if (!isZero(offset, next - offset))
+                m_statistics.num_of_bad_blocks++;
+            m_statistics.num_of_skipped_bytes += next - offset;
+            offset = next;
+            continue;
+        }
+
+        LogBlockHeader header;
+        memcpy(&header, block, sizeof(header));
+
+        // the schema is only written at the start of a file, the first session found is the one of the file
+        const uint16_t session = logGetBlockSession(block);
+        if ((has_data && (header.type == LOG_BLOCK_SCHEMA)) || ((session != 0) && (m_session != 0) && (session != m_session))) {
+            m_statistics.num_of_stale_blocks++;
+            offset += LOG_FORMAT_BLOCK_SIZE;
+            continue;
+        }
+        if (m_session == 0)
+            m_session = session;
+        if (header.type != LOG_BLOCK_SCHEMA)
+            has_data = true;
+        if (!is_first_block && (header.seq > seq_expected))
+            m_statistics.num_of_lost_blocks += header.seq - seq_expected;
+        is_first_block = false;
+        seq_expected = header.seq + 1;
+        m_statistics.num_of_blocks++;
+
+        if (header.type == LOG_BLOCK_SCHEMA) {
+            if (!parseSchemaBlock(block, num_of_channels_received)) {
+                printf("LogReader: invalid schema in block %u\n", (unsigned)header.seq);
+                return false;
+            }
+        } else if ((header.type == LOG_BLOCK_DATA) || (header.type == LOG_BLOCK_DATA_COMPRESSED)) {
+            parseDataBlock(block, header);
+        } else if (header.type == LOG_BLOCK_SYNC) {
+            m_statistics.num_of_sync_blocks++;
+        }
+        offset += LOG_FORMAT_BLOCK_SIZE;
+    }
+    m_statistics.num_of_skipped_bytes += m_size - offset;
+
+    if (m_streams.empty()) {
+        printf("LogReader: no complete schema found\n");
+        return false;
+    }
+    for (Stream& stream : m_streams)
+        setPeriods(stream);
+    return true;
+}
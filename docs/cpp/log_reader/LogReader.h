@@ -0,0 +1,198 @@
+/**
+ * @file LogReader.h
+ * @brief Defines the LogReader class, a host side reader of the SDLogger files.
+ *
+ * The LogReader class maps a log file into memory (mmap) and decodes it without copying the data:
+ * - typed log format (see lib/LogFormat/LogFormat.h): the schema gives name, type, unit, scale,
+ *   rate and stream of every channel, the data blocks are checked with their CRC32, blocks with a
+ *   wrong magic or CRC are skipped and the reader resynchronises on the next valid block (also
+ *   after a write that was not a multiple of 512 bytes), gaps in the sequence numbers are counted
+ * - streams: every stream has its own records, blocks and time base, a record index always
+ *   refers to the records of one stream, gaps in the record indices of a stream are lost records
+ * - sessions: the session of the file is taken from its first data or sync block, blocks of
+ *   another session and schema blocks behind the data are left over from an older file (in the
+ *   preallocated space of the crash consistent mode) and are skipped as stale, zero bytes (unused
+ *   preallocated space) are skipped without counting them as bad
+ * - plain format (a "num_of_floats" byte followed by float records): one stream, the channels are
+ *   float and named ch0, ch1, ..., with LOG_FORMAT_PLAIN_TIME_FLAG every record starts with its
+ *   time difference (the record size includes it, the channel offsets skip it)
+ *
+ * open() only keeps an index of the data blocks of every stream (64 bytes per block of 512
+ * bytes), the records and the record times stay in the mapped file. readBlock() decodes the records
+ * and times of one block into buffers of the caller that are reused from block to block, so a tool
+ * that runs block by block over a file needs memory for one block, whatever the size of the log.
+ * Compressed blocks are decompressed once when the file is opened to count and check their records
+ * and again by every readBlock().
+ *
+ * getRecord() returns a pointer to the raw record in the mapped file (or in the last decoded
+ * compressed block), getValue() decodes one value with the scale of the channel, getColumn()
+ * decodes a whole channel.
+ *
+ * getTimes() returns the time of every record of a stream. With record times (version 3 blocks and
+ * the plain format with LOG_FORMAT_PLAIN_TIME_FLAG) the times are exact, getTimesUs() gives them
+ * in us without rounding. Blocks without record times (version 2) are reconstructed from the time
+ * of the first record of each block: the records of a block are spaced evenly up to the next
+ * block of the stream, the last block and blocks before a gap use the spacing of the previous
+ * block or the rate from the schema. Without any times (plain and version 1 files) the time is
+ * index / rate, or the index if the rate is unknown.
+ *
+ * @usage
+ * ```
+ * LogReader reader;
+ * if (!reader.open("001.bin"))
+ *     return 1;
+ * const int channel = reader.findChannel("angle");
+ * const size_t stream = reader.getStreamOfChannel(channel);
+ * const std::vector<double> time = reader.getTimes(stream);
+ * for (size_t i = 0; i < reader.getNumOfRecords(stream); i++)
+ *     printf("%f %f\n", time[i], reader.getValue(i, channel));
+ *
+ * // block by block, the memory does not grow with the size of the log
+ * LogReader::BlockData data;
+ * for (size_t b = 0; b < reader.getDataBlocks(stream).size(); b++) {
+ *     if (!reader.readBlock(stream, b, data))
+ *         continue;
+ *     for (size_t i = 0; i < data.num_of_records; i++)
+ *         printf("%f %f\n", data.times[i], reader.decodeValue(data.records + i * reader.getRecordSize(stream), channel));
+ * }
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef LOG_READER_H_
+#define LOG_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "LogFormat.h"
+
+#define LOG_READER_PLAIN_NUM_OF_RECORDS 4096 // records per data block of the plain format
+
+class LogReader
+{
+public:
+    struct Statistics {
+        size_t num_of_blocks{0};       // valid blocks
+        size_t num_of_bad_blocks{0};   // regions with a wrong magic or crc and data blocks without a schema
+        size_t num_of_lost_blocks{0};  // gaps in the sequence numbers
+        size_t num_of_skipped_bytes{0};
+        size_t num_of_compressed_blocks{0};
+        size_t num_of_sync_blocks{0};
+        size_t num_of_stale_blocks{0}; // valid blocks of another session
+    };
+
+    struct DataBlock {
+        const uint8_t* records; // first record in the mapped file, nullptr for a compressed block (see readBlock())
+        const uint8_t* block;   // block in the mapped file, nullptr for the plain format
+        size_t first_record;    // index of the first record in the records of the stream read from the file
+        size_t num_of_records;
+        uint32_t seq;
+        uint32_t index;         // index of the first record written by the logger, including lost records
+        uint64_t time_us;       // time of the first record
+        double period_us;       // spacing of the reconstructed times of a block without record times
+        bool has_time;
+        bool has_record_times;  // exact time of every record in the block
+    };
+
+    struct Stream {
+        size_t first_channel{0};
+        size_t num_of_channels{0};
+        size_t record_size{0};
+        double rate{0.0}; // nominal rate from the schema, 0 if unknown
+        size_t num_of_records{0};
+        size_t num_of_lost_records{0};
+        std::vector<DataBlock> data_blocks;
+    };
+
+    // records and times of one data block, decoded by readBlock()
+    struct BlockData {
+        const uint8_t* records{nullptr}; // in the mapped file or in decoded
+        size_t num_of_records{0};
+        std::vector<uint8_t> decoded;    // records of a compressed block
+        std::vector<double> times;       // time of every record in s, see getTimes()
+        std::vector<uint64_t> times_us;  // time of every record in us, see getTimesUs()
+    };
+
+    explicit LogReader() = default;
+    ~LogReader();
+    LogReader(const LogReader&) = delete;
+    LogReader& operator=(const LogReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; };
+    // true for the plain float format without schema
+    bool isPlain() const { return m_is_plain; };
+    const Statistics& getStatistics() const { return m_statistics; };
+    // session of the file, 0 if unknown (plain format and files without sessions)
+    uint16_t getSession() const { return m_session; };
+
+    size_t getNumOfChannels() const { return m_channels.size(); };
+    const LogChannel& getChannel(size_t i) const { return m_channels[i]; };
+    // returns -1 if there is no channel with this name
+    int findChannel(const std::string& name) const;
+    // offset of the channel in the record of its stream
+    size_t getChannelOffset(size_t i) const { return m_offsets[i]; };
+    size_t getStreamOfChannel(size_t i) const { return m_channels[i].stream; };
+
+    size_t getNumOfStreams() const { return m_streams.size(); };
+    const Stream& getStream(size_t stream) const { return m_streams[stream]; };
+    size_t getRecordSize(size_t stream = 0) const { return m_streams[stream].record_size; };
+    size_t getNumOfRecords(size_t stream = 0) const { return m_streams[stream].num_of_records; };
+    // valid data blocks of the stream in file order, for the plain format blocks of LOG_READER_PLAIN_NUM_OF_RECORDS records
+    const std::vector<DataBlock>& getDataBlocks(size_t stream = 0) const { return m_streams[stream].data_blocks; };
+    // decodes the records and times of a data block of the stream, the buffers of data are reused, false if the block is corrupt
+    bool readBlock(size_t stream, size_t block, BlockData& data) const;
+
+    // raw record of the stream in the mapped file, valid until close(), or in the decoded buffer of a compressed block,
+    // valid until a record of another compressed block is read
+    const uint8_t* getRecord(size_t record, size_t stream = 0) const;
+    // physical value, raw * scale, record is the index in the records of the stream of the channel
+    double getValue(size_t record, size_t channel) const;
+    // physical value of a channel from a raw record of its stream
+    double decodeValue(const uint8_t* record, size_t channel) const;
+    std::vector<double> getColumn(size_t channel) const;
+
+    // time of every record of the stream in seconds (since the start of the robot for typed files)
+    std::vector<double> getTimes(size_t stream = 0) const;
+    // time of every record of the stream in us, exact with record times, else rounded from getTimes()
+    std::vector<uint64_t> getTimesUs(size_t stream = 0) const;
+    // true if every record of the stream has its exact time
+    bool hasRecordTimes(size_t stream = 0) const;
+
+private:
+    const uint8_t* m_data{nullptr};
+    size_t m_size{0};
+    bool m_is_plain{false};
+    uint16_t m_session{0};
+
+    std::vector<LogChannel> m_channels;
+    std::vector<size_t> m_offsets;
+    std::vector<Stream> m_streams;
+    Statistics m_statistics;
+    std::vector<uint8_t> m_decoded;    // compressed block checked by parseDataBlock()
+    std::vector<uint64_t> m_times_us;  // record times checked by parseDataBlock()
+    mutable BlockData m_record_block;  // last compressed block of getRecord()
+    mutable size_t m_record_stream{0};
+    mutable size_t m_record_block_index{SIZE_MAX};
+
+    bool parsePlain();
+    bool parseBlocks();
+    bool parseSchemaBlock(const uint8_t* block, size_t& num_of_channels_received);
+    bool buildStreams();
+    void parseDataBlock(const uint8_t* block, const LogBlockHeader& header);
+    void setPeriods(Stream& stream);
+    bool decodeRecordTimes(const LogDataHeader& data_header, const uint8_t* times, uint16_t times_size, size_t num_of_records,
+                           std::vector<uint64_t>& times_us) const;
+    void decodeTimes(const Stream& stream, const DataBlock& block, BlockData& data) const;
+    size_t findNextBlock(size_t offset) const;
+    bool isZero(size_t offset, size_t size) const;
+};
+
+#endif /* LOG_READER_H_ */
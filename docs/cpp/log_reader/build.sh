@@ -0,0 +1,11 @@
+#!/bin/bash
+# builds the host side log reader tools log_dump, log_compress and log_convert, needs g++ with c++17 support and mmap (linux, macos)
+cd "$(dirname "$0")"
+LIB=../../../lib
+for tool in log_dump log_compress log_convert; do
+    g++ -O2 -std=c++17 -Wall -pthread \
+        -I$LIB/LogFormat \
+        $tool.cpp LogReader.cpp \
+        $LIB/LogFormat/LogFormat.cpp \
+        -o $tool || exit 1
+done
@@ -0,0 +1,224 @@
+/**
+ * @file log_compress.cpp
+ * @brief Converts SDLogger files into the typed log format with compressed data blocks and reports the compression ratio.
+ *
+ * Every input file (plain or typed format) is read with the LogReader class, its records are packed
+ * into data blocks with LogDataBlock like the SDLogger thread does it, once uncompressed and once
+ * with the LogCompressor, the compressed file is read back and compared record by record with the
+ * input (and time by time if the input has record times).
+ *
+ * Reports per file the size of the plain format, of the uncompressed and of the compressed
+ * typed format, the ratios plain / compressed and typed / compressed and the host time to
+ * compress one block (all records of the block and the crc).
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./log_compress ../../dev/dev_sdcard/002.bin ../../dev/dev_sdcard/005.bin  // ratios only
+ * ./log_compress --out /tmp ../../dev/dev_sdcard/002.bin                  // also writes /tmp/002.bin in the compressed format
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "LogReader.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    size_t plain_bytes{0};
+    size_t typed_bytes{0};
+    size_t compressed_bytes{0};
+    double block_time_max_us{0.0};
+    double block_time_mean_us{0.0};
+};
+
+// copies the channels of a record of the reader into a record of the schema, the records of the plain format with
+// record times start with the time difference
+static void packRecord(const LogReader& reader, const LogSchema& schema, size_t stream, const uint8_t* src, uint8_t* dst)
+{
+    const size_t first_channel = reader.getStream(stream).first_channel;
+    for (size_t i = first_channel; i < first_channel + reader.getStream(stream).num_of_channels; i++) {
+        const uint8_t channel = static_cast<uint8_t>(i);
+        memcpy(&dst[schema.getChannelOffset(channel)], &src[reader.getChannelOffset(i)], logTypeSize(schema.getChannel(channel).type));
+    }
+}
+
+// packs the records into schema and data blocks like SDLogger::flushBlocks() with LogDataBlock, the streams one after the other
+static std::vector<uint8_t> encodeFile(const LogReader& reader, bool do_compress, double& block_time_max_us, double& block_time_mean_us)
+{
+    LogSchema schema;
+    for (size_t i = 0; i < reader.getNumOfChannels(); i++) {
+        const LogChannel& channel = reader.getChannel(i);
+        if ((i > 0) && (channel.stream != reader.getChannel(i - 1).stream))
+            schema.addStream();
+        schema.addChannel(channel.name, channel.type, channel.unit, channel.rate, channel.scale);
+    }
+
+    std::vector<uint8_t> file;
+    uint8_t block[LOG_FORMAT_BLOCK_SIZE];
+    uint32_t seq = 0;
+    for (uint8_t i = 0; i < schema.getNumOfSchemaBlocks(); i++) {
+        schema.writeSchemaBlock(block, i, seq++);
+        file.insert(file.end(), block, block + LOG_FORMAT_BLOCK_SIZE);
+    }
+
+    LogDataBlock data_block;
+    double block_time_us = 0.0;
+    double block_time_sum_us = 0.0;
+    size_t num_of_blocks = 0;
+    block_time_max_us = 0.0;
+
+    auto finishBlock = [&]() {
+        const Clock::time_point time_start = Clock::now();
+        data_block.finish(block, seq++);
+        block_time_us += std::chrono::duration<double, std::micro>(Clock::now() - time_start).count();
+        file.insert(file.end(), block, block + LOG_FORMAT_BLOCK_SIZE);
+        if (block_time_us > block_time_max_us)
+            block_time_max_us = block_time_us;
+        block_time_sum_us += block_time_us;
+        num_of_blocks++;
+        block_time_us = 0.0;
+    };
+
+    uint8_t record[LOG_FORMAT_RECORD_SIZE_MAX];
+    for (uint8_t stream = 0; stream < schema.getNumOfStreams(); stream++) {
+        data_block.setChannels(&schema.getChannel(schema.getStreamFirstChannel(stream)), schema.getStreamNumOfChannels(stream), do_compress);
+        // files without times keep time 0, the reconstructed times of version 2 files become record times
+        const bool has_time = !reader.getDataBlocks(stream).empty() && reader.getDataBlocks(stream).front().has_time;
+
+        LogReader::BlockData reader_data;
+        for (size_t b = 0; b < reader.getDataBlocks(stream).size(); b++) {
+            const LogReader::DataBlock& reader_block = reader.getDataBlocks(stream)[b];
+            if (!reader.readBlock(stream, b, reader_data))
+                continue;
+            for (size_t r = 0; r < reader_block.num_of_records; r++) {
+                packRecord(reader, schema, stream, reader_data.records + r * reader.getRecordSize(stream), record);
+                const uint32_t index = reader_block.index + static_cast<uint32_t>(r);
+                const uint64_t time_us = has_time ? reader_data.times_us[r] : 0;
+                if (data_block.isStarted() && (index != data_block.getNextRecord()))
+                    finishBlock();
+                if (!data_block.isStarted())
+                    data_block.begin(stream, reader.getSession(), index, time_us);
+
+                // time of packing (and compressing) all records of a block plus the crc
+                const Clock::time_point time_start = Clock::now();
+                const bool is_added = data_block.add(record, time_us);
+                block_time_us += std::chrono::duration<double, std::micro>(Clock::now() - time_start).count();
+                if (!is_added) {
+                    finishBlock();
+                    data_block.begin(stream, reader.getSession(), index, time_us);
+                    data_block.add(record, time_us);
+                }
+            }
+        }
+        if (data_block.isStarted())
+            finishBlock();
+    }
+
+    block_time_mean_us = (num_of_blocks > 0) ? block_time_sum_us / num_of_blocks : 0.0;
+    return file;
+}
+
+static bool writeFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    const bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+static bool isEqual(const LogReader& a, const LogReader& b)
+{
+    if (a.getNumOfStreams() != b.getNumOfStreams())
+        return false;
+    for (size_t s = 0; s < a.getNumOfStreams(); s++) {
+        if (a.getNumOfRecords(s) != b.getNumOfRecords(s))
+            return false;
+        // the channels are compared byte by byte, the records of the plain format also hold the time difference
+        const size_t first_channel = a.getStream(s).first_channel;
+        for (size_t i = 0; i < a.getNumOfRecords(s); i++) {
+            for (size_t c = first_channel; c < first_channel + a.getStream(s).num_of_channels; c++) {
+                if (memcmp(a.getRecord(i, s) + a.getChannelOffset(c), b.getRecord(i, s) + b.getChannelOffset(c), logTypeSize(a.getChannel(c).type)) != 0)
+                    return false;
+            }
+        }
+        // the exact times survive the conversion
+        if (a.hasRecordTimes(s) && (a.getTimesUs(s) != b.getTimesUs(s)))
+            return false;
+    }
+    return true;
+}
+
+static size_t getNumOfRecordBytes(const LogReader& reader)
+{
+    size_t num_of_bytes = 0;
+    for (size_t s = 0; s < reader.getNumOfStreams(); s++)
+        num_of_bytes += reader.getNumOfRecords(s) * reader.getRecordSize(s);
+    return num_of_bytes;
+}
+
+int main(int argc, char** argv)
+{
+    std::string out_dir;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--out") == 0) && (i + 1 < argc))
+            out_dir = argv[++i];
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        printf("usage: %s [--out dir] file.bin ...\n", argv[0]);
+        return 1;
+    }
+
+    const std::string tmp_path = "log_compress.tmp";
+    Result total;
+    printf("file          records ch   plain [B]   typed [B]  compr. [B]  plain/c typed/c  block mean/max [us]\n");
+    for (const std::string& path : paths) {
+        LogReader reader;
+        if (!reader.open(path))
+            continue;
+
+        Result result;
+        double time_max_us, time_mean_us;
+        result.plain_bytes = 1 + getNumOfRecordBytes(reader);
+        result.typed_bytes = encodeFile(reader, false, time_max_us, time_mean_us).size();
+        const std::vector<uint8_t> compressed = encodeFile(reader, true, result.block_time_max_us, result.block_time_mean_us);
+        result.compressed_bytes = compressed.size();
+
+        // read the compressed file back and compare every record
+        const std::string name = path.substr(path.find_last_of('/') + 1);
+        const std::string out_path = out_dir.empty() ? tmp_path : out_dir + "/" + name;
+        LogReader check;
+        if (!writeFile(out_path, compressed) || !check.open(out_path) || !isEqual(reader, check)) {
+            printf("%s: round trip failed\n", path.c_str());
+            return 1;
+        }
+        if (out_dir.empty())
+            remove(tmp_path.c_str());
+
+        printf("%-12s %8zu %2zu %11zu %11zu %11zu %8.2f %7.2f %9.2f / %.2f\n", name.c_str(), reader.getNumOfRecords(0),
+               reader.getNumOfChannels(), result.plain_bytes, result.typed_bytes, result.compressed_bytes,
+               static_cast<double>(result.plain_bytes) / result.compressed_bytes,
+               static_cast<double>(result.typed_bytes) / result.compressed_bytes, result.block_time_mean_us, result.block_time_max_us);
+        total.plain_bytes += result.plain_bytes;
+        total.typed_bytes += result.typed_bytes;
+        total.compressed_bytes += result.compressed_bytes;
+    }
+    if (total.compressed_bytes > 0)
+        printf("%-12s %8s %2s %11zu %11zu %11zu %8.2f %7.2f\n", "total", "", "", total.plain_bytes, total.typed_bytes,
+               total.compressed_bytes, static_cast<double>(total.plain_bytes) / total.compressed_bytes,
+               static_cast<double>(total.typed_bytes) / total.compressed_bytes);
+    return 0;
+}
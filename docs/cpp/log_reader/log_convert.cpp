@@ -0,0 +1,528 @@
+/**
+ * @file log_convert.cpp
+ * @brief Converts SDLogger and SerialStream captures to csv or a columnar binary format and computes channel statistics, many files in parallel.
+ *
+ * Every file is mapped into memory with the LogReader class (typed and plain format, a SerialStream
+ * capture of the serial_receiver is a typed file, one saved byte by byte without frames a plain
+ * file) and streamed block by block with LogReader::readBlock(), the records and times of one
+ * block are decoded at a time, so the memory per file is the block index of the reader (64 bytes
+ * per block of 512 bytes) and the buffers of one block, compressed blocks are decoded once
+ * per pass. The files are spread over all cores, every thread takes the next file.
+ *
+ * Per stream of a file:
+ * - csv (--csv): time in s and the channels, one row per record
+ * - columnar (--col): a header, the time column (float64, s) and one float32 column per channel,
+ *   written with one pass over the mapped file per column, the layout is
+ *   "PCOL", uint32 version, uint32 number of channels, uint32 0, uint64 number of records,
+ *   per channel char name[16] and char unit[8], then the columns
+ * - statistics: number of values, min, max, mean, std (Welford) and the frequency of the largest
+ *   peak of the spectrum, non finite values are counted and left out
+ * - spectra (--psd): Welch power spectral density of every channel (Hann window of nfft records,
+ *   50 % overlap, mean removed per segment) in unit^2 / Hz as csv, the sample rate is taken from
+ *   the record times (or the rate of the schema)
+ *
+ * The outputs are named after the input, e.g. 002.bin gives 002.csv, 002.col and 002_psd.csv,
+ * files with several streams get _s0, _s1, ... Inputs with the same name in different directories
+ * would write the same outputs, they are rejected unless only the statistics are computed. The statistics of all files are printed in the
+ * order of the inputs and written to stats.csv in the output directory.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./log_convert ../../dev/dev_sdcard/0*.bin                        // statistics only
+ * ./log_convert --csv --psd --out /tmp/logs ../../dev/dev_sdcard/0*.bin
+ * ./log_convert --col --threads 4 --nfft 2048 --out /tmp/logs 001.bin 002.bin
+ * ```
+ *
+ * Read a columnar file with numpy:
+ * ```
+ * n = int(np.fromfile(f, "<u4", 4)[2])           # number of channels
+ * m = int(np.fromfile(f, "<u8", 1, offset=16)[0]) # number of records
+ * time = np.memmap(f, "<f8", "r", 24 + 24 * n, (m,))
+ * values = np.memmap(f, "<f4", "r", 24 + 24 * n + 8 * m, (n, m))
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LogReader.h"
+
+#define COLUMNAR_VERSION 1
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+struct Options {
+    bool do_csv{false};
+    bool do_col{false};
+    bool do_psd{false};
+    size_t nfft{1024};
+    std::string out_dir{"."};
+};
+
+struct ChannelStatistics {
+    std::string name;
+    std::string unit;
+    size_t stream{0};
+    size_t num_of_values{0};
+    size_t num_of_non_finite{0};
+    double min{0.0};
+    double max{0.0};
+    double mean{0.0};
+    double std{0.0};
+    double peak_frequency{0.0};
+};
+
+struct Job {
+    std::string path;
+    std::string name; // file name without directory and extension
+    bool ok{false};
+    size_t num_of_bytes{0};
+    size_t num_of_records{0};
+    std::vector<ChannelStatistics> statistics;
+};
+
+// buffered sequential writer, the output is written in chunks of WRITE_BUFFER_SIZE
+class Writer
+{
+public:
+    explicit Writer(const std::string& path) : m_file(fopen(path.c_str(), "wb")) { m_buffer.reserve(WRITE_BUFFER_SIZE); };
+    ~Writer() { close(); };
+
+    bool isOpen() const { return m_file != nullptr; };
+    void write(const void* data, size_t size)
+    {
+        if (m_buffer.size() + size > WRITE_BUFFER_SIZE)
+            flush();
+        m_buffer.insert(m_buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    };
+    void write(const std::string& text) { write(text.data(), text.size()); };
+    // writes the number in its shortest round trip form
+    template <typename T> void writeNumber(T value, char separator)
+    {
+        char text[32];
+        const std::to_chars_result result = std::to_chars(text, text + sizeof(text) - 1, value);
+        *result.ptr = separator;
+        write(text, result.ptr + 1 - text);
+    };
+    void writeFixed(double value, int precision, char separator)
+    {
+        char text[48];
+        const std::to_chars_result result = std::to_chars(text, text + sizeof(text) - 1, value, std::chars_format::fixed, precision);
+        *result.ptr = separator;
+        write(text, result.ptr + 1 - text);
+    };
+    bool close()
+    {
+        if (!m_file)
+            return false;
+        flush();
+        const bool ok = !m_has_error && (fclose(m_file) == 0);
+        m_file = nullptr;
+        return ok;
+    };
+
+private:
+    FILE* m_file;
+    std::vector<char> m_buffer;
+    bool m_has_error{false};
+
+    void flush()
+    {
+        if (m_file && !m_buffer.empty() && (fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()))
+            m_has_error = true;
+        m_buffer.clear();
+    };
+};
+
+// welch power spectral density of one channel, fed record by record
+class Spectrum
+{
+public:
+    explicit Spectrum(size_t nfft) : m_nfft(nfft), m_segment(nfft), m_window(nfft), m_re(nfft), m_im(nfft), m_psd(nfft / 2 + 1, 0.0)
+    {
+        for (size_t i = 0; i < nfft; i++) {
+            m_window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / nfft);
+            m_window_power += m_window[i] * m_window[i];
+        }
+        // twiddle factors and bit reversed indices, computed once per channel
+        for (size_t k = 0; k < nfft / 2; k++) {
+            m_cos.push_back(cos(2.0 * M_PI * k / nfft));
+            m_sin.push_back(-sin(2.0 * M_PI * k / nfft));
+        }
+        m_bit_reversed.resize(nfft, 0);
+        for (size_t i = 1, j = 0; i < nfft; i++) {
+            size_t bit = nfft >> 1;
+            for (; j & bit; bit >>= 1)
+                j ^= bit;
+            j ^= bit;
+            m_bit_reversed[i] = j;
+        }
+    };
+
+    void add(double value)
+    {
+        m_segment[m_num_of_values++] = value;
+        if (m_num_of_values < m_nfft)
+            return;
+        addSegment();
+        // 50 % overlap
+        std::copy(m_segment.begin() + m_nfft / 2, m_segment.end(), m_segment.begin());
+        m_num_of_values = m_nfft - m_nfft / 2;
+    };
+
+    // one sided psd in unit^2 / Hz, empty if there are less than nfft values
+    std::vector<double> getPsd(double sample_rate) const
+    {
+        std::vector<double> psd;
+        if (m_num_of_segments == 0)
+            return psd;
+        const double scale = 1.0 / (sample_rate * m_window_power * m_num_of_segments);
+        for (size_t k = 0; k < m_psd.size(); k++) {
+            const bool is_edge = (k == 0) || (2 * k == m_nfft);
+            psd.push_back(m_psd[k] * scale * (is_edge ? 1.0 : 2.0));
+        }
+        return psd;
+    };
+
+private:
+    size_t m_nfft;
+    std::vector<double> m_segment;
+    std::vector<double> m_window;
+    double m_window_power{0.0};
+    std::vector<double> m_re;
+    std::vector<double> m_im;
+    std::vector<double> m_cos;
+    std::vector<double> m_sin;
+    std::vector<size_t> m_bit_reversed;
+    std::vector<double> m_psd;
+    size_t m_num_of_values{0};
+    size_t m_num_of_segments{0};
+
+    void addSegment()
+    {
+        double mean = 0.0;
+        for (double value : m_segment)
+            mean += value;
+        mean /= m_nfft;
+        for (size_t i = 0; i < m_nfft; i++) {
+            m_re[m_bit_reversed[i]] = (m_segment[i] - mean) * m_window[i];
+            m_im[m_bit_reversed[i]] = 0.0;
+        }
+        fft();
+        for (size_t k = 0; k < m_psd.size(); k++)
+            m_psd[k] += m_re[k] * m_re[k] + m_im[k] * m_im[k];
+        m_num_of_segments++;
+    };
+
+    // iterative radix 2 fft of the bit reversed input in place, real and imaginary part in separate arrays
+    void fft()
+    {
+        for (size_t len = 2; len <= m_nfft; len <<= 1) {
+            const size_t half = len / 2;
+            const size_t step = m_nfft / len;
+            for (size_t i = 0; i < m_nfft; i += len) {
+                for (size_t j = 0; j < half; j++) {
+                    const double w_re = m_cos[j * step];
+                    const double w_im = m_sin[j * step];
+                    const size_t a = i + j;
+                    const size_t b = a + half;
+                    const double v_re = m_re[b] * w_re - m_im[b] * w_im;
+                    const double v_im = m_re[b] * w_im + m_im[b] * w_re;
+                    m_re[b] = m_re[a] - v_re;
+                    m_im[b] = m_im[a] - v_im;
+                    m_re[a] += v_re;
+                    m_im[a] += v_im;
+                }
+            }
+        }
+    };
+};
+
+static std::string getOutputPath(const Options& options, const Job& job, const LogReader& reader, size_t stream, const char* suffix)
+{
+    std::string path = options.out_dir + "/" + job.name;
+    if (reader.getNumOfStreams() > 1)
+        path += "_s" + std::to_string(stream);
+    return path + suffix;
+}
+
+// calls fcn(record, time) for every record of the stream in file order, one block is decoded at a time
+template <typename Fcn> static void forEachRecord(const LogReader& reader, size_t stream, Fcn fcn)
+{
+    const LogReader::Stream& s = reader.getStream(stream);
+    LogReader::BlockData data;
+    for (size_t b = 0; b < s.data_blocks.size(); b++) {
+        if (!reader.readBlock(stream, b, data))
+            continue;
+        for (size_t r = 0; r < data.num_of_records; r++)
+            fcn(data.records + r * s.record_size, data.times[r]);
+    }
+}
+
+static bool writeColumnar(const Options& options, const Job& job, const LogReader& reader, size_t stream)
+{
+    const LogReader::Stream& s = reader.getStream(stream);
+    Writer writer(getOutputPath(options, job, reader, stream, ".col"));
+    if (!writer.isOpen())
+        return false;
+
+    const uint32_t header[4] = {0x4C4F4350UL, COLUMNAR_VERSION, static_cast<uint32_t>(s.num_of_channels), 0}; // "PCOL"
+    const uint64_t num_of_records = s.num_of_records;
+    writer.write(header, sizeof(header));
+    writer.write(&num_of_records, sizeof(num_of_records));
+    for (size_t i = s.first_channel; i < s.first_channel + s.num_of_channels; i++) {
+        writer.write(reader.getChannel(i).name, LOG_FORMAT_NAME_SIZE);
+        writer.write(reader.getChannel(i).unit, LOG_FORMAT_UNIT_SIZE);
+    }
+    forEachRecord(reader, stream, [&](const uint8_t*, double time) { writer.write(&time, sizeof(time)); });
+    // one pass over the mapped file per column, the pages stay in the page cache for files that fit into ram
+    for (size_t i = s.first_channel; i < s.first_channel + s.num_of_channels; i++) {
+        forEachRecord(reader, stream, [&](const uint8_t* record, double) {
+            const float value = static_cast<float>(reader.decodeValue(record, i));
+            writer.write(&value, sizeof(value));
+        });
+    }
+    return writer.close();
+}
+
+static bool writePsd(const Options& options, const Job& job, const LogReader& reader, size_t stream, const std::vector<Spectrum>& spectra,
+                     double sample_rate)
+{
+    const LogReader::Stream& s = reader.getStream(stream);
+    std::vector<std::vector<double>> psds;
+    for (const Spectrum& spectrum : spectra)
+        psds.push_back(spectrum.getPsd(sample_rate));
+    if (psds.empty() || psds.front().empty())
+        return true;
+
+    Writer writer(getOutputPath(options, job, reader, stream, "_psd.csv"));
+    if (!writer.isOpen())
+        return false;
+    writer.write("frequency");
+    for (size_t i = s.first_channel; i < s.first_channel + s.num_of_channels; i++)
+        writer.write("," + std::string(reader.getChannel(i).name, strnlen(reader.getChannel(i).name, LOG_FORMAT_NAME_SIZE)));
+    writer.write("\n");
+    for (size_t k = 0; k < psds.front().size(); k++) {
+        writer.writeNumber(k * sample_rate / options.nfft, ',');
+        for (size_t c = 0; c < psds.size(); c++)
+            writer.writeNumber(psds[c][k], (c + 1 < psds.size()) ? ',' : '\n');
+    }
+    return writer.close();
+}
+
+static bool convertStream(const Options& options, Job& job, const LogReader& reader, size_t stream)
+{
+    const LogReader::Stream& s = reader.getStream(stream);
+
+    // sample rate from the record times, including lost records, else from the schema
+    const bool has_time = !s.data_blocks.empty() && s.data_blocks.front().has_time;
+    double sample_rate = (s.rate > 0.0) ? s.rate : 1.0;
+    LogReader::BlockData first, last;
+    if (has_time && (s.num_of_records > 1) && reader.readBlock(stream, 0, first) && reader.readBlock(stream, s.data_blocks.size() - 1, last) &&
+        (last.times.back() > first.times.front())) {
+        const uint32_t num_of_periods = s.data_blocks.back().index + static_cast<uint32_t>(s.data_blocks.back().num_of_records) - 1 - s.data_blocks.front().index;
+        sample_rate = num_of_periods / (last.times.back() - first.times.front());
+    }
+
+    std::vector<ChannelStatistics> statistics(s.num_of_channels);
+    std::vector<double> m2(s.num_of_channels, 0.0);
+    std::vector<double> last_finite(s.num_of_channels, 0.0);
+    std::vector<Spectrum> spectra(s.num_of_channels, Spectrum(options.nfft));
+    for (size_t c = 0; c < s.num_of_channels; c++) {
+        const LogChannel& channel = reader.getChannel(s.first_channel + c);
+        statistics[c].name.assign(channel.name, strnlen(channel.name, LOG_FORMAT_NAME_SIZE));
+        statistics[c].unit.assign(channel.unit, strnlen(channel.unit, LOG_FORMAT_UNIT_SIZE));
+        statistics[c].stream = stream;
+    }
+
+    std::unique_ptr<Writer> csv;
+    if (options.do_csv) {
+        csv.reset(new Writer(getOutputPath(options, job, reader, stream, ".csv")));
+        if (!csv->isOpen())
+            return false;
+        csv->write("time");
+        for (const ChannelStatistics& channel : statistics)
+            csv->write("," + channel.name);
+        csv->write("\n");
+    }
+
+    // statistics, spectra and csv in one pass
+    forEachRecord(reader, stream, [&](const uint8_t* record, double time) {
+        if (csv)
+            csv->writeFixed(time, 6, ',');
+        for (size_t c = 0; c < s.num_of_channels; c++) {
+            const double value = reader.decodeValue(record, s.first_channel + c);
+            if (csv)
+                csv->writeNumber(static_cast<float>(value), (c + 1 < s.num_of_channels) ? ',' : '\n');
+
+            ChannelStatistics& stat = statistics[c];
+            if (!std::isfinite(value)) {
+                // the spectrum holds the last finite value
+                stat.num_of_non_finite++;
+                spectra[c].add(last_finite[c]);
+                continue;
+            }
+            last_finite[c] = value;
+            if (stat.num_of_values == 0) {
+                stat.min = value;
+                stat.max = value;
+            }
+            stat.min = std::min(stat.min, value);
+            stat.max = std::max(stat.max, value);
+            stat.num_of_values++;
+            const double delta = value - stat.mean;
+            stat.mean += delta / stat.num_of_values;
+            m2[c] += delta * (value - stat.mean);
+            spectra[c].add(value);
+        }
+    });
+    if (csv && !csv->close())
+        return false;
+
+    for (size_t c = 0; c < s.num_of_channels; c++) {
+        ChannelStatistics& stat = statistics[c];
+        stat.std = (stat.num_of_values > 1) ? sqrt(m2[c] / (stat.num_of_values - 1)) : 0.0;
+        // largest peak without the dc bin
+        const std::vector<double> psd = spectra[c].getPsd(sample_rate);
+        if (psd.size() > 1)
+            stat.peak_frequency = (std::max_element(psd.begin() + 1, psd.end()) - psd.begin()) * sample_rate / options.nfft;
+    }
+    job.statistics.insert(job.statistics.end(), statistics.begin(), statistics.end());
+    job.num_of_records += s.num_of_records;
+
+    if (options.do_psd && !writePsd(options, job, reader, stream, spectra, sample_rate))
+        return false;
+    if (options.do_col && !writeColumnar(options, job, reader, stream))
+        return false;
+    return true;
+}
+
+static void convertFile(const Options& options, Job& job)
+{
+    LogReader reader;
+    if (!reader.open(job.path))
+        return;
+    for (size_t s = 0; s < reader.getNumOfStreams(); s++) {
+        if (!convertStream(options, job, reader, s)) {
+            printf("%s: could not write to %s\n", job.path.c_str(), options.out_dir.c_str());
+            return;
+        }
+    }
+    for (size_t s = 0; s < reader.getNumOfStreams(); s++)
+        job.num_of_bytes += reader.getNumOfRecords(s) * reader.getRecordSize(s);
+    job.ok = true;
+}
+
+static void printUsage()
+{
+    printf("usage: log_convert [options] file.bin ...\n"
+           "  --csv          time and channels of every stream as csv\n"
+           "  --col          columnar binary file per stream (float64 time, float32 channels)\n"
+           "  --psd          welch power spectral density of every channel as csv\n"
+           "  --nfft n       segment length of the spectra, power of two (default 1024)\n"
+           "  --out dir      output directory (default .)\n"
+           "  --threads n    number of threads (default all cores)\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    unsigned num_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<Job> jobs;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_1 = i + 1 < argc;
+        if (!strcmp(arg, "--csv")) {
+            options.do_csv = true;
+        } else if (!strcmp(arg, "--col")) {
+            options.do_col = true;
+        } else if (!strcmp(arg, "--psd")) {
+            options.do_psd = true;
+        } else if (!strcmp(arg, "--nfft") && has_1) {
+            options.nfft = static_cast<size_t>(std::max(2, atoi(argv[++i])));
+        } else if (!strcmp(arg, "--out") && has_1) {
+            options.out_dir = argv[++i];
+        } else if (!strcmp(arg, "--threads") && has_1) {
+            num_of_threads = std::max(1, atoi(argv[++i]));
+        } else if (arg[0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            Job job;
+            job.path = arg;
+            job.name = job.path.substr(job.path.find_last_of('/') + 1);
+            job.name = job.name.substr(0, job.name.find_last_of('.'));
+            jobs.push_back(job);
+        }
+    }
+    if (jobs.empty() || (options.nfft & (options.nfft - 1))) {
+        printUsage();
+        return 1;
+    }
+    // the outputs are named after the input without its directory, two inputs of the same name would be written to the
+    // same files by different threads
+    if (options.do_csv || options.do_col || options.do_psd) {
+        for (size_t i = 0; i < jobs.size(); i++) {
+            for (size_t j = 0; j < i; j++) {
+                if (jobs[i].name == jobs[j].name) {
+                    printf("%s and %s have the same output name %s, convert them into different output directories\n",
+                           jobs[j].path.c_str(), jobs[i].path.c_str(), jobs[i].name.c_str());
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // spread the files over all cores, every thread takes the next file
+    std::atomic<size_t> next_job{0};
+    auto worker = [&]() {
+        for (size_t idx = next_job++; idx < jobs.size(); idx = next_job++)
+            convertFile(options, jobs[idx]);
+    };
+    const auto time_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::min<size_t>(num_of_threads, jobs.size()); i++)
+        threads.emplace_back(worker);
+    for (std::thread& thread : threads)
+        thread.join();
+    const double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+    Writer stats(options.out_dir + "/stats.csv");
+    stats.write("file,stream,channel,unit,values,non_finite,min,max,mean,std,peak_frequency\n");
+    printf("file         st channel          unit       values        min        max       mean        std  peak [Hz]\n");
+    size_t num_of_bytes = 0, num_of_records = 0, num_of_files = 0;
+    for (const Job& job : jobs) {
+        if (!job.ok)
+            continue;
+        num_of_files++;
+        num_of_bytes += job.num_of_bytes;
+        num_of_records += job.num_of_records;
+        for (const ChannelStatistics& stat : job.statistics) {
+            printf("%-12s %2zu %-16s %-6s %10zu %10.4g %10.4g %10.4g %10.4g %10.4g\n", job.name.c_str(), stat.stream, stat.name.c_str(),
+                   stat.unit.c_str(), stat.num_of_values, stat.min, stat.max, stat.mean, stat.std, stat.peak_frequency);
+            char line[512];
+            snprintf(line, sizeof(line), "%s,%zu,%s,%s,%zu,%zu,%.9g,%.9g,%.9g,%.9g,%.9g\n", job.name.c_str(), stat.stream, stat.name.c_str(),
+                     stat.unit.c_str(), stat.num_of_values, stat.num_of_non_finite, stat.min, stat.max, stat.mean, stat.std, stat.peak_frequency);
+            stats.write(line);
+        }
+    }
+    if (!stats.close())
+        printf("could not write %s/stats.csv\n", options.out_dir.c_str());
+    printf("%zu files, %zu records, %.1f MB in %.2f s on %u threads, %.0f MB/s\n", num_of_files, num_of_records, num_of_bytes * 1.0e-6,
+           elapsed_time, std::min<unsigned>(num_of_threads, static_cast<unsigned>(jobs.size())),
+           num_of_bytes * 1.0e-6 / std::max(elapsed_time, 1.0e-9));
+    return (num_of_files == jobs.size()) ? 0 : 1;
+}
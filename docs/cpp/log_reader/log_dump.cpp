@@ -0,0 +1,113 @@
+/**
+ * @file log_dump.cpp
+ * @brief Prints the schema and the statistics of an SDLogger file and the records as csv.
+ *
+ * Reads the typed log format and the plain float format with the LogReader class. The csv has
+ * the time of the records (exact with record times, else reconstructed per stream, see
+ * LogReader::getTimes()) in the first column and the channels of one stream in the other columns.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./log_dump 001.bin                   // schema, statistics and the first 10 records of every stream
+ * ./log_dump 001.bin --csv > 001.csv   // records of stream 0
+ * ./log_dump 001.bin --csv 1 > 001_1.csv
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LogReader.h"
+
+static const char* typeName(uint8_t type)
+{
+    switch (type) {
+        case LOG_TYPE_INT8:
+            return "int8";
+        case LOG_TYPE_INT16:
+            return "int16";
+        case LOG_TYPE_INT32:
+            return "int32";
+        case LOG_TYPE_FLOAT:
+            return "float";
+        default:
+            return "unknown";
+    }
+}
+
+static void printRecords(const LogReader& reader, size_t stream, size_t num_of_records)
+{
+    const LogReader::Stream& s = reader.getStream(stream);
+    printf("time");
+    for (size_t i = s.first_channel; i < s.first_channel + s.num_of_channels; i++)
+        printf(",%.*s", LOG_FORMAT_NAME_SIZE, reader.getChannel(i).name);
+    printf("\n");
+
+    LogReader::BlockData data;
+    for (size_t b = 0; (b < s.data_blocks.size()) && (s.data_blocks[b].first_record < num_of_records); b++) {
+        const LogReader::DataBlock& block = s.data_blocks[b];
+        if (!reader.readBlock(stream, b, data))
+            continue;
+        for (size_t r = 0; (r < block.num_of_records) && (block.first_record + r < num_of_records); r++) {
+            const uint8_t* record = data.records + r * s.record_size;
+            printf("%.6f", data.times[r]);
+            for (size_t i = s.first_channel; i < s.first_channel + s.num_of_channels; i++)
+                printf(",%.9g", reader.decodeValue(record, i));
+            printf("\n");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s file.bin [--csv [stream]]\n", argv[0]);
+        return 1;
+    }
+    const bool do_csv = (argc > 2) && (strcmp(argv[2], "--csv") == 0);
+    const size_t csv_stream = (argc > 3) ? static_cast<size_t>(atoi(argv[3])) : 0;
+
+    LogReader reader;
+    if (!reader.open(argv[1]))
+        return 1;
+
+    if (do_csv) {
+        if (csv_stream >= reader.getNumOfStreams()) {
+            printf("stream %zu does not exist\n", csv_stream);
+            return 1;
+        }
+        printRecords(reader, csv_stream, reader.getNumOfRecords(csv_stream));
+        return 0;
+    }
+
+    const LogReader::Statistics& statistics = reader.getStatistics();
+    printf("%s: %s format, %zu streams\n", argv[1], reader.isPlain() ? "plain" : "typed", reader.getNumOfStreams());
+    printf("blocks %zu (compressed %zu, sync %zu), bad %zu, lost %zu, stale %zu, skipped bytes %zu\n", statistics.num_of_blocks,
+           statistics.num_of_compressed_blocks, statistics.num_of_sync_blocks, statistics.num_of_bad_blocks,
+           statistics.num_of_lost_blocks, statistics.num_of_stale_blocks, statistics.num_of_skipped_bytes);
+    if (reader.getSession() != 0)
+        printf("session %04x\n", (unsigned)reader.getSession());
+    for (size_t s = 0; s < reader.getNumOfStreams(); s++) {
+        const LogReader::Stream& stream = reader.getStream(s);
+        printf("stream %zu: %zu records of %zu bytes, %zu lost records, rate %g Hz, %s times\n", s, stream.num_of_records,
+               stream.record_size, stream.num_of_lost_records, stream.rate, reader.hasRecordTimes(s) ? "exact" : "reconstructed");
+    }
+    printf("\n");
+
+    printf("  #  stream name             type   unit     scale          rate\n");
+    for (size_t i = 0; i < reader.getNumOfChannels(); i++) {
+        const LogChannel& channel = reader.getChannel(i);
+        printf("%3zu  %6u %-16.*s %-6s %-8.*s %-14.7g %g\n", i, (unsigned)channel.stream, LOG_FORMAT_NAME_SIZE, channel.name,
+               typeName(channel.type), LOG_FORMAT_UNIT_SIZE, channel.unit, channel.scale, channel.rate);
+    }
+    for (size_t s = 0; s < reader.getNumOfStreams(); s++) {
+        printf("\nstream %zu\n", s);
+        printRecords(reader, s, 10);
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "LogRecovery.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+void LogRecovery::scan(const uint8_t* data, size_t size)
+{
+    m_statistics = Statistics();
+    m_sessions.clear();
+
+    // schema blocks in front of the next session, channels received
+    std::vector<const uint8_t*> schema_blocks;
+    size_t num_of_channels_received = 0;
+    size_t num_of_channels = 0;
+
+    size_t offset = 0;
+    while (offset + LOG_FORMAT_BLOCK_SIZE <= size) {
+        const uint8_t* block = data + offset;
+        if (!logCheckBlock(block)) {
+            const size_t next = findNextBlock(data, size, offset + 1);
+            bool is_zero = true;
+            for (size_t i = offset; (i < next) && is_zero; i++)
+                is_zero = (data[i] == 0);
+            if (!is_zero) {
+                m_statistics.num_of_bad_regions++;
+                m_statistics.num_of_skipped_bytes += next - offset;
+            }
+            offset = next;
+            continue;
+        }
+        offset += LOG_FORMAT_BLOCK_SIZE;
+        m_statistics.num_of_blocks++;
+
+        LogBlockHeader header;
+        memcpy(&header, block, sizeof(header));
+        if (header.type == LOG_BLOCK_SCHEMA) {
+            LogSchemaHeader schema_header;
+            memcpy(&schema_header, block + LOG_FORMAT_BLOCK_HEADER_SIZE, sizeof(schema_header));
+            LogBlockHeader last_header;
+            if (!schema_blocks.empty())
+                memcpy(&last_header, schema_blocks.back(), sizeof(last_header));
+            // a schema starts with its first channel, the other blocks follow without a gap
+            if (schema_header.first_channel == 0) {
+                m_statistics.num_of_orphan_blocks += schema_blocks.size();
+                schema_blocks.clear();
+                num_of_channels_received = 0;
+                num_of_channels = schema_header.num_of_channels;
+            } else if (schema_blocks.empty() || (header.seq != last_header.seq + 1) ||
+                       (schema_header.num_of_channels != num_of_channels)) {
+                m_statistics.num_of_orphan_blocks++;
+                continue;
+            }
+            schema_blocks.push_back(block);
+            num_of_channels_received += schema_header.num_of_channels_in_block;
+            continue;
+        }
+
+        const uint16_t session_id = logGetBlockSession(block);
+        auto it = std::find_if(m_sessions.begin(), m_sessions.end(), [session_id](const Session& s) { return s.session == session_id; });
+        if (it == m_sessions.end()) {
+            m_sessions.push_back(Session());
+            m_sessions.back().session = session_id;
+            it = m_sessions.end() - 1;
+        }
+        // a complete schema belongs to the session of the next block
+        if (!schema_blocks.empty() && (num_of_channels_received == num_of_channels)) {
+            if (it->schema_blocks.empty())
+                it->schema_blocks = schema_blocks;
+            else
+                m_statistics.num_of_orphan_blocks += schema_blocks.size();
+            schema_blocks.clear();
+        }
+        it->blocks.push_back(block);
+    }
+    m_statistics.num_of_orphan_blocks += schema_blocks.size();
+
+    for (Session& session : m_sessions)
+        finishSession(session);
+}
+
+bool LogRecovery::writeSession(size_t i, const std::string& path) const
+{
+    const Session& session = m_sessions[i];
+    if (!session.hasSchema())
+        return false;
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        printf("LogRecovery: could not create %s\n", path.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (const uint8_t* block : session.schema_blocks)
+        ok &= (fwrite(block, LOG_FORMAT_BLOCK_SIZE, 1, file) == 1);
+    for (const uint8_t* block : session.blocks)
+        ok &= (fwrite(block, LOG_FORMAT_BLOCK_SIZE, 1, file) == 1);
+    ok &= (fclose(file) == 0);
+    if (!ok)
+        printf("LogRecovery: writing %s failed\n", path.c_str());
+    return ok;
+}
+
+size_t LogRecovery::findNextBlock(const uint8_t* data, size_t size, size_t offset) const
+{
+    const uint8_t magic[4] = {LOG_FORMAT_MAGIC & 0xFF, (LOG_FORMAT_MAGIC >> 8) & 0xFF, (LOG_FORMAT_MAGIC >> 16) & 0xFF, (LOG_FORMAT_MAGIC >> 24) & 0xFF};
+    while (offset + LOG_FORMAT_BLOCK_SIZE <= size) {
+        const uint8_t* candidate = static_cast<const uint8_t*>(memchr(data + offset, magic[0], size - LOG_FORMAT_BLOCK_SIZE + 1 - offset));
+        if (!candidate)
+            break;
+        offset = static_cast<size_t>(candidate - data);
+        if ((memcmp(candidate, magic, sizeof(magic)) == 0) && logCheckBlock(candidate))
+            return offset;
+        offset++;
+    }
+    return size;
+}
+
+void LogRecovery::finishSession(Session& session)
+{
+    auto getSeq = [](const uint8_t* block) {
+        LogBlockHeader header;
+        memcpy(&header, block, sizeof(header));
+        return header.seq;
+    };
+    std::stable_sort(session.blocks.begin(), session.blocks.end(),
+                     [&getSeq](const uint8_t* a, const uint8_t* b) { return getSeq(a) < getSeq(b); });
+    const size_t num_of_blocks = session.blocks.size();
+    session.blocks.erase(std::unique(session.blocks.begin(), session.blocks.end(),
+                                     [&getSeq](const uint8_t* a, const uint8_t* b) { return getSeq(a) == getSeq(b); }),
+                         session.blocks.end());
+    m_statistics.num_of_duplicate_blocks += num_of_blocks - session.blocks.size();
+
+    // the data follows the schema blocks
+    uint32_t seq_expected = session.hasSchema() ? getSeq(session.schema_blocks.back()) + 1 : getSeq(session.blocks.front());
+    for (const uint8_t* block : session.blocks) {
+        LogBlockHeader header;
+        memcpy(&header, block, sizeof(header));
+        if (header.seq > seq_expected)
+            session.num_of_lost_blocks += header.seq - seq_expected;
+        seq_expected = header.seq + 1;
+
+        const uint8_t* payload = block + LOG_FORMAT_BLOCK_HEADER_SIZE;
+        if (header.type == LOG_BLOCK_SYNC) {
+            LogSyncHeader sync_header;
+            memcpy(&sync_header, payload, sizeof(sync_header));
+            session.num_of_sync_blocks++;
+            session.last_sync_index = sync_header.sync_index;
+            session.num_of_blocks_after_last_sync = 0;
+        } else if ((header.type == LOG_BLOCK_DATA) || (header.type == LOG_BLOCK_DATA_COMPRESSED)) {
+            session.num_of_data_blocks++;
+            session.num_of_blocks_after_last_sync++;
+            if ((header.version >= 2) && (header.payload_size >= sizeof(LogDataHeader))) {
+                LogDataHeader data_header;
+                memcpy(&data_header, payload, sizeof(data_header));
+                if ((session.first_time_us == 0) || (data_header.time_us < session.first_time_us))
+                    session.first_time_us = data_header.time_us;
+                if (data_header.time_us > session.last_time_us)
+                    session.last_time_us = data_header.time_us;
+            }
+        }
+    }
+}
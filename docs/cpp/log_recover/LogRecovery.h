@@ -0,0 +1,87 @@
+/**
+ * @file LogRecovery.h
+ * @brief Defines the LogRecovery class, extracts the intact blocks of the typed log format from damaged data.
+ *
+ * The data can be a log file that was cut off by a power loss, a file of the preallocated crash
+ * consistent mode of the SDLogger or the image of a whole SD card or raw log partition (e.g.
+ * made with dd). Every block of the typed log format (see lib/LogFormat/LogFormat.h) is checked
+ * on its own with its magic and CRC32, so the scan does not depend on the file system:
+ * - the data is scanned byte by byte for valid blocks, torn and overwritten blocks fail the CRC
+ * - data and sync blocks are grouped by their session, a session takes the schema blocks that
+ *   were found in front of its first block
+ * - the blocks of a session are sorted by their sequence number (a raw partition wraps around),
+ *   duplicates are dropped, gaps are lost blocks
+ * - the last sync block tells how much of the session was confirmed on the card, the blocks
+ *   behind it are still recovered if they are intact
+ *
+ * writeSession() writes the schema and the blocks of a session as a clean log file for LogReader.
+ *
+ * @usage
+ * ```
+ * LogRecovery recovery;
+ * recovery.scan(data, size);
+ * for (size_t i = 0; i < recovery.getSessions().size(); i++)
+ *     recovery.writeSession(i, "session_" + std::to_string(i) + ".bin");
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef LOG_RECOVERY_H_
+#define LOG_RECOVERY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "LogFormat.h"
+
+class LogRecovery
+{
+public:
+    struct Statistics {
+        size_t num_of_blocks{0};           // valid blocks
+        size_t num_of_duplicate_blocks{0};
+        size_t num_of_orphan_blocks{0};    // schema blocks without a session
+        size_t num_of_bad_regions{0};      // non-zero data between valid blocks
+        size_t num_of_skipped_bytes{0};
+    };
+
+    struct Session {
+        uint16_t session{0};                    // 0 for files without sessions
+        std::vector<const uint8_t*> schema_blocks;
+        std::vector<const uint8_t*> blocks;     // data and sync blocks sorted by their sequence number
+        size_t num_of_data_blocks{0};
+        size_t num_of_lost_blocks{0};           // gaps in the sequence numbers
+        size_t num_of_sync_blocks{0};
+        uint32_t last_sync_index{0};
+        size_t num_of_blocks_after_last_sync{0}; // data blocks behind the last sync block, all if there is none
+        uint64_t first_time_us{0};              // time of the first and the last data block with a time
+        uint64_t last_time_us{0};
+        bool hasSchema() const { return !schema_blocks.empty(); };
+    };
+
+    explicit LogRecovery() = default;
+    ~LogRecovery() = default;
+
+    // scans the data, the blocks of the sessions point into it, so it has to stay valid
+    void scan(const uint8_t* data, size_t size);
+
+    const Statistics& getStatistics() const { return m_statistics; };
+    // sessions in the order they are found in the data
+    const std::vector<Session>& getSessions() const { return m_sessions; };
+
+    // writes the schema and the blocks of the session as a log file, false if it has no schema or can not be written
+    bool writeSession(size_t i, const std::string& path) const;
+
+private:
+    Statistics m_statistics;
+    std::vector<Session> m_sessions;
+
+    size_t findNextBlock(const uint8_t* data, size_t size, size_t offset) const;
+    void finishSession(Session& session);
+};
+
+#endif /* LOG_RECOVERY_H_ */
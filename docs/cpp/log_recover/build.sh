@@ -0,0 +1,16 @@
+#!/bin/bash
+# builds the host side recovery tools log_recover and raw_extract and the power cut simulation power_cut_sim, needs g++ with c++17 support and mmap (linux, macos)
+cd "$(dirname "$0")"
+LIB=../../../lib
+for tool in log_recover power_cut_sim; do
+    g++ -O2 -std=c++17 -Wall \
+        -I$LIB/LogFormat \
+        $tool.cpp LogRecovery.cpp \
+        $LIB/LogFormat/LogFormat.cpp \
+        -o $tool || exit 1
+done
+g++ -O2 -std=c++17 -Wall \
+    -I$LIB/LogFormat -I$LIB/SDWriter \
+    raw_extract.cpp \
+    $LIB/LogFormat/LogFormat.cpp \
+    -o raw_extract || exit 1
@@ -0,0 +1,80 @@
+/**
+ * @file log_recover.cpp
+ * @brief Extracts every intact session of the typed log format from a damaged log file or an SD card image.
+ *
+ * Maps the input into memory, scans it with the LogRecovery class and prints a table of the
+ * sessions (blocks, lost blocks, sync blocks, data behind the last sync block, time span). With an
+ * output prefix every session with a schema is written as prefix_<n>_<session>.bin, the files are
+ * clean log files for log_dump and LogReader.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./log_recover 007.bin                        // report only
+ * ./log_recover 007.bin recovered              // writes recovered_0_xxxx.bin, ...
+ * sudo dd if=/dev/sdb of=card.img bs=1M        // image of the whole card (linux)
+ * ./log_recover card.img recovered
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "LogRecovery.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s file_or_image [output_prefix]\n", argv[0]);
+        return 1;
+    }
+
+    const int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        printf("could not open %s\n", argv[1]);
+        return 1;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("mmap of %s failed\n", argv[1]);
+        return 1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    LogRecovery recovery;
+    recovery.scan(static_cast<const uint8_t*>(data), size);
+
+    const LogRecovery::Statistics& statistics = recovery.getStatistics();
+    printf("%s: %zu valid blocks, %zu duplicate, %zu schema blocks without session, %zu bad regions (%zu bytes)\n", argv[1],
+           statistics.num_of_blocks, statistics.num_of_duplicate_blocks, statistics.num_of_orphan_blocks,
+           statistics.num_of_bad_regions, statistics.num_of_skipped_bytes);
+    printf("  #  session  schema  data blocks  lost  sync  last sync  after sync  start [s]  duration [s]  file\n");
+    for (size_t i = 0; i < recovery.getSessions().size(); i++) {
+        const LogRecovery::Session& session = recovery.getSessions()[i];
+        std::string path = "-";
+        if ((argc > 2) && session.hasSchema()) {
+            char name[32];
+            snprintf(name, sizeof(name), "_%zu_%04x.bin", i, (unsigned)session.session);
+            path = argv[2] + std::string(name);
+            if (!recovery.writeSession(i, path))
+                path = "failed";
+        }
+        printf("%3zu     %04x  %6s  %11zu  %4zu  %4zu  %9lu  %10zu  %9.3f  %12.3f  %s\n", i, (unsigned)session.session,
+               session.hasSchema() ? "yes" : "no", session.num_of_data_blocks, session.num_of_lost_blocks,
+               session.num_of_sync_blocks, (unsigned long)session.last_sync_index, session.num_of_blocks_after_last_sync,
+               1.0e-6 * session.first_time_us, 1.0e-6 * (session.last_time_us - session.first_time_us), path.c_str());
+    }
+
+    munmap(data, size);
+    return 0;
+}
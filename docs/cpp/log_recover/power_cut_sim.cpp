@@ -0,0 +1,374 @@
+/**
+ * @file power_cut_sim.cpp
+ * @brief Host side power cut simulation of the SDLogger write path with a block device stand-in.
+ *
+ * Emulates the typed log format of the SDLogger (one stream of float channels, blocks written in
+ * chunks of 4 sectors) on a block device stand-in, an array of 512 byte sectors. Every write takes
+ * cmd_us plus sector_us per sector and every spike_sectors sectors the card is busy for spike_ms
+ * (like docs/cpp/sdlogger_benchmark). The power is cut at random times:
+ * - the writes that are complete before the cut are on the device, the write in progress has
+ *   written its first sectors, the sector in progress is torn (only a random part is new)
+ * - the device is filled with the blocks of an older session before, like a reused preallocated
+ *   file or a raw partition that wrapped around
+ *
+ * Compared modes:
+ * - fat flush:    file system, fflush every 5 s (SDLogger before the crash consistent mode), the
+ *                 size in the directory is only written when the file is closed
+ * - fat fsync:    file system, fflush and fsync every 5 s, the size in the directory is the size
+ *                 at the last completed fsync
+ * - fat crash:    crash consistent mode, preallocated file, sync block and fsync every 1 s
+ * - raw:          raw region, sync block and index update every 1 s
+ *
+ * For every cut the file (the first "size in the directory" bytes of the file) and the image of
+ * the device are scanned with LogRecovery. Reports the recovered part of the records sent before
+ * the cut, the time between the last recovered record and the cut, and the number of records
+ * with wrong values (torn or stale blocks that were accepted), which has to be 0.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./power_cut_sim [--floats 22] [--rate 500] [--time 60] [--cuts 100] [--spike_ms 150] [--seed 1]
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "LogFormat.h"
+#include "LogRecovery.h"
+
+#define CHUNK_SIZE 4 // blocks per write, SD_LOGGER_WRITE_SIZE / LOG_FORMAT_BLOCK_SIZE
+
+struct Parameters {
+    uint8_t num_of_floats = 22;
+    double rate = 500.0;
+    double time_s = 60.0;
+    int num_of_cuts = 100;
+    double cmd_us = 800.0;
+    double sector_us = 450.0;
+    double spike_ms = 150.0;
+    uint32_t spike_sectors = 256;
+    uint32_t seed = 1;
+};
+
+struct Mode {
+    const char* name;
+    double sync_period_s;
+    bool do_fsync;       // the size in the directory (or the raw index) is updated at every sync
+    bool do_sync_blocks;
+    bool is_whole_file;  // preallocated file or raw partition, the whole region is readable after the cut
+};
+
+// an array of sectors, a write in progress at a power cut writes its first sectors and tears the next one
+class BlockDeviceStandIn
+{
+public:
+    explicit BlockDeviceStandIn(size_t num_of_blocks) : m_data(num_of_blocks * LOG_FORMAT_BLOCK_SIZE, 0) {}
+
+    void program(size_t block, const uint8_t* data, size_t num_of_blocks)
+    {
+        memcpy(&m_data[block * LOG_FORMAT_BLOCK_SIZE], data, num_of_blocks * LOG_FORMAT_BLOCK_SIZE);
+    }
+    void programTorn(size_t block, const uint8_t* data, size_t num_of_bytes)
+    {
+        memcpy(&m_data[block * LOG_FORMAT_BLOCK_SIZE], data, num_of_bytes);
+    }
+
+    const uint8_t* getData() const { return m_data.data(); };
+    size_t getSize() const { return m_data.size(); };
+    size_t getNumOfBlocks() const { return m_data.size() / LOG_FORMAT_BLOCK_SIZE; };
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+struct WriteOp {
+    double start_us;
+    double end_us;
+    size_t block;              // first block in the region of the file
+    std::vector<uint8_t> data; // empty for the fsync or raw index write
+    size_t committed_size;     // size in the directory after an fsync
+};
+
+// the SDLogger thread with the typed log format, records are packed as they arrive, a chunk is written when it is full
+class LoggerModel
+{
+public:
+    LoggerModel(const Parameters& parameters, const Mode& mode, uint16_t session, bool is_stale)
+        : m_parameters(parameters), m_mode(mode), m_session(session), m_is_stale(is_stale)
+    {
+        for (uint8_t i = 0; i < parameters.num_of_floats; i++) {
+            char name[LOG_FORMAT_NAME_SIZE];
+            snprintf(name, sizeof(name), "ch%u", (unsigned)i);
+            m_schema.addChannel(name, LOG_TYPE_FLOAT, "", static_cast<float>(parameters.rate), 1.0f);
+        }
+        m_record_size = m_schema.getRecordSize();
+        m_data_block.setChannels(m_schema.getChannels(), m_schema.getNumOfChannels(), false);
+    }
+
+    // runs the logger until max_blocks are written or the time is over
+    std::vector<WriteOp> run(size_t max_blocks)
+    {
+        uint8_t block[LOG_FORMAT_BLOCK_SIZE];
+        for (uint8_t i = 0; i < m_schema.getNumOfSchemaBlocks(); i++) {
+            m_schema.writeSchemaBlock(block, i, m_seq++);
+            m_chunk.insert(m_chunk.end(), block, block + LOG_FORMAT_BLOCK_SIZE);
+        }
+
+        const size_t num_of_records = static_cast<size_t>(m_parameters.time_s * m_parameters.rate);
+        double sync_time_us = m_mode.sync_period_s * 1.0e6;
+        std::vector<uint8_t> record(m_record_size);
+        for (size_t i = 0; (i < num_of_records) && (m_block < max_blocks); i++) {
+            const double time_us = i * 1.0e6 / m_parameters.rate;
+            if (time_us >= sync_time_us) {
+                sync(time_us);
+                sync_time_us += m_mode.sync_period_s * 1.0e6;
+            }
+            // the values tell the record index and the session apart from stale data
+            for (uint8_t c = 0; c < m_parameters.num_of_floats; c++) {
+                const float value = static_cast<float>(i + c) * (m_is_stale ? -1.0f : 1.0f);
+                m_schema.encodeValue(record.data(), c, value);
+            }
+            addRecord(static_cast<uint32_t>(i), time_us, record.data());
+        }
+        return m_ops;
+    }
+
+    size_t getRecordSize() const { return m_record_size; };
+
+private:
+    const Parameters& m_parameters;
+    Mode m_mode;
+    uint16_t m_session;
+    bool m_is_stale;
+    LogSchema m_schema;
+    size_t m_record_size;
+
+    LogDataBlock m_data_block;
+    uint32_t m_seq{0};
+    uint32_t m_sync_index{0};
+    std::vector<uint8_t> m_chunk;
+    size_t m_block{0};  // next block of the file
+    double m_card_free_us{0.0};
+    uint32_t m_sectors{0};
+    std::vector<WriteOp> m_ops;
+
+    void addRecord(uint32_t index, double time_us, const uint8_t* record)
+    {
+        if (!m_data_block.isStarted())
+            m_data_block.begin(0, m_session, index, static_cast<uint64_t>(time_us));
+        if (!m_data_block.add(record, static_cast<uint64_t>(time_us))) {
+            finishBlock(time_us);
+            m_data_block.begin(0, m_session, index, static_cast<uint64_t>(time_us));
+            m_data_block.add(record, static_cast<uint64_t>(time_us));
+        }
+    }
+
+    void finishBlock(double time_us)
+    {
+        uint8_t block[LOG_FORMAT_BLOCK_SIZE];
+        m_data_block.finish(block, m_seq++);
+        m_chunk.insert(m_chunk.end(), block, block + LOG_FORMAT_BLOCK_SIZE);
+        if (m_chunk.size() >= CHUNK_SIZE * LOG_FORMAT_BLOCK_SIZE)
+            writeChunk(time_us);
+    }
+
+    void sync(double time_us)
+    {
+        if (m_data_block.isStarted())
+            finishBlock(time_us);
+        if (m_mode.do_sync_blocks) {
+            uint8_t block[LOG_FORMAT_BLOCK_SIZE];
+            memset(block, 0, sizeof(block));
+            LogSyncHeader sync_header;
+            memset(&sync_header, 0, sizeof(sync_header));
+            sync_header.session = m_session;
+            sync_header.sync_index = m_sync_index++;
+            sync_header.time_us = static_cast<uint64_t>(time_us);
+            memcpy(&block[LOG_FORMAT_BLOCK_HEADER_SIZE], &sync_header, sizeof(sync_header));
+            logFinishBlock(block, LOG_BLOCK_SYNC, sizeof(sync_header), m_seq++);
+            m_chunk.insert(m_chunk.end(), block, block + LOG_FORMAT_BLOCK_SIZE);
+        }
+        writeChunk(time_us);
+        if (m_mode.do_fsync) {
+            // directory entry or raw index, one sector somewhere else
+            WriteOp op;
+            op.start_us = std::max(time_us, m_card_free_us);
+            op.end_us = op.start_us + m_parameters.cmd_us + m_parameters.sector_us;
+            op.block = 0;
+            op.committed_size = m_block * LOG_FORMAT_BLOCK_SIZE;
+            m_card_free_us = op.end_us;
+            m_ops.push_back(op);
+        }
+    }
+
+    void writeChunk(double time_us)
+    {
+        while (!m_chunk.empty()) {
+            const size_t num_of_blocks = std::min(m_chunk.size() / LOG_FORMAT_BLOCK_SIZE, static_cast<size_t>(CHUNK_SIZE));
+            WriteOp op;
+            op.start_us = std::max(time_us, m_card_free_us);
+            op.end_us = op.start_us + m_parameters.cmd_us + num_of_blocks * m_parameters.sector_us;
+            // the card is busy from time to time (garbage collection)
+            if ((m_sectors + num_of_blocks) / m_parameters.spike_sectors != m_sectors / m_parameters.spike_sectors)
+                op.end_us += m_parameters.spike_ms * 1.0e3;
+            m_sectors += static_cast<uint32_t>(num_of_blocks);
+            op.block = m_block;
+            op.data.assign(m_chunk.begin(), m_chunk.begin() + num_of_blocks * LOG_FORMAT_BLOCK_SIZE);
+            op.committed_size = 0;
+            m_chunk.erase(m_chunk.begin(), m_chunk.begin() + num_of_blocks * LOG_FORMAT_BLOCK_SIZE);
+            m_block += num_of_blocks;
+            m_card_free_us = op.end_us;
+            m_ops.push_back(op);
+        }
+    }
+};
+
+struct Result {
+    double recovered_sum{0.0};
+    double lost_ms_sum{0.0};
+    double lost_ms_max{0.0};
+    size_t num_of_wrong_records{0};
+};
+
+// checks the records of the session against the values written by the logger
+static void evaluate(const LogRecovery& recovery, uint16_t session, size_t record_size, size_t num_of_sent,
+                     double cut_us, double rate, Result& result)
+{
+    std::vector<bool> is_recovered(num_of_sent, false);
+    size_t num_of_recovered = 0;
+    size_t last_index = 0;
+    for (const LogRecovery::Session& s : recovery.getSessions()) {
+        if ((s.session != session) || !s.hasSchema())
+            continue;
+        for (const uint8_t* block : s.blocks) {
+            LogBlockHeader header;
+            memcpy(&header, block, sizeof(header));
+            if (header.type != LOG_BLOCK_DATA)
+                continue;
+            LogDataHeader data_header;
+            const uint8_t* times;
+            uint16_t times_size;
+            const uint8_t* records;
+            uint16_t records_size;
+            if (!logParseDataBlock(block, data_header, times, times_size, records, records_size))
+                continue;
+            const size_t num_of_records = records_size / record_size;
+            for (size_t r = 0; r < num_of_records; r++) {
+                const uint8_t* record = records + r * record_size;
+                const size_t index = data_header.first_record + r;
+                bool is_valid = (index < num_of_sent);
+                for (size_t c = 0; (c < record_size / sizeof(float)) && is_valid; c++) {
+                    float value;
+                    memcpy(&value, record + c * sizeof(float), sizeof(value));
+                    is_valid = (value == static_cast<float>(index + c));
+                }
+                if (!is_valid || is_recovered[index]) {
+                    result.num_of_wrong_records++;
+                    continue;
+                }
+                is_recovered[index] = true;
+                num_of_recovered++;
+                last_index = std::max(last_index, index);
+            }
+        }
+    }
+    result.recovered_sum += (num_of_sent > 0) ? static_cast<double>(num_of_recovered) / num_of_sent : 1.0;
+    const double lost_ms = 1.0e-3 * (cut_us - ((num_of_recovered > 0) ? last_index * 1.0e6 / rate : 0.0));
+    result.lost_ms_sum += lost_ms;
+    result.lost_ms_max = std::max(result.lost_ms_max, lost_ms);
+}
+
+int main(int argc, char** argv)
+{
+    Parameters parameters;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--floats") == 0)
+            parameters.num_of_floats = static_cast<uint8_t>(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--rate") == 0)
+            parameters.rate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--time") == 0)
+            parameters.time_s = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--cuts") == 0)
+            parameters.num_of_cuts = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--spike_ms") == 0)
+            parameters.spike_ms = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            parameters.seed = static_cast<uint32_t>(atoi(argv[i + 1]));
+    }
+
+    const Mode modes[] = {
+        {"fat flush", 5.0, false, false, false},
+        {"fat fsync", 5.0, true, false, false},
+        {"fat crash", 1.0, true, true, true},
+        {"raw", 1.0, true, true, true},
+    };
+    const uint16_t session = 0x1234;
+    const uint16_t stale_session = 0x4321;
+
+    printf("%u floats at %.0f Hz, %.0f s, %d power cuts, card %.0f us + %.0f us per sector, %.0f ms busy every %u sectors\n",
+           (unsigned)parameters.num_of_floats, parameters.rate, parameters.time_s, parameters.num_of_cuts, parameters.cmd_us,
+           parameters.sector_us, parameters.spike_ms, parameters.spike_sectors);
+    printf("mode        file: recovered  lost mean/max [ms]   image: recovered  lost mean/max [ms]   wrong records\n");
+
+    for (const Mode& mode : modes) {
+        LoggerModel logger(parameters, mode, session, false);
+        const std::vector<WriteOp> ops = logger.run(SIZE_MAX);
+        const size_t num_of_blocks = ops.empty() ? 0 : ops.back().block + ops.back().data.size() / LOG_FORMAT_BLOCK_SIZE;
+
+        // the region was used by an older session before
+        BlockDeviceStandIn stale_device(num_of_blocks + CHUNK_SIZE);
+        LoggerModel stale_logger(parameters, mode, stale_session, true);
+        for (const WriteOp& op : stale_logger.run(stale_device.getNumOfBlocks() - CHUNK_SIZE)) {
+            if (!op.data.empty())
+                stale_device.program(op.block, op.data.data(), op.data.size() / LOG_FORMAT_BLOCK_SIZE);
+        }
+
+        std::mt19937 generator(parameters.seed);
+        std::uniform_real_distribution<double> cut_distribution(1.0e6, parameters.time_s * 1.0e6);
+        std::uniform_int_distribution<size_t> torn_distribution(1, LOG_FORMAT_BLOCK_SIZE - 1);
+        Result file_result;
+        Result image_result;
+        for (int cut = 0; cut < parameters.num_of_cuts; cut++) {
+            const double cut_us = cut_distribution(generator);
+            BlockDeviceStandIn device = stale_device;
+            size_t committed_size = mode.is_whole_file ? device.getSize() : 0;
+            for (const WriteOp& op : ops) {
+                if (op.end_us <= cut_us) {
+                    if (op.data.empty())
+                        committed_size = mode.is_whole_file ? device.getSize() : op.committed_size;
+                    else
+                        device.program(op.block, op.data.data(), op.data.size() / LOG_FORMAT_BLOCK_SIZE);
+                } else if ((op.start_us < cut_us) && !op.data.empty()) {
+                    // the first sectors of the write in progress are written, the next one is torn
+                    const double sectors = (cut_us - op.start_us - parameters.cmd_us) / parameters.sector_us;
+                    const size_t num_of_sectors = std::min(static_cast<size_t>(std::max(sectors, 0.0)), op.data.size() / LOG_FORMAT_BLOCK_SIZE);
+                    device.program(op.block, op.data.data(), num_of_sectors);
+                    if ((sectors > 0.0) && (num_of_sectors < op.data.size() / LOG_FORMAT_BLOCK_SIZE))
+                        device.programTorn(op.block + num_of_sectors, &op.data[num_of_sectors * LOG_FORMAT_BLOCK_SIZE], torn_distribution(generator));
+                }
+            }
+
+            const size_t num_of_sent = static_cast<size_t>(cut_us * 1.0e-6 * parameters.rate) + 1;
+            LogRecovery recovery;
+            recovery.scan(device.getData(), committed_size);
+            evaluate(recovery, session, logger.getRecordSize(), num_of_sent, cut_us, parameters.rate, file_result);
+            recovery.scan(device.getData(), device.getSize());
+            evaluate(recovery, session, logger.getRecordSize(), num_of_sent, cut_us, parameters.rate, image_result);
+        }
+
+        const double n = static_cast<double>(parameters.num_of_cuts);
+        printf("%-10s  %14.1f %%  %8.0f / %6.0f   %15.1f %%  %8.0f / %6.0f   %13zu\n", mode.name,
+               100.0 * file_result.recovered_sum / n, file_result.lost_ms_sum / n, file_result.lost_ms_max,
+               100.0 * image_result.recovered_sum / n, image_result.lost_ms_sum / n, image_result.lost_ms_max,
+               file_result.num_of_wrong_records + image_result.num_of_wrong_records);
+    }
+    return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file raw_extract.cpp
+ * @brief Extracts the sessions of the raw log region (SD_LOGGER_RAW_PARTITION) from an image of the SD card.
+ *
+ * Maps the input into memory and looks for the index of the raw region (see SDRawIndex.h) at the
+ * start of the image (image of the region only), at the start of every primary partition and
+ * behind the last partition (image of the whole card). It prints a table of the sessions in the
+ * index, with an output prefix every session is written as prefix_<session>.bin, a clean log file
+ * for log_dump and LogReader:
+ * - the blocks are copied in ring order, a session that wrapped around the end of the region is
+ *   continuous in the file
+ * - a session that was cut off (not closed) can have up to SD_RAW_INDEX_INTERVAL blocks more than
+ *   its index entry tells, they are appended as long as they are intact log blocks of the session
+ * - a session that was partly overwritten by newer sessions is marked, the reader drops the
+ *   foreign blocks by their session
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * sudo dd if=/dev/sdb of=card.img bs=1M       // image of the whole card (linux)
+ * ./raw_extract card.img                       // list the sessions
+ * ./raw_extract card.img raw                   // writes raw_0001.bin, raw_0002.bin, ...
+ * ./raw_extract card.img raw 7                 // only session 7
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "LogFormat.h"
+#include "SDRawIndex.h"
+
+namespace {
+
+struct Region {
+    uint64_t first_block;   // on the card
+    uint32_t num_of_blocks; // from the index
+    SDRawIndex index;
+};
+
+bool readIndex(const uint8_t* data, size_t size, uint64_t first_block, Region& region)
+{
+    if ((first_block + 1) * SD_RAW_BLOCK_SIZE > size)
+        return false;
+    memcpy(&region.index, data + first_block * SD_RAW_BLOCK_SIZE, sizeof(region.index));
+    if ((region.index.magic != SD_RAW_INDEX_MAGIC) || (region.index.checksum != sdRawIndexChecksum(region.index)))
+        return false;
+    region.first_block = first_block;
+    region.num_of_blocks = region.index.num_of_blocks;
+    return true;
+}
+
+// the index is at the start of the image or of a region in the partition table
+bool findRegion(const uint8_t* data, size_t size, Region& region)
+{
+    if (readIndex(data, size, 0, region))
+        return true;
+    if ((size < SD_RAW_BLOCK_SIZE) || (data[510] != 0x55) || (data[511] != 0xAA))
+        return false;
+    uint64_t free_space = 0;
+    for (int i = 0; i < 4; i++) {
+        const uint8_t* entry = &data[446 + 16 * i];
+        uint32_t first_block, num_of_blocks;
+        memcpy(&first_block, &entry[8], sizeof(first_block));
+        memcpy(&num_of_blocks, &entry[12], sizeof(num_of_blocks));
+        if (entry[4] == 0)
+            continue;
+        if (readIndex(data, size, first_block, region))
+            return true;
+        if (static_cast<uint64_t>(first_block) + num_of_blocks > free_space)
+            free_space = static_cast<uint64_t>(first_block) + num_of_blocks;
+    }
+    return (free_space > 0) && readIndex(data, size, free_space, region);
+}
+
+// blocks of the region covered by a session, split where the ring wraps around
+void getRanges(const SDRawSession& session, uint32_t num_of_blocks, uint32_t n, std::vector<std::pair<uint32_t, uint32_t>>& ranges)
+{
+    ranges.clear();
+    uint32_t block = session.first_block;
+    while (n > 0) {
+        const uint32_t length = (n < num_of_blocks - block) ? n : num_of_blocks - block;
+        ranges.emplace_back(block, block + length);
+        block = sdRawWrapBlock(block + length, num_of_blocks);
+        n -= length;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s image [output_prefix [session]]\n", argv[0]);
+        return 1;
+    }
+
+    const int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        printf("could not open %s\n", argv[1]);
+        return 1;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("mmap of %s failed\n", argv[1]);
+        return 1;
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(mapping);
+
+    Region region;
+    if (!findRegion(data, size, region)) {
+        printf("%s: no raw log region found\n", argv[1]);
+        munmap(mapping, size);
+        return 1;
+    }
+    const uint8_t* region_data = data + region.first_block * SD_RAW_BLOCK_SIZE;
+    const uint64_t num_of_blocks_in_image = size / SD_RAW_BLOCK_SIZE - region.first_block;
+    printf("%s: raw region at block %llu, %lu blocks (%.1f MB), last session %lu\n", argv[1],
+           (unsigned long long)region.first_block, (unsigned long)region.num_of_blocks,
+           region.num_of_blocks * (double)SD_RAW_BLOCK_SIZE / 1.0e6, (unsigned long)region.index.last_session);
+    if (num_of_blocks_in_image < region.num_of_blocks)
+        printf("warning: the image ends after %llu blocks of the region\n", (unsigned long long)num_of_blocks_in_image);
+
+    // sessions in the order they were written
+    std::vector<SDRawSession> sessions;
+    for (const SDRawSession& session : region.index.sessions) {
+        if ((session.session != 0) && (session.first_block > 0) && (session.first_block < region.num_of_blocks))
+            sessions.push_back(session);
+    }
+    std::sort(sessions.begin(), sessions.end(), [](const SDRawSession& a, const SDRawSession& b) { return a.session < b.session; });
+
+    const uint32_t session_filter = (argc > 3) ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 0;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges, newer_ranges;
+    printf("session  first block  blocks  appended  closed  overwritten  file\n");
+    for (size_t i = 0; i < sessions.size(); i++) {
+        const SDRawSession& session = sessions[i];
+        uint32_t n = (session.num_of_blocks < region.num_of_blocks - 1) ? session.num_of_blocks : region.num_of_blocks - 1;
+
+        // the blocks written after the last index update of a session that was cut off
+        uint32_t num_of_appended = 0;
+        if (!session.is_closed) {
+            const uint16_t log_session = (static_cast<uint16_t>(session.session) != 0) ? static_cast<uint16_t>(session.session) : 1;
+            uint32_t block = sdRawWrapBlock(session.first_block + n, region.num_of_blocks);
+            while ((num_of_appended < SD_RAW_INDEX_INTERVAL) && (n < region.num_of_blocks - 1) && (block < num_of_blocks_in_image)) {
+                const uint8_t* candidate = region_data + static_cast<uint64_t>(block) * SD_RAW_BLOCK_SIZE;
+                if (!logCheckBlock(candidate) || (logGetBlockSession(candidate) != log_session))
+                    break;
+                num_of_appended++;
+                n++;
+                block = sdRawWrapBlock(block + 1, region.num_of_blocks);
+            }
+        }
+
+        // a newer session that starts inside this one overwrote its tail
+        getRanges(session, region.num_of_blocks, n, ranges);
+        bool is_overwritten = false;
+        for (size_t j = i + 1; (j < sessions.size()) && !is_overwritten; j++) {
+            const SDRawSession& newer = sessions[j];
+            const uint32_t newer_n = newer.is_closed ? newer.num_of_blocks : newer.num_of_blocks + SD_RAW_INDEX_INTERVAL;
+            getRanges(newer, region.num_of_blocks, (newer_n < region.num_of_blocks - 1) ? newer_n : region.num_of_blocks - 1, newer_ranges);
+            for (const auto& a : ranges)
+                for (const auto& b : newer_ranges)
+                    is_overwritten |= (a.first < b.second) && (b.first < a.second);
+        }
+
+        std::string path = "-";
+        if ((argc > 2) && ((session_filter == 0) || (session_filter == session.session))) {
+            char name[32];
+            snprintf(name, sizeof(name), "_%04lu.bin", (unsigned long)session.session);
+            path = argv[2] + std::string(name);
+            FILE* file = fopen(path.c_str(), "wb");
+            bool ok = (file != nullptr);
+            for (const auto& range : ranges) {
+                // blocks missing in the image are left out
+                const uint64_t end = (range.second < num_of_blocks_in_image) ? range.second : num_of_blocks_in_image;
+                if (ok && (end > range.first))
+                    ok = (fwrite(region_data + static_cast<uint64_t>(range.first) * SD_RAW_BLOCK_SIZE, SD_RAW_BLOCK_SIZE,
+                                 end - range.first, file) == end - range.first);
+            }
+            if (file)
+                ok &= (fclose(file) == 0);
+            if (!ok)
+                path = "failed";
+        }
+        printf("%7lu  %11lu  %6lu  %8lu  %6s  %11s  %s\n", (unsigned long)session.session, (unsigned long)session.first_block,
+               (unsigned long)session.num_of_blocks, (unsigned long)num_of_appended, session.is_closed ? "yes" : "no",
+               is_overwritten ? "yes" : "no", path.c_str());
+    }
+
+    munmap(mapping, size);
+    return 0;
+}
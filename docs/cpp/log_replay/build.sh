@@ -0,0 +1,18 @@
+#!/bin/bash
+# builds the host side replay of logged signals through the firmware control classes, needs g++ with c++17 support and mmap (linux, macos)
+cd "$(dirname "$0")"
+LIB=../../../lib
+# same eigen flags as the firmware (platformio.ini)
+g++ -O2 -std=c++17 -Wall -DEIGEN_NO_DEBUG -DEIGEN_DONT_VECTORIZE \
+    -I../log_reader -I$LIB/LogFormat -I$LIB/PIDCntrl -I$LIB/IIRFilter -I$LIB/Mahony \
+    -I$LIB/LineFollowerCntrl -I$LIB/LineTracker -I$LIB/SpeedScheduler -I$LIB/SensorBar -I$LIB/AvgFilter -I$LIB/eigen-lib \
+    log_replay.cpp ../log_reader/LogReader.cpp \
+    $LIB/LogFormat/LogFormat.cpp \
+    $LIB/PIDCntrl/PIDCntrl.cpp \
+    $LIB/IIRFilter/IIRFilter.cpp \
+    $LIB/Mahony/Mahony.cpp \
+    $LIB/LineFollowerCntrl/LineFollowerCntrl.cpp \
+    $LIB/LineTracker/LineTracker.cpp \
+    $LIB/SpeedScheduler/SpeedScheduler.cpp \
+    $LIB/AvgFilter/AvgFilter.cpp \
+    -o log_replay || exit 1
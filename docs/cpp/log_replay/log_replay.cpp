@@ -0,0 +1,463 @@
+/**
+ * @file log_replay.cpp
+ * @brief Host side replay of logged signals through the control classes of the firmware.
+ *
+ * Reads an SDLogger file (typed or plain format) with the LogReader class and feeds the input
+ * channels record by record into the unmodified firmware class, the outputs are compared with the
+ * logged outputs of the robot (reference channels):
+ * - pid: PIDCntrl, inputs e (update(e)), e and y (update(e, y)) or w, y_p, y_i, y_d, output u
+ * - iir: IIRFilter, input x, output y, type lowpass1, lowpass2, notch, leadlag1, dlowpass1 (differentiating
+ *   lowpass), integrator or differentiator
+ * - mahony: Mahony, inputs gyro x y z in rad/s and acc x y z (and mag x y z), outputs roll, pitch, yaw in rad
+ * - line_follower: LineFollowerCntrl (the algorithm of the LineFollower thread), input the raw byte of the
+ *   SensorBar, outputs the right and left wheel velocity in rps and the angle in rad
+ *
+ * The inputs are decoded into memory first and the class runs over all records without I/O, the
+ * replay is run twice and has to give bitwise equal outputs (deterministic). The summary gives per
+ * output the max. and rms difference to the reference and the first record with a difference above
+ * the tolerance, the time per step and the speed compared with real time. The exit code is 1 if a
+ * difference is above the tolerance, so a replay of a known good log is a regression test.
+ *
+ * The channels are given by name, plain files have the names ch0, ch1, ... The inputs and the
+ * references have to be in the same stream. The sampling time is the mean period of the record
+ * times (including lost records), the rate from the schema or --ts. The robot and the host both
+ * compute in single precision, but the firmware is compiled with fused multiply add and its own
+ * libm, so the outputs of a field log agree to about 1e-6 relative, not bit by bit.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./log_replay 001.bin pid --in e --param P=1.2,I=10,D=0.01,tau_f=0.002,umin=-12,umax=12 --ref u
+ * ./log_replay 001.bin iir --in omega --param type=lowpass2,fcut=20,D=0.7 --ref omega_f --tol 1e-5
+ * ./log_replay 001.bin mahony --in gx,gy,gz,ax,ay,az --param kp=2,ki=0.1 --ref roll,pitch --out replay.csv
+ * ./log_replay 001.bin line_follower --in raw --param kp=2.4,kp_nl=20.4,vel=2.5,tracker=1 --ref vel_r,vel_l
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "IIRFilter.h"
+#include "LineFollowerCntrl.h"
+#include "LogReader.h"
+#include "Mahony.h"
+#include "PIDCntrl.h"
+
+typedef std::map<std::string, float> Params;
+
+// one firmware class with its inputs and outputs
+class Replay
+{
+public:
+    virtual ~Replay() = default;
+    // false if the number of inputs does not fit
+    virtual bool setup(const Params& params, size_t num_of_inputs, float Ts) = 0;
+    virtual void step(const float* inputs, float* outputs) = 0;
+    virtual std::vector<std::string> getOutputNames() const = 0;
+};
+
+static float getParam(const Params& params, const char* name, float value)
+{
+    const auto it = params.find(name);
+    return (it != params.end()) ? it->second : value;
+}
+
+class ReplayPID : public Replay
+{
+public:
+    bool setup(const Params& params, size_t num_of_inputs, float Ts) override
+    {
+        m_num_of_inputs = num_of_inputs;
+        const float u_max = getParam(params, "umax", 1.0e9f);
+        m_PIDCntrl.setup(getParam(params, "P", 0.0f), getParam(params, "I", 0.0f), getParam(params, "D", 0.0f),
+                         getParam(params, "tau_f", 0.0f), getParam(params, "tau_ro", 0.0f), Ts, getParam(params, "umin", -u_max), u_max);
+        if (params.count("F"))
+            m_PIDCntrl.setCoeff_F(params.at("F"));
+        m_PIDCntrl.reset(getParam(params, "u0", 0.0f));
+        return (num_of_inputs == 1) || (num_of_inputs == 2) || (num_of_inputs == 4);
+    }
+    void step(const float* inputs, float* outputs) override
+    {
+        if (m_num_of_inputs == 1)
+            outputs[0] = m_PIDCntrl.update(inputs[0]);
+        else if (m_num_of_inputs == 2)
+            outputs[0] = m_PIDCntrl.update(inputs[0], inputs[1]);
+        else
+            outputs[0] = m_PIDCntrl.update(inputs[0], inputs[1], inputs[2], inputs[3]);
+    }
+    std::vector<std::string> getOutputNames() const override { return {"u"}; }
+
+private:
+    PIDCntrl m_PIDCntrl;
+    size_t m_num_of_inputs{1};
+};
+
+class ReplayIIR : public Replay
+{
+public:
+    explicit ReplayIIR(const std::string& type) : m_type(type) {}
+
+    bool setup(const Params& params, size_t num_of_inputs, float Ts) override
+    {
+        const float fcut = getParam(params, "fcut", 10.0f);
+        const float D = getParam(params, "D", 1.0f / sqrtf(2.0f));
+        if (m_type == "lowpass1")
+            m_IIRFilter.lowPass1Init(fcut, Ts);
+        else if (m_type == "lowpass2")
+            m_IIRFilter.lowPass2Init(fcut, D, Ts);
+        else if (m_type == "notch")
+            m_IIRFilter.notchInit(fcut, D, Ts);
+        else if (m_type == "leadlag1")
+            m_IIRFilter.leadLag1Init(getParam(params, "fzero", 1.0f), getParam(params, "fpole", 10.0f), Ts);
+        else if (m_type == "dlowpass1")
+            m_IIRFilter.differentiatingLowPass1Init(fcut, Ts);
+        else if (m_type == "integrator")
+            m_IIRFilter.integratorInit(Ts);
+        else if (m_type == "differentiator")
+            m_IIRFilter.differentiatorInit(Ts);
+        else
+            return false;
+        if (params.count("y0"))
+            m_IIRFilter.reset(params.at("y0"));
+        return num_of_inputs == 1;
+    }
+    void step(const float* inputs, float* outputs) override { outputs[0] = m_IIRFilter.apply(inputs[0]); }
+    std::vector<std::string> getOutputNames() const override { return {"y"}; }
+
+private:
+    std::string m_type;
+    IIRFilter m_IIRFilter;
+};
+
+class ReplayMahony : public Replay
+{
+public:
+    bool setup(const Params& params, size_t num_of_inputs, float Ts) override
+    {
+        m_Mahony.setup(getParam(params, "kp", 2.0f), getParam(params, "ki", 0.1f), Ts);
+        m_use_mag = (num_of_inputs == 9);
+        return (num_of_inputs == 6) || (num_of_inputs == 9);
+    }
+    void step(const float* inputs, float* outputs) override
+    {
+        const Eigen::Vector3f gyro(inputs[0], inputs[1], inputs[2]);
+        const Eigen::Vector3f acc(inputs[3], inputs[4], inputs[5]);
+        if (m_use_mag)
+            m_Mahony.update(gyro, acc, Eigen::Vector3f(inputs[6], inputs[7], inputs[8]));
+        else
+            m_Mahony.update(gyro, acc);
+        const Eigen::Vector3f rpy = m_Mahony.getOrientationAsRPYAngles();
+        outputs[0] = rpy(0);
+        outputs[1] = rpy(1);
+        outputs[2] = rpy(2);
+    }
+    std::vector<std::string> getOutputNames() const override { return {"roll", "pitch", "yaw"}; }
+
+private:
+    Mahony m_Mahony;
+    bool m_use_mag{false};
+};
+
+class ReplayLineFollower : public Replay
+{
+public:
+    bool setup(const Params& params, size_t num_of_inputs, float Ts) override
+    {
+        // robot of the line follower simulator, 78:1 gear
+        m_LineFollowerCntrl.reset(new LineFollowerCntrl(getParam(params, "bar_dist", 0.118f), getParam(params, "d_wheel", 0.035f),
+                                                        getParam(params, "b_wheel", 0.1518f), getParam(params, "vmax", 3.0f), Ts));
+        m_LineFollowerCntrl->setRotationalVelocityGain(getParam(params, "kp", 2.0f), getParam(params, "kp_nl", 17.0f));
+        if (params.count("vel"))
+            m_LineFollowerCntrl->setMaxWheelVelocityRPS(params.at("vel"));
+        m_LineFollowerCntrl->enableLineTracker(getParam(params, "tracker", 0.0f) != 0.0f);
+        if (getParam(params, "sched", 0.0f) != 0.0f) {
+            m_LineFollowerCntrl->enableSpeedScheduling(true);
+            m_LineFollowerCntrl->setSpeedSchedulingLimits(getParam(params, "acc_lat_max", 2.0f), getParam(params, "acc_max", 2.0f),
+                                                          getParam(params, "dec_max", 4.0f));
+        }
+        return num_of_inputs == 1;
+    }
+    void step(const float* inputs, float* outputs) override
+    {
+        // the raw byte is logged as float
+        m_LineFollowerCntrl->update(static_cast<uint8_t>(lrintf(inputs[0])));
+        outputs[0] = m_LineFollowerCntrl->getRightWheelVelocity();
+        outputs[1] = m_LineFollowerCntrl->getLeftWheelVelocity();
+        outputs[2] = m_LineFollowerCntrl->getAngleRadians();
+    }
+    std::vector<std::string> getOutputNames() const override { return {"vel_right", "vel_left", "angle"}; }
+
+private:
+    std::unique_ptr<LineFollowerCntrl> m_LineFollowerCntrl;
+};
+
+static std::unique_ptr<Replay> createReplay(const std::string& name, const std::string& iir_type)
+{
+    if (name == "pid")
+        return std::unique_ptr<Replay>(new ReplayPID());
+    if (name == "iir")
+        return std::unique_ptr<Replay>(new ReplayIIR(iir_type));
+    if (name == "mahony")
+        return std::unique_ptr<Replay>(new ReplayMahony());
+    if (name == "line_follower")
+        return std::unique_ptr<Replay>(new ReplayLineFollower());
+    return nullptr;
+}
+
+static std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= text.size()) {
+        const size_t end = std::min(text.find(separator, start), text.size());
+        if (end > start)
+            parts.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+// k=v,k=v, the iir type is the only text value
+static bool parseParams(const std::string& text, Params& params, std::string& iir_type)
+{
+    for (const std::string& part : split(text, ',')) {
+        const size_t eq = part.find('=');
+        if (eq == std::string::npos)
+            return false;
+        const std::string key = part.substr(0, eq);
+        const std::string value = part.substr(eq + 1);
+        if (key == "type") {
+            iir_type = value;
+            continue;
+        }
+        char* end;
+        params[key] = strtof(value.c_str(), &end);
+        if (*end != '\0')
+            return false;
+    }
+    return true;
+}
+
+// channel indices by name, false if a channel is missing or not in the stream (SIZE_MAX: the stream of the first channel)
+static bool findChannels(const LogReader& reader, const std::vector<std::string>& names, std::vector<size_t>& channels, size_t& stream)
+{
+    for (const std::string& name : names) {
+        const int channel = reader.findChannel(name);
+        if (channel < 0) {
+            printf("channel %s not found\n", name.c_str());
+            return false;
+        }
+        if (stream == SIZE_MAX)
+            stream = reader.getStreamOfChannel(channel);
+        if (reader.getStreamOfChannel(channel) != stream) {
+            printf("channel %s is not in stream %zu\n", name.c_str(), stream);
+            return false;
+        }
+        channels.push_back(static_cast<size_t>(channel));
+    }
+    return true;
+}
+
+// runs the replay over all records, outputs has num_of_records * num_of_outputs values
+static double run(Replay& replay, const std::vector<float>& inputs, size_t num_of_inputs, size_t num_of_records, size_t num_of_outputs,
+                  std::vector<float>& outputs)
+{
+    outputs.assign(num_of_records * num_of_outputs, 0.0f);
+    const auto time_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_of_records; i++)
+        replay.step(&inputs[i * num_of_inputs], &outputs[i * num_of_outputs]);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+}
+
+static void printUsage()
+{
+    printf("usage: log_replay file.bin <pid | iir | mahony | line_follower> --in ch,... [options]\n"
+           "  --in ch,...      input channels (pid: e | e,y | w,y_p,y_i,y_d, iir: x, mahony: gyro xyz, acc xyz [, mag xyz],\n"
+           "                   line_follower: raw byte of the sensor bar)\n"
+           "  --param k=v,...  pid: P, I, D, tau_f, tau_ro, umin, umax, F, u0\n"
+           "                   iir: type (lowpass1, lowpass2, notch, leadlag1, dlowpass1, integrator, differentiator),\n"
+           "                        fcut, D, fzero, fpole, y0\n"
+           "                   mahony: kp, ki\n"
+           "                   line_follower: kp, kp_nl, vel, tracker, sched, acc_lat_max, acc_max, dec_max, bar_dist, d_wheel,\n"
+           "                                  b_wheel, vmax\n"
+           "  --ref ch,...     logged outputs in the order of the outputs, compared with the replay\n"
+           "  --ts s           sampling time (default from the record times or the rate)\n"
+           "  --tol x          max. difference to the reference (default 1e-6 times the max. reference value)\n"
+           "  --out file       csv with time, inputs, outputs and references\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+    const std::string path = argv[1];
+    const std::string name = argv[2];
+    std::vector<std::string> input_names, ref_names;
+    Params params;
+    std::string iir_type = "lowpass1";
+    float Ts = 0.0f;
+    double tolerance = -1.0;
+    std::string out_file;
+    for (int i = 3; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_1 = i + 1 < argc;
+        if (!strcmp(arg, "--in") && has_1) {
+            input_names = split(argv[++i], ',');
+        } else if (!strcmp(arg, "--param") && has_1) {
+            if (!parseParams(argv[++i], params, iir_type)) {
+                printf("invalid parameters %s\n", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(arg, "--ref") && has_1) {
+            ref_names = split(argv[++i], ',');
+        } else if (!strcmp(arg, "--ts") && has_1) {
+            Ts = strtof(argv[++i], nullptr);
+        } else if (!strcmp(arg, "--tol") && has_1) {
+            tolerance = strtod(argv[++i], nullptr);
+        } else if (!strcmp(arg, "--out") && has_1) {
+            out_file = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    LogReader reader;
+    if (!reader.open(path))
+        return 1;
+    std::vector<size_t> input_channels, ref_channels;
+    size_t stream = SIZE_MAX;
+    if (input_names.empty() || !findChannels(reader, input_names, input_channels, stream) ||
+        !findChannels(reader, ref_names, ref_channels, stream)) {
+        printUsage();
+        return 1;
+    }
+    const size_t num_of_records = reader.getNumOfRecords(stream);
+    const std::vector<double> times = reader.getTimes(stream);
+
+    // sampling time from the record times including the lost records, else from the rate of the schema
+    const LogReader::Stream& s = reader.getStream(stream);
+    const bool has_time = !s.data_blocks.empty() && s.data_blocks.front().has_time;
+    if ((Ts <= 0.0f) && has_time && (num_of_records > 1) && (times.back() > times.front())) {
+        const uint32_t num_of_periods = s.data_blocks.back().index + static_cast<uint32_t>(s.data_blocks.back().num_of_records) - 1 - s.data_blocks.front().index;
+        Ts = static_cast<float>((times.back() - times.front()) / num_of_periods);
+    }
+    if ((Ts <= 0.0f) && (s.rate > 0.0))
+        Ts = static_cast<float>(1.0 / s.rate);
+    if (Ts <= 0.0f) {
+        printf("the file has no times and no rate, give the sampling time with --ts\n");
+        return 1;
+    }
+
+    // the inputs and references as contiguous floats, the replay itself does not touch the file
+    const size_t num_of_inputs = input_channels.size();
+    std::vector<float> inputs(num_of_records * num_of_inputs);
+    std::vector<float> refs(num_of_records * ref_channels.size());
+    for (size_t i = 0; i < num_of_records; i++) {
+        const uint8_t* record = reader.getRecord(i, stream);
+        for (size_t c = 0; c < num_of_inputs; c++)
+            inputs[i * num_of_inputs + c] = static_cast<float>(reader.decodeValue(record, input_channels[c]));
+        for (size_t c = 0; c < ref_channels.size(); c++)
+            refs[i * ref_channels.size() + c] = static_cast<float>(reader.decodeValue(record, ref_channels[c]));
+    }
+
+    // two runs from the same initial state have to give the same outputs
+    std::vector<float> outputs[2];
+    double elapsed_time[2];
+    size_t num_of_outputs = 0;
+    std::vector<std::string> output_names;
+    for (int r = 0; r < 2; r++) {
+        std::unique_ptr<Replay> replay = createReplay(name, iir_type);
+        if (!replay) {
+            printf("unknown class %s\n", name.c_str());
+            return 1;
+        }
+        if (!replay->setup(params, num_of_inputs, Ts)) {
+            printf("%s: invalid number of inputs or parameters\n", name.c_str());
+            return 1;
+        }
+        output_names = replay->getOutputNames();
+        num_of_outputs = output_names.size();
+        elapsed_time[r] = run(*replay, inputs, num_of_inputs, num_of_records, num_of_outputs, outputs[r]);
+    }
+    const bool is_deterministic = (memcmp(outputs[0].data(), outputs[1].data(), outputs[0].size() * sizeof(float)) == 0);
+    if (ref_channels.size() > num_of_outputs) {
+        printf("%s has %zu outputs, more references given\n", name.c_str(), num_of_outputs);
+        return 1;
+    }
+
+    const double step_time = std::min(elapsed_time[0], elapsed_time[1]) / std::max<size_t>(num_of_records, 1);
+    printf("%s: %s, %zu records of stream %zu, Ts %.6f s, %s\n", path.c_str(), name.c_str(), num_of_records, stream, Ts,
+           is_deterministic ? "deterministic" : "NOT deterministic");
+    printf("%.1f ns per step, %.0f x real time\n", step_time * 1.0e9, Ts / std::max(step_time, 1.0e-12));
+
+    bool is_equal = is_deterministic;
+    if (!ref_channels.empty()) {
+        printf("output     reference        max. diff   rms diff     tolerance  first diff\n");
+        for (size_t c = 0; c < ref_channels.size(); c++) {
+            double max_ref = 0.0, max_diff = 0.0, sum_diff2 = 0.0;
+            for (size_t i = 0; i < num_of_records; i++)
+                max_ref = std::max(max_ref, fabs(static_cast<double>(refs[i * ref_channels.size() + c])));
+            const double tol = (tolerance >= 0.0) ? tolerance : 1.0e-6 * max_ref;
+            long first_diff = -1;
+            for (size_t i = 0; i < num_of_records; i++) {
+                const double diff = fabs(static_cast<double>(outputs[0][i * num_of_outputs + c]) - refs[i * ref_channels.size() + c]);
+                // a nan on one side is a difference
+                const bool is_diff = (diff > tol) || (std::isnan(diff) && !(std::isnan(outputs[0][i * num_of_outputs + c]) &&
+                                                                            std::isnan(refs[i * ref_channels.size() + c])));
+                if (is_diff && (first_diff < 0))
+                    first_diff = static_cast<long>(i);
+                if (!std::isnan(diff)) {
+                    max_diff = std::max(max_diff, diff);
+                    sum_diff2 += diff * diff;
+                }
+            }
+            is_equal &= (first_diff < 0);
+            printf("%-10s %-16s %10.3g %10.3g %13.3g  %s\n", output_names[c].c_str(), ref_names[c].c_str(), max_diff,
+                   sqrt(sum_diff2 / std::max<size_t>(num_of_records, 1)), tol,
+                   (first_diff < 0) ? "-" : (std::to_string(first_diff) + " (" + std::to_string(times[first_diff]) + " s)").c_str());
+        }
+    }
+
+    if (!out_file.empty()) {
+        FILE* file = fopen(out_file.c_str(), "w");
+        if (!file) {
+            printf("could not open %s\n", out_file.c_str());
+            return 1;
+        }
+        fprintf(file, "time");
+        for (const std::string& input : input_names)
+            fprintf(file, ",%s", input.c_str());
+        for (const std::string& output : output_names)
+            fprintf(file, ",%s", output.c_str());
+        for (const std::string& ref : ref_names)
+            fprintf(file, ",ref_%s", ref.c_str());
+        fprintf(file, "\n");
+        for (size_t i = 0; i < num_of_records; i++) {
+            fprintf(file, "%.6f", times[i]);
+            for (size_t c = 0; c < num_of_inputs; c++)
+                fprintf(file, ",%.9g", inputs[i * num_of_inputs + c]);
+            for (size_t c = 0; c < num_of_outputs; c++)
+                fprintf(file, ",%.9g", outputs[0][i * num_of_outputs + c]);
+            for (size_t c = 0; c < ref_channels.size(); c++)
+                fprintf(file, ",%.9g", refs[i * ref_channels.size() + c]);
+            fprintf(file, "\n");
+        }
+        fclose(file);
+    }
+    return is_equal ? 0 : 1;
+}
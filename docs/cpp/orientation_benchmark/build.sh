@@ -0,0 +1,11 @@
+#!/bin/bash
+# builds the host side orientation estimator benchmark, needs g++ with c++17 support
+cd "$(dirname "$0")"
+LIB=../../../lib
+# same eigen flags as the firmware (platformio.ini)
+g++ -O2 -std=c++17 -DEIGEN_NO_DEBUG -DEIGEN_DONT_VECTORIZE \
+    -I$LIB/Mahony -I$LIB/ESKF -I$LIB/eigen-lib \
+    orientation_benchmark.cpp MahonyReference.cpp \
+    $LIB/Mahony/Mahony.cpp \
+    $LIB/ESKF/ESKF.cpp \
+    -o orientation_benchmark
@@ -0,0 +1,229 @@
+/**
+ * @file orientation_benchmark.cpp
+ * @brief Host side accuracy and timing benchmark of the orientation estimators.
+ *
+ * Simulates a gyro, acc and mag sequence of a balancing robot (oscillating tilt, linear
+ * accelerations, gyro bias and noise, an initial tilt of 30 deg) and runs the Mahony filter
+ * (IMU parameters) and the ESKF (covariance update and steady state gain) on it. Reports the
+ * tilt error, the time until the tilt error is below 2 deg and the time per update.
+ *
+ * The Mahony class is also checked against MahonyReference, an unmodified copy of the class
+ * before the optimised update kernel, the program fails if the orientations differ.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./orientation_benchmark [--mag] [--ts 0.02] [--time 60] [--seed 1]
+ * ```
+ *
+ * The times are host times with the firmware eigen flags, they are meant to compare the
+ * estimators, not to predict the time on the nucleo.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_HAS_RDTSC 1
+#endif
+
+#include "ESKF.h"
+#include "Mahony.h"
+#include "MahonyReference.h"
+
+// max. difference of quaternion, rpy and tilt between Mahony and MahonyReference
+#define BENCHMARK_EQUIVALENCE_TOLERANCE 1.0e-4f
+
+struct Sample {
+    Eigen::Vector3f gyro, acc, mag;
+    float tilt;
+};
+
+static std::vector<Sample> simulate(float Ts, float time, bool use_mag, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    const float g = 9.81f;
+    const float gyro_noise = 0.015f, acc_noise = 0.3f, mag_noise = 0.02f;
+    const Eigen::Vector3f gyro_bias(0.01f, -0.02f, 0.015f);
+    // earth magnetic field in world frame, 63 deg inclination, normalised
+    const Eigen::Vector3f mag_world(cosf(1.1f), 0.0f, -sinf(1.1f));
+
+    // initial tilt of 30 deg around x
+    Eigen::Quaternionf q(Eigen::AngleAxisf(0.52f, Eigen::Vector3f::UnitX()));
+    const int num_of_sub_steps = 20;
+    const float dt = Ts / num_of_sub_steps;
+
+    std::vector<Sample> samples;
+    for (int k = 0; k * Ts < time; k++) {
+        const float t = k * Ts;
+        // balancing like motion: pitch oscillation, slow yaw, some roll
+        const Eigen::Vector3f w(0.4f * sinf(2.0f * 3.1416f * 0.3f * t),
+                                1.5f * sinf(2.0f * 3.1416f * 1.2f * t),
+                                0.3f * sinf(2.0f * 3.1416f * 0.1f * t));
+        for (int i = 0; i < num_of_sub_steps; i++) {
+            const Eigen::Vector3f dtheta = w * dt;
+            const float angle = dtheta.norm();
+            if (angle > 0.0f)
+                q = q * Eigen::Quaternionf(Eigen::AngleAxisf(angle, dtheta / angle));
+        }
+        q.normalize();
+        const Eigen::Matrix3f R = q.toRotationMatrix();
+
+        // linear acceleration in world frame (driving back and forth)
+        const Eigen::Vector3f acc_lin(1.5f * sinf(2.0f * 3.1416f * 1.2f * t + 0.5f), 0.0f, 0.0f);
+
+        Sample s;
+        s.gyro = w + gyro_bias + gyro_noise * Eigen::Vector3f(normal(rng), normal(rng), normal(rng));
+        s.acc = R.transpose() * (Eigen::Vector3f(0.0f, 0.0f, g) + acc_lin) + acc_noise * Eigen::Vector3f(normal(rng), normal(rng), normal(rng));
+        s.mag = use_mag ? Eigen::Vector3f(R.transpose() * mag_world + mag_noise * Eigen::Vector3f(normal(rng), normal(rng), normal(rng)))
+                        : Eigen::Vector3f::Zero();
+        s.tilt = acosf(fminf(1.0f, fmaxf(-1.0f, R(2, 2))));
+        samples.push_back(s);
+    }
+    return samples;
+}
+
+template<typename Estimator>
+static void run(const char* name, Estimator& estimator, const std::vector<Sample>& samples, float Ts, bool use_mag)
+{
+    double err_sq_sum = 0.0;
+    float err_max = 0.0f;
+    float converged_time = -1.0f;
+    int num_of_steady_samples = 0;
+    const float time_steady = 5.0f;
+
+    for (size_t k = 0; k < samples.size(); k++) {
+        const Sample& s = samples[k];
+        if (use_mag)
+            estimator.update(s.gyro, s.acc, s.mag);
+        else
+            estimator.update(s.gyro, s.acc);
+        const float err = fabsf(estimator.getTiltAngle() - s.tilt);
+        if ((converged_time < 0.0f) && (err < 2.0f * 3.1416f / 180.0f))
+            converged_time = k * Ts;
+        if (k * Ts >= time_steady) {
+            err_sq_sum += static_cast<double>(err) * err;
+            err_max = fmaxf(err_max, err);
+            num_of_steady_samples++;
+        }
+    }
+
+    // timing, repeat the sequence until enough updates are measured
+    const int num_of_repetitions = 20;
+    volatile float sink = 0.0f;
+    const auto time_start = std::chrono::steady_clock::now();
+#ifdef BENCHMARK_HAS_RDTSC
+    const unsigned long long cycles_start = __rdtsc();
+#endif
+    for (int r = 0; r < num_of_repetitions; r++) {
+        for (const Sample& s : samples) {
+            if (use_mag)
+                estimator.update(s.gyro, s.acc, s.mag);
+            else
+                estimator.update(s.gyro, s.acc);
+            sink = sink + estimator.getTiltAngle();
+        }
+    }
+#ifdef BENCHMARK_HAS_RDTSC
+    const unsigned long long cycles = __rdtsc() - cycles_start;
+#endif
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+    const double num_of_updates = static_cast<double>(num_of_repetitions) * samples.size();
+
+    const float rad2deg = 180.0f / 3.1416f;
+    printf("%-20s  %8.3f deg  %8.3f deg  %7.2f s  %8.1f ns",
+           name,
+           rad2deg * sqrtf(static_cast<float>(err_sq_sum / fmax(1, num_of_steady_samples))),
+           rad2deg * err_max,
+           converged_time,
+           1.0e9 * elapsed / num_of_updates);
+#ifdef BENCHMARK_HAS_RDTSC
+    printf("  %8.0f", cycles / num_of_updates);
+#endif
+    printf("\n");
+}
+
+static bool checkEquivalence(const std::vector<Sample>& samples, float Ts, bool use_mag, float kp, float ki)
+{
+    Mahony mahony(kp, ki, Ts);
+    MahonyReference reference(kp, ki, Ts);
+    float quat_diff_max = 0.0f, rpy_diff_max = 0.0f, tilt_diff_max = 0.0f;
+    for (const Sample& s : samples) {
+        if (use_mag) {
+            mahony.update(s.gyro, s.acc, s.mag);
+            reference.update(s.gyro, s.acc, s.mag);
+        } else {
+            mahony.update(s.gyro, s.acc);
+            reference.update(s.gyro, s.acc);
+        }
+        quat_diff_max = fmaxf(quat_diff_max, (mahony.getOrientationAsQuaternion().coeffs() - reference.getOrientationAsQuaternion().coeffs()).cwiseAbs().maxCoeff());
+        // yaw may wrap around at +-pi
+        Eigen::Vector3f rpy_diff = mahony.getOrientationAsRPYAngles() - reference.getOrientationAsRPYAngles();
+        for (int i = 0; i < 3; i++)
+            rpy_diff(i) = fabsf(remainderf(rpy_diff(i), 2.0f * 3.14159265f));
+        rpy_diff_max = fmaxf(rpy_diff_max, rpy_diff.maxCoeff());
+        tilt_diff_max = fmaxf(tilt_diff_max, fabsf(mahony.getTiltAngle() - reference.getTiltAngle()));
+    }
+    const bool is_equivalent = (quat_diff_max < BENCHMARK_EQUIVALENCE_TOLERANCE) &&
+                               (rpy_diff_max < BENCHMARK_EQUIVALENCE_TOLERANCE) &&
+                               (tilt_diff_max < BENCHMARK_EQUIVALENCE_TOLERANCE);
+    printf("Mahony vs. reference: max. difference quaternion %.2e, rpy %.2e rad, tilt %.2e rad, %s\n",
+           quat_diff_max, rpy_diff_max, tilt_diff_max, is_equivalent ? "ok" : "FAILED");
+    return is_equivalent;
+}
+
+int main(int argc, char* argv[])
+{
+    bool use_mag = false;
+    float Ts = 0.02f;
+    float time = 60.0f;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--mag")) {
+            use_mag = true;
+        } else if (!strcmp(argv[i], "--ts") && (i + 1 < argc)) {
+            Ts = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--time") && (i + 1 < argc)) {
+            time = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && (i + 1 < argc)) {
+            seed = atoi(argv[++i]);
+        } else {
+            printf("usage: orientation_benchmark [--mag] [--ts 0.02] [--time 60] [--seed 1]\n");
+            return 1;
+        }
+    }
+
+    const std::vector<Sample> samples = simulate(Ts, time, use_mag, seed);
+    printf("%zu samples, Ts = %.4f s, %s\n", samples.size(), Ts, use_mag ? "with mag" : "without mag");
+    printf("%-20s  %12s  %12s  %9s  %11s", "estimator", "tilt rms", "tilt max", "converged", "time/update");
+#ifdef BENCHMARK_HAS_RDTSC
+    printf("  %8s", "cycles");
+#endif
+    printf("\n");
+
+    // same gains as in IMU.h
+    const float kp = use_mag ? 3.0f / (sqrtf(3.0f) / 3.0f) : 3.0f;
+    const float ki = use_mag ? kp * kp / 3.0f : 0.0f;
+    MahonyReference mahony_reference(kp, ki, Ts);
+    run("Mahony reference", mahony_reference, samples, Ts, use_mag);
+
+    Mahony mahony(kp, ki, Ts);
+    run("Mahony", mahony, samples, Ts, use_mag);
+
+    ESKF eskf(Ts);
+    run("ESKF", eskf, samples, Ts, use_mag);
+
+    ESKF eskf_steady_state(Ts);
+    eskf_steady_state.enableSteadyStateGain(true);
+    run("ESKF steady state", eskf_steady_state, samples, Ts, use_mag);
+
+    return checkEquivalence(samples, Ts, use_mag, kp, ki) ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# builds the host side sd logger buffer benchmark, needs g++ with c++17 support
+cd "$(dirname "$0")"
+LIB=../../../lib
+g++ -O2 -std=c++17 -pthread \
+    -I$LIB/SPSCRingBuffer \
+    sdlogger_benchmark.cpp \
+    $LIB/SPSCRingBuffer/SPSCRingBuffer.cpp \
+    -o sdlogger_benchmark
@@ -0,0 +1,366 @@
+/**
+ * @file sdlogger_benchmark.cpp
+ * @brief Host side benchmark of the SDLogger buffer, mutex and float ring versus SPSCRingBuffer.
+ *
+ * Emulates both buffer designs of the SDLogger with a producer thread (the control loop, one
+ * record of 22 floats per period) and a consumer thread (the logger thread, every 20 ms and for
+ * spsc also woken up by the producer as soon as a chunk is ready, emulated by polling every 1 ms):
+ * - mutex: CircularBuffer<float, 2048> with a Mutex, floats pushed one by one, drained in
+ *   chunks of 256 floats through a 1024 byte stdio buffer, the file starts with a header byte
+ * - spsc: SPSCRingBuffer of 16384 bytes (SDLogger::BUFFER_SIZE), one memcpy per record, whole sectors of the file are
+ *   written directly from the buffer in chunks of 2048 bytes, the rest with the periodic flush
+ *
+ * The SD card is a timing model of the FAT file system on the card: a partial sector is kept in
+ * the sector buffer and written when it is complete, whole aligned sectors are written with one
+ * multi block write, every write command costs cmd_us plus sector_us per sector and every
+ * spike_sectors sectors the card is busy for spike_ms (internal garbage collection).
+ *
+ * Reports the cpu time per record (push and drain in one thread without the card), the max. time
+ * of a push while the logger thread runs, the number of write commands and the highest record
+ * rate without lost records, compared with the "22 floats at 500 Hz" tested on the robot.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./sdlogger_benchmark [--floats 22] [--time 3] [--cmd_us 800] [--sector_us 450] [--spike_ms 150] [--spike_sectors 256]
+ * ```
+ *
+ * The push times are host times. The rates depend on the card model, change it to the
+ * timing of your card (SDLogger::printStatistics() shows the max. write time on the robot).
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "SPSCRingBuffer.h"
+
+#define SECTOR_SIZE 512
+
+typedef std::chrono::steady_clock Clock;
+
+struct CardParameters {
+    double cmd_us = 800.0;
+    double sector_us = 450.0;
+    double spike_ms = 150.0;
+    uint32_t spike_sectors = 256;
+};
+
+class SDCardModel
+{
+public:
+    explicit SDCardModel(const CardParameters& parameters) : m_parameters(parameters) {}
+
+    void write(const void* data, size_t size)
+    {
+        (void)data;
+        double time_us = 0.0;
+        // complete the partial sector in the sector buffer
+        const size_t in_sector = m_position % SECTOR_SIZE;
+        if (in_sector != 0) {
+            const size_t size_head = std::min(size, static_cast<size_t>(SECTOR_SIZE - in_sector));
+            m_position += size_head;
+            size -= size_head;
+            if (m_position % SECTOR_SIZE == 0)
+                time_us += writeSectors(1);
+        }
+        // whole sectors directly, the rest stays in the sector buffer
+        const size_t num_of_sectors = size / SECTOR_SIZE;
+        if (num_of_sectors > 0)
+            time_us += writeSectors(num_of_sectors);
+        m_position += size;
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(time_us)));
+    }
+
+    uint32_t getNumOfCommands() const { return m_num_of_commands; }
+
+private:
+    CardParameters m_parameters;
+    uint64_t m_position{0};
+    uint32_t m_num_of_sectors{0};
+    uint32_t m_num_of_commands{0};
+
+    double writeSectors(size_t num_of_sectors)
+    {
+        m_num_of_commands++;
+        double time_us = m_parameters.cmd_us + m_parameters.sector_us * num_of_sectors;
+        for (size_t i = 0; i < num_of_sectors; i++)
+            if (++m_num_of_sectors % m_parameters.spike_sectors == 0)
+                time_us += 1.0e3 * m_parameters.spike_ms;
+        return time_us;
+    }
+};
+
+// SDLogger before: CircularBuffer<float, 2048> protected by a mutex
+class MutexLogger
+{
+public:
+    static constexpr size_t BUFFER_SIZE = 2048;
+    static constexpr size_t CHUNK_SIZE = 256;
+    static constexpr size_t STDIO_BUFFER_SIZE = 1024;
+
+    explicit MutexLogger(SDCardModel& card) : m_card(card) {}
+
+    bool push(const float* data, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < count; i++) {
+            if (m_count == BUFFER_SIZE)
+                return false;
+            m_buffer[m_head] = data[i];
+            m_head = (m_head + 1) % BUFFER_SIZE;
+            m_count++;
+        }
+        return true;
+    }
+
+    void writeHeader(uint8_t header) { stdioWrite(&header, 1); }
+
+    bool isChunkReady() const { return false; }
+
+    void flushBuffer(bool write_all)
+    {
+        float tmp[CHUNK_SIZE];
+        while (true) {
+            size_t count_to_pop = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                while ((count_to_pop < CHUNK_SIZE) && (m_count > 0)) {
+                    tmp[count_to_pop++] = m_buffer[m_tail];
+                    m_tail = (m_tail + 1) % BUFFER_SIZE;
+                    m_count--;
+                }
+            }
+            if (count_to_pop == 0)
+                break;
+            stdioWrite(tmp, count_to_pop * sizeof(float));
+        }
+        if (write_all && (m_stdio_fill > 0)) {
+            m_card.write(m_stdio_buffer, m_stdio_fill);
+            m_stdio_fill = 0;
+        }
+    }
+
+private:
+    SDCardModel& m_card;
+    std::mutex m_mutex;
+    float m_buffer[BUFFER_SIZE];
+    size_t m_head{0}, m_tail{0}, m_count{0};
+    uint8_t m_stdio_buffer[STDIO_BUFFER_SIZE];
+    size_t m_stdio_fill{0};
+
+    void stdioWrite(const void* data, size_t size)
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            const size_t size_chunk = std::min(size, STDIO_BUFFER_SIZE - m_stdio_fill);
+            memcpy(&m_stdio_buffer[m_stdio_fill], src, size_chunk);
+            m_stdio_fill += size_chunk;
+            src += size_chunk;
+            size -= size_chunk;
+            if (m_stdio_fill == STDIO_BUFFER_SIZE) {
+                m_card.write(m_stdio_buffer, m_stdio_fill);
+                m_stdio_fill = 0;
+            }
+        }
+    }
+};
+
+// SDLogger now: SPSCRingBuffer, whole sectors written from the buffer
+class SPSCLogger
+{
+public:
+    static constexpr size_t BUFFER_SIZE = 16384; // SDLogger::BUFFER_SIZE
+    static constexpr size_t WRITE_SIZE = 2048;   // SD_LOGGER_WRITE_SIZE
+
+    explicit SPSCLogger(SDCardModel& card) : m_ring(m_buffer, BUFFER_SIZE), m_card(card) {}
+
+    bool push(const float* data, size_t count) { return m_ring.push(data, count * sizeof(float)); }
+
+    void writeHeader(uint8_t header) { m_ring.push(&header, 1); }
+
+    bool isChunkReady() const { return m_ring.size() >= WRITE_SIZE; }
+
+    void flushBuffer(bool write_all)
+    {
+        if (!write_all && !isChunkReady())
+            return;
+        while (true) {
+            const uint8_t* data;
+            size_t size = std::min(m_ring.peek(data), WRITE_SIZE);
+            if (!write_all) {
+                const uint64_t file_bytes_aligned = ((m_file_bytes + size) / SECTOR_SIZE) * SECTOR_SIZE;
+                size = (file_bytes_aligned > m_file_bytes) ? file_bytes_aligned - m_file_bytes : 0;
+            }
+            if (size == 0)
+                break;
+            m_card.write(data, size);
+            m_ring.consume(size);
+            m_file_bytes += size;
+        }
+    }
+
+private:
+    uint8_t m_buffer[BUFFER_SIZE];
+    SPSCRingBuffer m_ring;
+    SDCardModel& m_card;
+    uint64_t m_file_bytes{0};
+};
+
+struct Result {
+    double push_ns_max;
+    uint32_t num_of_lost_records;
+    uint32_t num_of_commands;
+};
+
+template<typename Logger>
+static Result run(const CardParameters& card_parameters, int num_of_floats, double rate, double time)
+{
+    SDCardModel card(card_parameters);
+    Logger logger(card);
+    std::atomic<bool> is_running{true};
+
+    // logger thread, every 20 ms, flush every 5 s
+    std::thread consumer([&]() {
+        auto next = Clock::now();
+        auto flush_time = Clock::now();
+        while (is_running.load()) {
+            next += std::chrono::milliseconds(20);
+            while ((Clock::now() < next) && !logger.isChunkReady())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (Clock::now() < next)
+                next = Clock::now();
+            logger.flushBuffer(false);
+            if (Clock::now() - flush_time >= std::chrono::seconds(5)) {
+                flush_time = Clock::now();
+                logger.flushBuffer(true);
+            }
+        }
+    });
+
+    // control loop, one record per period
+    std::vector<float> record(num_of_floats);
+    logger.writeHeader(static_cast<uint8_t>(num_of_floats));
+    const auto period = std::chrono::nanoseconds(static_cast<int64_t>(1.0e9 / rate));
+    const int64_t num_of_records = static_cast<int64_t>(rate * time);
+    Result result = {0.0, 0, 0};
+    auto next = Clock::now();
+    for (int64_t k = 0; k < num_of_records; k++) {
+        next += period;
+        while (Clock::now() < next) {
+        }
+        for (int i = 0; i < num_of_floats; i++)
+            record[i] = static_cast<float>(k + i);
+        const auto time_start = Clock::now();
+        const bool is_ok = logger.push(record.data(), num_of_floats);
+        const double push_ns = std::chrono::duration<double, std::nano>(Clock::now() - time_start).count();
+        result.push_ns_max = std::max(result.push_ns_max, push_ns);
+        if (!is_ok)
+            result.num_of_lost_records++;
+    }
+    is_running.store(false);
+    consumer.join();
+    result.num_of_commands = card.getNumOfCommands();
+    return result;
+}
+
+// cpu time per record in ns, push and drain in one thread, the card write takes no time
+template<typename Logger>
+static double measureCpuTime(int num_of_floats)
+{
+    CardParameters card_parameters;
+    card_parameters.cmd_us = card_parameters.sector_us = card_parameters.spike_ms = 0.0;
+    SDCardModel card(card_parameters);
+    Logger logger(card);
+    std::vector<float> record(num_of_floats, 1.0f);
+    const int num_of_records = 1000000;
+    const auto time_start = Clock::now();
+    for (int k = 0; k < num_of_records; k++) {
+        record[0] = static_cast<float>(k);
+        logger.push(record.data(), num_of_floats);
+        if (k % 16 == 15)
+            logger.flushBuffer(false);
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - time_start).count() / num_of_records;
+}
+
+// highest rate in Hz without lost records
+template<typename Logger>
+static double findSustainedRate(const CardParameters& card_parameters, int num_of_floats, double time)
+{
+    double rate_ok = 0.0, rate_lost = 20000.0;
+    for (double rate = 250.0; rate < rate_lost; rate *= 2.0) {
+        if (run<Logger>(card_parameters, num_of_floats, rate, time).num_of_lost_records > 0) {
+            rate_lost = rate;
+            break;
+        }
+        rate_ok = rate;
+    }
+    for (int i = 0; i < 6; i++) {
+        const double rate = 0.5 * (rate_ok + rate_lost);
+        if (run<Logger>(card_parameters, num_of_floats, rate, time).num_of_lost_records > 0)
+            rate_lost = rate;
+        else
+            rate_ok = rate;
+    }
+    return rate_ok;
+}
+
+template<typename Logger>
+static void report(const char* name, const CardParameters& card_parameters, int num_of_floats, double time)
+{
+    const double cpu_time = measureCpuTime<Logger>(num_of_floats);
+    const Result result = run<Logger>(card_parameters, num_of_floats, 500.0, time);
+    const double rate = findSustainedRate<Logger>(card_parameters, num_of_floats, time);
+    printf("%-8s  %9.1f ns  %9.1f ns  %7u  %8lu  %9.0f Hz  %7.1f kB/s  %5.1f x\n",
+           name,
+           cpu_time,
+           result.push_ns_max,
+           result.num_of_commands,
+           static_cast<unsigned long>(result.num_of_lost_records),
+           rate,
+           1.0e-3 * rate * num_of_floats * sizeof(float),
+           rate / 500.0);
+}
+
+int main(int argc, char* argv[])
+{
+    CardParameters card_parameters;
+    int num_of_floats = 22;
+    double time = 3.0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--floats") && (i + 1 < argc)) {
+            num_of_floats = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--time") && (i + 1 < argc)) {
+            time = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--cmd_us") && (i + 1 < argc)) {
+            card_parameters.cmd_us = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--sector_us") && (i + 1 < argc)) {
+            card_parameters.sector_us = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--spike_ms") && (i + 1 < argc)) {
+            card_parameters.spike_ms = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--spike_sectors") && (i + 1 < argc)) {
+            card_parameters.spike_sectors = atoi(argv[++i]);
+        } else {
+            printf("usage: sdlogger_benchmark [--floats 22] [--time 3] [--cmd_us 800] [--sector_us 450] [--spike_ms 150] [--spike_sectors 256]\n");
+            return 1;
+        }
+    }
+
+    printf("%d floats per record, card: %.0f us per command, %.0f us per sector, %.0f ms busy every %u sectors\n",
+           num_of_floats, card_parameters.cmd_us, card_parameters.sector_us, card_parameters.spike_ms, card_parameters.spike_sectors);
+    printf("%-8s  %12s  %12s  %7s  %8s  %12s  %12s  %7s\n",
+           "buffer", "cpu/record", "push max", "cmds", "lost", "sustained", "", "vs 500");
+    printf("%-8s  %12s  %12s  %7s  %8s\n", "", "", "(500 Hz)", "(500 Hz)", "(500 Hz)");
+    report<MutexLogger>("mutex", card_parameters, num_of_floats, time);
+    report<SPSCLogger>("spsc", card_parameters, num_of_floats, time);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#!/bin/bash
+# builds the host side check and benchmark of the sensor bar decode tables, needs g++ with c++17 support
+cd "$(dirname "$0")"
+LIB=../../../lib
+g++ -O2 -std=c++17 -Wall \
+    -I$LIB/SensorBar \
+    sensorbar_decode.cpp \
+    -o sensorbar_decode
@@ -0,0 +1,229 @@
+/**
+ * @file sensorbar_decode.cpp
+ * @brief Host side equivalence check and benchmark of the SensorBar decode tables.
+ *
+ * Compares the table decode of SensorBar::update() (SensorBarDecodeTable for the binary position
+ * and the number of active leds, the angle table filled in the constructor) with the previous
+ * decode, which walked the 8 bits of the raw value three times and divided:
+ * - exhaustive check, all 256 raw values for several bar distances, the binary position, the
+ *   number of active leds and the angle have to be bit identical, the program fails otherwise
+ * - timing, both decodes on the same random sequence of raw values
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./sensorbar_decode [--samples 10000000] [--dist 0.118] [--seed 1]
+ * ```
+ *
+ * The times are host times, they are meant to compare the decodes, not to predict the time on
+ * the nucleo.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "SensorBarDecodeTable.h"
+
+struct Decoded {
+    int8_t binaryPosition;
+    uint8_t nrOfLedsActive;
+    float angle;
+};
+
+// previous decode of SensorBar::update(), getBinaryPosition(), updateAngleRad() and updateNrOfLedsActive()
+class ReferenceDecode
+{
+public:
+    explicit ReferenceDecode(float bar_dist) : distAxisToSensor(bar_dist) {}
+
+    __attribute__((noinline)) Decoded decode(uint8_t raw)
+    {
+        lastBarRawValue = raw;
+
+        //Assign values to each bit, -127 to 127, sum, and divide
+        int16_t accumulator = 0;
+        uint8_t bitsCounted = 0;
+        int16_t i;
+
+        //count bits
+        for ( i = 0; i < 8; i++ ) {
+            if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
+                bitsCounted++;
+            }
+        }
+
+        //Find the vector value of each positive bit and sum
+        for ( i = 7; i > 3; i-- ) { //iterate negative side bits
+            if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
+                accumulator += ((-32 * (i - 3)) + 1);
+            }
+        }
+        for ( i = 0; i < 4; i++ ) { //iterate positive side bits
+            if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
+                accumulator += ((32 * (4 - i)) - 1);
+            }
+        }
+
+        if ( bitsCounted > 0 ) {
+            lastBarPositionValue = accumulator / bitsCounted;
+        } else {
+            lastBarPositionValue = 0;
+        }
+
+        Decoded decoded;
+        decoded.binaryPosition = getBinaryPosition();
+        decoded.angle = updateAngleRad();
+        decoded.nrOfLedsActive = updateNrOfLedsActive();
+        return decoded;
+    }
+
+private:
+    uint8_t lastBarRawValue{0};
+    uint8_t lastBarPositionValue{0};
+    float distAxisToSensor;
+
+    int8_t getBinaryPosition()
+    {
+        return -lastBarPositionValue;
+    }
+
+    float updateAngleRad()
+    {
+        int8_t binaryPosition  = getBinaryPosition();
+        float position = static_cast<float>(binaryPosition) / 127.0f * 0.0445f; // 0.0445 m is half of sensor length
+        return atan2f(position, distAxisToSensor);
+    }
+
+    uint8_t updateNrOfLedsActive()
+    {
+        uint8_t bitsCounted = 0;
+        uint8_t i;
+
+        //count bits
+        for ( i = 0; i < 8; i++ ) {
+            if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
+                bitsCounted++;
+            }
+        }
+        return bitsCounted;
+    }
+};
+
+// decode of SensorBar::update() with the tables
+class TableDecode
+{
+public:
+    explicit TableDecode(float bar_dist)
+    {
+        for (int raw = 0; raw < 256; raw++) {
+            const float position = static_cast<float>(decodeTable.binaryPosition[raw]) / 127.0f * 0.0445f;
+            angleTable[raw] = atan2f(position, bar_dist);
+        }
+    }
+
+    __attribute__((noinline)) Decoded decode(uint8_t raw)
+    {
+        Decoded decoded;
+        decoded.binaryPosition = decodeTable.binaryPosition[raw];
+        decoded.nrOfLedsActive = decodeTable.nrOfLedsActive[raw];
+        decoded.angle = angleTable[raw];
+        return decoded;
+    }
+
+private:
+    static constexpr SensorBarDecodeTable decodeTable{};
+    float angleTable[256];
+};
+
+constexpr SensorBarDecodeTable TableDecode::decodeTable;
+
+static bool checkAll(float bar_dist)
+{
+    ReferenceDecode reference(bar_dist);
+    TableDecode table(bar_dist);
+    size_t num_of_mismatches = 0;
+    for (int raw = 0; raw < 256; raw++) {
+        const Decoded expected = reference.decode(static_cast<uint8_t>(raw));
+        const Decoded decoded = table.decode(static_cast<uint8_t>(raw));
+        // bit identical, the angle has to be the same float and not just close
+        if ((expected.binaryPosition != decoded.binaryPosition) ||
+            (expected.nrOfLedsActive != decoded.nrOfLedsActive) ||
+            (memcmp(&expected.angle, &decoded.angle, sizeof(float)) != 0)) {
+            if (num_of_mismatches++ < 10)
+                printf("  raw 0x%02X: position %d / %d, leds %u / %u, angle %.9f / %.9f\n", raw,
+                       expected.binaryPosition, decoded.binaryPosition, expected.nrOfLedsActive,
+                       decoded.nrOfLedsActive, expected.angle, decoded.angle);
+        }
+    }
+    printf("bar distance %.3f m: %s (%zu of 256 raw values differ)\n", bar_dist,
+           (num_of_mismatches == 0) ? "identical" : "FAILED", num_of_mismatches);
+    return num_of_mismatches == 0;
+}
+
+template <typename Decode>
+static double measure(Decode& decode, const std::vector<uint8_t>& raws, float& sink)
+{
+    // best of 5 runs, the result is summed so that the decode is not optimised away
+    double time_min_ns = 1.0e30;
+    for (int run = 0; run < 5; run++) {
+        float sum = 0.0f;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint8_t raw : raws) {
+            const Decoded decoded = decode.decode(raw);
+            sum += decoded.angle + decoded.binaryPosition + decoded.nrOfLedsActive;
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        sink += sum;
+        const double time_ns = std::chrono::duration<double, std::nano>(stop - start).count() / raws.size();
+        if (time_ns < time_min_ns)
+            time_min_ns = time_ns;
+    }
+    return time_min_ns;
+}
+
+int main(int argc, char** argv)
+{
+    size_t num_of_samples = 10000000;
+    float bar_dist = 0.118f;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--samples") == 0)
+            num_of_samples = static_cast<size_t>(atof(argv[i + 1]));
+        else if (strcmp(argv[i], "--dist") == 0)
+            bar_dist = static_cast<float>(atof(argv[i + 1]));
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = static_cast<unsigned>(atoi(argv[i + 1]));
+    }
+
+    // exhaustive check, the bar distances of the docs and the given one
+    bool is_ok = true;
+    const float bar_dists[] = {0.083f, 0.118f, bar_dist};
+    for (float dist : bar_dists)
+        is_ok &= checkAll(dist);
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> uniform(0, 255);
+    std::vector<uint8_t> raws(num_of_samples);
+    for (uint8_t& raw : raws)
+        raw = static_cast<uint8_t>(uniform(rng));
+
+    ReferenceDecode reference(bar_dist);
+    TableDecode table(bar_dist);
+    float sink = 0.0f;
+    const double reference_ns = measure(reference, raws, sink);
+    const double table_ns = measure(table, raws, sink);
+    printf("decode of %zu random raw values: bit loops %.1f ns, tables %.1f ns per sample (%.1fx)\n",
+           num_of_samples, reference_ns, table_ns, reference_ns / table_ns);
+    if (sink == 12345.0f)
+        printf("\n");
+
+    return is_ok ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#!/bin/bash
+# builds the host side receiver of the framed SerialStream serial_receiver and the simulation serial_stream_sim, needs g++ with c++17 support and termios (linux)
+cd "$(dirname "$0")"
+LIB=../../../lib
+g++ -O2 -std=c++17 -Wall -pthread \
+    -I$LIB/LogFormat -I$LIB/SerialFrame \
+    serial_receiver.cpp \
+    $LIB/LogFormat/LogFormat.cpp \
+    $LIB/SerialFrame/SerialFrame.cpp \
+    -o serial_receiver || exit 1
+g++ -O2 -std=c++17 -Wall \
+    -I$LIB/SerialFrame \
+    serial_stream_sim.cpp \
+    $LIB/SerialFrame/SerialFrame.cpp \
+    -o serial_stream_sim || exit 1
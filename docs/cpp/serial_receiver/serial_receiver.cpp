@@ -0,0 +1,572 @@
+/**
+ * @file serial_receiver.cpp
+ * @brief Receives the framed SerialStream of the robot and writes it as a typed log file, with resynchronisation and loss detection.
+ *
+ * The receiver opens the serial port (raw mode, e.g. 2 Mbaud), sends the start byte and decodes
+ * the frames of the SerialStream (see lib/SerialFrame/SerialFrame.h):
+ * - the bytes up to the next zero byte are one COBS coded frame, a frame with a wrong coding,
+ *   size or CRC is dropped and counted as bad, the next frame starts after the next zero byte,
+ *   so a lost or corrupted byte costs one or two frames and never the alignment of the rest
+ * - gaps in the sequence numbers of the data frames are counted as lost records, no matter if
+ *   they were dropped by the robot (serial buffer full) or on the line, records lost after the
+ *   last received record are not counted
+ * - the 32 bit times of the frames are extended to 64 bit with the start time of the info frame
+ *
+ * The records are written in the typed log format (schema with the channel names, data blocks
+ * with the exact record times), the index of a record is its sequence number, so a reader sees
+ * lost records as gaps. The file is read by LogReader, log_dump, log_convert and log_replay.
+ *
+ * A reader thread moves the bytes from the port into a queue and the main thread decodes and
+ * writes them, so a slow disk does not stall the port (its buffer holds only a few ms at 2 Mbaud).
+ * Instead of a port the tool also decodes a file with the received bytes (--raw of an earlier run,
+ * or a stream of serial_stream_sim).
+ *
+ * The receiving ends after --time seconds, if no byte arrived for --timeout seconds after the
+ * stream started, at the end of an input file or with Ctrl+C.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./serial_receiver /dev/ttyACM0 --out capture.bin --names time,w_M1,w_M2,u_M1,u_M2
+ * ./serial_receiver /dev/ttyACM0 --time 30 --raw capture.raw --compress
+ * ./serial_receiver capture.raw --out capture.bin   // decodes a saved stream
+ * ../log_reader/log_dump capture.bin
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "LogFormat.h"
+#include "SerialFrame.h"
+
+#define START_BYTE 255 // S_STREAM_START_BYTE of the SerialStream
+#define CHUNK_SIZE 65536
+#define START_TIMEOUT 3.0 // s until the start byte is sent again
+#define START_ATTEMPTS_MAX 5
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<bool> s_do_stop{false};
+
+static void onSignal(int)
+{
+    s_do_stop = true;
+}
+
+struct Options {
+    std::string input;
+    std::string out_path{"capture.bin"};
+    std::string raw_path;
+    std::vector<std::string> names;
+    int baudrate{2000000};
+    double time_max{0.0}; // 0: no limit
+    double timeout{0.5};
+    bool do_compress{false};
+};
+
+struct Statistics {
+    size_t num_of_bytes{0};
+    size_t num_of_frames{0};  // valid frames
+    size_t num_of_records{0}; // valid data frames
+    size_t num_of_lost{0};    // gaps in the sequence numbers
+    size_t num_of_bad{0};     // invalid coding, size or crc
+    size_t num_of_infos{0};
+};
+
+static bool getSpeed(int baudrate, speed_t& speed)
+{
+    static const struct {
+        int baudrate;
+        speed_t speed;
+    } speeds[] = {
+        {115200, B115200}, {230400, B230400},
+#ifdef B460800
+        {460800, B460800},
+#endif
+#ifdef B921600
+        {921600, B921600},
+#endif
+#ifdef B1000000
+        {1000000, B1000000},
+#endif
+#ifdef B2000000
+        {2000000, B2000000},
+#endif
+    };
+    for (const auto& entry : speeds) {
+        if (entry.baudrate == baudrate) {
+            speed = entry.speed;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int openSerial(const std::string& port, int baudrate)
+{
+    speed_t speed;
+    if (!getSpeed(baudrate, speed)) {
+        printf("baud rate %d is not supported\n", baudrate);
+        return -1;
+    }
+    const int fd = open(port.c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+
+    // raw 8N1, read() returns after 100 ms without bytes
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 1;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// queue of received chunks between the reader thread and the main thread
+class ChunkQueue
+{
+public:
+    void push(std::vector<uint8_t>&& chunk)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_chunks.push_back(std::move(chunk));
+        m_cv.notify_one();
+    }
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_finished = true;
+        m_cv.notify_one();
+    }
+
+    // returns false if there is no chunk within the timeout, is_finished is true after the last chunk
+    bool pop(std::vector<uint8_t>& chunk, double timeout, bool& is_finished)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait_for(lock, std::chrono::duration<double>(timeout), [this]() { return !m_chunks.empty() || m_is_finished; });
+        is_finished = m_chunks.empty() && m_is_finished;
+        if (m_chunks.empty())
+            return false;
+        chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::vector<uint8_t>> m_chunks;
+    bool m_is_finished{false};
+};
+
+// writes the records in the typed log format, the schema is written with the first record
+class CaptureWriter
+{
+public:
+    bool open(const std::string& path, const std::vector<std::string>& names, bool do_compress)
+    {
+        m_file = fopen(path.c_str(), "wb");
+        if (!m_file)
+            return false;
+        setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+        m_names = names;
+        m_do_compress = do_compress;
+        std::random_device random;
+        m_session = static_cast<uint16_t>(random() % 0xFFFF + 1);
+        return true;
+    }
+
+    bool isStarted() const { return m_num_of_floats > 0; };
+    uint8_t getNumOfFloats() const { return m_num_of_floats; };
+
+    void start(uint8_t num_of_floats)
+    {
+        m_num_of_floats = num_of_floats;
+        for (uint8_t i = 0; i < num_of_floats; i++) {
+            const std::string name = (i < m_names.size()) ? m_names[i] : "ch" + std::to_string(i);
+            m_LogSchema.addChannel(name.c_str(), LOG_TYPE_FLOAT, "", 0.0f, 1.0f);
+        }
+        for (uint8_t i = 0; i < m_LogSchema.getNumOfSchemaBlocks(); i++) {
+            m_LogSchema.writeSchemaBlock(m_block, i, m_seq++);
+            m_is_ok &= fwrite(m_block, 1, LOG_FORMAT_BLOCK_SIZE, m_file) == LOG_FORMAT_BLOCK_SIZE;
+        }
+        m_LogDataBlock.setChannels(m_LogSchema.getChannels(), m_LogSchema.getNumOfChannels(), m_do_compress);
+    }
+
+    // index is the record number of the stream, a gap starts a new block
+    void write(uint32_t index, uint64_t time_us, const uint8_t* record)
+    {
+        if (m_LogDataBlock.isStarted() && (index != m_LogDataBlock.getNextRecord()))
+            finishBlock();
+        if (!m_LogDataBlock.isStarted())
+            m_LogDataBlock.begin(0, m_session, index, time_us);
+        if (!m_LogDataBlock.add(record, time_us)) {
+            finishBlock();
+            m_LogDataBlock.begin(0, m_session, index, time_us);
+            m_LogDataBlock.add(record, time_us);
+        }
+    }
+
+    bool close()
+    {
+        if (!m_file)
+            return false;
+        if (m_LogDataBlock.isStarted())
+            finishBlock();
+        m_is_ok &= fclose(m_file) == 0;
+        m_file = nullptr;
+        return m_is_ok;
+    }
+
+private:
+    FILE* m_file{nullptr};
+    std::vector<std::string> m_names;
+    bool m_do_compress{false};
+    bool m_is_ok{true};
+    uint16_t m_session{0};
+    uint8_t m_num_of_floats{0};
+    uint32_t m_seq{0};
+    uint8_t m_block[LOG_FORMAT_BLOCK_SIZE];
+    LogSchema m_LogSchema;
+    LogDataBlock m_LogDataBlock;
+
+    void finishBlock()
+    {
+        m_LogDataBlock.finish(m_block, m_seq++);
+        m_is_ok &= fwrite(m_block, 1, LOG_FORMAT_BLOCK_SIZE, m_file) == LOG_FORMAT_BLOCK_SIZE;
+    }
+};
+
+// splits the bytes at the zero bytes, checks the frames and follows the sequence numbers and the time
+class FrameDecoder
+{
+public:
+    explicit FrameDecoder(CaptureWriter& capture_writer) : m_CaptureWriter(capture_writer) {}
+
+    void add(const uint8_t* data, size_t size)
+    {
+        m_statistics.num_of_bytes += size;
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != 0) {
+                // a frame without its zero byte, the bytes up to the next zero byte are dropped
+                if (m_size < sizeof(m_coded))
+                    m_coded[m_size] = data[i];
+                m_size++;
+                continue;
+            }
+            if (m_size > 0)
+                decodeFrame();
+            m_size = 0;
+        }
+    }
+
+    const Statistics& getStatistics() const { return m_statistics; };
+
+private:
+    CaptureWriter& m_CaptureWriter;
+    Statistics m_statistics;
+    uint8_t m_coded[SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_SIZE_MAX)];
+    size_t m_size{0};
+    uint8_t m_frame[SERIAL_FRAME_SIZE_MAX];
+
+    bool m_has_time{false};
+    uint64_t m_time_us{0};   // 64 bit time of the last frame
+    bool m_has_seq{false};
+    uint16_t m_seq{0};       // sequence number of the last data frame
+    bool m_has_index{false};
+    uint32_t m_index{0};     // record index of the last data frame
+
+    void decodeFrame()
+    {
+        SerialFrameHeader header;
+        const uint8_t* payload;
+        size_t payload_size;
+        if ((m_size > sizeof(m_coded)) || !serialFrameDecode(m_coded, m_size, m_frame, header, payload, payload_size)) {
+            m_statistics.num_of_bad++;
+            return;
+        }
+
+        if (header.type == SERIAL_FRAME_TYPE_INFO) {
+            uint8_t num_of_floats;
+            uint64_t time_us;
+            if (!serialFrameReadInfo(payload, payload_size, num_of_floats, time_us) || (num_of_floats == 0) ||
+                (num_of_floats > LOG_FORMAT_NUM_OF_CHANNELS_MAX)) {
+                m_statistics.num_of_bad++;
+                return;
+            }
+            m_statistics.num_of_frames++;
+            m_statistics.num_of_infos++;
+            if (m_CaptureWriter.isStarted() && (num_of_floats != m_CaptureWriter.getNumOfFloats()))
+                printf("\nstream restarted with %u instead of %u floats, its records are dropped\n", num_of_floats,
+                       m_CaptureWriter.getNumOfFloats());
+            if (!m_CaptureWriter.isStarted())
+                m_CaptureWriter.start(num_of_floats);
+            // the sequence numbers start at 0 after the info frame, a restarted stream continues the record index
+            m_has_seq = true;
+            m_seq = 0xFFFF;
+            if (!m_has_index) {
+                m_index = 0xFFFFFFFF;
+                m_has_index = true;
+            }
+            m_has_time = true;
+            m_time_us = time_us;
+            return;
+        }
+
+        if ((header.type != SERIAL_FRAME_TYPE_DATA) || (payload_size % sizeof(float) != 0) || (payload_size == 0)) {
+            m_statistics.num_of_bad++;
+            return;
+        }
+        // without the info frame the number of floats is taken from the first record
+        if (!m_CaptureWriter.isStarted())
+            m_CaptureWriter.start(static_cast<uint8_t>(payload_size / sizeof(float)));
+        if (payload_size != m_CaptureWriter.getNumOfFloats() * sizeof(float)) {
+            m_statistics.num_of_bad++;
+            return;
+        }
+        m_statistics.num_of_frames++;
+        m_statistics.num_of_records++;
+
+        // the difference of the sequence numbers modulo 2^16, a gap of more than 65535 records is not detected
+        if (m_has_seq) {
+            const uint16_t diff = static_cast<uint16_t>(header.seq - m_seq);
+            m_statistics.num_of_lost += (diff > 0) ? diff - 1 : 0;
+            m_index += diff;
+        } else {
+            // the info frame is lost, the records before are not counted
+            m_index = header.seq;
+            m_has_index = true;
+        }
+        m_has_seq = true;
+        m_seq = header.seq;
+
+        // the time wraps around after 71 minutes, the difference to the last frame is less
+        if (m_has_time)
+            m_time_us += static_cast<uint32_t>(header.time_us - static_cast<uint32_t>(m_time_us));
+        else
+            m_time_us = header.time_us;
+        m_has_time = true;
+
+        m_CaptureWriter.write(m_index, m_time_us, payload);
+    }
+};
+
+static void readInput(int fd, bool is_serial, ChunkQueue& chunk_queue, FILE* raw_file)
+{
+    std::vector<uint8_t> chunk(CHUNK_SIZE);
+    while (!s_do_stop) {
+        const ssize_t num_of_bytes = read(fd, chunk.data(), chunk.size());
+        if (num_of_bytes < 0)
+            break;
+        if (num_of_bytes == 0) {
+            // a port returns 0 after the read timeout, a file at its end
+            if (!is_serial)
+                break;
+            continue;
+        }
+        if (raw_file)
+            fwrite(chunk.data(), 1, static_cast<size_t>(num_of_bytes), raw_file);
+        chunk_queue.push(std::vector<uint8_t>(chunk.begin(), chunk.begin() + num_of_bytes));
+    }
+    chunk_queue.finish();
+}
+
+static void printStatistics(const Statistics& statistics, double elapsed_time, const char* end)
+{
+    const size_t num_of_expected = statistics.num_of_records + statistics.num_of_lost;
+    printf("%7.1f s, %zu records, %zu lost (%.3f %%), %zu bad frames, %.1f kB/s%s", elapsed_time, statistics.num_of_records,
+           statistics.num_of_lost, (num_of_expected > 0) ? 100.0 * statistics.num_of_lost / num_of_expected : 0.0,
+           statistics.num_of_bad, statistics.num_of_bytes * 1.0e-3 / std::max(elapsed_time, 1.0e-9), end);
+    fflush(stdout);
+}
+
+static void splitNames(const char* list, std::vector<std::string>& names)
+{
+    std::string name;
+    for (const char* c = list;; c++) {
+        if ((*c == ',') || (*c == '\0')) {
+            names.push_back(name);
+            name.clear();
+            if (*c == '\0')
+                break;
+        } else {
+            name += *c;
+        }
+    }
+}
+
+static void printUsage()
+{
+    printf("usage: serial_receiver port|file [options]\n"
+           "  --out file     typed log file (default capture.bin)\n"
+           "  --raw file     also save the received bytes\n"
+           "  --names a,b,.. channel names (default ch0, ch1, ...)\n"
+           "  --baud n       baud rate (default 2000000)\n"
+           "  --time s       stop after s seconds (default no limit)\n"
+           "  --timeout s    stop if no byte arrived for s seconds after the start (default 0.5)\n"
+           "  --compress     compressed data blocks\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool has_1 = i + 1 < argc;
+        if (!strcmp(arg, "--out") && has_1) {
+            options.out_path = argv[++i];
+        } else if (!strcmp(arg, "--raw") && has_1) {
+            options.raw_path = argv[++i];
+        } else if (!strcmp(arg, "--names") && has_1) {
+            splitNames(argv[++i], options.names);
+        } else if (!strcmp(arg, "--baud") && has_1) {
+            options.baudrate = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--time") && has_1) {
+            options.time_max = atof(argv[++i]);
+        } else if (!strcmp(arg, "--timeout") && has_1) {
+            options.timeout = atof(argv[++i]);
+        } else if (!strcmp(arg, "--compress")) {
+            options.do_compress = true;
+        } else if ((arg[0] == '-') || !options.input.empty()) {
+            printUsage();
+            return 1;
+        } else {
+            options.input = arg;
+        }
+    }
+    if (options.input.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    struct stat input_stat;
+    if (stat(options.input.c_str(), &input_stat) != 0) {
+        printf("could not open %s\n", options.input.c_str());
+        return 1;
+    }
+    const bool is_serial = S_ISCHR(input_stat.st_mode);
+    const int fd = is_serial ? openSerial(options.input, options.baudrate) : open(options.input.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("could not open %s\n", options.input.c_str());
+        return 1;
+    }
+
+    CaptureWriter capture_writer;
+    if (!capture_writer.open(options.out_path, options.names, options.do_compress)) {
+        printf("could not open %s\n", options.out_path.c_str());
+        return 1;
+    }
+    FILE* raw_file = nullptr;
+    if (!options.raw_path.empty() && !(raw_file = fopen(options.raw_path.c_str(), "wb"))) {
+        printf("could not open %s\n", options.raw_path.c_str());
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+
+    // the robot only starts to send after the start byte
+    int start_attempts = 0;
+    auto sendStartByte = [&]() {
+        const uint8_t start_byte = START_BYTE;
+        tcflush(fd, TCIFLUSH);
+        if (write(fd, &start_byte, 1) != 1)
+            printf("could not send the start byte\n");
+        start_attempts++;
+        printf("waiting for the stream (attempt %d of %d)...\n", start_attempts, START_ATTEMPTS_MAX);
+    };
+    if (is_serial)
+        sendStartByte();
+
+    ChunkQueue chunk_queue;
+    std::thread reader(readInput, fd, is_serial, std::ref(chunk_queue), raw_file);
+
+    FrameDecoder frame_decoder(capture_writer);
+    const Clock::time_point time_start = Clock::now();
+    Clock::time_point time_attempt = time_start;
+    Clock::time_point time_byte = time_start;
+    Clock::time_point time_print = time_start;
+    bool is_streaming = false;
+    std::vector<uint8_t> chunk;
+    while (!s_do_stop) {
+        bool is_finished = false;
+        const Clock::time_point time_now = Clock::now();
+        if (chunk_queue.pop(chunk, 0.1, is_finished)) {
+            frame_decoder.add(chunk.data(), chunk.size());
+            is_streaming = true;
+            time_byte = time_now;
+        }
+        if (is_finished)
+            break;
+
+        const double elapsed_time = std::chrono::duration<double>(time_now - time_start).count();
+        if ((options.time_max > 0.0) && (elapsed_time > options.time_max))
+            break;
+        if (is_serial && is_streaming && (std::chrono::duration<double>(time_now - time_byte).count() > options.timeout)) {
+            printf("\nno data for %.2f s\n", options.timeout);
+            break;
+        }
+        if (is_serial && !is_streaming && (std::chrono::duration<double>(time_now - time_attempt).count() > START_TIMEOUT)) {
+            if (start_attempts == START_ATTEMPTS_MAX) {
+                printf("stream not started after %d attempts\n", START_ATTEMPTS_MAX);
+                break;
+            }
+            sendStartByte();
+            time_attempt = time_now;
+        }
+        if (is_serial && is_streaming && (std::chrono::duration<double>(time_now - time_print).count() >= 1.0)) {
+            printStatistics(frame_decoder.getStatistics(), elapsed_time, "\r");
+            time_print = time_now;
+        }
+    }
+    s_do_stop = true;
+    reader.join();
+    // decode what the reader queued after the end
+    bool is_finished = false;
+    while (chunk_queue.pop(chunk, 0.0, is_finished))
+        frame_decoder.add(chunk.data(), chunk.size());
+    close(fd);
+
+    const double elapsed_time = std::chrono::duration<double>(Clock::now() - time_start).count();
+    const Statistics& statistics = frame_decoder.getStatistics();
+    printStatistics(statistics, elapsed_time, "\n");
+    printf("%zu frames, %zu info frames, %u floats per record, %.1f MB\n", statistics.num_of_frames, statistics.num_of_infos,
+           capture_writer.getNumOfFloats(), statistics.num_of_bytes * 1.0e-6);
+
+    bool is_ok = capture_writer.close();
+    if (raw_file)
+        is_ok &= fclose(raw_file) == 0;
+    if (!is_ok)
+        printf("could not write %s\n", options.out_path.c_str());
+    return is_ok ? 0 : 1;
+}
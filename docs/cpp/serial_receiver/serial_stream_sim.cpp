@@ -0,0 +1,205 @@
+/**
+ * @file serial_stream_sim.cpp
+ * @brief Host side simulation of the framed SerialStream with a DMA transmitter and a noisy line.
+ *
+ * Builds the byte stream of the SerialStream (info frame, then one data frame per record, see
+ * lib/SerialFrame/SerialFrame.h) like the firmware does it and passes it through a model of the
+ * transmit path and of the line:
+ * - the control loop sends a record every 1 / rate s with a random jitter, the records are queued
+ *   in the two buffers of the SerialDma (SERIAL_DMA_BUFFER_SIZE bytes each) and transmitted at the
+ *   baud rate (10 bits per byte), a record that does not fit is dropped by the robot, its sequence
+ *   number is used anyway
+ * - on the line every bit is flipped with the bit error rate and every byte is lost with the byte
+ *   loss rate (e.g. an overrun of the receiver)
+ *
+ * Writes the received bytes to a file for serial_receiver and prints the records dropped by the
+ * robot, the records destroyed on the line (an error in the frame, its zero byte or the zero byte
+ * in front of it) and the records the receiver has to recover, the number of floats in channel 0
+ * of a record is its record index (an incrementing counter), the other channels are sines.
+ *
+ * @usage
+ * ```
+ * ./build.sh
+ * ./serial_stream_sim [--floats 20] [--rate 2000] [--time 60] [--baud 2000000] [--jitter_us 100]
+ *                     [--ber 1e-6] [--byte_loss 1e-6] [--seed 1] [--out stream.raw]
+ * ./serial_receiver stream.raw --out stream.bin
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "SerialFrame.h"
+
+#define DMA_BUFFER_SIZE 256 // SERIAL_DMA_BUFFER_SIZE
+
+struct Parameters {
+    uint8_t num_of_floats = 20;
+    double rate = 2000.0;
+    double time_s = 60.0;
+    double baudrate = 2.0e6;
+    double jitter_us = 100.0;
+    double ber = 1.0e-6;
+    double byte_loss = 1.0e-6;
+    uint32_t seed = 1;
+    std::string out_path = "stream.raw";
+};
+
+// the two buffers of the SerialDma, one is transmitted while the records are appended to the other
+class DmaModel
+{
+public:
+    explicit DmaModel(double byte_time) : m_byte_time(byte_time) {}
+
+    bool queue(double time, size_t size)
+    {
+        // transfers that completed before the record start the pending buffer
+        while (m_is_busy && (m_end_time <= time)) {
+            if (m_pending_size > 0) {
+                m_end_time += m_pending_size * m_byte_time;
+                m_pending_size = 0;
+            } else {
+                m_is_busy = false;
+            }
+        }
+        if (!m_is_busy) {
+            m_is_busy = true;
+            m_end_time = time + size * m_byte_time;
+            return true;
+        }
+        if (m_pending_size + size <= DMA_BUFFER_SIZE) {
+            m_pending_size += size;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    double m_byte_time;
+    bool m_is_busy{false};
+    double m_end_time{0.0};
+    size_t m_pending_size{0};
+};
+
+int main(int argc, char** argv)
+{
+    Parameters parameters;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--floats") == 0)
+            parameters.num_of_floats = static_cast<uint8_t>(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--rate") == 0)
+            parameters.rate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--time") == 0)
+            parameters.time_s = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--baud") == 0)
+            parameters.baudrate = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--jitter_us") == 0)
+            parameters.jitter_us = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--ber") == 0)
+            parameters.ber = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--byte_loss") == 0)
+            parameters.byte_loss = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            parameters.seed = static_cast<uint32_t>(atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--out") == 0)
+            parameters.out_path = argv[i + 1];
+    }
+    if ((parameters.num_of_floats == 0) || (parameters.num_of_floats * sizeof(float) > SERIAL_FRAME_PAYLOAD_SIZE_MAX)) {
+        printf("number of floats has to be 1 ... %zu\n", SERIAL_FRAME_PAYLOAD_SIZE_MAX / sizeof(float));
+        return 1;
+    }
+
+    std::mt19937 generator(parameters.seed);
+    std::uniform_real_distribution<double> jitter(0.0, parameters.jitter_us * 1.0e-6);
+
+    // the stream without errors and the position of the zero byte at the end of every data frame
+    std::vector<uint8_t> stream;
+    std::vector<size_t> ends;
+    uint8_t frame[SERIAL_FRAME_SIZE_MAX];
+    uint8_t coded[SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_SIZE_MAX)];
+    const uint64_t time_start_us = 5000000; // the robot started 5 s before the stream
+
+    stream.push_back(0);
+    serialFrameWriteInfo(&frame[SERIAL_FRAME_HEADER_SIZE], parameters.num_of_floats, time_start_us);
+    size_t size = serialFrameFinish(frame, SERIAL_FRAME_TYPE_INFO, 0, static_cast<uint32_t>(time_start_us), SERIAL_FRAME_INFO_SIZE);
+    size = serialFrameEncode(frame, size, coded);
+    stream.insert(stream.end(), coded, coded + size);
+    const size_t info_end = stream.size() - 1;
+
+    DmaModel dma_model(10.0 / parameters.baudrate);
+    const size_t num_of_records = static_cast<size_t>(parameters.time_s * parameters.rate);
+    size_t num_of_dropped = 0;
+    for (size_t k = 0; k < num_of_records; k++) {
+        const double time = k / parameters.rate + jitter(generator);
+        float values[SERIAL_FRAME_PAYLOAD_SIZE_MAX / sizeof(float)];
+        values[0] = static_cast<float>(k);
+        for (uint8_t c = 1; c < parameters.num_of_floats; c++)
+            values[c] = static_cast<float>(sin(2.0 * M_PI * c * time));
+        memcpy(&frame[SERIAL_FRAME_HEADER_SIZE], values, parameters.num_of_floats * sizeof(float));
+        const uint64_t time_us = time_start_us + static_cast<uint64_t>(time * 1.0e6);
+        size = serialFrameFinish(frame, SERIAL_FRAME_TYPE_DATA, static_cast<uint16_t>(k), static_cast<uint32_t>(time_us),
+                                 parameters.num_of_floats * sizeof(float));
+        size = serialFrameEncode(frame, size, coded);
+        if (!dma_model.queue(time, size)) {
+            num_of_dropped++;
+            continue;
+        }
+        stream.insert(stream.end(), coded, coded + size);
+        ends.push_back(stream.size() - 1);
+    }
+
+    // errors on the line, a record survives if its bytes, its zero byte and the zero byte in front of it are intact
+    std::bernoulli_distribution bit_error(1.0 - pow(1.0 - parameters.ber, 8.0));
+    std::bernoulli_distribution byte_loss(parameters.byte_loss);
+    std::uniform_int_distribution<int> bit(0, 7);
+    std::vector<bool> is_damaged(stream.size(), false);
+    std::vector<uint8_t> received;
+    received.reserve(stream.size());
+    for (size_t i = 0; i < stream.size(); i++) {
+        if (byte_loss(generator)) {
+            is_damaged[i] = true;
+            continue;
+        }
+        uint8_t byte = stream[i];
+        if (bit_error(generator)) {
+            byte ^= static_cast<uint8_t>(1 << bit(generator));
+            is_damaged[i] = true;
+        }
+        received.push_back(byte);
+    }
+    size_t num_of_destroyed = 0;
+    size_t begin = info_end;
+    for (size_t end : ends) {
+        for (size_t i = begin; i <= end; i++) {
+            if (is_damaged[i]) {
+                num_of_destroyed++;
+                break;
+            }
+        }
+        begin = end;
+    }
+
+    FILE* file = fopen(parameters.out_path.c_str(), "wb");
+    if (!file || (fwrite(received.data(), 1, received.size(), file) != received.size())) {
+        printf("could not write %s\n", parameters.out_path.c_str());
+        return 1;
+    }
+    fclose(file);
+
+    const double line_load = stream.size() * 10.0 / parameters.baudrate / parameters.time_s;
+    printf("%zu records of %u floats at %.0f Hz, %zu bytes, line load %.1f %%\n", num_of_records, parameters.num_of_floats,
+           parameters.rate, stream.size(), 100.0 * line_load);
+    printf("dropped by the robot %zu, destroyed on the line %zu, damaged bytes %zu\n", num_of_dropped, num_of_destroyed,
+           static_cast<size_t>(std::count(is_damaged.begin(), is_damaged.end(), true)));
+    printf("expected: %zu records, %zu lost\n", ends.size() - num_of_destroyed, num_of_dropped + num_of_destroyed);
+    return 0;
+}
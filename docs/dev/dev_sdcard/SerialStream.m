@@ -10,6 +10,9 @@ classdef SerialStream < handle
         ind_end
         timeout
         num_of_floats
+        has_time
+        is_framed
+        time_start_us
         is_busy
         max_trigger_attempts
         trigger_attempts
@@ -21,7 +24,7 @@ classdef SerialStream < handle
             obj.port = port;
             obj.baudrate = baudrate;
             obj.SerialPort = serialport(obj.port, obj.baudrate);
-            obj.data = zeros(1e8, 1); % preallocate big data array
+            obj.data = zeros(4e8, 1, 'uint8'); % preallocate big data array of the received bytes
             reset(obj);
         end
 
@@ -31,6 +34,9 @@ classdef SerialStream < handle
             obj.is_waiting_for_fist_measurement = true;
             obj.ind_end = 0;
             obj.num_of_floats = 0;
+            obj.has_time = false;
+            obj.is_framed = false;
+            obj.time_start_us = uint64(0);
             obj.is_busy = true;
             obj.max_trigger_attempts = 5;
             obj.trigger_attempts = 0;
@@ -48,21 +54,33 @@ classdef SerialStream < handle
 
                     obj.is_waiting_for_fist_measurement = false;
                     obj.num_of_floats = obj.SerialPort.read(1, 'uint8');
-
                     bytes_readable = bytes_readable - 1;
 
-                    fprintf("SerialStream started, logging %d signals\n", obj.num_of_floats);
+                    % the framed stream starts with a zero byte in front of the info frame, the frames are decoded in getData()
+                    obj.is_framed = obj.num_of_floats == 0;
+                    if (obj.is_framed)
+                        fprintf("SerialStream started, receiving frames\n");
+                    else
+                        % the flag 0x80 marks records with their time, the byte is followed by the time of the first record
+                        obj.has_time = bitand(obj.num_of_floats, 128) ~= 0;
+                        obj.num_of_floats = bitand(obj.num_of_floats, 127);
+                        if (obj.has_time)
+                            obj.time_start_us = obj.SerialPort.read(1, 'uint64');
+                            bytes_readable = bytes_readable - 8;
+                        end
+
+                        fprintf("SerialStream started, logging %d signals\n", obj.num_of_floats);
+                    end
                     obj.timeout = 0.3;
                 end
 
-                if (bytes_readable >= 4)
+                if (bytes_readable > 0)
 
-                    num_of_floats_readable = ceil(bytes_readable / 4);
-                    data_raw = obj.SerialPort.read(num_of_floats_readable, 'single');
+                    data_raw = obj.SerialPort.read(bytes_readable, 'uint8');
 
                     ind_start = obj.ind_end + 1;
-                    obj.ind_end = ind_start + num_of_floats_readable - 1;
-                    obj.data(ind_start:obj.ind_end) = double(data_raw(1:obj.ind_end-ind_start+1));
+                    obj.ind_end = ind_start + length(data_raw) - 1;
+                    obj.data(ind_start:obj.ind_end) = uint8(data_raw);
 
                     obj.Timer = tic;
                 end
@@ -78,7 +96,7 @@ classdef SerialStream < handle
                                 obj.max_trigger_attempts, obj.timeout);
                         else
                             fprintf("SerialStream ended with %0.2f seconds timeout\n", obj.timeout);
-                            fprintf("             measured %d datapoints\n", obj.ind_end);
+                            fprintf("             measured %d bytes\n", obj.ind_end);
                         end
                         obj.is_busy = false;
                         break;
@@ -93,12 +111,29 @@ classdef SerialStream < handle
 
         function data = getData(obj)
 
-            data.values = reshape(obj.data(1:obj.ind_end), [obj.num_of_floats, obj.ind_end/obj.num_of_floats]).';
-            
-            data.time = cumsum(data.values(:,1)) * 1e-6;
-            data.time = data.time - data.time(1);
+            if (obj.is_framed)
+                data = obj.getFramedData();
+            elseif (obj.has_time)
+                % per record the uint32 time difference in microseconds to the previous record and the floats
+                record_size = 4 + 4 * obj.num_of_floats;
+                num_of_records = floor(obj.ind_end / record_size);
+                data_bytes = reshape(obj.data(1:num_of_records * record_size), [record_size, num_of_records]);
+                delta_time_us = double(typecast(reshape(data_bytes(1:4,:), [], 1), 'uint32'));
+                data.values = double(reshape(typecast(reshape(data_bytes(5:end,:), [], 1), 'single'), [obj.num_of_floats, num_of_records]).');
 
-            data.values = data.values(:,2:end);
+                % exact time in microseconds since the start of the robot
+                data.time_us = double(obj.time_start_us) + cumsum(delta_time_us);
+                data.time = (data.time_us - data.time_us(1)) * 1e-6;
+            else
+                num_of_values = floor(obj.ind_end / 4);
+                data_raw = double(typecast(obj.data(1:4 * num_of_values), 'single'));
+                data.values = reshape(data_raw(1:floor(num_of_values / obj.num_of_floats) * obj.num_of_floats), obj.num_of_floats, []).';
+
+                data.time = cumsum(data.values(:,1)) * 1e-6;
+                data.time = data.time - data.time(1);
+
+                data.values = data.values(:,2:end);
+            end
 
         end
     end
@@ -106,6 +141,61 @@ classdef SerialStream < handle
 %%
     methods (Access = private)
 
+        function data = getFramedData(obj)
+
+            % the frames are COBS coded and end with a zero byte, see lib/SerialFrame/SerialFrame.h
+            bytes = obj.data(1:obj.ind_end);
+            ind_zero = find(bytes == 0);
+            ind_begin = [1; ind_zero(1:end-1) + 1];
+            frames = cell(numel(ind_zero), 1);
+            for i = 1:numel(ind_zero)
+                frames{i} = SerialStream.decodeCobs(bytes(ind_begin(i):ind_zero(i)-1));
+            end
+            frame_sizes = cellfun(@numel, frames);
+
+            % the info frame (type 1, 19 bytes) has the number of floats and the time of the start
+            has_info = false;
+            for i = find(frame_sizes == 19).'
+                frame = frames{i};
+                if (frame(1) == 1 && SerialStream.crc16(frame(1:end-2)) == typecast(frame(end-1:end), 'uint16'))
+                    obj.num_of_floats = double(frame(9));
+                    obj.time_start_us = typecast(frame(10:17), 'uint64');
+                    has_info = true;
+                    break;
+                end
+            end
+            if (~has_info)
+                obj.num_of_floats = (mode(frame_sizes(frame_sizes >= 13 & frame_sizes ~= 19)) - 9) / 4;
+            end
+
+            % data frames (type 2): uint16 sequence number, uint32 time in us, the floats and the crc16
+            frame_size = 9 + 4 * obj.num_of_floats;
+            ind_data = find(frame_sizes == frame_size);
+            data_frames = zeros(frame_size, numel(ind_data), 'uint8');
+            for i = 1:numel(ind_data)
+                data_frames(:,i) = frames{ind_data(i)};
+            end
+            crc = typecast(reshape(data_frames(end-1:end,:), [], 1), 'uint16').';
+            is_valid = (data_frames(1,:) == 2) & (SerialStream.crc16(data_frames(1:end-2,:)) == crc);
+            data_frames = data_frames(:,is_valid);
+            num_of_records = size(data_frames, 2);
+
+            seq = double(typecast(reshape(data_frames(2:3,:), [], 1), 'uint16'));
+            time_us = double(typecast(reshape(data_frames(4:7,:), [], 1), 'uint32'));
+            data.values = double(reshape(typecast(reshape(data_frames(8:end-2,:), [], 1), 'single'), [obj.num_of_floats, num_of_records]).');
+
+            % the sequence numbers and the times wrap around, a gap in the sequence numbers is a lost record
+            seq_diff = mod(diff(seq), 2^16);
+            data.index = seq(1) + [0; cumsum(seq_diff)];
+            time_first_us = double(obj.time_start_us) + mod(time_us(1) - mod(double(obj.time_start_us), 2^32), 2^32);
+            data.time_us = time_first_us + [0; cumsum(mod(diff(time_us), 2^32))];
+            data.time = (data.time_us - data.time_us(1)) * 1e-6;
+
+            num_of_lost = sum(seq_diff - 1);
+            num_of_bad = sum(frame_sizes > 0) - num_of_records - has_info;
+            fprintf("SerialStream %d records, %d lost, %d bad frames\n", num_of_records, num_of_lost, num_of_bad);
+        end
+
         function sendStartByte(obj, start_byte)
 
             if (~exist('byte', 'var') || isempty(start_byte))
@@ -119,4 +209,53 @@ classdef SerialStream < handle
             fprintf("SerialStream waiting for %0.2f seconds...\n", obj.timeout);
         end
     end
+
+%%
+    methods (Static, Access = private)
+
+        function frame = decodeCobs(coded)
+
+            % every code byte gives the distance to the next zero byte, 255 means 254 bytes without a zero
+            frame = zeros(numel(coded), 1, 'uint8');
+            n = 0;
+            i = 1;
+            while (i <= numel(coded))
+                code = double(coded(i));
+                if (i + code - 1 > numel(coded))
+                    frame = zeros(0, 1, 'uint8');
+                    return;
+                end
+                frame(n+1:n+code-1) = coded(i+1:i+code-1);
+                n = n + code - 1;
+                i = i + code;
+                if (code < 255 && i <= numel(coded))
+                    n = n + 1; % the zero byte, frame is filled with zeros
+                end
+            end
+            frame = frame(1:n);
+        end
+
+        function crc = crc16(frames)
+
+            % crc16 ccitt-false (polynomial 0x1021, init 0xFFFF) of every column
+            table = zeros(256, 1, 'uint16');
+            for i = 0:255
+                c = uint16(i * 256);
+                for j = 1:8
+                    if (bitand(c, 32768))
+                        c = bitxor(bitshift(c, 1), uint16(4129));
+                    else
+                        c = bitshift(c, 1);
+                    end
+                end
+                table(i + 1) = c;
+            end
+
+            crc = repmat(uint16(65535), 1, size(frames, 2));
+            for i = 1:size(frames, 1)
+                ind = bitxor(bitshift(crc, -8), uint16(frames(i,:)));
+                crc = bitxor(bitshift(crc, 8), reshape(table(double(ind) + 1), 1, []));
+            end
+        end
+    end
 end
@@ -6,17 +6,39 @@ function data = read_sdcard_data(file_name)
     % open the file
     file_id = fopen(file_name); % test measurement
     
-    % extract number of floats
+    % extract number of floats, the flag 0x80 marks records with their time
     num_of_floats = fread(file_id, 1, 'uint8');
+    has_time = bitand(num_of_floats, 128) ~= 0;
+    num_of_floats = bitand(num_of_floats, 127);
     fprintf('   Number of floats: %d\n', num_of_floats);
     
-    % extract raw data
-    data_raw = fread(file_id, 'single');
-    fprintf('   Raw data length: %d\n', length(data_raw));
+    if (has_time)
+        % time of the first record in microseconds, then per record the
+        % uint32 time difference to the previous record and the floats
+        time_start_us = fread(file_id, 1, 'uint64=>uint64');
+        data_bytes = fread(file_id, 'uint8=>uint8');
+    else
+        % extract raw data
+        data_raw = fread(file_id, 'single');
+        fprintf('   Raw data length: %d\n', length(data_raw));
+    end
     
     % close the file
     fclose(file_id);
 
+    if (has_time)
+        record_size = 4 + 4 * num_of_floats;
+        num_of_records = floor(length(data_bytes) / record_size);
+        data_bytes = reshape(data_bytes(1:num_of_records * record_size), [record_size, num_of_records]);
+        delta_time_us = double(typecast(reshape(data_bytes(1:4,:), [], 1), 'uint32'));
+        data.values = double(reshape(typecast(reshape(data_bytes(5:end,:), [], 1), 'single'), [num_of_floats, num_of_records]).');
+        % exact time in microseconds since the start of the robot
+        data.time_us = double(time_start_us) + cumsum(delta_time_us);
+        data.time = (data.time_us - data.time_us(1)) * 1e-6;
+        fprintf('   Data matrix: %dx%d\n', size(data.values));
+        return
+    end
+
 
     %% preprocess the data
     
@@ -8,17 +8,21 @@ import matplotlib.pyplot as plt
 def read_sdcard_data_with_time(file_name):
     """
     1) Reads the first byte as the number of floats per record.
-    2) Reads the remaining data as float32 and truncates to a multiple
-        of num_of_floats.
-    3) Reshapes into (num_records, num_of_floats).
-    4) The first column is delta time in microseconds -> convert to
-        cumulative time in seconds.
-    5) The remaining columns are returned as measurements.
+    2) If the byte has the record time flag (0x80) set, the byte is followed by the
+        uint64 time in microseconds of the first record and every record starts with
+        the uint32 time difference in microseconds to the previous record, the exact
+        time of the records is the cumulative sum.
+    3) Otherwise reads the remaining data as float32, truncates to a multiple of
+        num_of_floats and reshapes into (num_records, num_of_floats), the first column
+        is delta time in microseconds -> convert to cumulative time in seconds.
+    4) The remaining columns are returned as measurements.
 
     Returns a dictionary with:
         {
           "time":    1D array of length num_records,
-          "values":  2D array [num_records x (num_of_floats-1)]
+          "values":  2D array [num_records x (num_of_floats-1)],
+          "time_us": 1D array of the exact time in microseconds since the start of the robot
+                     (only with the record time flag)
         }
     """
     print("   --- read_sdcard_data_with_time ---")
@@ -29,32 +33,51 @@ def read_sdcard_data_with_time(file_name):
         num_of_floats_array = np.fromfile(f, dtype=np.uint8, count=1)
         if len(num_of_floats_array) == 0:
             raise ValueError("File is empty or not in the expected format.")
-        num_of_floats = int(num_of_floats_array[0])
+        has_time = (int(num_of_floats_array[0]) & 0x80) != 0
+        num_of_floats = int(num_of_floats_array[0]) & 0x7F
         print(f"   Number of floats: {num_of_floats}")
 
-        # Read the remaining data as float32
-        data_raw = np.fromfile(f, dtype=np.float32)
-        print(f"   Raw data length: {len(data_raw)}")
-
-    # Truncate to a multiple of num_of_floats
-    length_adjusted = (len(data_raw) // num_of_floats) * num_of_floats
-    data_raw = data_raw[:length_adjusted]
-
-    # Reshape into (num_records, num_of_floats)
-    data_values = data_raw.reshape(-1, num_of_floats)
-
-    # We assume the first column is delta time in microseconds
-    delta_time_us = data_values[:, 0]
-
-    # Convert to cumulative time in seconds, shift to start at 0
-    time = np.cumsum(delta_time_us) * 1e-6
-
-    # The remaining columns are measurements
-    data_values = data_values[:, 1:]
+        if has_time:
+            # Time of the first record, then per record the time difference and the floats
+            time_start_us = np.fromfile(f, dtype="<u8", count=1)[0]
+            record_type = np.dtype([("delta_time_us", "<u4"), ("values", "<f4", (num_of_floats,))])
+            records = np.fromfile(f, dtype=record_type)
+            print(f"   Number of records: {len(records)}")
+            delta_time_us = records["delta_time_us"]
+            data_values = records["values"].reshape(-1, num_of_floats)
+        else:
+            # Read the remaining data as float32
+            data_raw = np.fromfile(f, dtype=np.float32)
+            print(f"   Raw data length: {len(data_raw)}")
+
+    if not has_time:
+        # Truncate to a multiple of num_of_floats
+        length_adjusted = (len(data_raw) // num_of_floats) * num_of_floats
+        data_raw = data_raw[:length_adjusted]
+
+        # Reshape into (num_records, num_of_floats)
+        data_values = data_raw.reshape(-1, num_of_floats)
+
+    if has_time:
+        # The exact time of the records, the measurements are all columns
+        time_us = time_start_us + np.cumsum(delta_time_us.astype(np.uint64))
+        time = (time_us - time_us[0]) * 1e-6
+    else:
+        # We assume the first column is delta time in microseconds
+        delta_time_us = data_values[:, 0]
+
+        # Convert to cumulative time in seconds, shift to start at 0
+        time = np.cumsum(delta_time_us) * 1e-6
+
+        # The remaining columns are measurements
+        data_values = data_values[:, 1:]
 
     print(f"   Data matrix: {data_values.shape[0]}x{data_values.shape[1]}\n")
 
-    return {"time": time, "values": data_values}  # 1D array of length num_records, # 2D array of shape [num_records x (num_of_floats-1)]
+    data = {"time": time, "values": data_values}  # 1D array of length num_records, # 2D array of shape [num_records x (num_of_floats-1)]
+    if has_time:
+        data["time_us"] = time_us
+    return data
 
 
 # Read the file
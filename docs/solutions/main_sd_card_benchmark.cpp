@@ -0,0 +1,113 @@
+#include "mbed.h"
+
+// pes board pin map
+#include "PESBoardPinMap.h"
+
+// drivers
+#include "DebounceIn.h"
+#include "SDWriter.h"
+
+// compares the write paths of the SDWriter on the sd card of the robot, press the user button to start:
+// - fat:              new file in /sd/data, grows while writing (cluster allocation and FAT updates)
+// - fat preallocated: new file in /sd/data, preallocated to the size of the test
+// - raw:              space behind the last partition of the card (SD_RAW_FREE_SPACE), no file system
+// every mode writes BENCHMARK_SIZE bytes in chunks of 2048 bytes (like the SDLogger thread) and flushes every
+// 500 chunks (about 1 s of logging at 1 MB/s), the time of every writeBytes() and flush() is measured
+#define BENCHMARK_SIZE (8UL * 1024UL * 1024UL)
+#define BENCHMARK_CHUNK_SIZE 2048
+#define BENCHMARK_FLUSH_CHUNKS 500
+
+bool do_execute_main_task = false; // this variable will be toggled via the user button (blue button)
+
+// objects for user button (blue button) handling on nucleo board
+DebounceIn user_button(BUTTON1);   // create DebounceIn to evaluate the user button
+void toggle_do_execute_main_fcn(); // custom function which is getting executed when user
+                                   // button gets pressed, definition below
+
+void run_benchmark(SDWriter& sd_writer, const char* name, int mode);
+
+// main runs as an own thread
+int main()
+{
+    // attach button fall function address to user button object
+    user_button.fall(&toggle_do_execute_main_fcn);
+
+    // led on nucleo board
+    DigitalOut user_led(LED1);
+
+    // sd card writer, the benchmark does not use the logger thread
+    SDWriter sd_writer(PB_SD_MOSI, PB_SD_MISO, PB_SD_SCK, PB_SD_CS);
+
+    printf("press the user button to start the sd card benchmark\n");
+
+    // this loop will run forever
+    while (true) {
+        if (do_execute_main_task) {
+            user_led = 1;
+            run_benchmark(sd_writer, "fat", 0);
+            run_benchmark(sd_writer, "fat preallocated", 1);
+            run_benchmark(sd_writer, "raw", 2);
+            user_led = 0;
+            do_execute_main_task = false;
+            printf("done\n");
+        }
+        thread_sleep_for(100);
+    }
+}
+
+void run_benchmark(SDWriter& sd_writer, const char* name, int mode)
+{
+    static uint8_t chunk[BENCHMARK_CHUNK_SIZE];
+    for (size_t i = 0; i < BENCHMARK_CHUNK_SIZE; i++)
+        chunk[i] = static_cast<uint8_t>(i);
+
+    bool is_open = false;
+    if (mode == 2) {
+        sd_writer.unmount();
+        is_open = sd_writer.openRaw(SD_RAW_FREE_SPACE);
+    } else {
+        is_open = sd_writer.mount() && sd_writer.openNextFile((mode == 1) ? BENCHMARK_SIZE : 0);
+    }
+    if (!is_open) {
+        printf("%s: could not open\n", name);
+        return;
+    }
+
+    Timer timer;
+    timer.start();
+    const uint32_t num_of_chunks = BENCHMARK_SIZE / BENCHMARK_CHUNK_SIZE;
+    int64_t time_max_us = 0;
+    int64_t flush_time_max_us = 0;
+    uint32_t num_of_slow_writes = 0; // longer than 10 ms, the SDLogger buffer of 16384 bytes lasts about 370 ms at 22 floats and 500 Hz
+    bool is_ok = true;
+    const int64_t start_us = duration_cast<microseconds>(timer.elapsed_time()).count();
+    for (uint32_t i = 0; (i < num_of_chunks) && is_ok; i++) {
+        const int64_t write_start_us = duration_cast<microseconds>(timer.elapsed_time()).count();
+        is_ok = sd_writer.writeBytes(chunk, BENCHMARK_CHUNK_SIZE);
+        const int64_t write_time_us = duration_cast<microseconds>(timer.elapsed_time()).count() - write_start_us;
+        if (write_time_us > time_max_us)
+            time_max_us = write_time_us;
+        if (write_time_us > 10000)
+            num_of_slow_writes++;
+        if ((i + 1) % BENCHMARK_FLUSH_CHUNKS == 0) {
+            const int64_t flush_start_us = duration_cast<microseconds>(timer.elapsed_time()).count();
+            is_ok &= sd_writer.flush();
+            const int64_t flush_time_us = duration_cast<microseconds>(timer.elapsed_time()).count() - flush_start_us;
+            if (flush_time_us > flush_time_max_us)
+                flush_time_max_us = flush_time_us;
+        }
+    }
+    is_ok &= sd_writer.flush();
+    const int64_t time_us = duration_cast<microseconds>(timer.elapsed_time()).count() - start_us;
+    sd_writer.closeFile();
+
+    printf("%s: %s, %.2f MB/s, max. write %lld us, max. flush %lld us, %lu writes > 10 ms\n", name, is_ok ? "ok" : "failed",
+           static_cast<float>(BENCHMARK_SIZE) / static_cast<float>(time_us), time_max_us, flush_time_max_us,
+           (unsigned long)num_of_slow_writes);
+}
+
+void toggle_do_execute_main_fcn()
+{
+    // start the benchmark if the button was pressed
+    do_execute_main_task = true;
+}
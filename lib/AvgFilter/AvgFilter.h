@@ -1,7 +1,8 @@
 #ifndef AVG_FILTER_H_
 #define AVG_FILTER_H_
 
-#include "mbed.h"
+#include <stdint.h>
+#include <stdlib.h>
 
 /**
  * Average filter class.
@@ -0,0 +1,245 @@
+#include "Capture.h"
+
+#include <new>
+
+#include "SDLogger.h"
+#include "SerialStream.h"
+
+Capture::Capture(uint8_t num_of_channels, uint32_t num_of_samples, uint32_t num_of_pre_samples)
+{
+    m_num_of_channels = (num_of_channels < 1) ? 1 : ((num_of_channels > CAPTURE_NUM_OF_CHANNELS_MAX) ? CAPTURE_NUM_OF_CHANNELS_MAX : num_of_channels);
+    m_slot_size = m_num_of_channels + 1;
+
+    // the ring is the window, limited to CAPTURE_BUFFER_SIZE words
+    const uint32_t num_of_samples_max = CAPTURE_BUFFER_SIZE / m_slot_size;
+    m_num_of_samples = (num_of_samples < 2) ? 2 : ((num_of_samples > num_of_samples_max) ? num_of_samples_max : num_of_samples);
+    m_num_of_pre_samples = (num_of_pre_samples < m_num_of_samples) ? num_of_pre_samples : m_num_of_samples - 1;
+    if (m_num_of_samples < num_of_samples) {
+        printf("Capture: window limited to %lu samples\n", (unsigned long)m_num_of_samples);
+    }
+
+    // allocated once for the window, the object itself stays small
+    m_buffer = new (std::nothrow) uint32_t[m_num_of_samples * m_slot_size];
+    if (m_buffer == nullptr) {
+        printf("Capture: allocating %lu bytes for the window failed\n", (unsigned long)(m_num_of_samples * m_slot_size * sizeof(uint32_t)));
+        m_state = State::IDLE;
+        return;
+    }
+
+    arm();
+}
+
+Capture::~Capture()
+{
+    delete[] m_buffer;
+}
+
+void Capture::setThresholdTrigger(uint8_t channel, float level, bool trigger_above)
+{
+    m_trigger_mode = TriggerMode::THRESHOLD;
+    m_trigger_channel = (channel < m_num_of_channels) ? channel : m_num_of_channels - 1;
+    m_trigger_level = level;
+    m_trigger_above = trigger_above;
+}
+
+void Capture::setEdgeTrigger(uint8_t channel, float level, Edge edge)
+{
+    m_trigger_mode = TriggerMode::EDGE;
+    m_trigger_channel = (channel < m_num_of_channels) ? channel : m_num_of_channels - 1;
+    m_trigger_level = level;
+    m_trigger_edge = edge;
+    m_previous_is_valid = false;
+}
+
+void Capture::setCallbackTrigger(trigger_t trigger)
+{
+    m_trigger_mode = TriggerMode::CALLBACK;
+    m_trigger = trigger;
+}
+
+bool Capture::setOutput(SDLogger& sd_logger, uint8_t stream)
+{
+    // the plain format has one record size for the file, the records of the capture need their own stream
+    const uint8_t num_of_channels = sd_logger.getStreamNumOfChannels(stream);
+    if (num_of_channels != m_num_of_channels + 2) {
+        printf("Capture: SDLogger stream %u has %u channels, needs a stream of the typed log format with %u\n",
+               (unsigned)stream, (unsigned)num_of_channels, (unsigned)(m_num_of_channels + 2));
+        return false;
+    }
+    m_sd_logger = &sd_logger;
+    m_sd_logger_stream = stream;
+    return true;
+}
+
+bool Capture::setOutput(SerialStream& serial_stream)
+{
+    const uint8_t num_of_floats = serial_stream.getNumOfFloats();
+    if (num_of_floats != m_num_of_channels + 2) {
+        printf("Capture: SerialStream has %u floats, needs %u\n", (unsigned)num_of_floats, (unsigned)(m_num_of_channels + 2));
+        return false;
+    }
+    m_serial_stream = &serial_stream;
+    return true;
+}
+
+void Capture::arm()
+{
+    if (m_buffer == nullptr) {
+        return;
+    }
+    m_head = 0;
+    m_num_of_recorded = 0;
+    m_post_cntr = 0;
+    m_trigger_is_forced = false;
+    m_previous_is_valid = false;
+    m_state = State::ARMED;
+}
+
+void Capture::write(const float val)
+{
+    if (m_float_cntr < m_num_of_channels) {
+        m_sample[m_float_cntr++] = val;
+    }
+}
+
+void Capture::send()
+{
+    const uint8_t num_of_values = m_float_cntr;
+    m_float_cntr = 0;
+
+    if (m_state == State::FROZEN) {
+        writeOutput();
+        return;
+    }
+    if ((m_state == State::IDLE) || (num_of_values == 0)) {
+        return;
+    }
+
+    // channels that were not written are zero
+    if (num_of_values < m_num_of_channels) {
+        memset(&m_sample[num_of_values], 0, (m_num_of_channels - num_of_values) * sizeof(float));
+    }
+    const uint32_t time_us = static_cast<uint32_t>(ticker_read_us(get_us_ticker_data()));
+    uint32_t* slot = &m_buffer[m_head * m_slot_size];
+    slot[0] = time_us;
+    memcpy(&slot[1], m_sample, m_num_of_channels * sizeof(float));
+    m_head = (m_head + 1 == m_num_of_samples) ? 0 : m_head + 1;
+    if (m_num_of_recorded < m_num_of_samples) {
+        m_num_of_recorded++;
+    }
+
+    if (m_state == State::ARMED) {
+        const bool is_triggered = m_trigger_is_forced || checkTrigger();
+        m_previous_value = m_sample[m_trigger_channel];
+        m_previous_is_valid = true;
+        if (is_triggered) {
+            // the pre-trigger part is shorter if the trigger comes right after arm()
+            const uint32_t num_of_pre_samples = (m_num_of_recorded - 1 < m_num_of_pre_samples) ? m_num_of_recorded - 1 : m_num_of_pre_samples;
+            m_post_cntr = m_num_of_samples - m_num_of_pre_samples - 1;
+            m_window_size = num_of_pre_samples + 1 + m_post_cntr;
+            m_window_trigger = num_of_pre_samples;
+            m_trigger_time_us = time_us;
+            m_trigger_is_forced = false;
+            m_state = State::TRIGGERED;
+        }
+    } else if (m_post_cntr > 0) {
+        m_post_cntr--;
+    }
+
+    if ((m_state == State::TRIGGERED) && (m_post_cntr == 0)) {
+        // the last sample of the window is the one before the head
+        m_window_first = (m_head + m_num_of_samples - m_window_size) % m_num_of_samples;
+        m_output_cntr = 0;
+        m_capture_cntr++;
+        m_state = State::FROZEN;
+    }
+}
+
+float Capture::getValue(uint32_t sample, uint8_t channel) const
+{
+    if ((sample >= m_window_size) || (channel >= m_num_of_channels)) {
+        return 0.0f;
+    }
+    float value;
+    memcpy(&value, &m_buffer[getSlot(sample) * m_slot_size + 1 + channel], sizeof(value));
+    return value;
+}
+
+float Capture::getTime(uint32_t sample) const
+{
+    if (sample >= m_window_size) {
+        return 0.0f;
+    }
+    // the difference is correct across the wrap around of the 32 bit time
+    const int32_t time_us = static_cast<int32_t>(m_buffer[getSlot(sample) * m_slot_size] - m_trigger_time_us);
+    return 1.0e-6f * static_cast<float>(time_us);
+}
+
+bool Capture::checkTrigger() const
+{
+    const float value = m_sample[m_trigger_channel];
+    switch (m_trigger_mode) {
+        case TriggerMode::THRESHOLD:
+            return m_trigger_above ? (value > m_trigger_level) : (value < m_trigger_level);
+        case TriggerMode::EDGE: {
+            if (!m_previous_is_valid) {
+                return false;
+            }
+            const bool is_rising = (m_previous_value < m_trigger_level) && (value >= m_trigger_level);
+            const bool is_falling = (m_previous_value > m_trigger_level) && (value <= m_trigger_level);
+            return ((m_trigger_edge != Edge::FALLING) && is_rising) || ((m_trigger_edge != Edge::RISING) && is_falling);
+        }
+        case TriggerMode::CALLBACK:
+            return m_trigger && m_trigger(m_sample);
+        default:
+            return false;
+    }
+}
+
+void Capture::writeOutput()
+{
+    // without output the window stays in ram until arm()
+    if ((m_sd_logger == nullptr) && (m_serial_stream == nullptr)) {
+        return;
+    }
+    if ((m_serial_stream != nullptr) && !m_serial_stream->startByteReceived()) {
+        return;
+    }
+
+    for (uint8_t i = 0; (i < CAPTURE_OUTPUT_NUM_OF_RECORDS) && (m_output_cntr < m_window_size); i++, m_output_cntr++) {
+        float record[CAPTURE_NUM_OF_CHANNELS_MAX + 2];
+        record[0] = static_cast<float>(m_capture_cntr);
+        record[1] = getTime(m_output_cntr);
+        memcpy(&record[2], &m_buffer[getSlot(m_output_cntr) * m_slot_size + 1], m_num_of_channels * sizeof(float));
+        const uint8_t num_of_floats = m_num_of_channels + 2;
+
+        // the outputs send the record with its last float, a dropped record shows up in their counters
+        if (m_sd_logger != nullptr) {
+            const uint32_t lost_cntr = m_sd_logger->getOverflowCount() + m_sd_logger->getNoFileCount();
+            for (uint8_t j = 0; j < num_of_floats; j++)
+                m_sd_logger->write(m_sd_logger_stream, record[j]);
+            if (m_sd_logger->getOverflowCount() + m_sd_logger->getNoFileCount() != lost_cntr)
+                m_dropped_cntr++;
+        }
+        if (m_serial_stream != nullptr) {
+            const uint32_t lost_cntr = m_serial_stream->getDroppedCount();
+            for (uint8_t j = 0; j < num_of_floats; j++)
+                m_serial_stream->write(record[j]);
+            if (m_serial_stream->getDroppedCount() != lost_cntr)
+                m_dropped_cntr++;
+        }
+    }
+
+    if (m_output_cntr == m_window_size) {
+        if (m_do_auto_rearm) {
+            arm();
+        } else {
+            m_state = State::IDLE;
+        }
+    }
+}
+
+uint32_t Capture::getSlot(uint32_t sample) const
+{
+    return (m_window_first + sample) % m_num_of_samples;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file Capture.h
+ * @brief Defines the Capture class, a pre-trigger RAM capture of selected signals (oscilloscope mode).
+ *
+ * The Capture class records one sample of a few channels per period of the control loop into a
+ * RAM ring buffer and keeps a window of num_of_samples around an event, e.g. a wheel slip or a
+ * saturated controller, at a rate the SD card could not sustain continuously:
+ * - while armed, the ring always holds the last num_of_pre_samples samples (pre-trigger depth)
+ * - a trigger is a threshold (channel above or below a level), an edge (channel crosses a level
+ *   rising, falling or both), a user callback with the values of the sample or trigger() from
+ *   the code, the trigger is checked for every sample
+ * - after the trigger the rest of the window is recorded, then the window is frozen
+ * - the frozen window is passed to the output (SDLogger or SerialStream) in slices of
+ *   CAPTURE_OUTPUT_NUM_OF_RECORDS records per send(), so the control loop is never stalled and
+ *   the output keeps its single producer (the thread of the control loop), afterwards the
+ *   capture is armed again (setAutoRearm()) or waits for arm()
+ * - without output the frozen window stays in RAM and can be read with getValue() and getTime()
+ *
+ * The ring buffer is allocated in the constructor with num_of_samples * (num_of_channels + 1)
+ * words (the time and the channels of a sample), 400 samples of 3 channels take 6.4 kB.
+ *
+ * An output record is {capture number, time relative to the trigger sample in s, channel 0,
+ * channel 1, ...}, the SDLogger needs a stream of the typed log format with num_of_channels + 2
+ * channels, the SerialStream as many floats, setOutput() rejects other outputs. The plain format
+ * of the SDLogger is not supported, it has a single record size for the whole file, so records of
+ * the control loop and of the capture in the same file could not be separated. The SerialStream
+ * is only written after the start byte of the host was received.
+ *
+ * A record is not repeated if the output drops it (SDLogger buffer full or no file, transmit
+ * buffer of the SerialStream full), the dropped records are counted, see getDroppedCount().
+ * Samples that arrive while the window is written to the output are not recorded.
+ *
+ * @usage
+ * ```
+ * // the channels of the control loop are stream 0, the capture gets its own stream
+ * const int capture_stream = sd_logger.addStream();
+ * sd_logger.addChannel("capture");
+ * sd_logger.addChannel("time", LOG_TYPE_FLOAT, "s");
+ * sd_logger.addChannel("wheel_speed", LOG_TYPE_FLOAT, "m/s");
+ * sd_logger.addChannel("robot_speed", LOG_TYPE_FLOAT, "m/s");
+ * sd_logger.addChannel("slip");
+ *
+ * static Capture capture(3, 400, 100); // 3 channels, 400 samples with 100 before the trigger
+ * capture.setEdgeTrigger(2, 0.5f, Capture::Edge::RISING);
+ * capture.setOutput(sd_logger, capture_stream);
+ *
+ * // in the control loop
+ * capture.write(wheel_speed);
+ * capture.write(robot_speed);
+ * capture.write(slip);
+ * capture.send(); // records the sample and writes a slice of a frozen window
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "mbed.h"
+
+#define CAPTURE_NUM_OF_CHANNELS_MAX 16
+#define CAPTURE_BUFFER_SIZE 8192 // maximum window in 32 bit words (32 kB), a sample takes num_of_channels + 1 words (the time)
+#define CAPTURE_OUTPUT_NUM_OF_RECORDS 4 // records of a frozen window written to the output per send()
+
+class SDLogger;
+class SerialStream;
+
+class Capture
+{
+public:
+    enum class State : uint8_t {
+        IDLE = 0,  // not recording, waits for arm()
+        ARMED,     // recording the pre-trigger samples, checks the trigger
+        TRIGGERED, // recording the rest of the window
+        FROZEN     // window complete, written to the output
+    };
+
+    enum class Edge : uint8_t {
+        RISING = 0,
+        FALLING,
+        BOTH
+    };
+
+    // returns true to trigger, called with the values of every sample while armed
+    typedef Callback<bool(const float*)> trigger_t;
+
+    /**
+     * @param num_of_channels    number of floats per sample
+     * @param num_of_samples     length of the window, limited to CAPTURE_BUFFER_SIZE words
+     * @param num_of_pre_samples samples before the trigger sample
+     */
+    Capture(uint8_t num_of_channels, uint32_t num_of_samples, uint32_t num_of_pre_samples);
+    ~Capture();
+
+    // trigger if the channel is above (or below) the level
+    void setThresholdTrigger(uint8_t channel, float level, bool trigger_above = true);
+    // trigger if the channel crosses the level
+    void setEdgeTrigger(uint8_t channel, float level, Edge edge = Edge::RISING);
+    void setCallbackTrigger(trigger_t trigger);
+
+    // stream of the typed log format with num_of_channels + 2 channels, declared before, false if the output is rejected
+    bool setOutput(SDLogger& sd_logger, uint8_t stream);
+    // with num_of_channels + 2 floats, false if the output is rejected
+    bool setOutput(SerialStream& serial_stream);
+    // arm again after the window is written to the output, default true
+    void setAutoRearm(bool do_auto_rearm) { m_do_auto_rearm = do_auto_rearm; };
+
+    // starts a new pre-trigger recording, also releases a frozen window
+    void arm();
+    // triggers with the next sample
+    void trigger() { m_trigger_is_forced = true; };
+
+    // write the channels of the sample one by one
+    void write(const float val);
+    // records the sample, checks the trigger and writes a slice of a frozen window to the output
+    void send();
+
+    State getState() const { return m_state; };
+    uint32_t getNumOfSamples() const { return m_num_of_samples; };
+    // number of completed windows
+    uint32_t getNumOfCaptures() const { return m_capture_cntr; };
+    // number of records of the windows that were dropped by the output
+    uint32_t getDroppedCount() const { return m_dropped_cntr; };
+    // frozen window, sample 0 is the oldest, getTriggerSample() the trigger sample
+    uint32_t getNumOfWindowSamples() const { return m_window_size; };
+    uint32_t getTriggerSample() const { return m_window_trigger; };
+    float getValue(uint32_t sample, uint8_t channel) const;
+    // time relative to the trigger sample in sec
+    float getTime(uint32_t sample) const;
+
+private:
+    enum class TriggerMode : uint8_t {
+        NONE = 0,
+        THRESHOLD,
+        EDGE,
+        CALLBACK
+    };
+
+    uint32_t* m_buffer{nullptr}; // ring of m_num_of_samples samples
+    uint8_t m_num_of_channels;
+    uint8_t m_slot_size;       // words per sample
+    uint32_t m_num_of_samples; // window length, also the length of the ring
+    uint32_t m_num_of_pre_samples;
+
+    float m_sample[CAPTURE_NUM_OF_CHANNELS_MAX];
+    uint8_t m_float_cntr{0};
+
+    TriggerMode m_trigger_mode{TriggerMode::NONE};
+    uint8_t m_trigger_channel{0};
+    float m_trigger_level{0.0f};
+    bool m_trigger_above{true};
+    Edge m_trigger_edge{Edge::RISING};
+    trigger_t m_trigger;
+    bool m_trigger_is_forced{false};
+    float m_previous_value{0.0f};
+    bool m_previous_is_valid{false};
+
+    State m_state{State::ARMED};
+    uint32_t m_head{0};            // next slot of the ring
+    uint32_t m_num_of_recorded{0}; // samples since arm(), up to m_num_of_samples
+    uint32_t m_post_cntr{0};       // samples still to record after the trigger
+    uint32_t m_window_first{0};    // slot of the oldest sample of the frozen window
+    uint32_t m_window_size{0};
+    uint32_t m_window_trigger{0};
+    uint32_t m_trigger_time_us{0};
+    uint32_t m_capture_cntr{0};
+
+    SDLogger* m_sd_logger{nullptr};
+    uint8_t m_sd_logger_stream{0};
+    SerialStream* m_serial_stream{nullptr};
+    bool m_do_auto_rearm{true};
+    uint32_t m_output_cntr{0}; // records of the frozen window written to the output
+    uint32_t m_dropped_cntr{0};
+
+    bool checkTrigger() const;
+    void writeOutput();
+    uint32_t getSlot(uint32_t sample) const;
+};
+
+#endif /* CAPTURE_H_ */
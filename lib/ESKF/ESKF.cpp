@@ -0,0 +1,323 @@
+/**
+ * notes:
+ * - the quaternion rotates from body to world frame, the world z axis points up
+ * - the error state is the rotation error dtheta in body frame, q_true = q * [1, dtheta/2], and the gyro bias error
+ * - the acc measures the direction of gravity in body frame, v = R^T * e_z, h(dtheta) = v + skew(v) * dtheta
+ * - the mag only corrects the rotation around the world z axis, which is e_z^T * R * dtheta = v^T * dtheta
+ */
+
+#include "ESKF.h"
+
+#include <math.h>
+
+// gravity, same value as in the LSM9DS1 driver
+#define ESKF_GRAVITY 9.81f
+// initial uncertainty of the orientation in rad and of the gyro bias in rad/s
+#define ESKF_ORIENTATION_STD_0 0.5f
+#define ESKF_GYRO_BIAS_STD_0 0.01f
+#define ESKF_STEADY_STATE_GAIN_NUM_OF_ITERATIONS_MAX 5000
+// in steady state gain mode the covariance update runs for this time after the start, so the
+// initial orientation and gyro bias errors are corrected with the larger initial gain
+#define ESKF_STEADY_STATE_GAIN_WARM_UP_TIME 10.0f
+
+ESKF::ESKF()
+{
+    initialise();
+}
+
+ESKF::ESKF(float Ts)
+{
+    initialise();
+    setSamplingTime(Ts);
+}
+
+void ESKF::setup(float gyro_noise, float gyro_bias_noise, float acc_noise, float mag_noise, float Ts)
+{
+    // sampling time first, so that setNoise() computes the steady state gain only once
+    m_Ts = Ts;
+    m_Ts_nominal = Ts;
+    setNoise(gyro_noise, gyro_bias_noise, acc_noise, mag_noise);
+}
+
+void ESKF::setNoise(float gyro_noise, float gyro_bias_noise, float acc_noise, float mag_noise)
+{
+    m_gyro_noise = gyro_noise;
+    m_gyro_bias_noise = gyro_bias_noise;
+    m_acc_noise = acc_noise;
+    m_mag_noise = mag_noise;
+    m_steady_state_gain_is_valid = false;
+    if (m_use_steady_state_gain)
+        calcSteadyStateGain();
+}
+
+void ESKF::setSamplingTime(float Ts)
+{
+    m_Ts = Ts;
+    m_Ts_nominal = Ts;
+    if (m_Ts_nominal != m_Ts_steady_state_gain)
+        m_steady_state_gain_is_valid = false;
+    if (m_use_steady_state_gain && !m_steady_state_gain_is_valid)
+        calcSteadyStateGain();
+}
+
+void ESKF::setTimeStep(float dt)
+{
+    m_Ts = dt;
+}
+
+void ESKF::enableSteadyStateGain(bool enable)
+{
+    // the gain is only computed here, in setNoise() and in setSamplingTime(), never in update()
+    m_use_steady_state_gain = enable;
+    if (m_use_steady_state_gain && !m_steady_state_gain_is_valid)
+        calcSteadyStateGain();
+}
+
+void ESKF::update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc)
+{
+    if (!m_is_initialised) {
+        initialiseOrientation(acc);
+        return;
+    }
+    predict(gyro);
+    updateAcc(acc);
+}
+
+void ESKF::update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc, const Eigen::Vector3f& mag)
+{
+    if (!m_is_initialised) {
+        initialiseOrientation(acc);
+        return;
+    }
+    predict(gyro);
+    updateAcc(acc);
+    updateMag(mag);
+}
+
+Eigen::Quaternionf ESKF::getOrientationAsQuaternion() const
+{
+    return m_quat;
+}
+
+Eigen::Vector3f ESKF::getOrientationAsRPYAngles() const
+{
+    // same convention as Mahony, ||quat|| = 1
+    const Eigen::Quaternionf& q = m_quat;
+    Eigen::Vector3f rpy;
+    rpy(0) = atan2f(q.y() * q.z() + q.w() * q.x(), 0.5f - (q.x() * q.x() + q.y() * q.y()));
+    float sinarg = -2.0f * (q.x() * q.z() - q.w() * q.y());
+    if (sinarg > 1.0f)
+        sinarg = 1.0f;
+    if (sinarg < -1.0f)
+        sinarg = -1.0f;
+    rpy(1) = asinf(sinarg);
+    rpy(2) = atan2f(q.x() * q.y() + q.w() * q.z(), 0.5f - (q.y() * q.y() + q.z() * q.z()));
+    return rpy;
+}
+
+float ESKF::getTiltAngle() const
+{
+    float cos_tilt = m_quat.w() * m_quat.w() - m_quat.x() * m_quat.x() - m_quat.y() * m_quat.y() + m_quat.z() * m_quat.z();
+    if (cos_tilt > 1.0f)
+        cos_tilt = 1.0f;
+    if (cos_tilt < -1.0f)
+        cos_tilt = -1.0f;
+    return acosf(cos_tilt);
+}
+
+Eigen::Vector3f ESKF::getGyroBias() const
+{
+    return m_bias;
+}
+
+void ESKF::initialise()
+{
+    m_quat.setIdentity();
+    m_bias.setZero();
+    m_P.setZero();
+    m_P.topLeftCorner<3, 3>().diagonal().setConstant(ESKF_ORIENTATION_STD_0 * ESKF_ORIENTATION_STD_0);
+    m_P.bottomRightCorner<3, 3>().diagonal().setConstant(ESKF_GYRO_BIAS_STD_0 * ESKF_GYRO_BIAS_STD_0);
+    m_K_acc.setZero();
+    m_K_mag.setZero();
+    m_warm_up_time = 0.0f;
+    m_is_initialised = false;
+}
+
+void ESKF::initialiseOrientation(const Eigen::Vector3f& acc)
+{
+    // roll and pitch from the direction of gravity, acc = [-sin(pitch), sin(roll)*cos(pitch), cos(roll)*cos(pitch)] * g
+    if (acc.squaredNorm() < 1.0e-6f)
+        return;
+    const float roll = atan2f(acc(1), acc(2));
+    const float pitch = atan2f(-acc(0), sqrtf(acc(1) * acc(1) + acc(2) * acc(2)));
+    m_quat = Eigen::AngleAxisf(pitch, Eigen::Vector3f::UnitY()) * Eigen::AngleAxisf(roll, Eigen::Vector3f::UnitX());
+    m_is_initialised = true;
+}
+
+void ESKF::predict(const Eigen::Vector3f& gyro)
+{
+    const Eigen::Vector3f w = gyro - m_bias;
+
+    // nominal state, q = q * [1, w*Ts/2]
+    const Eigen::Vector3f dtheta = w * m_Ts;
+    m_quat = m_quat * Eigen::Quaternionf(1.0f, 0.5f * dtheta(0), 0.5f * dtheta(1), 0.5f * dtheta(2));
+    m_quat.normalize();
+
+    if (useSteadyStateGain())
+        return;
+    m_warm_up_time += m_Ts;
+
+    // error state covariance, F = [I - skew(w)*Ts, -I*Ts; 0, I], P = F * P * F^T + Q
+    Matrix6f F = Matrix6f::Identity();
+    F.topLeftCorner<3, 3>() -= skew(dtheta);
+    F.topRightCorner<3, 3>().diagonal().setConstant(-m_Ts);
+    m_P = F * m_P * F.transpose();
+    const float q_theta = m_gyro_noise * m_gyro_noise * m_Ts * m_Ts;
+    const float q_bias = m_gyro_bias_noise * m_gyro_bias_noise * m_Ts;
+    m_P.topLeftCorner<3, 3>().diagonal().array() += q_theta;
+    m_P.bottomRightCorner<3, 3>().diagonal().array() += q_bias;
+}
+
+void ESKF::updateAcc(const Eigen::Vector3f& acc)
+{
+    const float acc_norm = acc.norm();
+    if (acc_norm < 1.0e-3f)
+        return;
+
+    // measured and predicted direction of gravity in body frame
+    const Eigen::Vector3f v = calcGravityInBodyFrame();
+    const Eigen::Vector3f y = acc / acc_norm - v;
+
+    // linear accelerations change ||acc||, so the acc is trusted less
+    const float d = acc_norm / ESKF_GRAVITY - 1.0f;
+    const float r = m_acc_noise * m_acc_noise + d * d;
+
+    if (useSteadyStateGain()) {
+        // the gain is computed for the level orientation, so the innovation is rotated into world frame and the correction back
+        const Eigen::Matrix3f R = m_quat.toRotationMatrix();
+        const Vector6f dx = m_K_acc * (R * y) * (m_acc_noise * m_acc_noise / r);
+        injectError(R.transpose() * dx.head<3>(), R.transpose() * dx.tail<3>());
+        return;
+    }
+
+    // H = [skew(v), 0]
+    const Eigen::Matrix3f H = skew(v);
+    const Eigen::Matrix<float, 6, 3> PHt = m_P.leftCols<3>() * H.transpose();
+    const Eigen::Matrix3f S = H * PHt.topRows<3>() + r * Eigen::Matrix3f::Identity();
+    const Eigen::Matrix<float, 6, 3> K = PHt * S.inverse();
+    const Vector6f dx = K * y;
+
+    // P = (I - K * H) * P
+    m_P -= K * (H * m_P.topRows<3>());
+    m_P = 0.5f * (m_P + m_P.transpose()).eval();
+
+    injectError(dx.head<3>(), dx.tail<3>());
+}
+
+void ESKF::updateMag(const Eigen::Vector3f& mag)
+{
+    const float mag_norm = mag.norm();
+    if (mag_norm < 1.0e-6f)
+        return;
+
+    // heading of the horizontal part of the mag in world frame, which should point in x direction
+    const Eigen::Matrix3f R = m_quat.toRotationMatrix();
+    const Eigen::Vector3f h = R * (mag / mag_norm);
+    if ((h(0) * h(0) + h(1) * h(1)) < 1.0e-6f)
+        return;
+    const float y = -atan2f(h(1), h(0));
+
+    if (useSteadyStateGain()) {
+        const Vector6f dx = m_K_mag * y;
+        injectError(R.transpose() * dx.head<3>(), R.transpose() * dx.tail<3>());
+        return;
+    }
+
+    // H = [v^T, 0]
+    const Eigen::Vector3f v = R.row(2).transpose();
+    const Vector6f PHt = m_P.leftCols<3>() * v;
+    const float S = v.dot(PHt.head<3>()) + m_mag_noise * m_mag_noise;
+    const Vector6f K = PHt / S;
+    const Vector6f dx = K * y;
+
+    m_P -= K * (v.transpose() * m_P.topRows<3>());
+    m_P = 0.5f * (m_P + m_P.transpose()).eval();
+
+    injectError(dx.head<3>(), dx.tail<3>());
+}
+
+void ESKF::injectError(const Eigen::Vector3f& dtheta, const Eigen::Vector3f& dbias)
+{
+    m_quat = m_quat * Eigen::Quaternionf(1.0f, 0.5f * dtheta(0), 0.5f * dtheta(1), 0.5f * dtheta(2));
+    m_quat.normalize();
+    m_bias += dbias;
+}
+
+bool ESKF::useSteadyStateGain() const
+{
+    return m_use_steady_state_gain && m_steady_state_gain_is_valid && (m_warm_up_time >= ESKF_STEADY_STATE_GAIN_WARM_UP_TIME);
+}
+
+void ESKF::calcSteadyStateGain()
+{
+    // iterate the riccati equation for the level orientation at rest (w = 0), where the acc sees
+    // v = e_z and the mag H = [e_z^T, 0], until the gain converges
+    const Eigen::Vector3f e_z = Eigen::Vector3f::UnitZ();
+    const Eigen::Matrix3f H_acc = skew(e_z);
+    Matrix6f F = Matrix6f::Identity();
+    F.topRightCorner<3, 3>().diagonal().setConstant(-m_Ts_nominal);
+    const float q_theta = m_gyro_noise * m_gyro_noise * m_Ts_nominal * m_Ts_nominal;
+    const float q_bias = m_gyro_bias_noise * m_gyro_bias_noise * m_Ts_nominal;
+    const float r_acc = m_acc_noise * m_acc_noise;
+    const float r_mag = m_mag_noise * m_mag_noise;
+
+    Matrix6f P = Matrix6f::Zero();
+    P.topLeftCorner<3, 3>().diagonal().setConstant(ESKF_ORIENTATION_STD_0 * ESKF_ORIENTATION_STD_0);
+    P.bottomRightCorner<3, 3>().diagonal().setConstant(ESKF_GYRO_BIAS_STD_0 * ESKF_GYRO_BIAS_STD_0);
+    Eigen::Matrix<float, 6, 3> K_acc = Eigen::Matrix<float, 6, 3>::Zero();
+    Vector6f K_mag = Vector6f::Zero();
+
+    for (int i = 0; i < ESKF_STEADY_STATE_GAIN_NUM_OF_ITERATIONS_MAX; i++) {
+        P = F * P * F.transpose();
+        P.topLeftCorner<3, 3>().diagonal().array() += q_theta;
+        P.bottomRightCorner<3, 3>().diagonal().array() += q_bias;
+
+        const Eigen::Matrix<float, 6, 3> PHt = P.leftCols<3>() * H_acc.transpose();
+        const Eigen::Matrix3f S = H_acc * PHt.topRows<3>() + r_acc * Eigen::Matrix3f::Identity();
+        const Eigen::Matrix<float, 6, 3> K_acc_new = PHt * S.inverse();
+        P -= K_acc_new * (H_acc * P.topRows<3>());
+
+        const Vector6f PHt_mag = P.col(2);
+        const Vector6f K_mag_new = PHt_mag / (PHt_mag(2) + r_mag);
+        P -= K_mag_new * P.row(2);
+        P = 0.5f * (P + P.transpose()).eval();
+
+        const float dK = fmaxf((K_acc_new - K_acc).cwiseAbs().maxCoeff(), (K_mag_new - K_mag).cwiseAbs().maxCoeff());
+        K_acc = K_acc_new;
+        K_mag = K_mag_new;
+        if (dK < 1.0e-7f)
+            break;
+    }
+
+    m_K_acc = K_acc;
+    m_K_mag = K_mag;
+    m_Ts_steady_state_gain = m_Ts_nominal;
+    m_steady_state_gain_is_valid = true;
+}
+
+Eigen::Vector3f ESKF::calcGravityInBodyFrame() const
+{
+    // third row of the rotation matrix, R^T * e_z
+    return Eigen::Vector3f(2.0f * (m_quat.x() * m_quat.z() - m_quat.w() * m_quat.y()),
+                           2.0f * (m_quat.y() * m_quat.z() + m_quat.w() * m_quat.x()),
+                           m_quat.w() * m_quat.w() - m_quat.x() * m_quat.x() - m_quat.y() * m_quat.y() + m_quat.z() * m_quat.z());
+}
+
+Eigen::Matrix3f ESKF::skew(const Eigen::Vector3f& v)
+{
+    Eigen::Matrix3f S;
+    S <<  0.0f, -v(2),  v(1),
+          v(2),  0.0f, -v(0),
+         -v(1),  v(0),  0.0f;
+    return S;
+}
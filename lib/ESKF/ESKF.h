@@ -0,0 +1,98 @@
+/**
+ * @file ESKF.h
+ * @brief Defines the ESKF class, an error state Kalman filter for the orientation.
+ *
+ * The ESKF estimates the orientation (quaternion) and the gyro bias from gyro, acc and
+ * optionally mag measurements, it is an alternative to the Mahony filter with the same API:
+ * - the nominal state (quaternion, gyro bias) is integrated with the gyro
+ * - the error state (rotation error in body frame, gyro bias error) has a 6x6 covariance
+ *   that is predicted and updated with the normalised acc (gravity direction) and with the
+ *   heading of the horizontal part of the mag (only yaw is corrected by the mag)
+ * - the acc measurement noise is increased by the deviation of ||acc|| from g, so linear
+ *   accelerations are trusted less
+ * - the orientation is initialised from the first acc measurement (roll and pitch)
+ *
+ * Steady state gain mode: instead of the covariance update a constant gain is used, which is
+ * computed once for the level orientation and at rest and rotated into the current body frame.
+ * This needs only a few multiplications per update but adapts less to large errors, so the
+ * covariance update still runs for the first seconds to correct the initial gyro bias error.
+ * The gain is computed for the nominal sampling time of setup() / setSamplingTime(), outside
+ * of update(). setTimeStep() changes the integration step of the next updates (e.g. the
+ * measured time between two data ready interrupts) without recomputing the gain.
+ *
+ * Fixed size Eigen matrices only, no heap. The class does not depend on mbed.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef ESKF_H_
+#define ESKF_H_
+
+#include <Eigen/Dense>
+
+class ESKF
+{
+public:
+    explicit ESKF();
+    explicit ESKF(float Ts);
+    ~ESKF() = default;
+
+    /**
+     * @param gyro_noise      standard deviation of the gyro per sample in rad/s
+     * @param gyro_bias_noise random walk of the gyro bias in rad/s/sqrt(s)
+     * @param acc_noise       standard deviation of the normalised acc (direction of gravity)
+     * @param mag_noise       standard deviation of the heading from the mag in rad
+     * @param Ts              sampling time in sec
+     */
+    void setup(float gyro_noise, float gyro_bias_noise, float acc_noise, float mag_noise, float Ts);
+    void setNoise(float gyro_noise, float gyro_bias_noise, float acc_noise, float mag_noise);
+    // nominal sampling time, recomputes the steady state gain if it is enabled (up to a few ms of cpu time)
+    void setSamplingTime(float Ts);
+    // integration step of the next updates, e.g. measured per sample, the steady state gain is not changed
+    void setTimeStep(float dt);
+    void enableSteadyStateGain(bool enable);
+    void update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc);
+    void update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc, const Eigen::Vector3f& mag);
+    Eigen::Quaternionf getOrientationAsQuaternion() const;
+    Eigen::Vector3f getOrientationAsRPYAngles() const;
+    float getTiltAngle() const;
+    Eigen::Vector3f getGyroBias() const;
+
+private:
+    typedef Eigen::Matrix<float, 6, 6> Matrix6f;
+    typedef Eigen::Matrix<float, 6, 1> Vector6f;
+
+    float m_gyro_noise = 0.015f;
+    float m_gyro_bias_noise = 1.0e-4f;
+    float m_acc_noise = 0.05f;
+    float m_mag_noise = 0.1f;
+    float m_Ts = 1.0f;         // integration step
+    float m_Ts_nominal = 1.0f; // sampling time of the steady state gain
+
+    Eigen::Quaternionf m_quat;
+    Eigen::Vector3f m_bias;
+    Matrix6f m_P;
+    bool m_is_initialised = false;
+
+    // steady state gain for the level orientation, acc (gravity direction in world frame) and mag (heading)
+    bool m_use_steady_state_gain = false;
+    bool m_steady_state_gain_is_valid = false;
+    float m_Ts_steady_state_gain = 0.0f;
+    Eigen::Matrix<float, 6, 3> m_K_acc;
+    Vector6f m_K_mag;
+    float m_warm_up_time = 0.0f;
+
+    void initialise();
+    void initialiseOrientation(const Eigen::Vector3f& acc);
+    void predict(const Eigen::Vector3f& gyro);
+    void updateAcc(const Eigen::Vector3f& acc);
+    void updateMag(const Eigen::Vector3f& mag);
+    void injectError(const Eigen::Vector3f& dtheta, const Eigen::Vector3f& dbias);
+    bool useSteadyStateGain() const;
+    void calcSteadyStateGain();
+    Eigen::Vector3f calcGravityInBodyFrame() const;
+    static Eigen::Matrix3f skew(const Eigen::Vector3f& v);
+};
+
+#endif /* ESKF_H_ */
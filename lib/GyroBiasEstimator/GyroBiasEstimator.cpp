@@ -0,0 +1,239 @@
+#include "GyroBiasEstimator.h"
+
+#include <math.h>
+
+GyroBiasEstimator::GyroBiasEstimator(float Ts, float window_time)
+{
+    setup(Ts, window_time);
+}
+
+void GyroBiasEstimator::setup(float Ts, float window_time)
+{
+    m_window_size = static_cast<uint32_t>(window_time / Ts + 0.5f);
+    if (m_window_size < 2)
+        m_window_size = 2;
+    reset();
+}
+
+void GyroBiasEstimator::reset()
+{
+    m_is_stationary = false;
+    m_bias_is_valid = false;
+    m_bias_is_confirmed = false;
+    m_bias_cntr = 0;
+    m_candidate_cntr = 0;
+    m_candidate_mean.setZero();
+    m_reseed_cntr = 0;
+    m_stationary_window_cntr = 0;
+    m_bias.setZero();
+    m_acc_mean.setZero();
+    resetWindow();
+    resetTable();
+    calcCompensatedBias();
+}
+
+void GyroBiasEstimator::setThresholds(float gyro_std_max, float acc_std_max, float gyro_mean_dev_max)
+{
+    m_gyro_std_max = gyro_std_max;
+    m_acc_std_max = acc_std_max;
+    m_gyro_mean_dev_max = gyro_mean_dev_max;
+}
+
+void GyroBiasEstimator::setBias(const Eigen::Vector3f& bias)
+{
+    // a stored bias counts as a few stationary windows, so it is refined quickly
+    m_bias = bias;
+    m_bias_is_valid = true;
+    m_bias_is_confirmed = false;
+    m_bias_cntr = BIAS_WINDOWS_MAX / 4;
+    m_candidate_cntr = 0;
+    calcCompensatedBias();
+}
+
+void GyroBiasEstimator::enableTemperatureModel(float temperature_min, float temperature_step)
+{
+    m_use_table = true;
+    m_table_temperature_min = temperature_min;
+    m_table_temperature_step = temperature_step;
+    resetTable();
+    calcCompensatedBias();
+}
+
+void GyroBiasEstimator::setTemperature(float temperature)
+{
+    m_temperature = temperature;
+    m_temperature_is_valid = true;
+    calcCompensatedBias();
+}
+
+void GyroBiasEstimator::getTableNode(uint8_t i, Eigen::Vector3f& bias, float& weight) const
+{
+    if (i >= GYRO_BIAS_TABLE_SIZE)
+        return;
+    bias = m_table_bias[i];
+    weight = m_table_weight[i];
+}
+
+void GyroBiasEstimator::setTableNode(uint8_t i, const Eigen::Vector3f& bias, float weight)
+{
+    if (i >= GYRO_BIAS_TABLE_SIZE)
+        return;
+    m_table_bias[i] = bias;
+    m_table_weight[i] = (weight > TABLE_WEIGHT_MAX) ? TABLE_WEIGHT_MAX : weight;
+    calcCompensatedBias();
+}
+
+bool GyroBiasEstimator::update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc)
+{
+    if (m_sample_cntr == 0) {
+        m_gyro_ref = gyro;
+        m_acc_ref = acc;
+    }
+    const Eigen::Vector3f dgyro = gyro - m_gyro_ref;
+    const Eigen::Vector3f dacc = acc - m_acc_ref;
+    m_gyro_sum += dgyro;
+    m_gyro_sq_sum += dgyro.cwiseProduct(dgyro);
+    m_acc_sum += dacc;
+    m_acc_sq_sum += dacc.cwiseProduct(dacc);
+    m_sample_cntr++;
+
+    if (m_sample_cntr < m_window_size)
+        return false;
+
+    // mean and variance of the window
+    const float n = static_cast<float>(m_sample_cntr);
+    const Eigen::Vector3f gyro_mean_rel = m_gyro_sum / n;
+    const Eigen::Vector3f acc_mean_rel = m_acc_sum / n;
+    const float gyro_var_max = (m_gyro_sq_sum / n - gyro_mean_rel.cwiseProduct(gyro_mean_rel)).maxCoeff();
+    const float acc_var_max = (m_acc_sq_sum / n - acc_mean_rel.cwiseProduct(acc_mean_rel)).maxCoeff();
+    const Eigen::Vector3f gyro_mean = m_gyro_ref + gyro_mean_rel;
+    const Eigen::Vector3f acc_mean = m_acc_ref + acc_mean_rel;
+    resetWindow();
+
+    m_is_stationary = (gyro_var_max < m_gyro_std_max * m_gyro_std_max) &&
+                      (acc_var_max < m_acc_std_max * m_acc_std_max) &&
+                      (fabsf(acc_mean.norm() - GRAVITY) < ACC_NORM_DEV_MAX);
+    if (!m_is_stationary)
+        return false;
+
+    const bool is_close_to_bias = m_bias_is_valid && ((gyro_mean - m_bias_compensated).norm() < m_gyro_mean_dev_max);
+    if (m_bias_is_confirmed && !is_close_to_bias) {
+        // a slow constant rotation around gravity is not visible in the variances, but a wrong bias
+        // is replaced if enough still windows agree on another one
+        if (!updateCandidate(gyro_mean)) {
+            m_is_stationary = false;
+            return false;
+        }
+    } else if (m_bias_is_valid && !is_close_to_bias) {
+        // a stored bias that the first still window does not confirm
+        reseedBias(gyro_mean, 0);
+    }
+    m_bias_is_confirmed = true;
+    m_candidate_cntr = 0;
+
+    // running mean over the last stationary windows
+    if (m_bias_cntr < BIAS_WINDOWS_MAX)
+        m_bias_cntr++;
+    m_bias += (gyro_mean - m_bias) / static_cast<float>(m_bias_cntr);
+    m_bias_is_valid = true;
+    m_acc_mean = acc_mean;
+    m_stationary_window_cntr++;
+    if (m_use_table && m_temperature_is_valid)
+        updateTable(gyro_mean);
+    calcCompensatedBias();
+
+    return true;
+}
+
+void GyroBiasEstimator::resetWindow()
+{
+    m_sample_cntr = 0;
+    m_gyro_ref.setZero();
+    m_acc_ref.setZero();
+    m_gyro_sum.setZero();
+    m_gyro_sq_sum.setZero();
+    m_acc_sum.setZero();
+    m_acc_sq_sum.setZero();
+}
+
+bool GyroBiasEstimator::updateCandidate(const Eigen::Vector3f& gyro_mean)
+{
+    if ((m_candidate_cntr > 0) && ((gyro_mean - m_candidate_mean).norm() < m_gyro_mean_dev_max)) {
+        m_candidate_cntr++;
+        m_candidate_mean += (gyro_mean - m_candidate_mean) / static_cast<float>(m_candidate_cntr);
+    } else {
+        m_candidate_cntr = 1;
+        m_candidate_mean = gyro_mean;
+    }
+    if (m_candidate_cntr < GYRO_BIAS_RESEED_WINDOWS)
+        return false;
+
+    // the running mean in update() adds the current window once more
+    reseedBias(m_candidate_mean, m_candidate_cntr - 1);
+    return true;
+}
+
+void GyroBiasEstimator::reseedBias(const Eigen::Vector3f& gyro_mean, uint32_t num_of_windows)
+{
+    m_bias = gyro_mean;
+    m_bias_cntr = (num_of_windows < BIAS_WINDOWS_MAX) ? num_of_windows : BIAS_WINDOWS_MAX;
+    m_reseed_cntr++;
+    resetTable();
+    calcCompensatedBias();
+}
+
+void GyroBiasEstimator::resetTable()
+{
+    for (uint8_t i = 0; i < GYRO_BIAS_TABLE_SIZE; i++) {
+        m_table_bias[i].setZero();
+        m_table_weight[i] = 0.0f;
+    }
+}
+
+void GyroBiasEstimator::updateTable(const Eigen::Vector3f& gyro_mean)
+{
+    // the window is split between the two nodes next to the temperature
+    uint8_t i;
+    float f;
+    calcTablePosition(m_temperature, i, f);
+    const float w[2] = {1.0f - f, f};
+    for (uint8_t k = 0; k < 2; k++) {
+        if ((w[k] <= 0.0f) || (i + k >= GYRO_BIAS_TABLE_SIZE))
+            continue;
+        const float weight = m_table_weight[i + k] + w[k];
+        m_table_bias[i + k] += (gyro_mean - m_table_bias[i + k]) * (w[k] / weight);
+        m_table_weight[i + k] = (weight > TABLE_WEIGHT_MAX) ? TABLE_WEIGHT_MAX : weight;
+    }
+}
+
+void GyroBiasEstimator::calcCompensatedBias()
+{
+    m_bias_compensated = m_bias;
+    if (!m_use_table || !m_temperature_is_valid)
+        return;
+
+    uint8_t i;
+    float f;
+    calcTablePosition(m_temperature, i, f);
+    const bool lower_is_valid = m_table_weight[i] > 0.0f;
+    const bool upper_is_valid = (i + 1 < GYRO_BIAS_TABLE_SIZE) && (m_table_weight[i + 1] > 0.0f);
+    if (lower_is_valid && upper_is_valid)
+        m_bias_compensated = (1.0f - f) * m_table_bias[i] + f * m_table_bias[i + 1];
+    else if (lower_is_valid)
+        m_bias_compensated = m_table_bias[i];
+    else if (upper_is_valid)
+        m_bias_compensated = m_table_bias[i + 1];
+}
+
+void GyroBiasEstimator::calcTablePosition(float temperature, uint8_t& i, float& f) const
+{
+    float x = (temperature - m_table_temperature_min) / m_table_temperature_step;
+    if (x < 0.0f)
+        x = 0.0f;
+    if (x > static_cast<float>(GYRO_BIAS_TABLE_SIZE - 1))
+        x = static_cast<float>(GYRO_BIAS_TABLE_SIZE - 1);
+    i = static_cast<uint8_t>(x);
+    if (i > GYRO_BIAS_TABLE_SIZE - 2)
+        i = GYRO_BIAS_TABLE_SIZE - 2;
+    f = x - static_cast<float>(i);
+}
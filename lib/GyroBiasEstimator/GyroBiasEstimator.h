@@ -0,0 +1,144 @@
+/**
+ * @file GyroBiasEstimator.h
+ * @brief Defines the GyroBiasEstimator class, a continuous gyro bias estimation with a zero motion detector.
+ *
+ * The GyroBiasEstimator class collects gyro and acc samples in windows of a fixed length and
+ * decides for every window if the robot was standing still:
+ * - the standard deviation of every gyro and acc axis is below a threshold
+ * - the length of the mean acc is close to g
+ * - once a bias is confirmed by a window, the mean gyro is close to the bias (no slow constant
+ *   rotation)
+ * The mean gyro of every stationary window updates the bias with a running mean over the last
+ * stationary windows, so the bias gets refined whenever the robot stands still and the robot
+ * can be moved right from the start. A stored bias can be set with setBias(), it is not used to
+ * reject windows: the first stationary window confirms it or, if its mean is not close to it
+ * (other board, temperature drift), replaces it. If GYRO_BIAS_RESEED_WINDOWS windows in a row
+ * are still but agree with each other and not with a confirmed bias, the bias is replaced by
+ * their mean, so a wrong bias does not block the correction forever.
+ *
+ * Optional temperature model: a piecewise linear table of the bias over the temperature with
+ * GYRO_BIAS_TABLE_SIZE equidistant nodes. Every stationary window is added to the two nodes
+ * next to the current temperature (weighted running mean), so the table is learned while the
+ * board heats up. getBias() then returns the table interpolated at the last temperature set
+ * with setTemperature(), or the running mean if the table has no data around this temperature.
+ * The bias is only recalculated when the temperature or the table changes, so the cost per
+ * sample is not increased. The table can be read and written node by node (dump and reload).
+ *
+ * The variances are accumulated relative to the first sample of the window, so float is
+ * accurate enough. The class does not depend on mbed.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef GYRO_BIAS_ESTIMATOR_H_
+#define GYRO_BIAS_ESTIMATOR_H_
+
+#include <Eigen/Dense>
+#include <stdint.h>
+
+#define GYRO_BIAS_TABLE_SIZE 16
+#define GYRO_BIAS_RESEED_WINDOWS 20 // still windows in a row that agree with each other but not with the bias
+
+class GyroBiasEstimator
+{
+public:
+    /**
+     * @param Ts          sampling time in sec
+     * @param window_time length of one window in sec
+     */
+    explicit GyroBiasEstimator(float Ts = 0.02f, float window_time = 0.5f);
+    ~GyroBiasEstimator() = default;
+
+    void setup(float Ts, float window_time);
+    void reset();
+
+    /**
+     * @param gyro_std_max      max. standard deviation of the gyro axes in rad/s
+     * @param acc_std_max       max. standard deviation of the acc axes in m/s^2
+     * @param gyro_mean_dev_max max. deviation of the mean gyro from the bias in rad/s
+     */
+    void setThresholds(float gyro_std_max, float acc_std_max, float gyro_mean_dev_max);
+
+    // e.g. a stored bias, it is refined by the following stationary windows
+    void setBias(const Eigen::Vector3f& bias);
+
+    /**
+     * @param temperature_min  temperature of the first table node in deg C
+     * @param temperature_step temperature difference between two nodes in deg C
+     */
+    void enableTemperatureModel(float temperature_min, float temperature_step);
+    void setTemperature(float temperature);
+    float getTemperature() const { return m_temperature; };
+    float getTableTemperature(uint8_t i) const { return m_table_temperature_min + static_cast<float>(i) * m_table_temperature_step; };
+    // weight is the number of stationary windows in the node, 0 if the node has no data
+    void getTableNode(uint8_t i, Eigen::Vector3f& bias, float& weight) const;
+    void setTableNode(uint8_t i, const Eigen::Vector3f& bias, float weight);
+
+    // returns true if a window is completed and the robot was standing still, the bias is then updated
+    bool update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc);
+
+    bool isStationary() const { return m_is_stationary; };
+    bool isBiasValid() const { return m_bias_is_valid; };
+    // true once a window of this run agreed with the bias or set it
+    bool isBiasConfirmed() const { return m_bias_is_confirmed; };
+    uint32_t getNumOfReseeds() const { return m_reseed_cntr; };
+    const Eigen::Vector3f& getBias() const { return m_bias_compensated; };
+    // mean acc of the last stationary window
+    const Eigen::Vector3f& getAccMean() const { return m_acc_mean; };
+    uint32_t getNumOfStationaryWindows() const { return m_stationary_window_cntr; };
+
+private:
+    static constexpr float GRAVITY = 9.81f;
+    static constexpr float ACC_NORM_DEV_MAX = 0.5f;
+    // the bias is the running mean over this number of stationary windows
+    static constexpr uint32_t BIAS_WINDOWS_MAX = 20;
+    // max. weight of a table node, so the table follows slow changes of the sensor
+    static constexpr float TABLE_WEIGHT_MAX = 50.0f;
+
+    uint32_t m_window_size{25};
+    float m_gyro_std_max{0.02f};
+    float m_acc_std_max{0.15f};
+    float m_gyro_mean_dev_max{0.02f};
+
+    // window sums relative to the first sample
+    uint32_t m_sample_cntr{0};
+    Eigen::Vector3f m_gyro_ref, m_acc_ref;
+    Eigen::Vector3f m_gyro_sum, m_gyro_sq_sum;
+    Eigen::Vector3f m_acc_sum, m_acc_sq_sum;
+
+    bool m_is_stationary{false};
+    bool m_bias_is_valid{false};
+    bool m_bias_is_confirmed{false};
+    uint32_t m_bias_cntr{0};
+    // still windows that were rejected because of the mean, they replace the bias if they agree
+    uint32_t m_candidate_cntr{0};
+    Eigen::Vector3f m_candidate_mean;
+    uint32_t m_reseed_cntr{0};
+    uint32_t m_stationary_window_cntr{0};
+    Eigen::Vector3f m_bias;
+    Eigen::Vector3f m_acc_mean;
+
+    // temperature model, m_bias_compensated is the bias used by the caller
+    bool m_use_table{false};
+    float m_table_temperature_min{20.0f};
+    float m_table_temperature_step{3.0f};
+    float m_temperature{0.0f};
+    bool m_temperature_is_valid{false};
+    Eigen::Vector3f m_table_bias[GYRO_BIAS_TABLE_SIZE];
+    float m_table_weight[GYRO_BIAS_TABLE_SIZE];
+    Eigen::Vector3f m_bias_compensated;
+
+    void resetWindow();
+    void resetTable();
+    // returns true if the candidate replaced the bias
+    bool updateCandidate(const Eigen::Vector3f& gyro_mean);
+    // the bias is replaced by gyro_mean, the table is cleared, it was learned with the old bias
+    void reseedBias(const Eigen::Vector3f& gyro_mean, uint32_t num_of_windows);
+    void updateTable(const Eigen::Vector3f& gyro_mean);
+    void calcCompensatedBias();
+    // position of the temperature in the table, index of the lower node and fraction to the upper node
+    void calcTablePosition(float temperature, uint8_t& i, float& f) const;
+};
+
+#endif /* GYRO_BIAS_ESTIMATOR_H_ */
@@ -0,0 +1,424 @@
+#include "I2CBus.h"
+
+I2CBus::Registration I2CBus::s_registry[I2C_BUS_NUM_OF_BUSES_MAX] = {};
+
+I2CBus::I2CBus(PinName sda, PinName scl, int frequency_hz) : m_I2C(sda, scl),
+                                                             m_sda(sda),
+                                                             m_scl(scl),
+                                                             m_frequency_hz(frequency_hz),
+                                                             m_Thread(osPriorityHigh2, 4096)
+{
+    m_I2C.frequency(frequency_hz);
+
+    // register the bus, so that the drivers constructed with these pins share it
+    getRegistryMutex().lock();
+    bool is_registered = false;
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+        if ((s_registry[i].bus != nullptr) && (s_registry[i].sda == sda) && (s_registry[i].scl == scl)) {
+            is_registered = true;
+            break;
+        }
+    }
+    if (!is_registered) {
+        for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+            if (s_registry[i].bus == nullptr) {
+                s_registry[i] = {sda, scl, this, 0, false};
+                is_registered = true;
+                break;
+            }
+        }
+    }
+    getRegistryMutex().unlock();
+    if (!is_registered)
+        printf("I2CBus: bus on these pins exists already or no free slot, the bus is not shared\n");
+
+    m_statistics_timer.start();
+
+    // start thread
+    m_Thread.start(callback(this, &I2CBus::threadTask));
+}
+
+I2CBus::~I2CBus()
+{
+    getRegistryMutex().lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+        if (s_registry[i].bus == this)
+            s_registry[i] = {NC, NC, nullptr, 0, false};
+    }
+    getRegistryMutex().unlock();
+
+#if DEVICE_I2C_ASYNCH
+    m_I2C.abort_transfer();
+#endif
+    m_Thread.terminate();
+}
+
+I2CBus* I2CBus::acquire(PinName sda, PinName scl, int frequency_hz)
+{
+    I2CBus* i2c_bus = nullptr;
+    // the mutex is recursive, the constructor registers the new bus while it is locked
+    getRegistryMutex().lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+        if ((s_registry[i].bus != nullptr) && (s_registry[i].sda == sda) && (s_registry[i].scl == scl)) {
+            s_registry[i].users++;
+            i2c_bus = s_registry[i].bus;
+            break;
+        }
+    }
+    if (i2c_bus == nullptr) {
+        i2c_bus = new I2CBus(sda, scl, frequency_hz);
+        bool is_registered = false;
+        for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+            if (s_registry[i].bus == i2c_bus) {
+                s_registry[i].users = 1;
+                s_registry[i].is_created = true;
+                is_registered = true;
+                break;
+            }
+        }
+        if (!is_registered) {
+            delete i2c_bus;
+            i2c_bus = nullptr;
+        }
+    }
+    getRegistryMutex().unlock();
+    return i2c_bus;
+}
+
+void I2CBus::release(I2CBus* i2c_bus)
+{
+    if (i2c_bus == nullptr)
+        return;
+
+    bool do_delete = false;
+    getRegistryMutex().lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_BUSES_MAX; i++) {
+        if ((s_registry[i].bus == i2c_bus) && (s_registry[i].users > 0)) {
+            s_registry[i].users--;
+            do_delete = (s_registry[i].users == 0) && s_registry[i].is_created;
+            break;
+        }
+    }
+    getRegistryMutex().unlock();
+    if (do_delete)
+        delete i2c_bus;
+}
+
+Mutex& I2CBus::getRegistryMutex()
+{
+    // constructed on first use, the buses can be global objects of other translation units
+    static Mutex mutex;
+    return mutex;
+}
+
+bool I2CBus::queueWrite(uint8_t address,
+                        uint8_t reg,
+                        const uint8_t* data,
+                        uint8_t length,
+                        Priority priority,
+                        completion_t callback,
+                        osThreadId_t thread_id,
+                        uint32_t thread_flag,
+                        int* result)
+{
+    // the register address occupies the first byte
+    if (length + 1 > I2C_BUS_TX_BUFFER_SIZE)
+        return false;
+
+    Transaction transaction;
+    transaction.address = address;
+    transaction.tx[0] = reg;
+    memcpy(&transaction.tx[1], data, length);
+    transaction.tx_length = length + 1;
+    transaction.rx = nullptr;
+    transaction.rx_length = 0;
+    transaction.priority = priority;
+    transaction.callback = callback;
+    transaction.thread_id = thread_id;
+    transaction.thread_flag = thread_flag;
+    transaction.result = result;
+
+    return enqueue(transaction);
+}
+
+bool I2CBus::queueRead(uint8_t address,
+                       uint8_t reg,
+                       uint8_t* dest,
+                       uint16_t length,
+                       Priority priority,
+                       completion_t callback,
+                       osThreadId_t thread_id,
+                       uint32_t thread_flag,
+                       int* result)
+{
+    Transaction transaction;
+    transaction.address = address;
+    transaction.tx[0] = reg;
+    transaction.tx_length = 1;
+    transaction.rx = dest;
+    transaction.rx_length = length;
+    transaction.priority = priority;
+    transaction.callback = callback;
+    transaction.thread_id = thread_id;
+    transaction.thread_flag = thread_flag;
+    transaction.result = result;
+
+    return enqueue(transaction);
+}
+
+int I2CBus::writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint32_t thread_flag,
+                           Priority priority)
+{
+    int result = -1;
+    if (!queueWrite(address, reg, data, length, priority, nullptr, ThisThread::get_id(), thread_flag, &result))
+        return -1;
+    ThisThread::flags_wait_any(thread_flag);
+    return result;
+}
+
+int I2CBus::readRegisters(uint8_t address, uint8_t reg, uint8_t* dest, uint16_t length, uint32_t thread_flag,
+                          Priority priority)
+{
+    int result = -1;
+    if (!queueRead(address, reg, dest, length, priority, nullptr, ThisThread::get_id(), thread_flag, &result))
+        return -1;
+    ThisThread::flags_wait_any(thread_flag);
+    return result;
+}
+
+uint32_t I2CBus::getTransferTimeMus(uint16_t tx_length, uint16_t rx_length) const
+{
+    // address byte(s), data bytes with ack, start, repeated start and stop
+    const uint32_t num_of_bytes = tx_length + rx_length + ((rx_length > 0) ? 2 : 1);
+    const uint32_t num_of_bits = 9 * num_of_bytes + 3;
+    return static_cast<uint32_t>((1000000ULL * num_of_bits + m_frequency_hz - 1) / m_frequency_hz);
+}
+
+float I2CBus::getUtilisation(uint8_t address) const
+{
+    DeviceStatistics statistics;
+    m_Mutex.lock();
+    const bool is_found = getStatistics(address, statistics);
+    const int64_t elapsed_time_mus = m_statistics_timer.elapsed_time().count();
+    m_Mutex.unlock();
+    if (!is_found)
+        return 0.0f;
+    if (elapsed_time_mus <= 0)
+        return 0.0f;
+    return static_cast<float>(statistics.busy_time_mus) / static_cast<float>(elapsed_time_mus);
+}
+
+float I2CBus::getUtilisation() const
+{
+    uint64_t busy_time_mus = 0;
+    m_Mutex.lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++)
+        busy_time_mus += m_statistics[i].busy_time_mus;
+    const int64_t elapsed_time_mus = m_statistics_timer.elapsed_time().count();
+    m_Mutex.unlock();
+    if (elapsed_time_mus <= 0)
+        return 0.0f;
+    return static_cast<float>(busy_time_mus) / static_cast<float>(elapsed_time_mus);
+}
+
+bool I2CBus::getStatistics(uint8_t address, DeviceStatistics& statistics) const
+{
+    bool is_found = false;
+    m_Mutex.lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++) {
+        if (m_statistics[i].address == address) {
+            statistics = m_statistics[i];
+            is_found = true;
+            break;
+        }
+    }
+    m_Mutex.unlock();
+    return is_found;
+}
+
+void I2CBus::resetStatistics()
+{
+    m_Mutex.lock();
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++) {
+        const uint8_t address = m_statistics[i].address;
+        m_statistics[i] = DeviceStatistics();
+        m_statistics[i].address = address;
+    }
+    m_queue_full_cntr = 0;
+    m_statistics_timer.reset();
+    m_Mutex.unlock();
+}
+
+void I2CBus::printStatistics() const
+{
+    // copy under the lock, print without it
+    DeviceStatistics statistics[I2C_BUS_NUM_OF_DEVICES_MAX];
+    m_Mutex.lock();
+    memcpy(statistics, m_statistics, sizeof(statistics));
+    const int64_t elapsed_time_mus = m_statistics_timer.elapsed_time().count();
+    const uint32_t queue_full_cntr = m_queue_full_cntr;
+    m_Mutex.unlock();
+
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++) {
+        if (statistics[i].address == 0)
+            continue;
+        printf("I2CBus: device 0x%02X, transactions %lu, bytes %lu, errors %lu, utilisation %.2f %%\n",
+               statistics[i].address,
+               (unsigned long)statistics[i].transactions,
+               (unsigned long)statistics[i].bytes,
+               (unsigned long)statistics[i].errors,
+               (elapsed_time_mus > 0) ? 100.0f * static_cast<float>(statistics[i].busy_time_mus) / static_cast<float>(elapsed_time_mus) : 0.0f);
+    }
+    if (queue_full_cntr > 0)
+        printf("I2CBus: queue full, %lu transactions dropped\n", (unsigned long)queue_full_cntr);
+}
+
+bool I2CBus::enqueue(Transaction& transaction)
+{
+    bool ok = false;
+
+    m_Mutex.lock();
+    for (uint8_t i = 0; i < I2C_BUS_QUEUE_SIZE; i++) {
+        if (!m_queue_used[i]) {
+            transaction.seq = m_seq++;
+            m_queue[i] = transaction;
+            m_queue_used[i] = true;
+            ok = true;
+            break;
+        }
+    }
+    // runs in the thread of the caller, so no print, printStatistics() reports the dropped transactions
+    if (!ok)
+        m_queue_full_cntr++;
+    m_Mutex.unlock();
+
+    // signal the bus thread that there is work to do
+    if (ok)
+        m_Thread.flags_set(m_ThreadFlag);
+    return ok;
+}
+
+bool I2CBus::dequeue(Transaction& transaction)
+{
+    int8_t idx = -1;
+
+    m_Mutex.lock();
+    // highest priority first, oldest first within the same priority
+    for (uint8_t i = 0; i < I2C_BUS_QUEUE_SIZE; i++) {
+        if (!m_queue_used[i])
+            continue;
+        if ((idx < 0) ||
+            (m_queue[i].priority > m_queue[idx].priority) ||
+            ((m_queue[i].priority == m_queue[idx].priority) && (int32_t)(m_queue[i].seq - m_queue[idx].seq) < 0))
+            idx = i;
+    }
+    if (idx >= 0) {
+        transaction = m_queue[idx];
+        m_queue_used[idx] = false;
+    }
+    m_Mutex.unlock();
+
+    return idx >= 0;
+}
+
+int I2CBus::execute(Transaction& transaction)
+{
+    int result = 0;
+
+#if DEVICE_I2C_ASYNCH
+    // interrupt driven transfer, write followed by a repeated start read if rx_length > 0
+    m_transfer_event = 0;
+    ThisThread::flags_clear(m_TransferFlag);
+    if (m_I2C.transfer(transaction.address,
+                       reinterpret_cast<const char*>(transaction.tx),
+                       transaction.tx_length,
+                       reinterpret_cast<char*>(transaction.rx),
+                       transaction.rx_length,
+                       callback(this, &I2CBus::onTransferEvent),
+                       I2C_EVENT_ALL) != 0) {
+        return -1;
+    }
+    // the timeout scales with the length of the transfer, a long burst read is not cut off
+    const uint32_t timeout_mus = 2 * getTransferTimeMus(transaction.tx_length, transaction.rx_length) +
+                                 I2C_BUS_TRANSFER_TIMEOUT_MARGIN_MUS;
+    if (ThisThread::flags_wait_any_for(m_TransferFlag, std::chrono::microseconds{timeout_mus}) == 0) {
+        m_I2C.abort_transfer();
+        return -2;
+    }
+    if (!(m_transfer_event & I2C_EVENT_TRANSFER_COMPLETE))
+        result = -1;
+#else
+    // blocking fallback
+    const bool repeated = transaction.rx_length > 0;
+    result = m_I2C.write(transaction.address, reinterpret_cast<const char*>(transaction.tx), transaction.tx_length, repeated);
+    if ((result == 0) && repeated)
+        result = m_I2C.read(transaction.address, reinterpret_cast<char*>(transaction.rx), transaction.rx_length);
+#endif
+
+    return result;
+}
+
+void I2CBus::complete(Transaction& transaction, int result)
+{
+    if (transaction.result)
+        *transaction.result = result;
+    if (transaction.callback)
+        transaction.callback(result);
+    if (transaction.thread_id && transaction.thread_flag)
+        osThreadFlagsSet(transaction.thread_id, transaction.thread_flag);
+}
+
+I2CBus::DeviceStatistics* I2CBus::findStatistics(uint8_t address, bool create)
+{
+    for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++) {
+        if (m_statistics[i].address == address)
+            return &m_statistics[i];
+    }
+    if (create) {
+        for (uint8_t i = 0; i < I2C_BUS_NUM_OF_DEVICES_MAX; i++) {
+            if (m_statistics[i].address == 0) {
+                m_statistics[i].address = address;
+                return &m_statistics[i];
+            }
+        }
+    }
+    return nullptr;
+}
+
+void I2CBus::threadTask()
+{
+    Timer transfer_timer;
+    transfer_timer.start();
+    Transaction transaction;
+
+    while (true) {
+        ThisThread::flags_wait_any(m_ThreadFlag);
+
+        // process everything that is queued, new transactions may arrive meanwhile
+        while (dequeue(transaction)) {
+            transfer_timer.reset();
+            const int result = execute(transaction);
+            const int64_t busy_time_mus = transfer_timer.elapsed_time().count();
+
+            m_Mutex.lock();
+            DeviceStatistics* statistics = findStatistics(transaction.address, true);
+            if (statistics) {
+                statistics->transactions++;
+                statistics->bytes += transaction.tx_length + transaction.rx_length;
+                statistics->busy_time_mus += busy_time_mus;
+                if (result != 0)
+                    statistics->errors++;
+            }
+            m_Mutex.unlock();
+
+            complete(transaction, result);
+        }
+    }
+}
+
+void I2CBus::onTransferEvent(int event)
+{
+    // executed in interrupt context
+    m_transfer_event = event;
+    m_Thread.flags_set(m_TransferFlag);
+}
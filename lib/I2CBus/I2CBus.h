@@ -0,0 +1,200 @@
+/**
+ * @file I2CBus.h
+ * @brief Defines the I2CBus class, an asynchronous manager for a shared I2C bus.
+ *
+ * The I2CBus class owns the I2C peripheral of one bus and executes queued register
+ * writes and burst reads from a dedicated thread. Transactions carry a priority, the
+ * highest priority pending transaction is executed next and transactions with the same
+ * priority are executed in the order they were queued. Transfers are interrupt driven
+ * (mbed asynchronous I2C API), so the bus thread sleeps while the peripheral is busy and
+ * the threads of the devices on the bus are only blocked if they explicitly wait for
+ * the result.
+ *
+ * Completion is either reported by a callback (executed in the bus thread) or by setting
+ * a thread flag on a given thread. The blocking helpers `writeRegisters()` and
+ * `readRegisters()` queue a transaction and wait on the calling thread for the flag.
+ *
+ * The bus keeps per-device statistics (bus time, transactions, bytes and errors), so that
+ * the bus utilisation of each device can be reported.
+ *
+ * The bus runs at 100 kHz (standard mode, the mbed default) unless a frequency is given.
+ * The LSM9DS1 and the SX1509 of the SensorBar support 400 kHz (fast mode), which takes a
+ * quarter of the bus time, but only if the pull-ups and the cabling of the bus allow it.
+ * The timeout of a transfer follows from its length and the bus frequency.
+ *
+ * There is one I2CBus per pin pair: every bus registers itself, the drivers that are constructed
+ * with pins (e.g. `SensorBar(sda, scl, ...)`) get the bus with `acquire()`, which returns the
+ * existing bus of these pins or creates one, and give it back with `release()`. A bus created by
+ * `acquire()` is deleted when its last user releases it. A transaction that does not fit into the
+ * queue is not executed, the caller gets false (or -1) and the bus counts it, see
+ * `getQueueFullCount()`.
+ *
+ * @dependencies
+ * This class relies on:
+ * - **I2C**: Asynchronous transfers (falls back to blocking transfers if the target has no DEVICE_I2C_ASYNCH).
+ * - **ThreadFlag**: Signals new transactions and transfer completion to the bus thread.
+ * - **Mutex**: Protects the transaction queue.
+ *
+ * @usage
+ * 1. Create one `I2CBus` instance per physical bus.
+ * 2. Pass it to the device drivers (e.g. `SensorBar`, `LSM9DS1`, `IMU`, `LineFollower`).
+ * 3. Optionally, read `getUtilisation(address)` to check the bus load of a device.
+ *
+ * @example
+ * ```
+ * I2CBus i2c_bus(PB_IMU_SDA, PB_IMU_SCL, 400000);
+ * IMU imu(i2c_bus);
+ * SensorBar sensor_bar(i2c_bus, bar_dist);
+ *
+ * // bus load of the sensor bar in percent
+ * printf("%.2f\n", 100.0f * i2c_bus.getUtilisation(0x3E << 1));
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef I2C_BUS_H_
+#define I2C_BUS_H_
+
+#include "mbed.h"
+
+#include "ThreadFlag.h"
+
+#define I2C_BUS_QUEUE_SIZE 16            // maximum number of pending transactions
+#define I2C_BUS_TX_BUFFER_SIZE 12        // register address plus payload of a register write
+#define I2C_BUS_NUM_OF_DEVICES_MAX 8     // number of devices with separate statistics
+#define I2C_BUS_TRANSFER_TIMEOUT_MARGIN_MUS 1000 // added to twice the nominal transfer time (clock stretching, latency)
+#define I2C_BUS_NUM_OF_BUSES_MAX 3       // I2C peripherals of the target
+
+class I2CBus
+{
+public:
+    enum class Priority : uint8_t {
+        LOW = 0,
+        NORMAL,
+        HIGH
+    };
+
+    // completion callback, the argument is 0 on success and negative on failure
+    typedef Callback<void(int)> completion_t;
+
+    struct DeviceStatistics {
+        uint8_t address{0};      // 8-bit I2C address, 0 if the slot is unused
+        uint32_t transactions{0};
+        uint32_t bytes{0};
+        uint32_t errors{0};
+        uint64_t busy_time_mus{0};
+    };
+
+    /**
+     * @param sda          I2C data pin
+     * @param scl          I2C clock pin
+     * @param frequency_hz bus frequency, 100 kHz (standard mode) or 400 kHz (fast mode) if all devices and the bus support it
+     */
+    explicit I2CBus(PinName sda, PinName scl, int frequency_hz = 100000);
+    ~I2CBus();
+
+    // the bus of these pins, created with frequency_hz if there is none yet, nullptr if all slots are used
+    static I2CBus* acquire(PinName sda, PinName scl, int frequency_hz = 100000);
+    // gives a bus of acquire() back, it is deleted with its last user if acquire() created it
+    static void release(I2CBus* i2c_bus);
+
+    // queue a register write, returns false if the queue is full or the payload is too long
+    bool queueWrite(uint8_t address,
+                    uint8_t reg,
+                    const uint8_t* data,
+                    uint8_t length,
+                    Priority priority = Priority::NORMAL,
+                    completion_t callback = nullptr,
+                    osThreadId_t thread_id = nullptr,
+                    uint32_t thread_flag = 0,
+                    int* result = nullptr);
+
+    // queue a burst read of length bytes starting at reg, dest has to stay valid until completion
+    bool queueRead(uint8_t address,
+                   uint8_t reg,
+                   uint8_t* dest,
+                   uint16_t length,
+                   Priority priority = Priority::NORMAL,
+                   completion_t callback = nullptr,
+                   osThreadId_t thread_id = nullptr,
+                   uint32_t thread_flag = 0,
+                   int* result = nullptr);
+
+    // queue a transaction and wait on the calling thread for thread_flag, returns 0 on success
+    int writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, uint8_t length, uint32_t thread_flag,
+                       Priority priority = Priority::NORMAL);
+    int readRegisters(uint8_t address, uint8_t reg, uint8_t* dest, uint16_t length, uint32_t thread_flag,
+                      Priority priority = Priority::NORMAL);
+
+    int getFrequency() const { return m_frequency_hz; };
+    // nominal bus time of a transfer with tx_length bytes written and rx_length bytes read (9 bits per byte)
+    uint32_t getTransferTimeMus(uint16_t tx_length, uint16_t rx_length) const;
+
+    // fraction of the time since the last statistics reset the bus was busy with this device
+    float getUtilisation(uint8_t address) const;
+    // fraction of the time since the last statistics reset the bus was busy at all
+    float getUtilisation() const;
+    bool getStatistics(uint8_t address, DeviceStatistics& statistics) const;
+    // number of transactions that were not queued because the queue was full
+    uint32_t getQueueFullCount() const { return m_queue_full_cntr; };
+    void resetStatistics();
+    void printStatistics() const;
+
+private:
+    struct Transaction {
+        uint8_t address;
+        uint8_t tx[I2C_BUS_TX_BUFFER_SIZE];
+        uint8_t tx_length;
+        uint8_t* rx;
+        uint16_t rx_length;
+        Priority priority;
+        uint32_t seq;
+        completion_t callback;
+        osThreadId_t thread_id;
+        uint32_t thread_flag;
+        int* result;
+    };
+
+    struct Registration {
+        PinName sda;
+        PinName scl;
+        I2CBus* bus;     // nullptr if the slot is unused
+        uint8_t users;   // users of acquire()
+        bool is_created; // created by acquire(), deleted with the last user
+    };
+    static Registration s_registry[I2C_BUS_NUM_OF_BUSES_MAX];
+    static Mutex& getRegistryMutex();
+
+    I2C m_I2C;
+    PinName m_sda;
+    PinName m_scl;
+    int m_frequency_hz;
+
+    Transaction m_queue[I2C_BUS_QUEUE_SIZE];
+    bool m_queue_used[I2C_BUS_QUEUE_SIZE]{};
+    uint32_t m_seq{0};
+    uint32_t m_queue_full_cntr{0};
+    mutable Mutex m_Mutex; // mutex to protect the queue and the statistics
+
+    DeviceStatistics m_statistics[I2C_BUS_NUM_OF_DEVICES_MAX];
+    Timer m_statistics_timer;
+
+    volatile int m_transfer_event{0};
+
+    Thread m_Thread;
+    ThreadFlag m_ThreadFlag;
+    ThreadFlag m_TransferFlag;
+
+    bool enqueue(Transaction& transaction);
+    bool dequeue(Transaction& transaction);
+    int execute(Transaction& transaction);
+    void complete(Transaction& transaction, int result);
+    DeviceStatistics* findStatistics(uint8_t address, bool create);
+
+    void threadTask();
+    void onTransferEvent(int event);
+};
+
+#endif /* I2C_BUS_H_ */
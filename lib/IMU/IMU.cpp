@@ -1,24 +1,58 @@
 #include "IMU.h"
 
-IMU::IMU(PinName pin_sda, PinName pin_scl) : m_ImuLSM9DS1(pin_sda, pin_scl),
-                                             m_Mahony(Parameters::kp, Parameters::ki, TS),
-                                             m_Thread(osPriorityHigh, 4096)
+// stored gyro bias and temperature table in the last flash sector
+#define IMU_GYRO_BIAS_RECORD_MAGIC 0x49474232 // "IGB2"
+
+struct GyroBiasRecord {
+    uint32_t magic;
+    float bias[3];
+    float table_temperature_min;
+    float table_temperature_step;
+    float table[GYRO_BIAS_TABLE_SIZE][4]; // bias x, y, z and weight of every node
+    uint32_t checksum;
+};
+
+static uint32_t calcGyroBiasRecordChecksum(const GyroBiasRecord& record)
 {
-#if (IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE && IMU_DO_USE_STATIC_MAG_CALIBRATION)
-    m_magCalib.setCalibrationParameter(Parameters::A_mag, Parameters::b_mag);
-#endif
-    
-    // start thread
-    m_Thread.start(callback(this, &IMU::threadTask));
+    // fnv-1a over everything but the checksum
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&record);
+    uint32_t checksum = 2166136261UL;
+    for (size_t i = 0; i < offsetof(GyroBiasRecord, checksum); i++) {
+        checksum ^= data[i];
+        checksum *= 16777619UL;
+    }
+    return checksum;
+}
+
+IMU::IMU(PinName pin_sda, PinName pin_scl, PinName pin_int) : m_ImuLSM9DS1(pin_sda, pin_scl),
+                                                              m_Thread(osPriorityHigh, 4096),
+                                                              m_MagCalibration(Parameters::mag_calib_min_dist),
+                                                              m_MagCalibrationThread(osPriorityLow, 8192)
+{
+    if (pin_int != NC)
+        m_DataReady = new InterruptIn(pin_int);
+    start();
+}
 
-    // attach sendThreadFlag() to ticker so that sendThreadFlag() is called periodically, which signals the thread to execute
-    m_Ticker.attach(callback(this, &IMU::sendThreadFlag), std::chrono::microseconds{PERIOD_MUS});
+IMU::IMU(I2CBus& i2c_bus, PinName pin_int) : m_ImuLSM9DS1(i2c_bus),
+                                             m_Thread(osPriorityHigh, 4096),
+                                             m_MagCalibration(Parameters::mag_calib_min_dist),
+                                             m_MagCalibrationThread(osPriorityLow, 8192)
+{
+    if (pin_int != NC)
+        m_DataReady = new InterruptIn(pin_int);
+    start();
 }
 
 IMU::~IMU()
 {
+    if (m_DataReady) {
+        m_DataReady->rise(nullptr);
+        delete m_DataReady;
+    }
     m_Ticker.detach();
     m_Thread.terminate();
+    m_MagCalibrationThread.terminate();
 }
 
 ImuData IMU::getImuData() const
@@ -26,69 +60,361 @@ ImuData IMU::getImuData() const
     return m_ImuData;
 }
 
+float IMU::getSampleRate() const
+{
+    return (m_dt_mean > 0.0f) ? 1.0f / m_dt_mean : 0.0f;
+}
+
+float IMU::getSamplingJitter() const
+{
+    return (m_dt_cntr > 1) ? sqrtf(m_dt_M2 / static_cast<float>(m_dt_cntr - 1)) : 0.0f;
+}
+
+float IMU::getReadTime() const
+{
+    return m_read_time_mean;
+}
+
+float IMU::getStartupTime() const
+{
+    return 1.0e-6f * static_cast<float>(m_startup_time_us);
+}
+
+void IMU::printSamplingStatistics() const
+{
+    printf("IMU: %s, rate %.2f Hz, dt mean %.1f us, jitter %.1f us, min %.1f us, max %.1f us, timeouts %lu, read %.1f us, read errors %lu, startup %.1f ms\n",
+           m_DataReady ? "data ready" : "ticker",
+           getSampleRate(),
+           1.0e6f * m_dt_mean,
+           1.0e6f * getSamplingJitter(),
+           1.0e6f * m_dt_min,
+           1.0e6f * m_dt_max,
+           (unsigned long)m_timeout_cntr,
+           1.0e6f * m_read_time_mean,
+           (unsigned long)m_read_error_cntr,
+           1.0e3f * getStartupTime());
+}
+
+bool IMU::saveGyroBias()
+{
+    if (!m_GyroBiasEstimator.isBiasValid()) {
+        printf("IMU: no valid gyro bias to save\n");
+        return false;
+    }
+
+    GyroBiasRecord record;
+    record.magic = IMU_GYRO_BIAS_RECORD_MAGIC;
+    const Eigen::Vector3f bias = m_GyroBiasEstimator.getBias();
+    for (int i = 0; i < 3; i++)
+        record.bias[i] = bias(i);
+    record.table_temperature_min = Parameters::gyro_bias_temperature_min;
+    record.table_temperature_step = Parameters::gyro_bias_temperature_step;
+    for (uint8_t i = 0; i < GYRO_BIAS_TABLE_SIZE; i++) {
+        Eigen::Vector3f node_bias;
+        float weight;
+        m_GyroBiasEstimator.getTableNode(i, node_bias, weight);
+        for (int j = 0; j < 3; j++)
+            record.table[i][j] = node_bias(j);
+        record.table[i][3] = weight;
+    }
+    record.checksum = calcGyroBiasRecordChecksum(record);
+
+    FlashIAP flash;
+    if (flash.init() != 0) {
+        printf("IMU: flash init failed\n");
+        return false;
+    }
+    const uint32_t flash_end = flash.get_flash_start() + flash.get_flash_size();
+    const uint32_t sector_size = flash.get_sector_size(flash_end - 1);
+    const uint32_t address = flash_end - sector_size;
+    const uint32_t page_size = flash.get_page_size();
+    // the program size has to be a multiple of the page size
+    uint8_t buffer[sizeof(GyroBiasRecord) + 32];
+    const uint32_t size = ((sizeof(GyroBiasRecord) + page_size - 1) / page_size) * page_size;
+    bool is_ok = (size <= sizeof(buffer));
+#ifdef FLASHIAP_APP_ROM_END_ADDR
+    // never erase the application
+    is_ok = is_ok && (address >= FLASHIAP_APP_ROM_END_ADDR);
+#endif
+    if (is_ok) {
+        memset(buffer, flash.get_erase_value(), sizeof(buffer));
+        memcpy(buffer, &record, sizeof(GyroBiasRecord));
+        is_ok = (flash.erase(address, sector_size) == 0) && (flash.program(buffer, address, size) == 0);
+    }
+    flash.deinit();
+
+    if (!is_ok)
+        printf("IMU: saving the gyro bias failed\n");
+    return is_ok;
+}
+
+bool IMU::loadGyroBias()
+{
+    FlashIAP flash;
+    if (flash.init() != 0)
+        return false;
+    const uint32_t flash_end = flash.get_flash_start() + flash.get_flash_size();
+    const uint32_t address = flash_end - flash.get_sector_size(flash_end - 1);
+    GyroBiasRecord record;
+    const bool is_read = (flash.read(&record, address, sizeof(GyroBiasRecord)) == 0);
+    flash.deinit();
+
+    // an erased or foreign sector fails the magic or the checksum
+    if (!is_read || (record.magic != IMU_GYRO_BIAS_RECORD_MAGIC) || (record.checksum != calcGyroBiasRecordChecksum(record)))
+        return false;
+    const Eigen::Vector3f bias(record.bias[0], record.bias[1], record.bias[2]);
+    if (!bias.allFinite())
+        return false;
+    m_GyroBiasEstimator.setBias(bias);
+
+#if IMU_DO_USE_GYRO_BIAS_TEMPERATURE_MODEL
+    // the table is only used if it was learned with the same nodes
+    if ((record.table_temperature_min == Parameters::gyro_bias_temperature_min) &&
+        (record.table_temperature_step == Parameters::gyro_bias_temperature_step)) {
+        for (uint8_t i = 0; i < GYRO_BIAS_TABLE_SIZE; i++) {
+            const Eigen::Vector3f node_bias(record.table[i][0], record.table[i][1], record.table[i][2]);
+            if (node_bias.allFinite() && (record.table[i][3] > 0.0f))
+                m_GyroBiasEstimator.setTableNode(i, node_bias, record.table[i][3]);
+        }
+    }
+#endif
+    return true;
+}
+
+void IMU::printGyroBiasTable() const
+{
+    printf("IMU: temperature %.1f deg C, gyro bias %.6f, %.6f, %.6f\n",
+           m_GyroBiasEstimator.getTemperature(),
+           m_GyroBiasEstimator.getBias()(0),
+           m_GyroBiasEstimator.getBias()(1),
+           m_GyroBiasEstimator.getBias()(2));
+    for (uint8_t i = 0; i < GYRO_BIAS_TABLE_SIZE; i++) {
+        Eigen::Vector3f node_bias;
+        float weight;
+        m_GyroBiasEstimator.getTableNode(i, node_bias, weight);
+        if (weight > 0.0f)
+            printf("%.1f, %.6f, %.6f, %.6f, %.1f\n", m_GyroBiasEstimator.getTableTemperature(i), node_bias(0), node_bias(1), node_bias(2), weight);
+    }
+}
+
+float IMU::getMagCalibrationCoverage()
+{
+    m_MagCalibrationMutex.lock();
+    const float coverage = m_MagCalibration.getCoverage();
+    m_MagCalibrationMutex.unlock();
+    return coverage;
+}
+
+float IMU::getMagCalibrationResidual()
+{
+    m_MagCalibrationMutex.lock();
+    const float residual = m_MagCalibration.getResidual();
+    m_MagCalibrationMutex.unlock();
+    return residual;
+}
+
+void IMU::printMagCalibration()
+{
+    m_MagCalibrationMutex.lock();
+    const uint32_t num_of_samples = m_MagCalibration.getStatistics().num_of_samples;
+    const float coverage = m_MagCalibration.getCoverage();
+    const float residual = m_MagCalibration.getResidual();
+    const uint32_t fit_cntr = m_mag_calib_fit_cntr;
+    const MagCalibration::Result result = m_mag_calib_result;
+    m_MagCalibrationMutex.unlock();
+
+    printf("IMU: mag %s, samples %lu, coverage %.2f, residual %.4f, fits %lu\n",
+           m_mag_is_calibrated ? "calibrated" : "not calibrated",
+           (unsigned long)num_of_samples,
+           coverage,
+           residual,
+           (unsigned long)fit_cntr);
+    if (fit_cntr == 0)
+        return;
+    printf("IMU: field strength %.4f gauss, axis ratio %.3f\n", result.field_strength, result.axis_ratio);
+    printf("    static const Eigen::Matrix3f A_mag = (Eigen::Matrix3f() << %.7ff, %.7ff, %.7ff,\n", result.A(0, 0), result.A(0, 1), result.A(0, 2));
+    printf("                                                               %.7ff, %.7ff, %.7ff,\n", result.A(1, 0), result.A(1, 1), result.A(1, 2));
+    printf("                                                               %.7ff, %.7ff, %.7ff).finished();\n", result.A(2, 0), result.A(2, 1), result.A(2, 2));
+    printf("    static const Eigen::Vector3f b_mag = (Eigen::Vector3f() << %.7ff, %.7ff, %.7ff).finished();\n", result.b(0), result.b(1), result.b(2));
+}
+
+void IMU::start()
+{
+#if IMU_DO_USE_ESKF
+    m_OrientationEstimator.setup(Parameters::eskf_gyro_noise, Parameters::eskf_gyro_bias_noise,
+                                 Parameters::eskf_acc_noise, Parameters::eskf_mag_noise, TS);
+#else
+    m_OrientationEstimator.setup(Parameters::kp, Parameters::ki, TS);
+#endif
+
+#if IMU_DO_USE_STATIC_MAG_CALIBRATION
+    // the online calibration starts from the static calibration
+    m_magCalib.setCalibrationParameter(Parameters::A_mag, Parameters::b_mag);
+    m_MagCalibration.setCalibration(Parameters::A_mag, Parameters::b_mag);
+    m_mag_is_calibrated = true;
+#elif !IMU_DO_USE_ONLINE_MAG_CALIBRATION
+    // no calibration, the raw mag is used
+    m_mag_is_calibrated = true;
+#endif
+
+    float Ts_sample = TS;
+    if (m_DataReady) {
+        // the gyro data ready signal on INT1_A/G triggers the thread, the fifo is not used in this mode
+        m_ImuLSM9DS1.setGyroODR(IMU_DATA_READY_GYRO_ODR);
+        Ts_sample = 1.0f / m_ImuLSM9DS1.getGyroODR();
+        m_period_mus = static_cast<int64_t>(1.0e6f * Ts_sample);
+        m_ImuLSM9DS1.configInt(XG_INT1, INT_DRDY_G, INT_ACTIVE_HIGH, INT_PUSH_PULL);
+        m_OrientationEstimator.setSamplingTime(Ts_sample);
+    } else {
+#if IMU_DO_USE_FIFO
+        // gyro and acc run at the gyro odr into the fifo, continuous mode overwrites the oldest sample if the fifo is full
+        m_use_fifo = true;
+        Ts_sample = 1.0f / m_ImuLSM9DS1.getGyroODR();
+        m_ImuLSM9DS1.enableFIFO(true);
+        m_ImuLSM9DS1.setFIFO(FIFO_CONT, 0x1F);
+        m_OrientationEstimator.setSamplingTime(Ts_sample);
+#endif
+    }
+#if IMU_DO_USE_ESKF
+    // the steady state gain is computed once here for the nominal sampling time
+    m_OrientationEstimator.enableSteadyStateGain(IMU_ESKF_DO_USE_STEADY_STATE_GAIN);
+#endif
+    // the gyro bias is estimated in the background, the orientation is valid from the first sample
+    m_GyroBiasEstimator.setup(Ts_sample, Parameters::gyro_bias_window_time);
+    m_GyroBiasEstimator.setThresholds(Parameters::gyro_bias_gyro_std_max, Parameters::gyro_bias_acc_std_max,
+                                      Parameters::gyro_bias_gyro_mean_dev_max);
+#if IMU_DO_USE_GYRO_BIAS_TEMPERATURE_MODEL
+    m_GyroBiasEstimator.enableTemperatureModel(Parameters::gyro_bias_temperature_min, Parameters::gyro_bias_temperature_step);
+#endif
+    // the temperature is read once per second, the first time in the first thread period
+    m_temperature_cntr_max = static_cast<uint32_t>(1000000 / m_period_mus);
+    m_temperature_cntr = m_temperature_cntr_max;
+#if IMU_DO_LOAD_GYRO_BIAS_FROM_FLASH
+    if (loadGyroBias()) {
+        const Eigen::Vector3f bias = m_GyroBiasEstimator.getBias();
+        printf("IMU: gyro bias loaded from flash: %.6f, %.6f, %.6f\n", bias(0), bias(1), bias(2));
+    }
+#endif
+#if IMU_DO_USE_STATIC_ACC_CALIBRATION
+    m_acc_offset = Parameters::b_acc;
+    m_acc_offset_is_valid = true;
+#else
+    m_acc_offset.setZero();
+#endif
+    m_start_time_us = ticker_read_us(get_us_ticker_data());
+
+    // start thread
+    m_Thread.start(callback(this, &IMU::threadTask));
+#if IMU_DO_USE_ONLINE_MAG_CALIBRATION
+    m_MagCalibrationThread.start(callback(this, &IMU::magCalibrationTask));
+#endif
+
+    if (m_DataReady) {
+        // the data ready signal is a level, if it is already high there is no rising edge until the data is read,
+        // this is handled by the timeout in the thread
+        m_DataReady->rise(callback(this, &IMU::dataReady));
+    } else {
+        // attach sendThreadFlag() to ticker so that sendThreadFlag() is called periodically, which signals the thread to execute
+        m_Ticker.attach(callback(this, &IMU::sendThreadFlag), std::chrono::microseconds{PERIOD_MUS});
+    }
+}
+
 void IMU::threadTask()
 {
-    static const uint16_t Navg = static_cast<uint16_t>(1.0f / TS);
-    static uint16_t avg_cntr = 0;
-    static bool imu_is_calibrated = false;
-    static Eigen::Vector3f gyro_offset;
-    static Eigen::Vector3f acc_offset;
-    gyro_offset.setZero();
-    acc_offset.setZero();
     static Timer timer;
     timer.start();
 
     while (true) {
-        ThisThread::flags_wait_any(m_ThreadFlag);
-
-        m_ImuLSM9DS1.updateGyro();
-        m_ImuLSM9DS1.updateAcc();
-        Eigen::Vector3f gyro(m_ImuLSM9DS1.readGyroX(), m_ImuLSM9DS1.readGyroY(), m_ImuLSM9DS1.readGyroZ());
-        Eigen::Vector3f acc(m_ImuLSM9DS1.readAccX(), m_ImuLSM9DS1.readAccY(), m_ImuLSM9DS1.readAccZ());
+        uint64_t time_us;
+        if (m_DataReady) {
+            // wait for the data ready interrupt, if an edge was missed the sample is read after two periods anyway
+            if (ThisThread::flags_wait_any_for(m_ThreadFlag, std::chrono::microseconds{2 * m_period_mus})) {
+                core_util_critical_section_enter();
+                time_us = m_data_ready_time_us;
+                core_util_critical_section_exit();
+            } else {
+                time_us = ticker_read_us(get_us_ticker_data());
+                m_timeout_cntr++;
+            }
+        } else {
+            ThisThread::flags_wait_any(m_ThreadFlag);
+            time_us = ticker_read_us(get_us_ticker_data());
+        }
 
-#if IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE
+#if (IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE || IMU_DO_USE_ONLINE_MAG_CALIBRATION)
+        // the mag is read once per thread period and used for all samples
         m_ImuLSM9DS1.updateMag();
         Eigen::Vector3f mag(m_ImuLSM9DS1.readMagX(), m_ImuLSM9DS1.readMagY(), m_ImuLSM9DS1.readMagZ());
+#if IMU_DO_USE_ONLINE_MAG_CALIBRATION
+        updateMagCalibration(mag);
+#endif
+        mag = m_magCalib.applyCalibration(mag);
 #else
         static Eigen::Vector3f mag = Eigen::Vector3f::Zero();
 #endif
 
-        if (!imu_is_calibrated) {
-            gyro_offset += gyro;
-            acc_offset += acc;
-            avg_cntr++;
-            if (avg_cntr == Navg) {
-                imu_is_calibrated = true;
-                gyro_offset /= avg_cntr;
-                acc_offset /= avg_cntr;
-                // we have to keep gravity in acc z direction
-                acc_offset(2) = 0.0f;
-#if IMU_DO_USE_STATIC_ACC_CALIBRATION
-                acc_offset = Parameters::b_acc;
-#else
-                printf("Averaged acc offset: %.7ff, %.7ff, %.7f\n", acc_offset(0), acc_offset(1), acc_offset(2));
-#endif
-            }
+        // the temperature changes slowly, the bias is only recalculated when it is read
+        if (++m_temperature_cntr >= m_temperature_cntr_max) {
+            m_temperature_cntr = 0;
+            m_ImuLSM9DS1.readTemp();
+            m_ImuData.temperature = m_ImuLSM9DS1.readTemperature();
+            m_GyroBiasEstimator.setTemperature(m_ImuData.temperature);
         }
 
-        if (imu_is_calibrated) {
-            gyro -= gyro_offset;
-            acc -= acc_offset;
-
-#if IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE
-            mag = m_magCalib.applyCalibration(mag);
-            m_Mahony.update(gyro, acc, mag);
+        bool data_is_valid = false;
+        Eigen::Vector3f gyro, acc;
+        if (m_use_fifo) {
+            // read all samples in the fifo with burst reads and run mahony over every sample read without error
+            bool overrun = false;
+            m_fifo_batch_size = m_ImuLSM9DS1.updateGyroAccFIFO(m_fifo_gyro, m_fifo_acc, LSM9DS1_FIFO_SIZE, &overrun);
+            if (overrun)
+                m_fifo_overrun_cntr++;
+            for (uint8_t i = 0; i < m_fifo_batch_size; i++) {
+                gyro = Eigen::Map<const Eigen::Vector3f>(&m_fifo_gyro[3 * i]);
+                acc = Eigen::Map<const Eigen::Vector3f>(&m_fifo_acc[3 * i]);
+                data_is_valid = updateSample(gyro, acc, mag);
+            }
+        } else {
+            const uint64_t read_start_us = ticker_read_us(get_us_ticker_data());
+#if IMU_DO_USE_GYRO_ACC_BURST_READ
+            if (!m_ImuLSM9DS1.updateGyroAcc(gyro.data(), acc.data())) {
+                // i2c error, skip the sample instead of feeding garbage into the estimator
+                m_read_error_cntr++;
+                continue;
+            }
+#else
+            m_ImuLSM9DS1.updateGyro();
+            m_ImuLSM9DS1.updateAcc();
+            gyro = Eigen::Vector3f(m_ImuLSM9DS1.readGyroX(), m_ImuLSM9DS1.readGyroY(), m_ImuLSM9DS1.readGyroZ());
+            acc = Eigen::Vector3f(m_ImuLSM9DS1.readAccX(), m_ImuLSM9DS1.readAccY(), m_ImuLSM9DS1.readAccZ());
+#endif
+            const float read_time = 1.0e-6f * static_cast<float>(ticker_read_us(get_us_ticker_data()) - read_start_us);
+            m_read_cntr++;
+            m_read_time_mean += (read_time - m_read_time_mean) / static_cast<float>(m_read_cntr);
+            const float dt = updateSamplingStatistics(time_us);
+            // integrate with the measured dt, limited in case of a missed interrupt
+            if (m_DataReady && (dt > 0.0f)) {
+                const float Ts_nominal = 1.0e-6f * static_cast<float>(m_period_mus);
+                const float Ts_step = fminf(fmaxf(dt, 0.5f * Ts_nominal), 2.0f * Ts_nominal);
+#if IMU_DO_USE_ESKF
+                // only the integration step, the steady state gain stays the one of the nominal sampling time
+                m_OrientationEstimator.setTimeStep(Ts_step);
 #else
-            m_Mahony.update(gyro, acc);
+                m_OrientationEstimator.setSamplingTime(Ts_step);
 #endif
+            }
+            data_is_valid = updateSample(gyro, acc, mag);
+        }
 
-            // update data object
+        if (data_is_valid) {
+            // update data object with the last sample
             m_ImuData.gyro = gyro;
             m_ImuData.acc = acc;
             m_ImuData.mag = mag;
-            m_ImuData.quat = m_Mahony.getOrientationAsQuaternion();
-            m_ImuData.rpy = m_Mahony.getOrientationAsRPYAngles();
-            m_ImuData.tilt = m_Mahony.getTiltAngle();
+            m_ImuData.quat = m_OrientationEstimator.getOrientationAsQuaternion();
+            m_ImuData.rpy = m_OrientationEstimator.getOrientationAsRPYAngles();
+            m_ImuData.tilt = m_OrientationEstimator.getTiltAngle();
+            m_ImuData.time_us = time_us;
         }
 
 #if IMU_DO_PRINTF
@@ -101,13 +427,120 @@ void IMU::threadTask()
                m_ImuData.mag(0), m_ImuData.mag(1), m_ImuData.mag(2), time_ms);
         printf("%.6f, %.6f, %.6f, %.6f, ", m_ImuData.quat.w(), m_ImuData.quat.x(), m_ImuData.quat.y(), m_ImuData.quat.z());
         printf("%.6f, %.6f, %.6f, ", m_ImuData.rpy(0), m_ImuData.rpy(1), m_ImuData.rpy(2));
+#if IMU_DO_USE_FIFO
+        printf("%d, %lu, ", m_fifo_batch_size, static_cast<unsigned long>(m_fifo_overrun_cntr));
+#endif
         printf("%.6f\n", m_ImuData.tilt);
 #endif
     }
 }
 
+bool IMU::updateSample(Eigen::Vector3f& gyro, Eigen::Vector3f& acc, Eigen::Vector3f& mag)
+{
+    // the bias is updated at the end of every window in which the robot stood still
+    if (m_GyroBiasEstimator.update(gyro, acc) && !m_acc_offset_is_valid) {
+        m_acc_offset = m_GyroBiasEstimator.getAccMean();
+        // we have to keep gravity in acc z direction
+        m_acc_offset(2) = 0.0f;
+        m_acc_offset_is_valid = true;
+        printf("Averaged acc offset: %.7ff, %.7ff, %.7f\n", m_acc_offset(0), m_acc_offset(1), m_acc_offset(2));
+    }
+
+    gyro -= m_GyroBiasEstimator.getBias();
+    acc -= m_acc_offset;
+
+#if IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE
+    // an uncalibrated mag would pull the yaw angle in the wrong direction
+    if (m_mag_is_calibrated)
+        m_OrientationEstimator.update(gyro, acc, mag);
+    else
+        m_OrientationEstimator.update(gyro, acc);
+#else
+    m_OrientationEstimator.update(gyro, acc);
+#endif
+
+    // startup ends with the first sample that is corrected with a converged (or loaded) gyro bias
+    if ((m_startup_time_us == 0) && m_GyroBiasEstimator.isBiasValid())
+        m_startup_time_us = ticker_read_us(get_us_ticker_data()) - m_start_time_us;
+
+    return true;
+}
+
+float IMU::updateSamplingStatistics(uint64_t time_us)
+{
+    if (m_time_us_past == 0) {
+        m_time_us_past = time_us;
+        return 0.0f;
+    }
+    const float dt = 1.0e-6f * static_cast<float>(time_us - m_time_us_past);
+    m_time_us_past = time_us;
+
+    // welford's algorithm for the running mean and variance
+    m_dt_cntr++;
+    const float delta = dt - m_dt_mean;
+    m_dt_mean += delta / static_cast<float>(m_dt_cntr);
+    m_dt_M2 += delta * (dt - m_dt_mean);
+    m_dt_min = (m_dt_cntr == 1) ? dt : fminf(m_dt_min, dt);
+    m_dt_max = (m_dt_cntr == 1) ? dt : fmaxf(m_dt_max, dt);
+
+    return dt;
+}
+
+void IMU::updateMagCalibration(const Eigen::Vector3f& mag_raw)
+{
+    m_MagCalibrationMutex.lock();
+    m_MagCalibration.addSample(mag_raw);
+    if (m_mag_calib_result_is_new) {
+        m_mag_calib_result_is_new = false;
+        m_magCalib.setCalibrationParameter(m_mag_calib_result.A, m_mag_calib_result.b);
+        m_MagCalibration.setCalibration(m_mag_calib_result.A, m_mag_calib_result.b);
+        m_mag_is_calibrated = true;
+    }
+    m_MagCalibrationMutex.unlock();
+}
+
+void IMU::magCalibrationTask()
+{
+    // the statistics are copied, so the fit does not block the imu thread
+    MagCalibration::Statistics statistics;
+    MagCalibration::Result result;
+    uint32_t num_of_samples_past = 0;
+
+    while (true) {
+        ThisThread::sleep_for(std::chrono::milliseconds{MAG_CALIBRATION_PERIOD_MS});
+
+        m_MagCalibrationMutex.lock();
+        statistics = m_MagCalibration.getStatistics();
+        m_MagCalibrationMutex.unlock();
+
+        // only fit if there are new samples and the directions are covered well enough
+        if ((statistics.num_of_samples == num_of_samples_past) ||
+            (statistics.num_of_samples < Parameters::mag_calib_num_of_samples_min) ||
+            (MagCalibration::getCoverage(statistics) < Parameters::mag_calib_coverage_min))
+            continue;
+        num_of_samples_past = statistics.num_of_samples;
+
+        if (!MagCalibration::fit(statistics, result, Parameters::mag_calib_axis_ratio_max))
+            continue;
+
+        // the result is applied by the imu thread
+        m_MagCalibrationMutex.lock();
+        m_mag_calib_result = result;
+        m_mag_calib_result_is_new = true;
+        m_mag_calib_fit_cntr++;
+        m_MagCalibrationMutex.unlock();
+    }
+}
+
 void IMU::sendThreadFlag()
 {
     // set the thread flag to trigger the thread task
     m_Thread.flags_set(m_ThreadFlag);
 }
+
+void IMU::dataReady()
+{
+    // timestamp of the sample, then trigger the thread task
+    m_data_ready_time_us = ticker_read_us(get_us_ticker_data());
+    m_Thread.flags_set(m_ThreadFlag);
+}
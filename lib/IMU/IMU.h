@@ -6,13 +6,24 @@
 
 #include "LSM9DS1.h"
 #include "LinearCharacteristics3.h"
+#include "ESKF.h"
+#include "GyroBiasEstimator.h"
+#include "MagCalibration.h"
 #include "Mahony.h"
 #include "ThreadFlag.h"
 
 #define IMU_DO_PRINTF false
 #define IMU_DO_USE_STATIC_ACC_CALIBRATION true  // if this is false then acc gets averaged at the beginning and printed to the console
 #define IMU_DO_USE_STATIC_MAG_CALIBRATION false // if this is false then no mag calibration gets applied, e.g. A_mag = I, b_mag = 0
+#define IMU_DO_USE_ONLINE_MAG_CALIBRATION false // if this is true then the mag calibration is fitted online while the robot is moved around
 #define IMU_THREAD_DO_USE_MAG_FOR_MAHONY_UPDATE false
+#define IMU_DO_USE_ESKF false // if this is true then the error state kalman filter is used instead of the mahony filter
+#define IMU_ESKF_DO_USE_STEADY_STATE_GAIN false // constant gain instead of the covariance update, less cpu time
+#define IMU_DO_LOAD_GYRO_BIAS_FROM_FLASH true // if this is true then the gyro bias stored with saveGyroBias() is used at startup
+#define IMU_DO_USE_GYRO_BIAS_TEMPERATURE_MODEL true // if this is true then the gyro bias is learned over the chip temperature
+#define IMU_DO_USE_FIFO false // if this is true then gyro and acc run at their odr (476 Hz) into the fifo, which is read once per thread period and mahony is updated for every sample
+#define IMU_DO_USE_GYRO_ACC_BURST_READ true // if this is false then gyro and acc are read with updateGyro(), updateAcc() and the six read accessors
+#define IMU_DATA_READY_GYRO_ODR 3 // odr of the gyro (and acc) if the imu is driven by the data ready interrupt, 3 = 119 Hz
 
 namespace Parameters
 {
@@ -32,11 +43,33 @@ namespace Parameters
     static const float ki = 0.0f;
 #endif
 
+    // eskf noise parameters, gyro noise per sample in rad/s, gyro bias random walk in rad/s/sqrt(s),
+    // noise of the normalised acc and of the heading from the mag in rad
+    static const float eskf_gyro_noise = 0.015f;
+    static const float eskf_gyro_bias_noise = 1.0e-4f;
+    static const float eskf_acc_noise = 0.05f;
+    static const float eskf_mag_noise = 0.1f;
+
     // mag_calibrated = A_mag * ( mag - b_mag )
     static const Eigen::Matrix3f A_mag = (Eigen::Matrix3f() << 1.0000000f, 0.0000000f, 0.0000000f,
                                                                0.0000000f, 1.0000000f, 0.0000000f,
                                                                0.0000000f, 0.0000000f, 1.0000000f).finished();
     static const Eigen::Vector3f b_mag = (Eigen::Vector3f() << 0.0000000f, 0.0000000f, 0.0000000f).finished();
+    // online mag calibration, min. distance of two accepted raw samples in gauss, min. coverage of the
+    // direction bins and min. number of samples before the first fit, max. axis ratio of the ellipsoid
+    static const float mag_calib_min_dist = 0.02f;
+    static const float mag_calib_coverage_min = 0.5f;
+    static const uint32_t mag_calib_num_of_samples_min = 200;
+    static const float mag_calib_axis_ratio_max = 2.0f;
+    // zero motion detector of the gyro bias estimation, window length in sec, max. standard deviation
+    // of the gyro in rad/s and of the acc in m/s^2, max. deviation of the mean gyro from the bias in rad/s
+    static const float gyro_bias_window_time = 0.5f;
+    static const float gyro_bias_gyro_std_max = 0.02f;
+    static const float gyro_bias_acc_std_max = 0.15f;
+    static const float gyro_bias_gyro_mean_dev_max = 0.02f;
+    // temperature model of the gyro bias, temperature of the first table node and between two nodes in deg C
+    static const float gyro_bias_temperature_min = 20.0f;
+    static const float gyro_bias_temperature_step = 3.0f;
     static const Eigen::Vector3f b_acc = (Eigen::Vector3f() << 0.0000000f, 0.0000000f, 0.0000000f).finished();
 }
 
@@ -52,6 +85,8 @@ public:
     Eigen::Quaternionf quat;
     Eigen::Vector3f rpy;
     float tilt = 0.0f;
+    float temperature = 0.0f; // chip temperature in deg C, updated once per second
+    uint64_t time_us = 0; // timestamp of the sample in microseconds
 
     void init() {
         gyro.setZero();
@@ -65,26 +100,113 @@ public:
 class IMU
 {
 public:
-    explicit IMU(PinName pin_sda, PinName pin_scl);
+    // if pin_int is connected to INT1_A/G of the LSM9DS1 the imu is driven by the gyro data ready interrupt
+    // instead of a ticker, every sample gets the timestamp of the interrupt and mahony uses the measured dt
+    explicit IMU(PinName pin_sda, PinName pin_scl, PinName pin_int = NC);
+    // use a shared (asynchronous) I2C bus, e.g. together with the SensorBar
+    explicit IMU(I2CBus& i2c_bus, PinName pin_int = NC);
     virtual ~IMU();
 
     ImuData getImuData() const;
+    // achieved sample rate in Hz and sampling jitter (standard deviation of dt) in sec (not in fifo mode)
+    float getSampleRate() const;
+    float getSamplingJitter() const;
+    // mean time in sec to read and convert one gyro and acc sample (not in fifo mode), includes the i2c bus time
+    float getReadTime() const;
+    void printSamplingStatistics() const;
+    // time in sec from the start of the imu until the gyro bias is valid (first stationary window or loaded
+    // from flash) and a sample was corrected with it, 0 as long as there is no valid bias
+    float getStartupTime() const;
+    // the gyro bias is estimated whenever the robot stands still, it is valid after the first stationary
+    // window (0.5 sec) or right from the start if a bias was stored with saveGyroBias()
+    bool isGyroBiasValid() const { return m_GyroBiasEstimator.isBiasValid(); };
+    Eigen::Vector3f getGyroBias() const { return m_GyroBiasEstimator.getBias(); };
+    bool isStationary() const { return m_GyroBiasEstimator.isStationary(); };
+    // stores the gyro bias and the temperature table in the last flash sector, this erases the sector and stalls
+    // the cpu for about one second, so only call it while the robot is not driving, e.g. on a button press
+    bool saveGyroBias();
+    // prints the learned nodes of the temperature table (temperature, bias x, y, z, number of windows)
+    void printGyroBiasTable() const;
+    // number of samples of the last fifo read and number of fifo overruns (only with IMU_DO_USE_FIFO)
+    uint8_t getFIFOBatchSize() const { return m_fifo_batch_size; };
+    uint32_t getFIFOOverrunCount() const { return m_fifo_overrun_cntr; };
+    // online mag calibration (only with IMU_DO_USE_ONLINE_MAG_CALIBRATION), coverage of the directions in 0...1
+    // and rms of ||mag_calibrated|| - 1, the mag is only used in the mahony update once it is calibrated
+    bool isMagCalibrated() const { return m_mag_is_calibrated; };
+    float getMagCalibrationCoverage();
+    float getMagCalibrationResidual();
+    // prints the state of the online calibration and A_mag, b_mag in the format of the Parameters namespace
+    void printMagCalibration();
 
 private:
     static constexpr int64_t PERIOD_MUS = 20000;
     static constexpr float TS = 1.0e-6f * static_cast<float>(PERIOD_MUS);
+    static constexpr int64_t MAG_CALIBRATION_PERIOD_MS = 2000;
 
     ImuData m_ImuData;
     LSM9DS1 m_ImuLSM9DS1;
     LinearCharacteristics3 m_magCalib;
-    Mahony m_Mahony;
+#if IMU_DO_USE_ESKF
+    ESKF m_OrientationEstimator;
+#else
+    Mahony m_OrientationEstimator;
+#endif
 
     Thread m_Thread;
     Ticker m_Ticker;
     ThreadFlag m_ThreadFlag;
 
+    // online mag calibration, the statistics are accumulated in the imu thread and fitted in a low priority thread
+    MagCalibration m_MagCalibration;
+    Thread m_MagCalibrationThread;
+    Mutex m_MagCalibrationMutex;
+    MagCalibration::Result m_mag_calib_result;
+    bool m_mag_calib_result_is_new{false};
+    uint32_t m_mag_calib_fit_cntr{0};
+    bool m_mag_is_calibrated{false};
+
+    // data ready interrupt, nullptr if the imu is driven by the ticker
+    InterruptIn* m_DataReady{nullptr};
+    volatile uint64_t m_data_ready_time_us{0};
+    int64_t m_period_mus{PERIOD_MUS};
+    bool m_use_fifo{false};
+
+    // sampling statistics, running mean and variance of dt
+    uint64_t m_time_us_past{0};
+    uint32_t m_dt_cntr{0};
+    float m_dt_mean{0.0f};
+    float m_dt_M2{0.0f};
+    float m_dt_min{0.0f};
+    float m_dt_max{0.0f};
+    uint32_t m_timeout_cntr{0};
+    uint32_t m_read_cntr{0};
+    uint32_t m_read_error_cntr{0};
+    float m_read_time_mean{0.0f};
+
+    // gyro bias, estimated whenever the robot stands still, and acc offset
+    GyroBiasEstimator m_GyroBiasEstimator;
+    bool m_acc_offset_is_valid{false};
+    Eigen::Vector3f m_acc_offset;
+    uint64_t m_start_time_us{0};
+    uint64_t m_startup_time_us{0};
+    uint32_t m_temperature_cntr{0};
+    uint32_t m_temperature_cntr_max{0};
+
+    // fifo batch, gyro and acc with 3 floats per sample
+    float m_fifo_gyro[3 * LSM9DS1_FIFO_SIZE];
+    float m_fifo_acc[3 * LSM9DS1_FIFO_SIZE];
+    uint8_t m_fifo_batch_size{0};
+    uint32_t m_fifo_overrun_cntr{0};
+
+    void start();
     void threadTask();
+    bool updateSample(Eigen::Vector3f& gyro, Eigen::Vector3f& acc, Eigen::Vector3f& mag);
+    float updateSamplingStatistics(uint64_t time_us);
     void sendThreadFlag();
+    void dataReady();
+    bool loadGyroBias();
+    void updateMagCalibration(const Eigen::Vector3f& mag_raw);
+    void magCalibrationTask();
 };
 
 #endif /* IMU_H_ */
@@ -6,19 +6,40 @@ float magSensitivity[4] = {0.00014, 0.00029, 0.00043, 0.00058};
 //extern Serial pc;
 
 LSM9DS1::LSM9DS1(PinName sda, PinName scl, uint8_t xgAddr, uint8_t mAddr)
-    :i2c(sda, scl)
+    :i2cBus(I2CBus::acquire(sda, scl)), ownsI2CBus(true)
 {
     init(IMU_MODE_I2C, xgAddr, mAddr); // dont know about 0xD6 or 0x3B
     begin();
 }
 
 LSM9DS1::LSM9DS1(PinName sda, PinName scl)
-    :i2c(sda, scl)
+    :i2cBus(I2CBus::acquire(sda, scl)), ownsI2CBus(true)
 {
     init(IMU_MODE_I2C, 0xD6, 0x3C); // dont know about 0xD6 or 0x3B
     begin();
 }
 
+LSM9DS1::LSM9DS1(I2CBus& i2c_bus, uint8_t xgAddr, uint8_t mAddr)
+    :i2cBus(&i2c_bus), ownsI2CBus(false)
+{
+    init(IMU_MODE_I2C, xgAddr, mAddr);
+    begin();
+}
+
+LSM9DS1::LSM9DS1(I2CBus& i2c_bus)
+    :i2cBus(&i2c_bus), ownsI2CBus(false)
+{
+    init(IMU_MODE_I2C, 0xD6, 0x3C);
+    begin();
+}
+
+LSM9DS1::~LSM9DS1()
+{
+    // the bus of the pins is shared with the other drivers on it
+    if (ownsI2CBus)
+        I2CBus::release(i2cBus);
+}
+
 /*
 LSM9DS1::LSM9DS1()
 {
@@ -178,6 +199,7 @@ float LSM9DS1::readAccZ(){return accZ;}
 float LSM9DS1::readMagX(){return magX;}
 float LSM9DS1::readMagY(){return magY;}
 float LSM9DS1::readMagZ(){return magZ;}
+float LSM9DS1::readTemperature(){return 25.0f + static_cast<float>(temperature) * (1.0f / 16.0f);}
 
 void LSM9DS1::initGyro()
 {
@@ -525,6 +547,21 @@ void LSM9DS1::updateAcc()
     accZ = static_cast<float>(az)/32768.0f*2.0f*9.81f;
 }
 
+bool LSM9DS1::updateGyroAcc(float* gyro, float* acc)
+{
+    uint8_t temp[12];
+#if LSM9DS1_GYRO_ACC_DO_USE_SINGLE_READ
+    // the address jumps from OUT_Z_H_G to OUT_X_L_XL, gyro is at temp[0], accel at temp[6]
+    if (xgReadBytes(OUT_X_L_G, temp, sizeof(temp)) != sizeof(temp))
+        return false;
+#else
+    if ((xgReadBytes(OUT_X_L_G, temp, 6) != 6) || (xgReadBytes(OUT_X_L_XL, &temp[6], 6) != 6))
+        return false;
+#endif
+    convertGyroAcc(temp, gyro, acc);
+    return true;
+}
+
 int16_t LSM9DS1::updateAcc(lsm9ds1_axis axis)
 {
     uint8_t temp[2];
@@ -758,11 +795,26 @@ void LSM9DS1::setMagODR(uint8_t mRate)
 void LSM9DS1::calcgRes()
 {
     gRes = ((float) settings.gyro.scale) / 32768.0f;
+    calcGyroAccScale();
 }
 
 void LSM9DS1::calcaRes()
 {
     aRes = ((float) settings.accel.scale) / 32768.0f;
+    calcGyroAccScale();
+}
+
+void LSM9DS1::calcGyroAccScale()
+{
+    // same as updateGyro() and updateAcc(), x is negated like in readGyroX() and readAccX()
+    const float gyroScale = (float)settings.gyro.scale/32768.0f*3.14159265358979323846f/180.0f * 1.17f; // measured correction 1.17, pmic 04.09.2019
+    const float accScale = 2.0f*9.81f/32768.0f;
+    gyroAccScale[0] = -gyroScale;
+    gyroAccScale[1] =  gyroScale;
+    gyroAccScale[2] =  gyroScale;
+    gyroAccScale[3] = -accScale;
+    gyroAccScale[4] =  accScale;
+    gyroAccScale[5] =  accScale;
 }
 
 void LSM9DS1::calcmRes()
@@ -964,6 +1016,88 @@ uint8_t LSM9DS1::getFIFOSamples()
     return (xgReadByte(FIFO_SRC) & 0x3F);
 }
 
+uint8_t LSM9DS1::updateGyroAccFIFO(float* gyro, float* acc, uint8_t maxSamples, bool* overrun)
+{
+    // FIFO_SRC: [FTH][OVRN][FSS5:0], FSS is the number of unread samples
+    const uint8_t fifoSrc = xgReadByte(FIFO_SRC);
+    if (overrun)
+        *overrun = (fifoSrc & (1<<6)) != 0;
+    uint8_t numOfSamples = fifoSrc & 0x3F;
+    if (numOfSamples > maxSamples)
+        numOfSamples = maxSamples;
+
+    uint8_t temp[LSM9DS1_FIFO_BURST_SAMPLES_MAX * LSM9DS1_FIFO_SAMPLE_SIZE];
+    uint8_t numOfSamplesRead = 0;
+    while (numOfSamplesRead < numOfSamples) {
+        uint8_t chunk = numOfSamples - numOfSamplesRead;
+        if (chunk > LSM9DS1_FIFO_BURST_SAMPLES_MAX)
+            chunk = LSM9DS1_FIFO_BURST_SAMPLES_MAX;
+#if LSM9DS1_FIFO_DO_USE_ADDRESS_ROLLOVER
+        const uint8_t size = chunk * LSM9DS1_FIFO_SAMPLE_SIZE;
+        if (xgReadBytes(OUT_X_L_G, temp, size) != size)
+            break;
+#else
+        uint8_t numOfValid = 0;
+        while (numOfValid < chunk) {
+            uint8_t* sample = &temp[numOfValid * LSM9DS1_FIFO_SAMPLE_SIZE];
+            if ((xgReadBytes(OUT_X_L_G, sample, 6) != 6) || (xgReadBytes(OUT_X_L_XL, &sample[6], 6) != 6))
+                break;
+            numOfValid++;
+        }
+        const bool isComplete = numOfValid == chunk;
+        chunk = numOfValid;
+#endif
+        // never convert the buffer of a failed read, it holds stale or uninitialised data
+        for (uint8_t i = 0; i < chunk; i++) {
+            const uint16_t idx = numOfSamplesRead + i;
+            convertGyroAcc(&temp[i * LSM9DS1_FIFO_SAMPLE_SIZE], &gyro[3 * idx], &acc[3 * idx]);
+        }
+        numOfSamplesRead += chunk;
+#if !LSM9DS1_FIFO_DO_USE_ADDRESS_ROLLOVER
+        if (!isComplete)
+            break;
+#endif
+    }
+
+    return numOfSamplesRead;
+}
+
+float LSM9DS1::getGyroODR()
+{
+    // 1 = 14.9, 2 = 59.5, 3 = 119, 4 = 238, 5 = 476, 6 = 952 Hz
+    static const float odr[7] = {0.0f, 14.9f, 59.5f, 119.0f, 238.0f, 476.0f, 952.0f};
+    const uint8_t sampleRate = settings.gyro.sampleRate;
+    return (sampleRate <= 6) ? odr[sampleRate] : 0.0f;
+}
+
+void LSM9DS1::convertGyroAcc(const uint8_t* data, float* gyro, float* acc)
+{
+    // gyro x, y, z followed by accel x, y, z, little endian
+    int16_t raw[6];
+    for (uint8_t i = 0; i < 6; i++)
+        raw[i] = (data[2 * i + 1] << 8) | data[2 * i];
+    if (_autoCalc)
+    {
+        for (uint8_t i = 0; i < 3; i++) {
+            raw[i] -= gBiasRaw[i];
+            raw[i + 3] -= aBiasRaw[i];
+        }
+    }
+
+    // one scale step for all six axes
+    float value[6];
+    for (uint8_t i = 0; i < 6; i++)
+        value[i] = static_cast<float>(raw[i]) * gyroAccScale[i];
+    memcpy(gyro, &value[0], 3 * sizeof(float));
+    memcpy(acc, &value[3], 3 * sizeof(float));
+
+    // keep the state of updateGyro() and updateAcc()
+    gx = raw[0]; gy = raw[1]; gz = raw[2];
+    ax = raw[3]; ay = raw[4]; az = raw[5];
+    gyroX = -value[0]; gyroY = value[1]; gyroZ = value[2];
+    accX = -value[3]; accY = value[4]; accZ = value[5];
+}
+
 void LSM9DS1::constrainScales()
 {
     if ((settings.gyro.scale != 245) && (settings.gyro.scale != 500) && 
@@ -1019,15 +1153,17 @@ uint8_t LSM9DS1::xgReadByte(uint8_t subAddress)
 	return 0;
 }
 
-void LSM9DS1::xgReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count)
+uint8_t LSM9DS1::xgReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count)
 {
     // Whether we're using I2C or SPI, read multiple bytes using the
     // gyro-specific I2C address or SPI CS pin.
     if (settings.device.commInterface == IMU_MODE_I2C) {
-        I2CreadBytes(_xgAddress, subAddress, dest, count);
+        return I2CreadBytes(_xgAddress, subAddress, dest, count);
     } else if (settings.device.commInterface == IMU_MODE_SPI) {
         SPIreadBytes(_xgAddress, subAddress, dest, count);
+        return count;
     }
+    return 0;
 }
 
 uint8_t LSM9DS1::mReadByte(uint8_t subAddress)
@@ -1133,8 +1269,8 @@ void LSM9DS1::I2CwriteByte(uint8_t address, uint8_t subAddress, uint8_t data)
     Wire.write(data);                 // Put data in Tx buffer
     Wire.endTransmission();           // Send the Tx buffer
     */
-    char temp_data[2] = {subAddress, data};
-    i2c.write(address, temp_data, 2);
+    // the imu feeds the orientation estimate, so it gets the bus first
+    i2cBus->writeRegisters(address, subAddress, &data, 1, i2cFlag, I2CBus::Priority::HIGH);
 }
 
 uint8_t LSM9DS1::I2CreadByte(uint8_t address, uint8_t subAddress)
@@ -1156,15 +1292,8 @@ uint8_t LSM9DS1::I2CreadByte(uint8_t address, uint8_t subAddress)
     data = Wire.read();                      // Fill Rx buffer with result
     return data;                             // Return data read from slave register
     */
-    char data;
-    char temp[2] = {subAddress};
-    
-    i2c.write(address, temp, 1);
-    //i2c.write(address & 0xFE);
-    temp[1] = 0x00;
-    i2c.write(address, temp, 1);
-    //i2c.write( address | 0x01);
-    i2c.read(address, &data, 1);
+    uint8_t data = 0;
+    i2cBus->readRegisters(address, subAddress, &data, 1, i2cFlag, I2CBus::Priority::HIGH);
     return data;
 }
 
@@ -1193,15 +1322,8 @@ uint8_t LSM9DS1::I2CreadBytes(uint8_t address, uint8_t subAddress, uint8_t * des
     }
     return count;
     */
-    int i;
-    char temp_dest[10]; // char temp_dest[count];
-    char temp[1] = {subAddress};
-    i2c.write(address, temp, 1);
-    i2c.read(address, temp_dest, count);
-    
-    //i2c doesn't take uint8_ts, but rather chars so do this nasty af conversion
-    for (i=0; i < count; i++) {
-        dest[i] = temp_dest[i];    
-    }
+    // burst read straight into dest, no intermediate buffer and therefor no length limit
+    if (i2cBus->readRegisters(address, subAddress, dest, count, i2cFlag, I2CBus::Priority::HIGH) != 0)
+        return 0;
     return count;
 }
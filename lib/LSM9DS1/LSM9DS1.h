@@ -3,6 +3,9 @@
 
 #include "mbed.h"
 
+#include "I2CBus.h"
+#include "ThreadFlag.h"
+
 /////////////////////////////////////////
 // LSM9DS1 Accel/Gyro (XL/G) Registers //
 /////////////////////////////////////////
@@ -317,6 +320,25 @@ struct IMUSettings
 };
 
 
+// FIFO of the accel/gyro, one sample is gyro x, y, z followed by accel x, y, z (12 bytes)
+#define LSM9DS1_FIFO_SIZE 32
+#define LSM9DS1_FIFO_SAMPLE_SIZE 12
+// max. samples per burst read, 8 * 12 = 96 bytes take 2.2 ms at 400 kHz (8.7 ms at 100 kHz), a full
+// fifo is read in several bursts so that other devices on the bus get a turn in between
+#define LSM9DS1_FIFO_BURST_SAMPLES_MAX 8
+// With the FIFO enabled and IF_ADD_INC set (CTRL_REG8, default), a burst read starting at
+// OUT_X_L_G (0x18) jumps from OUT_Z_H_G (0x1D) to OUT_X_L_XL (0x28) and rolls over from
+// OUT_Z_H_XL (0x2D) back to OUT_X_L_G, popping one FIFO sample per 12 bytes (application
+// note of the LSM9DS1 accel/gyro core). So n samples are read with one n * 12 byte burst read.
+// Set this to false to read each sample with two 6 byte reads instead.
+#define LSM9DS1_FIFO_DO_USE_ADDRESS_ROLLOVER true
+// updateGyroAcc() reads gyro and accel with two 6 byte reads (default). Set this to true to read
+// them with one 12 byte read from OUT_X_L_G instead, which relies on the same address jump from
+// OUT_Z_H_G (0x1D) to OUT_X_L_XL (0x28) as the FIFO burst read (gyro and accel active, IF_ADD_INC
+// set). Not verified on the robot without the FIFO, check the accel values before using it. A
+// plain 22 byte read from 0x18 to 0x2D does not work, the address does not run through 0x1E ... 0x27.
+#define LSM9DS1_GYRO_ACC_DO_USE_SINGLE_READ false
+
 #define LSM9DS1_AG_ADDR(sa0)    ((sa0) == 0 ? 0x6A : 0x6B)
 #define LSM9DS1_M_ADDR(sa1)     ((sa1) == 0 ? 0x1C : 0x1E)
 
@@ -364,6 +386,10 @@ public:
     */
     LSM9DS1(PinName sda, PinName scl, uint8_t xgAddr, uint8_t mAddr);
     LSM9DS1(PinName sda, PinName scl);
+    // use a shared (asynchronous) I2C bus, e.g. together with the SensorBar
+    LSM9DS1(I2CBus& i2c_bus, uint8_t xgAddr, uint8_t mAddr);
+    LSM9DS1(I2CBus& i2c_bus);
+    ~LSM9DS1();
     //LSM9DS1(interface_mode interface, uint8_t xgAddr, uint8_t mAddr);
     //LSM9DS1();
        
@@ -383,6 +409,8 @@ public:
     float readMagX();
     float readMagY();
     float readMagZ();
+    // chip temperature in deg C of the last readTemp(), 16 LSB per deg C and 0 at 25 deg C
+    float readTemperature();
     
     void calibrate(bool autoCalc = true);
     void calibrateMag(bool loadIn = true);
@@ -442,6 +470,18 @@ public:
     * those _after_ calling updateAcc().
     */
     void updateAcc();
+
+    /** updateGyroAcc() -- Read the gyroscope and accelerometer output registers together.
+    * Same as updateGyro() and updateAcc() followed by readGyroX() ... readAccZ() but with
+    * one read buffer (see LSM9DS1_GYRO_ACC_DO_USE_SINGLE_READ) and one scale
+    * step for all six axes. Do not use it with the FIFO enabled, use updateGyroAccFIFO().
+    * Input:
+    *  - gyro = Destination for gyro x, y, z in rad/sec (3 floats).
+    *  - acc = Destination for accel x, y, z in m/sec^2 (3 floats).
+    * Output:
+    *  false if the read failed, gyro and acc are not changed then.
+    */
+    bool updateGyroAcc(float* gyro, float* acc);
     
     /** int16_t updateAcc(axis) -- Read a specific axis of the accelerometer.
     * [axis] can be any of X_AXIS, Y_AXIS, or Z_AXIS.
@@ -658,6 +698,22 @@ public:
     
     //! getFIFOSamples() - Get number of FIFO samples
     uint8_t getFIFOSamples();
+
+    /** updateGyroAccFIFO() -- Read all samples from the FIFO (gyro and accel).
+    * The FIFO has to be enabled (enableFIFO(), setFIFO(FIFO_CONT, ...)). The samples are
+    * scaled and oriented as readGyroX() ... readAccZ(), gyro and acc get 3 floats per sample.
+    * Input:
+    *  - gyro, acc = Destination arrays with space for 3 * maxSamples floats.
+    *  - maxSamples = Max. number of samples to read, the rest stays in the FIFO.
+    *  - overrun = Optional, set to true if the FIFO was full and samples were lost.
+    * Output:
+    *  The number of samples read, if a burst read fails the samples of the
+    *  bursts before it (the samples of the failed burst are lost).
+    */
+    uint8_t updateGyroAccFIFO(float* gyro, float* acc, uint8_t maxSamples, bool* overrun = nullptr);
+
+    //! getGyroODR() - Get the output data rate of the gyro (and the FIFO) in Hz
+    float getGyroODR();
         
 
 protected:  
@@ -755,9 +811,9 @@ protected:
     //  - * dest = A pointer to an array of uint8_t's. Values read will be
     //      stored in here on return.
     //  - count = The number of bytes to be read.
-    // Output: No value is returned, but the `dest` array will store
-    //  the data read upon exit.
-    void xgReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count);
+    // Output: The number of bytes read, 0 if the read failed. The `dest`
+    //  array will store the data read upon exit.
+    uint8_t xgReadBytes(uint8_t subAddress, uint8_t * dest, uint8_t count);
     
     // xmWriteByte() -- Write a byte to a register in the accel/mag sensor.
     // Input:
@@ -851,10 +907,20 @@ protected:
     uint8_t I2CreadBytes(uint8_t address, uint8_t subAddress, uint8_t * dest, uint8_t count);
     
 private:
-    I2C i2c;
+    I2CBus* i2cBus;
+    bool ownsI2CBus; // acquired with the pins, released in the destructor
+    ThreadFlag i2cFlag;
     float gyroX, gyroY, gyroZ; // x, y, and z axis readings of the gyroscope (float value)
     float accX, accY, accZ; // x, y, and z axis readings of the accelerometer (float value)
     float magX, magY, magZ; // x, y, and z axis readings of the magnetometer (float value)
+    // scale from raw values to gyro x, y, z in rad/sec and acc x, y, z in m/sec^2, including the
+    // orientation of readGyroX() ... readAccZ()
+    float gyroAccScale[6];
+
+    // calcGyroAccScale() -- Calculate gyroAccScale, called by calcgRes() and calcaRes().
+    void calcGyroAccScale();
+    // convert one fifo sample (gyro followed by accel, 12 bytes) like updateGyro() and updateAcc()
+    void convertGyroAcc(const uint8_t* data, float* gyro, float* acc);
 };
 
 #endif  /* LSM9DS1_H_ */
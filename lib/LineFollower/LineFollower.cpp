@@ -7,23 +7,40 @@ LineFollower::LineFollower(PinName sda_pin,
                            float d_wheel,
                            float b_wheel,
                            float max_motor_vel_rps) : m_SensorBar(sda_pin, scl_pin, bar_dist, false),
+                                                      m_LineFollowerCntrl(bar_dist,
+                                                                          d_wheel,
+                                                                          b_wheel,
+                                                                          max_motor_vel_rps,
+                                                                          1.0e-6f * static_cast<float>(SensorBar::PERIOD_MUS)),
                                                       m_Thread(osPriorityAboveNormal2)
 {
-    // set default gains of the controllers
-    setRotationalVelocityGain();
-
-    // transform robot to wheel
-    float r_wheel = d_wheel / 2.0f;
-    m_Cwheel2robot << r_wheel / 2.0f,       r_wheel / 2.0f,
-                      r_wheel / b_wheel, -r_wheel / b_wheel;
+    init();
+}
 
-    m_robot_coord.setZero();
+LineFollower::LineFollower(I2CBus& i2c_bus,
+                           float bar_dist,
+                           float d_wheel,
+                           float b_wheel,
+                           float max_motor_vel_rps) : m_SensorBar(i2c_bus, bar_dist, false),
+                                                      m_LineFollowerCntrl(bar_dist,
+                                                                          d_wheel,
+                                                                          b_wheel,
+                                                                          max_motor_vel_rps,
+                                                                          1.0e-6f * static_cast<float>(SensorBar::PERIOD_MUS)),
+                                                      m_Thread(osPriorityAboveNormal2)
+{
+    init();
+}
 
-    if (r_wheel != 0.0f)
-        m_rotation_to_wheel_vel = b_wheel / (2.0f * r_wheel);
-    m_motor_vel_max_rps = max_motor_vel_rps;
-    m_wheel_vel_max_rps = m_motor_vel_max_rps;
+// Deconstructor
+LineFollower::~LineFollower()
+{
+    m_Ticker.detach();
+    m_Thread.terminate();
+}
 
+void LineFollower::init()
+{
     // start thread
     m_Thread.start(callback(this, &LineFollower::followLine));
 
@@ -31,63 +48,85 @@ LineFollower::LineFollower(PinName sda_pin,
     m_Ticker.attach(callback(this, &LineFollower::sendThreadFlag), std::chrono::microseconds{m_SensorBar.PERIOD_MUS});
 }
 
-// Deconstructor
-LineFollower::~LineFollower()
+void LineFollower::setRotationalVelocityGain(float Kp, float Kp_nl)
 {
-    m_Ticker.detach();
-    m_Thread.terminate();
+    m_LineFollowerCntrl.setRotationalVelocityGain(Kp, Kp_nl);
 }
 
-void LineFollower::setRotationalVelocityGain(float Kp, float Kp_nl)
+void LineFollower::setMaxWheelVelocityRPS(float wheel_vel_max)
 {
-    m_Kp = Kp;
-    m_Kp_nl = Kp_nl;
+    m_LineFollowerCntrl.setMaxWheelVelocityRPS(wheel_vel_max);
 }
 
-void LineFollower::setMaxWheelVelocityRPS(float wheel_vel_max)
+void LineFollower::enableLineTracker(bool enable)
 {
-    if (m_motor_vel_max_rps < wheel_vel_max) {
-        m_wheel_vel_max_rps = m_motor_vel_max_rps;
-    } else if (wheel_vel_max < 0.0f) {
-        m_wheel_vel_max_rps = 0.0f;
-    } else {
-        m_wheel_vel_max_rps = wheel_vel_max;
-    }
+    m_LineFollowerCntrl.enableLineTracker(enable);
+}
+
+LineTracker::Pattern LineFollower::getLinePattern() const
+{
+    return m_LineFollowerCntrl.getLinePattern();
+}
+
+void LineFollower::enableSpeedScheduling(bool enable)
+{
+    m_LineFollowerCntrl.enableSpeedScheduling(enable);
+}
+
+void LineFollower::setSpeedSchedulingLimits(float acc_lat_max, float acc_max, float dec_max)
+{
+    m_LineFollowerCntrl.setSpeedSchedulingLimits(acc_lat_max, acc_max, dec_max);
+}
+
+void LineFollower::enableLapProfile(bool enable, bool start_on_crossing)
+{
+    m_LineFollowerCntrl.enableLapProfile(enable, start_on_crossing);
+}
+
+void LineFollower::startLap()
+{
+    // the lap is started in the thread, the profile is computed there as well
+    m_LineFollowerCntrl.startLap();
+}
+
+float LineFollower::getCurvature() const
+{
+    return m_LineFollowerCntrl.getCurvature();
 }
 
 float LineFollower::getAngleRadians() const
 {
-    return m_angle;
+    return m_LineFollowerCntrl.getAngleRadians();
 }
 
 float LineFollower::getAngleDegrees() const
 {
-    return m_angle * 180.0f / M_PIf;
+    return m_LineFollowerCntrl.getAngleDegrees();
 }
 
 float LineFollower::getRotationalVelocity() const
 {
-    return m_robot_coord(1);
+    return m_LineFollowerCntrl.getRotationalVelocity();
 }
 
 float LineFollower::getTranslationalVelocity() const
 {
-    return m_robot_coord(0);
+    return m_LineFollowerCntrl.getTranslationalVelocity();
 }
 
 float LineFollower::getRightWheelVelocity() const
 {
-    return m_wheel_right_velocity_rps;
+    return m_LineFollowerCntrl.getRightWheelVelocity();
 }
 
 float LineFollower::getLeftWheelVelocity() const
 {
-    return m_wheel_left_velocity_rps;
+    return m_LineFollowerCntrl.getLeftWheelVelocity();
 }
 
 bool LineFollower::isLedActive() const
 {
-    return is_any_led_active;
+    return m_LineFollowerCntrl.isLedActive();
 }
 
 // Thread task
@@ -96,54 +135,14 @@ void LineFollower::followLine()
     while (true) {
         ThisThread::flags_wait_any(m_ThreadFlag);
 
-        // update sensor bar readings
-        m_SensorBar.update();
-
-        // only update sensor bar angle if a led is triggered
-        is_any_led_active = m_SensorBar.isAnyLedActive();
-        if (is_any_led_active) {
-            m_angle = m_SensorBar.getAvgAngleRad();
-        }
-
-        // control algorithm in robot velocities
-        m_robot_coord(1) = ang_cntrl_fcn(m_Kp, m_Kp_nl, m_angle);
-        m_robot_coord(0) = vel_cntrl_fcn(m_wheel_vel_max_rps * 2 * M_PIf,
-                                         m_rotation_to_wheel_vel,
-                                         m_robot_coord(1),
-                                         m_Cwheel2robot);
+        // only the raw reading, the decoding and averaging happen once in the controller
+        const uint8_t raw = m_SensorBar.readRaw();
 
-        // map robot velocities to wheel velocities in rad/sec
-        Eigen::Vector2f wheel_speed = m_Cwheel2robot.inverse() * m_robot_coord;
-
-        // setpoints for the dc-motors in rps
-        m_wheel_right_velocity_rps = wheel_speed(0) / (2.0f * M_PIf);
-        m_wheel_left_velocity_rps = wheel_speed(1) / (2.0f * M_PIf);
+        // control algorithm, angle estimation and wheel velocities
+        m_LineFollowerCntrl.update(raw);
     }
 }
 
-float LineFollower::ang_cntrl_fcn(float Kp, float Kp_nl, float angle)
-{
-    return Kp * angle + Kp_nl * copysignf(angle * angle, angle);
-}
-
-float LineFollower::vel_cntrl_fcn(float wheel_vel_max,
-                                  float rotation_to_wheel_vel,
-                                  float robot_ang_vel,
-                                  Eigen::Matrix2f Cwheel2robot)
-{
-    Eigen::Matrix<float, 2, 1> wheel_speed;
-    if (robot_ang_vel > 0.0f) {
-        wheel_speed(0) = wheel_vel_max;
-        wheel_speed(1) = wheel_vel_max - 2.0f * rotation_to_wheel_vel * robot_ang_vel;
-    } else {
-        wheel_speed(0) = wheel_vel_max + 2.0f * rotation_to_wheel_vel * robot_ang_vel;
-        wheel_speed(1) = wheel_vel_max;
-    }
-    Eigen::Matrix<float, 2, 1> robot_coord = Cwheel2robot * wheel_speed;
-
-    return robot_coord(0);
-}
-
 void LineFollower::sendThreadFlag()
 {
     // set the thread flag to trigger the thread task
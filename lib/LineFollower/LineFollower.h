@@ -3,16 +3,9 @@
 
 #include "mbed.h"
 
-#include <math.h>
-
+#include "LineFollowerCntrl.h"
 #include "SensorBar.h"
 
-#include <Eigen/Dense>
-
-#ifndef M_PIf
-    #define M_PIf 3.14159265358979323846f // pi
-#endif
-
 class LineFollower
 {
 public:
@@ -33,6 +26,21 @@ public:
                           float b_wheel,
                           float max_motor_vel_rps);
 
+    /**
+     * @brief Construct a new Line Follower object on a shared I2C bus.
+     *
+     * @param i2c_bus Shared I2C bus, e.g. also used by the IMU.
+     * @param bar_dist Distance between sensor bar and wheelbase in meters.
+     * @param d_wheel Diameter of the wheels in meters.
+     * @param b_wheel Wheelbase (distance between the wheels) in meters.
+     * @param max_motor_vel_rps Maximum motor velocity in rotations per second.
+     */
+    explicit LineFollower(I2CBus& i2c_bus,
+                          float bar_dist,
+                          float d_wheel,
+                          float b_wheel,
+                          float max_motor_vel_rps);
+
     /**
      * @brief Destroy the Line Follower object.
      */
@@ -53,6 +61,66 @@ public:
      */
     void setMaxWheelVelocityRPS(float wheel_vel_max);
 
+    /**
+     * @brief Use the line tracking estimator instead of the averaged sensor bar angle.
+     *
+     * The estimator fuses the sensor bar with the commanded robot velocities, has less lag than
+     * the average filter and keeps predicting the angle through short gaps in the line.
+     *
+     * @param enable True to use the estimator.
+     */
+    void enableLineTracker(bool enable = true);
+
+    /**
+     * @brief Get the pattern (line, gap, branch, fork, crossing, ...) seen by the sensor bar.
+     *
+     * @return LineTracker::Pattern Classified pattern, only valid if the line tracker is enabled.
+     */
+    LineTracker::Pattern getLinePattern() const;
+
+    /**
+     * @brief Schedule the translational velocity according to the curvature of the path.
+     *
+     * By default the outer wheel always runs at the max. wheel velocity. With speed scheduling
+     * the translational velocity is limited so that the lateral acceleration stays below
+     * acc_lat_max and it changes with at most acc_max and dec_max, see setSpeedSchedulingLimits().
+     *
+     * @param enable True to use the speed scheduling.
+     */
+    void enableSpeedScheduling(bool enable = true);
+
+    /**
+     * @brief Set the limits of the speed scheduling.
+     *
+     * @param acc_lat_max Max. lateral acceleration in m/s^2.
+     * @param acc_max Max. translational acceleration in m/s^2.
+     * @param dec_max Max. translational deceleration in m/s^2.
+     */
+    void setSpeedSchedulingLimits(float acc_lat_max = 2.0f, float acc_max = 2.0f, float dec_max = 4.0f);
+
+    /**
+     * @brief Record the curvature over the first lap and replay a speed profile on later laps.
+     *
+     * Needs the speed scheduling. The lap starts with startLap() or, if start_on_crossing is true
+     * and the line tracker is enabled, whenever the sensor bar detects a crossing (start / finish line).
+     *
+     * @param enable True to use the lap profile.
+     * @param start_on_crossing True to start a lap at every crossing.
+     */
+    void enableLapProfile(bool enable = true, bool start_on_crossing = false);
+
+    /**
+     * @brief Mark the start / finish of a lap, the first call starts the recording.
+     */
+    void startLap();
+
+    /**
+     * @brief Get the estimated curvature of the path used by the speed scheduling.
+     *
+     * @return float Curvature in 1/m.
+     */
+    float getCurvature() const;
+
     /**
      * @brief Get the angle in radians.
      *
@@ -105,39 +173,17 @@ public:
 
 
 private:
-    // rotational velocity controller
-    float m_Kp;
-    float m_Kp_nl;
-
-    // TODO: proper comments
-    float m_rotation_to_wheel_vel;
-    float m_motor_vel_max_rps;
-    float m_wheel_vel_max_rps;
-
-    // wheels velocities
-    float m_wheel_left_velocity_rps{0.0f};
-    float m_wheel_right_velocity_rps{0.0f};
-
-    // angle line sensor
-    float m_angle{0.0};
-    bool is_any_led_active{false};
-
     SensorBar m_SensorBar;
 
-    Eigen::Matrix2f m_Cwheel2robot; // transforms robot to wheel coordinates
-    Eigen::Vector2f m_robot_coord;  // contains w and v (robot rot. and trans. velocities)
+    // control algorithm, runs in the thread (does not depend on mbed, see LineFollowerCntrl.h)
+    LineFollowerCntrl m_LineFollowerCntrl;
 
     // thread objects
     Thread m_Thread;
     Ticker m_Ticker;
     ThreadFlag m_ThreadFlag;
 
-    // velocity controller functions
-    float ang_cntrl_fcn(float Kp, float Kp_nl, float angle);
-    float vel_cntrl_fcn(float wheel_vel_max,
-                        float rotation_to_wheel_vel,
-                        float robot_ang_vel,
-                        Eigen::Matrix2f Cwheel2robot);
+    void init();
 
     // thread functions
     void followLine();
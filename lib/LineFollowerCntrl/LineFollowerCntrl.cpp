@@ -0,0 +1,233 @@
+#include "LineFollowerCntrl.h"
+
+constexpr SensorBarDecodeTable LineFollowerCntrl::m_decode_table;
+
+LineFollowerCntrl::LineFollowerCntrl(float bar_dist,
+                                     float d_wheel,
+                                     float b_wheel,
+                                     float max_motor_vel_rps,
+                                     float Ts) : m_LineTracker(bar_dist, Ts),
+                                                 m_SpeedScheduler(Ts, bar_dist)
+{
+    // set default gains of the controllers
+    setRotationalVelocityGain();
+
+    // transform robot to wheel
+    float r_wheel = d_wheel / 2.0f;
+    m_Cwheel2robot << r_wheel / 2.0f,       r_wheel / 2.0f,
+                      r_wheel / b_wheel, -r_wheel / b_wheel;
+    m_Crobot2wheel = m_Cwheel2robot.inverse();
+
+    if (r_wheel != 0.0f)
+        m_rotation_to_wheel_vel = b_wheel / (2.0f * r_wheel);
+    m_motor_vel_max_rps = max_motor_vel_rps;
+    m_wheel_vel_max_rps = m_motor_vel_max_rps;
+
+    // angle per raw value, same as SensorBar::getAngleRad()
+    for (int raw = 0; raw < 256; raw++) {
+        const float position = static_cast<float>(m_decode_table.binaryPosition[raw]) / 127.0f * 0.0445f; // 0.0445 m is half of sensor length
+        m_angle_table[raw] = atan2f(position, bar_dist);
+    }
+    m_avg_filter.init(10);
+
+    reset();
+}
+
+void LineFollowerCntrl::reset()
+{
+    m_robot_coord.setZero();
+    m_wheel_left_velocity_rps = m_wheel_right_velocity_rps = 0.0f;
+    m_avg_filter.reset();
+    m_is_first_avg = true;
+    m_angle = 0.0f;
+    is_any_led_active = false;
+    m_LineTracker.reset();
+    m_SpeedScheduler.reset();
+    m_start_lap_request = false;
+    m_pattern_last = LineTracker::Pattern::LOST;
+}
+
+void LineFollowerCntrl::setRotationalVelocityGain(float Kp, float Kp_nl)
+{
+    m_Kp = Kp;
+    m_Kp_nl = Kp_nl;
+}
+
+void LineFollowerCntrl::setMaxWheelVelocityRPS(float wheel_vel_max)
+{
+    if (m_motor_vel_max_rps < wheel_vel_max) {
+        m_wheel_vel_max_rps = m_motor_vel_max_rps;
+    } else if (wheel_vel_max < 0.0f) {
+        m_wheel_vel_max_rps = 0.0f;
+    } else {
+        m_wheel_vel_max_rps = wheel_vel_max;
+    }
+}
+
+void LineFollowerCntrl::enableLineTracker(bool enable)
+{
+    if (enable && !m_use_line_tracker)
+        m_LineTracker.reset();
+    m_use_line_tracker = enable;
+}
+
+LineTracker::Pattern LineFollowerCntrl::getLinePattern() const
+{
+    return m_LineTracker.getPattern();
+}
+
+void LineFollowerCntrl::enableSpeedScheduling(bool enable)
+{
+    if (enable && !m_use_speed_scheduler)
+        m_SpeedScheduler.reset();
+    m_use_speed_scheduler = enable;
+}
+
+void LineFollowerCntrl::setSpeedSchedulingLimits(float acc_lat_max, float acc_max, float dec_max)
+{
+    m_SpeedScheduler.setLimits(acc_lat_max, acc_max, dec_max);
+}
+
+void LineFollowerCntrl::enableLapProfile(bool enable, bool start_on_crossing)
+{
+    m_SpeedScheduler.enableLapProfile(enable);
+    m_start_lap_on_crossing = start_on_crossing;
+}
+
+void LineFollowerCntrl::startLap()
+{
+    // the profile is computed in update()
+    m_start_lap_request = true;
+}
+
+float LineFollowerCntrl::getCurvature() const
+{
+    return m_SpeedScheduler.getCurvature();
+}
+
+void LineFollowerCntrl::update(uint8_t raw)
+{
+    // averaged sensor bar angle, the average filter is reset whenever the line is lost
+    is_any_led_active = m_decode_table.nrOfLedsActive[raw] != 0;
+    if (!is_any_led_active) {
+        if (!m_is_first_avg) {
+            m_avg_filter.reset();
+            m_is_first_avg = true;
+        }
+    } else {
+        const float angle = m_angle_table[raw];
+        if (m_is_first_avg) {
+            m_is_first_avg = false;
+            m_avg_filter.reset(angle);
+        }
+        m_avg_filter.apply(angle);
+    }
+
+    // only update sensor bar angle if a led is triggered
+    if (m_use_line_tracker) {
+        // fuse the sensor bar with the velocities commanded in the last step, the estimate is
+        // predicted through short gaps and only held once the line is lost
+        m_LineTracker.update(raw, m_robot_coord(0), m_robot_coord(1));
+        if (m_LineTracker.isTracking()) {
+            m_angle = m_LineTracker.getAngleRad();
+        }
+    } else if (is_any_led_active) {
+        m_angle = m_avg_filter.read();
+    }
+
+    // start / finish of a lap, either requested or detected as a crossing
+    const LineTracker::Pattern pattern = m_LineTracker.getPattern();
+    if (m_use_line_tracker && m_start_lap_on_crossing &&
+        (pattern == LineTracker::Pattern::CROSSING) && (m_pattern_last != LineTracker::Pattern::CROSSING))
+        m_start_lap_request = true;
+    m_pattern_last = pattern;
+    if (m_start_lap_request) {
+        m_start_lap_request = false;
+        m_SpeedScheduler.startLap();
+    }
+
+    // control algorithm in robot velocities, the robot velocities of the last step are used
+    // for the curvature estimate
+    const float robot_vel_last = m_robot_coord(0);
+    const float robot_ang_vel_last = m_robot_coord(1);
+    m_robot_coord(1) = ang_cntrl_fcn(m_Kp, m_Kp_nl, m_angle);
+    m_robot_coord(0) = vel_cntrl_fcn(m_wheel_vel_max_rps * 2 * M_PIf,
+                                     m_rotation_to_wheel_vel,
+                                     m_robot_coord(1),
+                                     m_Cwheel2robot);
+    if (m_use_speed_scheduler) {
+        // vel_cntrl_fcn() returns the velocity with the outer wheel at the max. wheel velocity,
+        // this is the upper limit for the scheduled velocity
+        const float curvature = (m_use_line_tracker && m_LineTracker.isTracking()) ? m_LineTracker.getCurvature() : NAN;
+        m_robot_coord(0) = m_SpeedScheduler.update(fmaxf(m_robot_coord(0), 0.0f),
+                                                   m_angle,
+                                                   robot_vel_last,
+                                                   robot_ang_vel_last,
+                                                   curvature);
+    }
+
+    // map robot velocities to wheel velocities in rad/sec
+    Eigen::Vector2f wheel_speed = m_Crobot2wheel * m_robot_coord;
+
+    // setpoints for the dc-motors in rps
+    m_wheel_right_velocity_rps = wheel_speed(0) / (2.0f * M_PIf);
+    m_wheel_left_velocity_rps = wheel_speed(1) / (2.0f * M_PIf);
+}
+
+float LineFollowerCntrl::getAngleRadians() const
+{
+    return m_angle;
+}
+
+float LineFollowerCntrl::getAngleDegrees() const
+{
+    return m_angle * 180.0f / M_PIf;
+}
+
+float LineFollowerCntrl::getRotationalVelocity() const
+{
+    return m_robot_coord(1);
+}
+
+float LineFollowerCntrl::getTranslationalVelocity() const
+{
+    return m_robot_coord(0);
+}
+
+float LineFollowerCntrl::getRightWheelVelocity() const
+{
+    return m_wheel_right_velocity_rps;
+}
+
+float LineFollowerCntrl::getLeftWheelVelocity() const
+{
+    return m_wheel_left_velocity_rps;
+}
+
+bool LineFollowerCntrl::isLedActive() const
+{
+    return is_any_led_active;
+}
+
+float LineFollowerCntrl::ang_cntrl_fcn(float Kp, float Kp_nl, float angle)
+{
+    return Kp * angle + Kp_nl * copysignf(angle * angle, angle);
+}
+
+float LineFollowerCntrl::vel_cntrl_fcn(float wheel_vel_max,
+                                       float rotation_to_wheel_vel,
+                                       float robot_ang_vel,
+                                       Eigen::Matrix2f Cwheel2robot)
+{
+    Eigen::Matrix<float, 2, 1> wheel_speed;
+    if (robot_ang_vel > 0.0f) {
+        wheel_speed(0) = wheel_vel_max;
+        wheel_speed(1) = wheel_vel_max - 2.0f * rotation_to_wheel_vel * robot_ang_vel;
+    } else {
+        wheel_speed(0) = wheel_vel_max + 2.0f * rotation_to_wheel_vel * robot_ang_vel;
+        wheel_speed(1) = wheel_vel_max;
+    }
+    Eigen::Matrix<float, 2, 1> robot_coord = Cwheel2robot * wheel_speed;
+
+    return robot_coord(0);
+}
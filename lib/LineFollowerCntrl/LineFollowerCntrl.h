@@ -0,0 +1,131 @@
+/**
+ * @file LineFollowerCntrl.h
+ * @brief Defines the LineFollowerCntrl class, the control algorithm of the LineFollower.
+ *
+ * The LineFollowerCntrl class contains everything the LineFollower thread does with a raw
+ * sensor bar reading: decoding and averaging of the angle, the optional LineTracker, the
+ * rotational velocity controller, the translational velocity (max. wheel velocity or
+ * SpeedScheduler) and the mapping to the wheel velocities.
+ *
+ * The class does not depend on mbed, so the same code runs on the robot (inside the
+ * LineFollower thread) and in the host side line follower simulator (docs/cpp/line_follower_sim).
+ *
+ * @usage
+ * ```
+ * LineFollowerCntrl line_follower_cntrl(bar_dist, d_wheel, b_wheel, max_motor_vel_rps, Ts);
+ * // every sample
+ * line_follower_cntrl.update(sensor_bar.readRaw());
+ * motor_M1.setVelocity(line_follower_cntrl.getRightWheelVelocity());
+ * motor_M2.setVelocity(line_follower_cntrl.getLeftWheelVelocity());
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef LINE_FOLLOWER_CNTRL_H_
+#define LINE_FOLLOWER_CNTRL_H_
+
+#include <math.h>
+
+#include "AvgFilter.h"
+#include "LineTracker.h"
+#include "SensorBarDecodeTable.h"
+#include "SpeedScheduler.h"
+
+#include <Eigen/Dense>
+
+#ifndef M_PIf
+    #define M_PIf 3.14159265358979323846f // pi
+#endif
+
+class LineFollowerCntrl
+{
+public:
+    /**
+     * @param bar_dist Distance between sensor bar and wheelbase in meters.
+     * @param d_wheel Diameter of the wheels in meters.
+     * @param b_wheel Wheelbase (distance between the wheels) in meters.
+     * @param max_motor_vel_rps Maximum motor velocity in rotations per second.
+     * @param Ts Sampling time in seconds.
+     */
+    explicit LineFollowerCntrl(float bar_dist,
+                               float d_wheel,
+                               float b_wheel,
+                               float max_motor_vel_rps,
+                               float Ts);
+    ~LineFollowerCntrl() = default;
+
+    void reset();
+
+    void setRotationalVelocityGain(float Kp = 2.0f, float Kp_nl = 17.0f);
+    void setMaxWheelVelocityRPS(float wheel_vel_max);
+
+    void enableLineTracker(bool enable = true);
+    LineTracker::Pattern getLinePattern() const;
+
+    void enableSpeedScheduling(bool enable = true);
+    void setSpeedSchedulingLimits(float acc_lat_max = 2.0f, float acc_max = 2.0f, float dec_max = 4.0f);
+    void enableLapProfile(bool enable = true, bool start_on_crossing = false);
+    // can be called from another thread, the lap is started with the next update()
+    void startLap();
+    float getCurvature() const;
+
+    // one control step with the raw sensor bar reading (bit 0 is the rightmost led)
+    void update(uint8_t raw);
+
+    float getAngleRadians() const;
+    float getAngleDegrees() const;
+    float getRotationalVelocity() const;
+    float getTranslationalVelocity() const;
+    float getRightWheelVelocity() const;
+    float getLeftWheelVelocity() const;
+    bool isLedActive() const;
+
+private:
+    // rotational velocity controller
+    float m_Kp;
+    float m_Kp_nl;
+
+    // wheel velocity difference per robot rotational velocity, b_wheel / (2 * r_wheel)
+    float m_rotation_to_wheel_vel{0.0f};
+    // max. velocity of the motors and the max. wheel velocity that is used (setMaxWheelVelocityRPS())
+    float m_motor_vel_max_rps;
+    float m_wheel_vel_max_rps;
+
+    // wheels velocities
+    float m_wheel_left_velocity_rps{0.0f};
+    float m_wheel_right_velocity_rps{0.0f};
+
+    // angle line sensor, same decoding and averaging as the SensorBar
+    static constexpr SensorBarDecodeTable m_decode_table{};
+    float m_angle_table[256];
+    AvgFilter m_avg_filter;
+    bool m_is_first_avg{true};
+    float m_angle{0.0f};
+    bool is_any_led_active{false};
+
+    // line tracking estimator
+    LineTracker m_LineTracker;
+    bool m_use_line_tracker{false};
+
+    // curvature aware speed scheduling
+    SpeedScheduler m_SpeedScheduler;
+    bool m_use_speed_scheduler{false};
+    bool m_start_lap_on_crossing{false};
+    volatile bool m_start_lap_request{false};
+    LineTracker::Pattern m_pattern_last{LineTracker::Pattern::LOST};
+
+    Eigen::Matrix2f m_Cwheel2robot; // transforms robot to wheel coordinates
+    Eigen::Matrix2f m_Crobot2wheel; // inverse of m_Cwheel2robot
+    Eigen::Vector2f m_robot_coord;  // contains v and w (robot trans. and rot. velocities)
+
+    // velocity controller functions
+    float ang_cntrl_fcn(float Kp, float Kp_nl, float angle);
+    float vel_cntrl_fcn(float wheel_vel_max,
+                        float rotation_to_wheel_vel,
+                        float robot_ang_vel,
+                        Eigen::Matrix2f Cwheel2robot);
+};
+
+#endif /* LINE_FOLLOWER_CNTRL_H_ */
@@ -0,0 +1,233 @@
+#include "LineTracker.h"
+
+LineTracker::LineTracker(float bar_dist, float Ts) : m_bar_dist(bar_dist),
+                                                     m_Ts(Ts)
+{
+    // measurement matrix, line position at the sensor bar (parabolic approximation of the line)
+    m_H << 1.0f, m_bar_dist, 0.5f * m_bar_dist * m_bar_dist;
+
+    // quantisation of the led pitch (32/127 of the half bar length) as measurement noise
+    const float led_pitch = LINE_TRACKER_HALF_BAR_LENGTH * 32.0f / 127.0f;
+    setNoise(led_pitch / sqrtf(12.0f), 0.5f, 2.0f);
+
+    reset();
+}
+
+void LineTracker::reset()
+{
+    m_x.setZero();
+    m_P.setZero();
+    m_dropout_time = 0.0f;
+    m_is_initialised = false;
+    m_num_of_rejections = 0;
+    m_pattern = m_pattern_candidate = Pattern::LOST;
+    m_pattern_cntr = 0;
+}
+
+void LineTracker::setNoise(float sigma_meas, float sigma_heading, float sigma_curvature)
+{
+    m_var_meas = sigma_meas * sigma_meas;
+    m_var_heading = sigma_heading * sigma_heading;
+    m_var_curvature = sigma_curvature * sigma_curvature;
+}
+
+void LineTracker::setMaxDropoutTime(float max_dropout_time)
+{
+    m_max_dropout_time = max_dropout_time;
+}
+
+void LineTracker::setSamplingTime(float Ts)
+{
+    m_Ts = Ts;
+}
+
+void LineTracker::update(uint8_t raw, float v, float w)
+{
+    if (m_is_initialised)
+        predict(v, w);
+
+    Group groups[LINE_TRACKER_NUM_OF_GROUPS_MAX];
+    const uint8_t num_of_groups = findGroups(raw, groups);
+
+    Pattern pattern;
+    if (num_of_groups == 0) {
+        // keep predicting through short gaps
+        m_dropout_time += m_Ts;
+        if (m_is_initialised && (m_dropout_time > m_max_dropout_time))
+            m_is_initialised = false;
+        pattern = m_is_initialised ? Pattern::GAP : Pattern::LOST;
+    } else {
+        m_dropout_time = 0.0f;
+        pattern = classify(groups, num_of_groups, raw);
+
+        if (pattern == Pattern::LINE) {
+            if (m_is_initialised)
+                correct(groups[0].position);
+            else
+                initialise(groups[0].position);
+        } else if ((pattern == Pattern::FORK) && m_is_initialised) {
+            // follow the branch that is closest to the prediction
+            const float position_predicted = getPositionAtBar();
+            uint8_t idx = 0;
+            for (uint8_t i = 1; i < num_of_groups; i++) {
+                if (fabsf(groups[i].position - position_predicted) < fabsf(groups[idx].position - position_predicted))
+                    idx = i;
+            }
+            correct(groups[idx].position);
+        }
+        // branches and crossings only predict, their centroid is biased by the branch
+    }
+
+    setPattern(pattern);
+}
+
+float LineTracker::getLateralOffset() const
+{
+    return m_x(0);
+}
+
+float LineTracker::getHeading() const
+{
+    return m_x(1);
+}
+
+float LineTracker::getCurvature() const
+{
+    return m_x(2);
+}
+
+float LineTracker::getPositionAtBar() const
+{
+    return m_H * m_x;
+}
+
+float LineTracker::getAngleRad() const
+{
+    return atan2f(getPositionAtBar(), m_bar_dist);
+}
+
+bool LineTracker::isTracking() const
+{
+    return m_is_initialised;
+}
+
+LineTracker::Pattern LineTracker::getPattern() const
+{
+    return m_pattern;
+}
+
+void LineTracker::predict(float v, float w)
+{
+    const float vTs = v * m_Ts;
+
+    // x_k+1 = F * x_k + [0; -w * Ts; 0]
+    Eigen::Matrix3f F;
+    F << 1.0f,  vTs, 0.0f,
+         0.0f, 1.0f,  vTs,
+         0.0f, 0.0f, 1.0f;
+    m_x = F * m_x;
+    m_x(1) -= w * m_Ts;
+
+    // heading noise covers wheel slip and the lag of the wheel velocity controllers,
+    // curvature noise scales with the travelled distance
+    m_P = F * m_P * F.transpose();
+    m_P(1, 1) += m_var_heading * m_Ts;
+    m_P(2, 2) += m_var_curvature * fabsf(vTs);
+}
+
+bool LineTracker::correct(float position)
+{
+    const float innovation = position - m_H * m_x;
+    const Eigen::Vector3f PHt = m_P * m_H.transpose();
+    const float S = m_H * PHt + m_var_meas;
+
+    // reject outliers (4 sigma), but re-initialise if the line is consistently somewhere else
+    if (innovation * innovation > 16.0f * S) {
+        if (++m_num_of_rejections >= 10)
+            initialise(position);
+        return false;
+    }
+    m_num_of_rejections = 0;
+
+    const Eigen::Vector3f K = PHt / S;
+    m_x += K * innovation;
+    m_P -= K * PHt.transpose();
+
+    return true;
+}
+
+void LineTracker::initialise(float position)
+{
+    m_x << position, 0.0f, 0.0f;
+    m_P.setZero();
+    m_P(0, 0) = m_var_meas;
+    m_P(1, 1) = 0.3f * 0.3f;
+    m_P(2, 2) = 5.0f * 5.0f;
+    m_num_of_rejections = 0;
+    m_is_initialised = true;
+}
+
+uint8_t LineTracker::findGroups(uint8_t raw, Group* groups) const
+{
+    uint8_t num_of_groups = 0;
+    uint8_t bit = 0;
+    while ((bit < 8) && (num_of_groups < LINE_TRACKER_NUM_OF_GROUPS_MAX)) {
+        if (((raw >> bit) & 0x01) == 0) {
+            bit++;
+            continue;
+        }
+        Group& group = groups[num_of_groups++];
+        group.first_bit = bit;
+        float position_sum = 0.0f;
+        while ((bit < 8) && (((raw >> bit) & 0x01) == 1)) {
+            position_sum += ledPosition(bit);
+            bit++;
+        }
+        group.last_bit = bit - 1;
+        group.position = position_sum / static_cast<float>(group.last_bit - group.first_bit + 1);
+    }
+    return num_of_groups;
+}
+
+LineTracker::Pattern LineTracker::classify(const Group* groups, uint8_t num_of_groups, uint8_t raw) const
+{
+    uint8_t nr_of_leds_active = 0;
+    for (uint8_t bit = 0; bit < 8; bit++)
+        nr_of_leds_active += (raw >> bit) & 0x01;
+
+    if (nr_of_leds_active >= 6)
+        return Pattern::CROSSING;
+    if (num_of_groups >= 2)
+        return Pattern::FORK;
+
+    // a single group that is wider than a line (max. 3 leds) and reaches the end of the bar
+    const Group& group = groups[0];
+    if (group.last_bit - group.first_bit + 1 >= 4) {
+        if (group.last_bit == 7)
+            return Pattern::BRANCH_LEFT;
+        if (group.first_bit == 0)
+            return Pattern::BRANCH_RIGHT;
+    }
+    return Pattern::LINE;
+}
+
+void LineTracker::setPattern(Pattern pattern)
+{
+    // junctions have to be seen twice in a row, line, gap and lost are reported immediately
+    if (pattern == m_pattern_candidate) {
+        if (m_pattern_cntr < 255)
+            m_pattern_cntr++;
+    } else {
+        m_pattern_candidate = pattern;
+        m_pattern_cntr = 1;
+    }
+    if ((pattern == Pattern::LINE) || (pattern == Pattern::GAP) || (pattern == Pattern::LOST) || (m_pattern_cntr >= 2))
+        m_pattern = pattern;
+}
+
+float LineTracker::ledPosition(uint8_t bit)
+{
+    // same weights as the SensorBar decoding, bit 0 is the rightmost and bit 7 the leftmost led
+    const float weight = (bit > 3) ? static_cast<float>((-32 * (bit - 3)) + 1) : static_cast<float>((32 * (4 - bit)) - 1);
+    return -weight / 127.0f * LINE_TRACKER_HALF_BAR_LENGTH;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file LineTracker.h
+ * @brief Defines the LineTracker class, a tracking estimator for the line seen by the SensorBar.
+ *
+ * The LineTracker fuses consecutive raw SensorBar readings with the commanded robot
+ * velocities in a small Kalman filter. The state describes the line relative to the robot:
+ * - lateral position of the line at the wheel axis (m, positive to the left)
+ * - heading of the line relative to the robot (rad, positive to the left)
+ * - curvature of the line (1/m, positive for a left bend)
+ *
+ * The model is d_dot = v * theta, theta_dot = v * kappa - w, kappa_dot = 0 and the sensor bar
+ * measures d + L * theta + L^2 / 2 * kappa, where L is the distance from the wheel axis
+ * to the sensor bar. Because the filter integrates the motion between samples, the lateral
+ * position gets a resolution finer than the led pitch, and the estimate keeps being
+ * predicted through short dropouts (gaps in the line).
+ *
+ * In addition the raw bit pattern is classified (line, gap, lost, branch, fork, crossing).
+ * Only plain line patterns and the group closest to the prediction of a fork are used as
+ * measurement.
+ *
+ * The class does not depend on mbed, so it can also be used in host side tools.
+ *
+ * @usage
+ * ```
+ * LineTracker line_tracker(bar_dist, Ts);
+ * // every sample (e.g. at the 250 Hz SensorBar rate)
+ * line_tracker.update(sensor_bar.getRaw(), v, w);
+ * if (line_tracker.isTracking())
+ *     angle = line_tracker.getAngleRad();
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef LINE_TRACKER_H_
+#define LINE_TRACKER_H_
+
+#include <Eigen/Dense>
+
+#include <math.h>
+#include <stdint.h>
+
+#define LINE_TRACKER_HALF_BAR_LENGTH 0.0445f // m, distance from the center to the outermost led
+#define LINE_TRACKER_NUM_OF_GROUPS_MAX 4
+
+class LineTracker
+{
+public:
+    enum class Pattern : uint8_t {
+        LOST = 0,     // no line since longer than the max. dropout time
+        GAP,          // no line, estimate is predicted
+        LINE,         // single narrow group of leds
+        BRANCH_LEFT,  // wide group that touches the left end of the bar
+        BRANCH_RIGHT, // wide group that touches the right end of the bar
+        FORK,         // two or more separated groups
+        CROSSING      // (almost) all leds active
+    };
+
+    explicit LineTracker(float bar_dist, float Ts);
+    ~LineTracker() = default;
+
+    void reset();
+
+    // standard deviations of the measurement (m), heading process noise (rad/sqrt(s)) and
+    // curvature process noise (1/m per sqrt(m) travelled)
+    void setNoise(float sigma_meas, float sigma_heading, float sigma_curvature);
+    void setMaxDropoutTime(float max_dropout_time);
+    void setSamplingTime(float Ts);
+
+    // one filter step, raw sensor bar value and commanded robot velocities (v in m/s, w in rad/s)
+    void update(uint8_t raw, float v, float w);
+
+    float getLateralOffset() const;
+    float getHeading() const;
+    float getCurvature() const;
+    // estimated line position at the sensor bar (m, positive to the left)
+    float getPositionAtBar() const;
+    // same definition as SensorBar::getAngleRad()
+    float getAngleRad() const;
+    bool isTracking() const;
+    Pattern getPattern() const;
+
+private:
+    float m_bar_dist;
+    float m_Ts;
+
+    Eigen::Vector3f m_x; // [lateral offset, heading, curvature]
+    Eigen::Matrix3f m_P;
+    Eigen::RowVector3f m_H;
+
+    float m_var_meas{0.0f};
+    float m_var_heading{0.0f};
+    float m_var_curvature{0.0f};
+
+    float m_max_dropout_time{0.3f};
+    float m_dropout_time{0.0f};
+    bool m_is_initialised{false};
+    uint8_t m_num_of_rejections{0};
+
+    Pattern m_pattern{Pattern::LOST};
+    Pattern m_pattern_candidate{Pattern::LOST};
+    uint8_t m_pattern_cntr{0};
+
+    struct Group {
+        uint8_t first_bit;
+        uint8_t last_bit;
+        float position; // centroid in m, positive to the left
+    };
+
+    void predict(float v, float w);
+    bool correct(float position);
+    void initialise(float position);
+    uint8_t findGroups(uint8_t raw, Group* groups) const;
+    Pattern classify(const Group* groups, uint8_t num_of_groups, uint8_t raw) const;
+    void setPattern(Pattern pattern);
+    static float ledPosition(uint8_t bit);
+};
+
+#endif /* LINE_TRACKER_H_ */
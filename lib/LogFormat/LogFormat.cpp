@@ -0,0 +1,499 @@
+#include "LogFormat.h"
+
+#include <math.h>
+#include <string.h>
+
+uint8_t logTypeSize(uint8_t type)
+{
+    switch (type) {
+        case LOG_TYPE_INT8:
+            return 1;
+        case LOG_TYPE_INT16:
+            return 2;
+        case LOG_TYPE_INT32:
+        case LOG_TYPE_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+uint32_t logCrc32(const void* data, size_t size, uint32_t crc)
+{
+    // nibble table, 64 bytes of flash instead of 1 kB for the byte table
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= ptr[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+void logFinishBlock(uint8_t* block, uint8_t type, uint16_t payload_size, uint32_t seq)
+{
+    memset(&block[LOG_FORMAT_BLOCK_HEADER_SIZE + payload_size], 0, LOG_FORMAT_PAYLOAD_SIZE - payload_size);
+
+    LogBlockHeader header;
+    header.magic = LOG_FORMAT_MAGIC;
+    header.type = type;
+    header.version = LOG_FORMAT_VERSION;
+    header.payload_size = payload_size;
+    header.seq = seq;
+    header.crc = 0;
+    memcpy(block, &header, sizeof(header));
+
+    header.crc = logCrc32(block, LOG_FORMAT_BLOCK_SIZE);
+    memcpy(block, &header, sizeof(header));
+}
+
+bool logCheckBlock(const uint8_t* block)
+{
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    if ((header.magic != LOG_FORMAT_MAGIC) ||
+        (header.version == 0) || (header.version > LOG_FORMAT_VERSION) ||
+        (header.payload_size > LOG_FORMAT_PAYLOAD_SIZE))
+        return false;
+
+    // crc over the header with a zero crc field followed by the payload
+    const uint32_t crc_zero = 0;
+    uint32_t crc = logCrc32(block, offsetof(LogBlockHeader, crc));
+    crc = logCrc32(&crc_zero, sizeof(crc_zero), crc);
+    crc = logCrc32(&block[LOG_FORMAT_BLOCK_HEADER_SIZE], LOG_FORMAT_PAYLOAD_SIZE, crc);
+    return crc == header.crc;
+}
+
+uint16_t logGetBlockSession(const uint8_t* block)
+{
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    const uint8_t* payload = &block[LOG_FORMAT_BLOCK_HEADER_SIZE];
+    if ((header.type == LOG_BLOCK_SYNC) && (header.payload_size >= sizeof(LogSyncHeader))) {
+        LogSyncHeader sync_header;
+        memcpy(&sync_header, payload, sizeof(sync_header));
+        return sync_header.session;
+    }
+    // version 1 data blocks have no LogDataHeader
+    if (((header.type == LOG_BLOCK_DATA) || (header.type == LOG_BLOCK_DATA_COMPRESSED)) && (header.version >= 2) &&
+        (header.payload_size >= sizeof(LogDataHeader))) {
+        LogDataHeader data_header;
+        memcpy(&data_header, payload, sizeof(data_header));
+        return data_header.session;
+    }
+    return 0;
+}
+
+uint8_t logWriteVarint(uint8_t* dst, uint64_t value)
+{
+    uint8_t size = 0;
+    while (value >= 0x80) {
+        dst[size++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    dst[size++] = static_cast<uint8_t>(value);
+    return size;
+}
+
+uint8_t logReadVarint(const uint8_t* src, size_t size, uint64_t& value)
+{
+    value = 0;
+    for (uint8_t i = 0; (i < size) && (i < LOG_FORMAT_VARINT_SIZE_MAX); i++) {
+        value |= static_cast<uint64_t>(src[i] & 0x7F) << (7 * i);
+        if ((src[i] & 0x80) == 0)
+            return i + 1;
+    }
+    return 0;
+}
+
+uint8_t logGetVarintSize(uint64_t value)
+{
+    uint8_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+bool logParseDataBlock(const uint8_t* block, LogDataHeader& data_header, const uint8_t*& times, uint16_t& times_size,
+                       const uint8_t*& records, uint16_t& records_size)
+{
+    LogBlockHeader header;
+    memcpy(&header, block, sizeof(header));
+    const uint8_t* payload = &block[LOG_FORMAT_BLOCK_HEADER_SIZE];
+    uint16_t payload_size = header.payload_size;
+    memset(&data_header, 0, sizeof(data_header));
+    times = nullptr;
+    times_size = 0;
+
+    // version 1 data blocks have no LogDataHeader
+    if (header.version >= 2) {
+        if (payload_size < sizeof(data_header))
+            return false;
+        memcpy(&data_header, payload, sizeof(data_header));
+        payload += sizeof(data_header);
+        payload_size -= sizeof(data_header);
+    }
+    if (header.version >= 3) {
+        if (payload_size < sizeof(times_size))
+            return false;
+        memcpy(&times_size, payload, sizeof(times_size));
+        if (sizeof(times_size) + times_size > payload_size)
+            return false;
+        times = payload + sizeof(times_size);
+        payload += sizeof(times_size) + times_size;
+        payload_size -= sizeof(times_size) + times_size;
+    }
+    records = payload;
+    records_size = payload_size;
+    return true;
+}
+
+LogSchema::LogSchema()
+{
+    reset();
+}
+
+void LogSchema::reset()
+{
+    m_num_of_channels = 0;
+    m_num_of_streams = 0;
+    memset(m_record_sizes, 0, sizeof(m_record_sizes));
+    memset(m_channels, 0, sizeof(m_channels));
+}
+
+int LogSchema::addStream()
+{
+    // an empty last stream is reused
+    if ((m_num_of_streams > 0) && (m_stream_num_of_channels[m_num_of_streams - 1] == 0))
+        return m_num_of_streams - 1;
+    if (m_num_of_streams == LOG_FORMAT_NUM_OF_STREAMS_MAX)
+        return -1;
+
+    m_stream_first_channels[m_num_of_streams] = m_num_of_channels;
+    m_stream_num_of_channels[m_num_of_streams] = 0;
+    m_record_sizes[m_num_of_streams] = 0;
+    return m_num_of_streams++;
+}
+
+bool LogSchema::addChannel(const char* name, uint8_t type, const char* unit, float rate, float scale)
+{
+    const uint8_t type_size = logTypeSize(type);
+    if ((m_num_of_channels == LOG_FORMAT_NUM_OF_CHANNELS_MAX) || (type_size == 0) || (scale == 0.0f))
+        return false;
+    if (m_num_of_streams == 0)
+        addStream();
+    const uint8_t stream = m_num_of_streams - 1;
+
+    LogChannel& channel = m_channels[m_num_of_channels];
+    memset(&channel, 0, sizeof(channel));
+    strncpy(channel.name, name ? name : "", LOG_FORMAT_NAME_SIZE - 1);
+    strncpy(channel.unit, unit ? unit : "", LOG_FORMAT_UNIT_SIZE - 1);
+    channel.type = type;
+    channel.stream = stream;
+    channel.scale = scale;
+    channel.rate = rate;
+
+    m_offsets[m_num_of_channels] = m_record_sizes[stream];
+    m_inv_scales[m_num_of_channels] = 1.0f / scale;
+    m_record_sizes[stream] += type_size;
+    m_stream_num_of_channels[stream]++;
+    m_num_of_channels++;
+    return true;
+}
+
+void LogSchema::encodeValue(uint8_t* record, uint8_t channel, float value) const
+{
+    encodeRaw(record, channel, value * m_inv_scales[channel]);
+}
+
+void LogSchema::encodeValue(uint8_t* record, uint8_t channel, int32_t value) const
+{
+    // integers with scale 1 are stored exactly, also beyond the 24 bit mantissa of a float
+    if ((m_channels[channel].type == LOG_TYPE_INT32) && (m_channels[channel].scale == 1.0f)) {
+        memcpy(&record[m_offsets[channel]], &value, sizeof(value));
+        return;
+    }
+    encodeRaw(record, channel, static_cast<float>(value) * m_inv_scales[channel]);
+}
+
+void LogSchema::encodeRaw(uint8_t* record, uint8_t channel, float raw) const
+{
+    uint8_t* dst = &record[m_offsets[channel]];
+    switch (m_channels[channel].type) {
+        case LOG_TYPE_INT8: {
+            const int8_t val = static_cast<int8_t>(lrintf(fminf(fmaxf(raw, -128.0f), 127.0f)));
+            memcpy(dst, &val, sizeof(val));
+            break;
+        }
+        case LOG_TYPE_INT16: {
+            const int16_t val = static_cast<int16_t>(lrintf(fminf(fmaxf(raw, -32768.0f), 32767.0f)));
+            memcpy(dst, &val, sizeof(val));
+            break;
+        }
+        case LOG_TYPE_INT32: {
+            // 2147483520 is the largest float below 2^31
+            const int32_t val = static_cast<int32_t>(lrintf(fminf(fmaxf(raw, -2147483648.0f), 2147483520.0f)));
+            memcpy(dst, &val, sizeof(val));
+            break;
+        }
+        default: {
+            memcpy(dst, &raw, sizeof(raw));
+            break;
+        }
+    }
+}
+
+uint8_t LogSchema::getNumOfSchemaBlocks() const
+{
+    if (m_num_of_channels == 0)
+        return 1;
+    return static_cast<uint8_t>((m_num_of_channels + LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK - 1) / LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK);
+}
+
+void LogSchema::writeSchemaBlock(uint8_t* block, uint8_t index, uint32_t seq) const
+{
+    const uint8_t first_channel = static_cast<uint8_t>(index * LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK);
+    uint8_t num_of_channels_in_block = 0;
+    if (m_num_of_channels > first_channel) {
+        num_of_channels_in_block = m_num_of_channels - first_channel;
+        if (num_of_channels_in_block > LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK)
+            num_of_channels_in_block = LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK;
+    }
+
+    LogSchemaHeader schema_header;
+    schema_header.num_of_channels = m_num_of_channels;
+    schema_header.first_channel = first_channel;
+    schema_header.num_of_channels_in_block = num_of_channels_in_block;
+    schema_header.reserved = 0;
+
+    uint8_t* payload = &block[LOG_FORMAT_BLOCK_HEADER_SIZE];
+    memcpy(payload, &schema_header, sizeof(schema_header));
+    memcpy(payload + sizeof(schema_header), &m_channels[first_channel], num_of_channels_in_block * sizeof(LogChannel));
+
+    const uint16_t payload_size = static_cast<uint16_t>(sizeof(schema_header) + num_of_channels_in_block * sizeof(LogChannel));
+    logFinishBlock(block, LOG_BLOCK_SCHEMA, payload_size, seq);
+}
+
+// lowest and highest non-zero byte of the control nibbles 1 ... 10, nibble = 1 + hi * (hi + 1) / 2 + lo
+static const uint8_t compressed_lo[11] = {0, 0, 0, 1, 0, 1, 2, 0, 1, 2, 3};
+static const uint8_t compressed_hi[11] = {0, 0, 1, 1, 2, 2, 2, 3, 3, 3, 3};
+
+static inline uint32_t logWidthMask(uint8_t width)
+{
+    return (width == 4) ? 0xFFFFFFFFUL : ((1UL << (8 * width)) - 1);
+}
+
+void LogCompressor::setChannels(const LogChannel* channels, uint8_t num_of_channels)
+{
+    m_channels = channels;
+    m_num_of_channels = num_of_channels;
+    m_record_size = 0;
+    for (uint8_t i = 0; i < num_of_channels; i++)
+        m_record_size += logTypeSize(channels[i].type);
+    m_record_size_max = static_cast<uint16_t>(m_record_size + (num_of_channels + 1) / 2);
+}
+
+void LogCompressor::begin(uint8_t* payload, uint16_t capacity)
+{
+    m_payload = payload;
+    m_capacity = capacity;
+    m_payload_size = sizeof(uint16_t);
+    m_num_of_records = 0;
+    memset(m_previous, 0, m_record_size);
+    memset(m_payload, 0, sizeof(uint16_t));
+}
+
+bool LogCompressor::add(const uint8_t* record)
+{
+    if (m_payload_size + m_record_size_max > m_capacity)
+        return false;
+
+    uint8_t* control = &m_payload[m_payload_size];
+    uint8_t* dst = control + (m_num_of_channels + 1) / 2;
+    memset(control, 0, (m_num_of_channels + 1) / 2);
+
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < m_num_of_channels; i++) {
+        const uint8_t width = logTypeSize(m_channels[i].type);
+        uint32_t value = 0;
+        uint32_t previous = 0;
+        memcpy(&value, &record[offset], width);
+        memcpy(&previous, &m_previous[offset], width);
+        offset += width;
+
+        uint32_t coded;
+        if (m_channels[i].type == LOG_TYPE_FLOAT) {
+            coded = value ^ previous;
+        } else {
+            // zigzag coded difference in the width of the type, small changes of either sign give small values
+            const uint32_t mask = logWidthMask(width);
+            const uint32_t diff = (value - previous) & mask;
+            coded = ((diff << 1) ^ (((diff >> (8 * width - 1)) & 1) ? mask : 0)) & mask;
+        }
+        if (coded == 0)
+            continue;
+
+        uint8_t bytes[4];
+        memcpy(bytes, &coded, sizeof(bytes));
+        uint8_t lo = 0;
+        while (bytes[lo] == 0)
+            lo++;
+        uint8_t hi = width - 1;
+        while (bytes[hi] == 0)
+            hi--;
+        for (uint8_t b = lo; b <= hi; b++)
+            *dst++ = bytes[b];
+        const uint8_t nibble = static_cast<uint8_t>(1 + hi * (hi + 1) / 2 + lo);
+        control[i >> 1] |= static_cast<uint8_t>(nibble << ((i & 1) * 4));
+    }
+
+    memcpy(m_previous, record, m_record_size);
+    m_payload_size = static_cast<uint16_t>(dst - m_payload);
+    m_num_of_records++;
+    memcpy(m_payload, &m_num_of_records, sizeof(m_num_of_records));
+    return true;
+}
+
+void LogDataBlock::setChannels(const LogChannel* channels, uint8_t num_of_channels, bool do_compress)
+{
+    m_do_compress = do_compress;
+    m_record_size = 0;
+    for (uint8_t i = 0; i < num_of_channels; i++)
+        m_record_size += logTypeSize(channels[i].type);
+    m_LogCompressor.setChannels(channels, num_of_channels);
+    m_is_started = false;
+}
+
+void LogDataBlock::begin(uint8_t stream, uint16_t session, uint32_t first_record, uint64_t time_us)
+{
+    m_data_header.stream = stream;
+    m_data_header.reserved = 0;
+    m_data_header.session = session;
+    m_data_header.first_record = first_record;
+    m_data_header.time_us = time_us;
+    m_is_started = true;
+    m_num_of_records = 0;
+    m_time_us = time_us;
+    m_times_size = 0;
+    m_records_size = 0;
+    if (m_do_compress) {
+        m_LogCompressor.begin(m_records, sizeof(m_records));
+        m_records_size = m_LogCompressor.getPayloadSize();
+    }
+}
+
+bool LogDataBlock::add(const uint8_t* record, uint64_t time_us)
+{
+    // the first record has the time of the block, times running backwards are stored as 0
+    const uint64_t time_diff_us = ((m_num_of_records > 0) && (time_us > m_time_us)) ? time_us - m_time_us : 0;
+    const uint8_t time_size = (m_num_of_records > 0) ? logGetVarintSize(time_diff_us) : 0;
+    const uint16_t capacity = static_cast<uint16_t>(LOG_FORMAT_PAYLOAD_SIZE - sizeof(LogDataHeader) - sizeof(m_times_size) - m_times_size - time_size);
+
+    if (m_do_compress) {
+        m_LogCompressor.setCapacity(capacity);
+        if (!m_LogCompressor.add(record))
+            return false;
+        m_records_size = m_LogCompressor.getPayloadSize();
+    } else {
+        // records never span two blocks, so every valid block can be decoded on its own
+        if (m_records_size + m_record_size > capacity)
+            return false;
+        memcpy(&m_records[m_records_size], record, m_record_size);
+        m_records_size += m_record_size;
+    }
+    if (m_num_of_records > 0)
+        m_times_size += logWriteVarint(&m_times[m_times_size], time_diff_us);
+    m_time_us = time_us;
+    m_num_of_records++;
+    return true;
+}
+
+uint16_t LogDataBlock::getPayloadSize() const
+{
+    return static_cast<uint16_t>(sizeof(LogDataHeader) + sizeof(m_times_size) + m_times_size + m_records_size);
+}
+
+void LogDataBlock::finish(uint8_t* block, uint32_t seq)
+{
+    uint8_t* payload = &block[LOG_FORMAT_BLOCK_HEADER_SIZE];
+    memcpy(payload, &m_data_header, sizeof(m_data_header));
+    payload += sizeof(m_data_header);
+    memcpy(payload, &m_times_size, sizeof(m_times_size));
+    payload += sizeof(m_times_size);
+    memcpy(payload, m_times, m_times_size);
+    memcpy(payload + m_times_size, m_records, m_records_size);
+    logFinishBlock(block, m_do_compress ? LOG_BLOCK_DATA_COMPRESSED : LOG_BLOCK_DATA, getPayloadSize(), seq);
+    m_is_started = false;
+}
+
+size_t logGetNumOfCompressedRecords(const uint8_t* payload, uint16_t payload_size)
+{
+    uint16_t num_of_records = 0;
+    if (payload_size >= sizeof(num_of_records))
+        memcpy(&num_of_records, payload, sizeof(num_of_records));
+    return num_of_records;
+}
+
+size_t logDecompressBlock(const LogChannel* channels, uint8_t num_of_channels, const uint8_t* payload, uint16_t payload_size,
+                          uint8_t* records, size_t max_records)
+{
+    const size_t num_of_records = logGetNumOfCompressedRecords(payload, payload_size);
+    if ((num_of_records == 0) || (num_of_records > max_records))
+        return 0;
+
+    uint16_t record_size = 0;
+    for (uint8_t i = 0; i < num_of_channels; i++)
+        record_size += logTypeSize(channels[i].type);
+    const size_t control_size = (num_of_channels + 1) / 2;
+
+    const uint8_t* src = payload + sizeof(uint16_t);
+    const uint8_t* end = payload + payload_size;
+    for (size_t r = 0; r < num_of_records; r++) {
+        uint8_t* record = &records[r * record_size];
+        const uint8_t* previous = (r > 0) ? record - record_size : nullptr;
+        if (src + control_size > end)
+            return 0;
+        const uint8_t* control = src;
+        src += control_size;
+
+        uint16_t offset = 0;
+        for (uint8_t i = 0; i < num_of_channels; i++) {
+            const uint8_t width = logTypeSize(channels[i].type);
+            const uint8_t nibble = (control[i >> 1] >> ((i & 1) * 4)) & 0x0F;
+            uint32_t coded = 0;
+            if (nibble != 0) {
+                if ((nibble > 10) || (compressed_hi[nibble] >= width))
+                    return 0;
+                const uint8_t lo = compressed_lo[nibble];
+                const uint8_t size = compressed_hi[nibble] - lo + 1;
+                if (src + size > end)
+                    return 0;
+                uint8_t bytes[4] = {0, 0, 0, 0};
+                memcpy(&bytes[lo], src, size);
+                src += size;
+                memcpy(&coded, bytes, sizeof(coded));
+            }
+
+            uint32_t value = 0;
+            if (previous)
+                memcpy(&value, &previous[offset], width);
+            if (channels[i].type == LOG_TYPE_FLOAT) {
+                value ^= coded;
+            } else {
+                const uint32_t mask = logWidthMask(width);
+                const uint32_t diff = (coded >> 1) ^ ((coded & 1) ? mask : 0);
+                value = (value + diff) & mask;
+            }
+            memcpy(&record[offset], &value, width);
+            offset += width;
+        }
+    }
+    return (src == end) ? num_of_records : 0;
+}
@@ -0,0 +1,333 @@
+/**
+ * @file LogFormat.h
+ * @brief Defines the self describing binary log format of the SDLogger and the LogSchema class.
+ *
+ * A log file is a sequence of blocks of LOG_FORMAT_BLOCK_SIZE (512) bytes, one block is one
+ * sector of the SD card. Every block starts with a LogBlockHeader (magic, block type, format
+ * version, used payload size, sequence number, CRC32 over the whole block with the crc field
+ * set to zero), the unused rest of the payload is zero. A corrupt or short write therefore only
+ * affects its own blocks, a reader skips blocks with a wrong magic or CRC and detects lost blocks
+ * by gaps in the sequence numbers.
+ *
+ * - schema blocks (at the start of the file): a LogSchemaHeader followed by LogChannel entries
+ *   (name, unit, type int8/int16/int32/float, scale, rate, stream), the channels can span several
+ *   schema blocks
+ * - streams: the channels are grouped into up to LOG_FORMAT_NUM_OF_STREAMS_MAX streams with their
+ *   own rate and record layout, e.g. the motor signals at 1 kHz and the battery voltage at 10 Hz,
+ *   the channels of a stream are contiguous in the schema
+ * - data blocks: a LogDataHeader (stream, session, index of the first record of the stream in the
+ *   block, time of the first record in us) followed by the record times and whole records of this
+ *   stream only, a record is the channels of the stream in schema order, packed without padding,
+ *   little endian, the physical value is raw * scale, the blocks of the streams are interleaved in
+ *   the file
+ * - record times (version 3): a uint16 size of the time section, then the time of every record but
+ *   the first as the difference in us to the previous record (LEB128 varint, 1 byte up to 127 us,
+ *   2 bytes up to 16 ms, 3 bytes up to 2 s), the exact time of a record is the time of the block
+ *   plus the sum of the differences, all times are us since the start of the robot (mbed us ticker)
+ * - sync blocks: a LogSyncHeader (session, running index of the sync block, time in us), written
+ *   by the crash consistent mode of the SDLogger after all blocks before it are on the card, so
+ *   everything up to the last sync block survives a power cut
+ *
+ * The session is a random 16 bit number per file (0 if unknown). A preallocated file or a raw
+ * partition can still hold the valid blocks of an older file behind the end of the new data, a
+ * reader only accepts the data and sync blocks of its own session.
+ *
+ * Version 1 files have no streams and no LogDataHeader, the data blocks are stream 0. Version 2
+ * files have no record times. LogDataBlock builds the data blocks of a stream, logParseDataBlock()
+ * splits a data block of any version.
+ *
+ * The plain format of the SDLogger and the SerialStream (a "num_of_floats" byte followed by float
+ * records) has record times if the byte has LOG_FORMAT_PLAIN_TIME_FLAG set: the byte is followed
+ * by the uint64 time in us of the first record and every record starts with the uint32 difference
+ * in us to the previous record (0 for the first).
+ *
+ * Narrow types cut the bandwidth, e.g. an angle in rad as int16 with scale 1e-4 covers +-3.2 rad.
+ * Values outside the range of the type are saturated.
+ *
+ * Compressed data blocks (LogCompressor) store the same records lossless and are decodable on
+ * their own, the first record of a block is coded against zero:
+ * - payload: LogDataHeader, record times, uint16 number of records, then per record one control nibble per channel (two per
+ *   byte, low nibble first) followed by the non-zero bytes of every channel
+ * - float channels are coded as the XOR with the previous value, integer channels as the zigzag
+ *   coded difference to the previous value (in the width of the type)
+ * - the control nibble is 0 if the coded value is zero, else it gives the range of its lowest to
+ *   its highest non-zero byte, only these bytes are stored, so a slowly changing value needs one
+ *   or two bytes and an unchanged value none (also the trailing zero bytes of integer floats are
+ *   dropped)
+ * - a record is only added if its worst case (all bytes plus the control nibbles) fits, so the
+ *   work per block is bounded by one pass over at most LOG_FORMAT_PAYLOAD_SIZE bytes
+ *
+ * The definitions do not depend on mbed, they are shared by the firmware and the host tools in
+ * docs/cpp.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef LOG_FORMAT_H_
+#define LOG_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_FORMAT_MAGIC 0x474F4C50UL // "PLOG" in the first four bytes of every block
+#define LOG_FORMAT_VERSION 3
+#define LOG_FORMAT_BLOCK_SIZE 512
+#define LOG_FORMAT_BLOCK_HEADER_SIZE 16
+#define LOG_FORMAT_PAYLOAD_SIZE (LOG_FORMAT_BLOCK_SIZE - LOG_FORMAT_BLOCK_HEADER_SIZE)
+#define LOG_FORMAT_NAME_SIZE 16
+#define LOG_FORMAT_UNIT_SIZE 8
+#define LOG_FORMAT_NUM_OF_CHANNELS_MAX 100
+#define LOG_FORMAT_RECORD_SIZE_MAX (4 * LOG_FORMAT_NUM_OF_CHANNELS_MAX) // also the sum of the record sizes of all streams
+#define LOG_FORMAT_NUM_OF_STREAMS_MAX 4
+#define LOG_FORMAT_VARINT_SIZE_MAX 10 // LEB128 of 64 bits
+#define LOG_FORMAT_PLAIN_TIME_FLAG 0x80 // in the "num_of_floats" byte of the plain format
+
+enum LogBlockType : uint8_t {
+    LOG_BLOCK_SCHEMA = 1,
+    LOG_BLOCK_DATA = 2,
+    LOG_BLOCK_DATA_COMPRESSED = 3,
+    LOG_BLOCK_SYNC = 4
+};
+
+enum LogChannelType : uint8_t {
+    LOG_TYPE_INT8 = 1,
+    LOG_TYPE_INT16 = 2,
+    LOG_TYPE_INT32 = 3,
+    LOG_TYPE_FLOAT = 4
+};
+
+struct LogBlockHeader {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t version;
+    uint16_t payload_size; // used bytes of the payload
+    uint32_t seq;          // counts all blocks of the file, starting with 0
+    uint32_t crc;          // crc32 of the whole block with this field set to zero
+};
+
+struct LogSchemaHeader {
+    uint8_t num_of_channels;          // channels of the whole record
+    uint8_t first_channel;            // index of the first channel in this block
+    uint8_t num_of_channels_in_block;
+    uint8_t reserved;
+};
+
+struct LogChannel {
+    char name[LOG_FORMAT_NAME_SIZE]; // zero terminated if shorter
+    char unit[LOG_FORMAT_UNIT_SIZE]; // zero terminated if shorter
+    uint8_t type;
+    uint8_t stream; // 0 in version 1
+    uint8_t reserved[2];
+    float scale; // physical value = raw * scale
+    float rate;  // nominal rate in Hz, 0 if unknown
+};
+
+struct LogDataHeader {
+    uint8_t stream;
+    uint8_t reserved;
+    uint16_t session;
+    uint32_t first_record; // index of the first record of the stream in this block, gaps are lost records
+    uint64_t time_us;      // time of the first record
+};
+
+struct LogSyncHeader {
+    uint16_t session;
+    uint16_t reserved;
+    uint32_t sync_index; // counts the sync blocks of the session, starting with 0
+    uint64_t time_us;
+};
+
+static_assert(sizeof(LogBlockHeader) == LOG_FORMAT_BLOCK_HEADER_SIZE, "LogBlockHeader has to be 16 bytes");
+static_assert(sizeof(LogSchemaHeader) == 4, "LogSchemaHeader has to be 4 bytes");
+static_assert(sizeof(LogChannel) == 36, "LogChannel has to be 36 bytes");
+static_assert(sizeof(LogDataHeader) == 16, "LogDataHeader has to be 16 bytes");
+static_assert(sizeof(LogSyncHeader) == 16, "LogSyncHeader has to be 16 bytes");
+
+#define LOG_FORMAT_CHANNELS_PER_SCHEMA_BLOCK ((LOG_FORMAT_PAYLOAD_SIZE - sizeof(LogSchemaHeader)) / sizeof(LogChannel))
+
+// size of a value of the type in bytes, 0 for an unknown type
+uint8_t logTypeSize(uint8_t type);
+
+// crc32 (ieee 802.3, reflected, polynomial 0xEDB88320), continue with the returned value for more data
+uint32_t logCrc32(const void* data, size_t size, uint32_t crc = 0);
+
+// writes the header and the crc of a block and zeroes the unused payload, the payload has to be filled already
+void logFinishBlock(uint8_t* block, uint8_t type, uint16_t payload_size, uint32_t seq);
+
+// returns true if the block has the magic, a known version, a valid payload size and a valid crc
+bool logCheckBlock(const uint8_t* block);
+
+// session of a checked data or sync block, 0 for schema blocks and blocks without a session
+uint16_t logGetBlockSession(const uint8_t* block);
+
+// writes value as LEB128 varint (7 bits per byte, low bits first), returns the number of bytes
+uint8_t logWriteVarint(uint8_t* dst, uint64_t value);
+// returns the number of bytes read, 0 if the varint is longer than size
+uint8_t logReadVarint(const uint8_t* src, size_t size, uint64_t& value);
+uint8_t logGetVarintSize(uint64_t value);
+
+/**
+ * @brief Splits a checked data block into its parts.
+ *
+ * @param block       data block
+ * @param data_header output, zero for version 1
+ * @param times       output, record times of the records after the first (varint differences), nullptr before version 3
+ * @param times_size  output, size of the record times
+ * @param records     output, records (compressed for LOG_BLOCK_DATA_COMPRESSED)
+ * @param records_size output, size of the records
+ * @return false if the parts do not fit into the payload
+ */
+bool logParseDataBlock(const uint8_t* block, LogDataHeader& data_header, const uint8_t*& times, uint16_t& times_size,
+                       const uint8_t*& records, uint16_t& records_size);
+
+class LogSchema
+{
+public:
+    explicit LogSchema();
+    ~LogSchema() = default;
+
+    void reset();
+
+    /**
+     * @brief Start a new stream, the following channels belong to it. The first channel starts stream 0.
+     *
+     * @return index of the stream, -1 if there are already LOG_FORMAT_NUM_OF_STREAMS_MAX streams
+     */
+    int addStream();
+
+    /**
+     * @brief Add a channel to the end of the record of the last stream.
+     *
+     * @param name  channel name, truncated to 15 characters
+     * @param type  LOG_TYPE_INT8, LOG_TYPE_INT16, LOG_TYPE_INT32 or LOG_TYPE_FLOAT
+     * @param unit  unit, truncated to 7 characters
+     * @param rate  nominal rate in Hz, 0 if unknown
+     * @param scale physical value = raw * scale
+     * @return false if the channel does not fit or the type is unknown
+     */
+    bool addChannel(const char* name, uint8_t type, const char* unit, float rate, float scale);
+
+    uint8_t getNumOfChannels() const { return m_num_of_channels; };
+    uint8_t getNumOfStreams() const { return m_num_of_streams; };
+    uint8_t getStreamFirstChannel(uint8_t stream) const { return m_stream_first_channels[stream]; };
+    uint8_t getStreamNumOfChannels(uint8_t stream) const { return m_stream_num_of_channels[stream]; };
+    uint16_t getRecordSize(uint8_t stream = 0) const { return m_record_sizes[stream]; };
+    const LogChannel& getChannel(uint8_t i) const { return m_channels[i]; };
+    // offset of the channel in the record of its stream
+    uint16_t getChannelOffset(uint8_t i) const { return m_offsets[i]; };
+    const LogChannel* getChannels() const { return m_channels; };
+
+    // converts the value with the scale of the channel into the record of its stream, saturated to the range of the type
+    void encodeValue(uint8_t* record, uint8_t channel, float value) const;
+    void encodeValue(uint8_t* record, uint8_t channel, int32_t value) const;
+
+    uint8_t getNumOfSchemaBlocks() const;
+    // writes schema block index (0 ... getNumOfSchemaBlocks() - 1) with sequence number seq
+    void writeSchemaBlock(uint8_t* block, uint8_t index, uint32_t seq) const;
+
+private:
+    uint8_t m_num_of_channels{0};
+    uint8_t m_num_of_streams{0};
+    uint8_t m_stream_first_channels[LOG_FORMAT_NUM_OF_STREAMS_MAX];
+    uint8_t m_stream_num_of_channels[LOG_FORMAT_NUM_OF_STREAMS_MAX];
+    uint16_t m_record_sizes[LOG_FORMAT_NUM_OF_STREAMS_MAX];
+    LogChannel m_channels[LOG_FORMAT_NUM_OF_CHANNELS_MAX];
+    uint16_t m_offsets[LOG_FORMAT_NUM_OF_CHANNELS_MAX];
+    float m_inv_scales[LOG_FORMAT_NUM_OF_CHANNELS_MAX];
+
+    void encodeRaw(uint8_t* record, uint8_t channel, float raw) const;
+};
+
+class LogCompressor
+{
+public:
+    explicit LogCompressor() = default;
+    ~LogCompressor() = default;
+
+    // the channels have to stay valid while the compressor is used
+    void setChannels(const LogChannel* channels, uint8_t num_of_channels);
+
+    // starts a compressed block, payload points to capacity bytes
+    void begin(uint8_t* payload, uint16_t capacity);
+    // returns false if the record might not fit, finish the block and begin a new one
+    bool add(const uint8_t* record);
+    // e.g. to make room for the record times, at least getPayloadSize()
+    void setCapacity(uint16_t capacity) { m_capacity = capacity; };
+
+    uint16_t getPayloadSize() const { return m_payload_size; };
+    uint16_t getNumOfRecords() const { return m_num_of_records; };
+    uint16_t getRecordSize() const { return m_record_size; };
+
+private:
+    const LogChannel* m_channels{nullptr};
+    uint8_t m_num_of_channels{0};
+    uint16_t m_record_size{0};
+    uint16_t m_record_size_max{0}; // worst case of a compressed record
+
+    uint8_t* m_payload{nullptr};
+    uint16_t m_capacity{0};
+    uint16_t m_payload_size{0};
+    uint16_t m_num_of_records{0};
+    uint8_t m_previous[LOG_FORMAT_RECORD_SIZE_MAX];
+};
+
+/**
+ * Builds the data blocks of one stream: LogDataHeader, record times and the records, compressed
+ * with a LogCompressor if do_compress is true. The records and the times are collected separately
+ * and put together by finish(), a record is only added if it fits with its time.
+ */
+class LogDataBlock
+{
+public:
+    explicit LogDataBlock() = default;
+    ~LogDataBlock() = default;
+
+    // the channels have to stay valid while the block is used
+    void setChannels(const LogChannel* channels, uint8_t num_of_channels, bool do_compress);
+
+    void begin(uint8_t stream, uint16_t session, uint32_t first_record, uint64_t time_us);
+    // returns false if the record does not fit, finish the block and begin a new one
+    bool add(const uint8_t* record, uint64_t time_us);
+    // writes the block with its header and crc
+    void finish(uint8_t* block, uint32_t seq);
+
+    bool isStarted() const { return m_is_started; };
+    uint16_t getNumOfRecords() const { return m_num_of_records; };
+    // index of the next record of the stream if it follows without a gap
+    uint32_t getNextRecord() const { return m_data_header.first_record + m_num_of_records; };
+    uint16_t getPayloadSize() const;
+
+private:
+    LogDataHeader m_data_header;
+    bool m_is_started{false};
+    bool m_do_compress{false};
+    uint16_t m_record_size{0};
+    uint16_t m_num_of_records{0};
+    uint64_t m_time_us{0}; // time of the last record
+
+    uint8_t m_times[LOG_FORMAT_PAYLOAD_SIZE];
+    uint16_t m_times_size{0};
+    uint8_t m_records[LOG_FORMAT_PAYLOAD_SIZE];
+    uint16_t m_records_size{0};
+    LogCompressor m_LogCompressor;
+};
+
+/**
+ * @brief Decodes the compressed records of a data block.
+ *
+ * @param channels        channels of the stream
+ * @param num_of_channels number of channels of the stream
+ * @param payload         compressed records, after the LogDataHeader
+ * @param payload_size    size of the compressed records
+ * @param records         output, space for max_records records
+ * @param max_records     size of records in records
+ * @return number of decoded records, 0 if the payload is invalid
+ */
+size_t logDecompressBlock(const LogChannel* channels, uint8_t num_of_channels, const uint8_t* payload, uint16_t payload_size,
+                          uint8_t* records, size_t max_records);
+
+// number of records in the compressed records, 0 if they are too short
+size_t logGetNumOfCompressedRecords(const uint8_t* payload, uint16_t payload_size);
+
+#endif /* LOG_FORMAT_H_ */
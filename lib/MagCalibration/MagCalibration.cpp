@@ -0,0 +1,154 @@
+#include "MagCalibration.h"
+
+#include <math.h>
+
+// the residual is averaged over roughly this number of samples
+#define MAG_CALIBRATION_RESIDUAL_WINDOW 500
+
+MagCalibration::MagCalibration(float min_dist, float forgetting_factor)
+    : m_min_dist(min_dist)
+    , m_forgetting_factor(forgetting_factor)
+{
+    reset();
+}
+
+void MagCalibration::reset()
+{
+    m_statistics.DtD.setZero();
+    m_statistics.num_of_samples = 0;
+    m_statistics.bins = 0;
+    m_last_sample.setZero();
+    m_min.setConstant(1.0e6f);
+    m_max.setConstant(-1.0e6f);
+    m_is_calibrated = false;
+    m_A.setIdentity();
+    m_b.setZero();
+    m_residual_sq_sum = 0.0f;
+    m_residual_cntr = 0;
+}
+
+bool MagCalibration::addSample(const Eigen::Vector3f& mag)
+{
+    if ((m_statistics.num_of_samples > 0) && ((mag - m_last_sample).norm() < m_min_dist))
+        return false;
+    m_last_sample = mag;
+
+    // D^T * D += d * d^T, only the upper triangle is accumulated
+    const double x = mag(0), y = mag(1), z = mag(2);
+    const double d[10] = {x * x, y * y, z * z, x * y, x * z, y * z, x, y, z, 1.0};
+    if (m_forgetting_factor < 1.0f)
+        m_statistics.DtD *= static_cast<double>(m_forgetting_factor);
+    for (int i = 0; i < 10; i++)
+        for (int j = i; j < 10; j++)
+            m_statistics.DtD(i, j) += d[i] * d[j];
+    m_statistics.num_of_samples++;
+
+    // coverage around the current centre, before the first calibration the centre of the bounding box
+    m_min = m_min.cwiseMin(mag);
+    m_max = m_max.cwiseMax(mag);
+    const Eigen::Vector3f centre = m_is_calibrated ? m_b : Eigen::Vector3f(0.5f * (m_min + m_max));
+    const Eigen::Vector3f dir = mag - centre;
+    if (dir.squaredNorm() > 0.0f)
+        m_statistics.bins |= (1UL << calcBin(dir.normalized()));
+
+    // residual with the current calibration
+    if (m_is_calibrated) {
+        const float r = (m_A * (mag - m_b)).norm() - 1.0f;
+        if (m_residual_cntr < MAG_CALIBRATION_RESIDUAL_WINDOW)
+            m_residual_cntr++;
+        m_residual_sq_sum += (r * r - m_residual_sq_sum) / static_cast<float>(m_residual_cntr);
+    }
+
+    return true;
+}
+
+float MagCalibration::getCoverage() const
+{
+    return getCoverage(m_statistics);
+}
+
+float MagCalibration::getCoverage(const Statistics& statistics)
+{
+    uint8_t num_of_bins = 0;
+    for (uint8_t i = 0; i < MAG_CALIBRATION_NUM_OF_BINS; i++)
+        if (statistics.bins & (1UL << i))
+            num_of_bins++;
+    return static_cast<float>(num_of_bins) / static_cast<float>(MAG_CALIBRATION_NUM_OF_BINS);
+}
+
+float MagCalibration::getResidual() const
+{
+    return sqrtf(m_residual_sq_sum);
+}
+
+bool MagCalibration::fit(const Statistics& statistics, Result& result, float axis_ratio_max)
+{
+    if (statistics.num_of_samples < 10)
+        return false;
+
+    // min ||D * p|| with ||p|| = 1 is the eigenvector of the smallest eigenvalue of D^T * D
+    const Eigen::Matrix<double, 10, 10> DtD = statistics.DtD.selfadjointView<Eigen::Upper>();
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 10, 10>> eigen_solver(DtD);
+    if (eigen_solver.info() != Eigen::Success)
+        return false;
+    Eigen::Matrix<double, 10, 1> p = eigen_solver.eigenvectors().col(0);
+    if (p(0) < 0.0)
+        p = -p;
+
+    // ellipsoid v^T * A * v + b^T * v + d = 0, A has to be positive definite
+    Eigen::Matrix3d A;
+    A << p(0),        0.5 * p(3), 0.5 * p(4),
+         0.5 * p(3),  p(1),       0.5 * p(5),
+         0.5 * p(4),  0.5 * p(5), p(2);
+    const Eigen::Vector3d b(p(6), p(7), p(8));
+    const double d = p(9);
+    Eigen::LLT<Eigen::Matrix3d> llt(A);
+    if (llt.info() != Eigen::Success)
+        return false;
+
+    // centre c = -A^-1 * b / 2, (v - c)^T * A * (v - c) = c^T * A * c - d
+    const Eigen::Vector3d c = -0.5 * llt.solve(b);
+    const double rhs = c.dot(A * c) - d;
+    if (rhs <= 0.0)
+        return false;
+
+    // A / rhs = U^T * U with U upper triangular, mag_calibrated = U * (v - c)
+    const Eigen::Matrix3d U = Eigen::Matrix3d(llt.matrixU()) / sqrt(rhs);
+
+    const Eigen::Vector3d eigen_values = Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(A, Eigen::EigenvaluesOnly).eigenvalues();
+    const double axis_ratio = sqrt(eigen_values(2) / eigen_values(0));
+    if (axis_ratio > axis_ratio_max)
+        return false;
+
+    result.A = U.cast<float>();
+    result.b = c.cast<float>();
+    result.field_strength = static_cast<float>(1.0 / cbrt(U.determinant()));
+    result.axis_ratio = static_cast<float>(axis_ratio);
+
+    return true;
+}
+
+void MagCalibration::setCalibration(const Eigen::Matrix3f& A, const Eigen::Vector3f& b)
+{
+    m_A = A;
+    m_b = b;
+    m_is_calibrated = true;
+    m_residual_sq_sum = 0.0f;
+    m_residual_cntr = 0;
+}
+
+uint8_t MagCalibration::calcBin(const Eigen::Vector3f& dir) const
+{
+    // 4 elevation bands of equal area (equal steps in z) times 8 azimuth sectors
+    int band = static_cast<int>((dir(2) + 1.0f) * 2.0f);
+    if (band > 3)
+        band = 3;
+    if (band < 0)
+        band = 0;
+    int sector = static_cast<int>((atan2f(dir(1), dir(0)) + 3.14159265f) * (8.0f / (2.0f * 3.14159265f)));
+    if (sector > 7)
+        sector = 7;
+    if (sector < 0)
+        sector = 0;
+    return static_cast<uint8_t>(8 * band + sector);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file MagCalibration.h
+ * @brief Defines the MagCalibration class, a streaming hard and soft iron calibration of the magnetometer.
+ *
+ * The MagCalibration class fits an ellipsoid to the raw magnetometer measurements with the same
+ * (non iterative) technique as MgnCalibration.m in docs/dev/dev_imu/99_fcn_bib (Merayo et al.):
+ * - every sample v adds d * d^T to the 10x10 matrix D^T * D, with
+ *   d = [x^2, y^2, z^2, x*y, x*z, y*z, x, y, z, 1], so the memory is constant
+ * - samples closer than min_dist to the last accepted sample are skipped, so the fit is not
+ *   dominated by the orientation the robot stands most of the time in
+ * - optional exponential forgetting, so the calibration follows changes of the robot
+ * - fit() solves min ||D * p|| with ||p|| = 1 (smallest eigenvector of D^T * D) and returns
+ *   A and b so that A * (v - b) lies on the unit sphere, as used by LinearCharacteristics3
+ *
+ * The coverage is the fraction of 32 equal area direction bins around the centre that were hit.
+ * The quality is the rms of ||A * (v - b)|| - 1 of the accepted samples with the last
+ * calibration set by setCalibration().
+ *
+ * addSample() is cheap and runs in the imu thread, fit() is expensive (10x10 eigen decomposition
+ * in double) and is meant to run on a copy of the statistics in a low priority thread.
+ * The class does not depend on mbed.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef MAG_CALIBRATION_H_
+#define MAG_CALIBRATION_H_
+
+#include <Eigen/Dense>
+#include <stdint.h>
+
+#define MAG_CALIBRATION_NUM_OF_BINS 32
+
+class MagCalibration
+{
+public:
+    struct Statistics {
+        Eigen::Matrix<double, 10, 10> DtD;
+        uint32_t num_of_samples;
+        uint32_t bins; // bit i is set if direction bin i was hit
+    };
+
+    struct Result {
+        Eigen::Matrix3f A;    // mag_calibrated = A * (mag - b), ||mag_calibrated|| = 1
+        Eigen::Vector3f b;
+        float field_strength; // radius of the sphere with the same volume as the ellipsoid in raw units
+        float axis_ratio;     // ratio of the longest to the shortest axis of the ellipsoid
+    };
+
+    /**
+     * @param min_dist          min. distance of two accepted samples in raw units
+     * @param forgetting_factor weight of the old statistics per accepted sample, 1 is no forgetting
+     */
+    explicit MagCalibration(float min_dist = 0.02f, float forgetting_factor = 1.0f);
+    ~MagCalibration() = default;
+
+    void reset();
+
+    // returns true if the sample was accepted
+    bool addSample(const Eigen::Vector3f& mag);
+
+    const Statistics& getStatistics() const { return m_statistics; };
+    float getCoverage() const;
+    static float getCoverage(const Statistics& statistics);
+    float getResidual() const;
+
+    /**
+     * @brief Fit the ellipsoid to the statistics.
+     *
+     * @param statistics     copy of getStatistics()
+     * @param result         calibration, only valid if true is returned
+     * @param axis_ratio_max the fit is rejected if the ellipsoid is more elongated than this
+     * @return true if the fit is valid (positive definite, not too elongated)
+     */
+    static bool fit(const Statistics& statistics, Result& result, float axis_ratio_max = 2.0f);
+
+    // calibration used for the coverage bins and the residual
+    void setCalibration(const Eigen::Matrix3f& A, const Eigen::Vector3f& b);
+
+private:
+    float m_min_dist;
+    float m_forgetting_factor;
+
+    Statistics m_statistics;
+    Eigen::Vector3f m_last_sample;
+    Eigen::Vector3f m_min, m_max;
+
+    bool m_is_calibrated = false;
+    Eigen::Matrix3f m_A;
+    Eigen::Vector3f m_b;
+    float m_residual_sq_sum = 0.0f;
+    uint32_t m_residual_cntr = 0;
+
+    uint8_t calcBin(const Eigen::Vector3f& dir) const;
+};
+
+#endif /* MAG_CALIBRATION_H_ */
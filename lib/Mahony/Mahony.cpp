@@ -19,32 +19,50 @@ Mahony::Mahony(float kp, float ki, float Ts)
     setup(kp, ki, Ts);
 }
 
-void Mahony::update(Eigen::Vector3f gyro, Eigen::Vector3f acc)
+void Mahony::update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc)
 {
-    Eigen::Vector3f g_n(                                          2.0f * ( m_quat.x()*m_quat.z() - m_quat.w()*m_quat.y() ),
-                                                                  2.0f * ( m_quat.y()*m_quat.z() + m_quat.w()*m_quat.x() ),
-                         ( m_quat.w()*m_quat.w() - m_quat.x()*m_quat.x() - m_quat.y()*m_quat.y() + m_quat.z()*m_quat.z() )  );
-    // Eigen::Vector3f e = acc.normalized().cross( g_n.normalized() );
-    Eigen::Vector3f e = calcRotationError(acc, g_n);
+    const float qw = m_quat.w(), qx = m_quat.x(), qy = m_quat.y(), qz = m_quat.z();
 
-    updateOrientation(gyro, e);
-}
+    // gravity in body frame (third row of the rotation matrix)
+    const float gx = 2.0f * ( qx*qz - qw*qy );
+    const float gy = 2.0f * ( qy*qz + qw*qx );
+    const float gz = qw*qw - qx*qx - qy*qy + qz*qz;
 
-void Mahony::update(Eigen::Vector3f gyro, Eigen::Vector3f acc, Eigen::Vector3f mag)
-{
-    Eigen::Matrix3f R = m_quat.toRotationMatrix();
+    // e = acc.normalized().cross( g_n.normalized() ) scaled to the angle between them
+    float ex, ey, ez;
+    calcRotationError(acc(0), acc(1), acc(2), gx, gy, gz, ex, ey, ez);
 
-    Eigen::Vector3f g_n = R.block<1,3>(2,0).transpose();
-    // Eigen::Vector3f e = acc.normalized().cross( g_n.normalized() );
-    Eigen::Vector3f e = calcRotationError(acc, g_n);
+    updateOrientation(gyro, ex, ey, ez);
+}
 
-    Eigen::Vector3f h = R * mag.normalized();
-    h(2) = 0.0f;
-    Eigen::Vector3f b(h.norm(), 0.0f, 0.0f);
-    // e += R.transpose() * h.cross(b);
-    e += R.transpose() * calcRotationError(h, b) * h.norm();
+void Mahony::update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc, const Eigen::Vector3f& mag)
+{
+    const float qw = m_quat.w(), qx = m_quat.x(), qy = m_quat.y(), qz = m_quat.z();
+
+    // rows of the rotation matrix, R = m_quat.toRotationMatrix()
+    const float r00 = 1.0f - 2.0f * ( qy*qy + qz*qz ), r01 = 2.0f * ( qx*qy - qw*qz ), r02 = 2.0f * ( qx*qz + qw*qy );
+    const float r10 = 2.0f * ( qx*qy + qw*qz ), r11 = 1.0f - 2.0f * ( qx*qx + qz*qz ), r12 = 2.0f * ( qy*qz - qw*qx );
+    const float r20 = 2.0f * ( qx*qz - qw*qy ), r21 = 2.0f * ( qy*qz + qw*qx ), r22 = 1.0f - 2.0f * ( qx*qx + qy*qy );
+
+    float ex, ey, ez;
+    calcRotationError(acc(0), acc(1), acc(2), r20, r21, r22, ex, ey, ez);
+
+    // horizontal part of the mag in world frame, h = R * mag.normalized(), h(2) = 0
+    const float mag_norm = mag.norm();
+    if (mag_norm > 0.0f) {
+        const float mx = mag(0) / mag_norm, my = mag(1) / mag_norm, mz = mag(2) / mag_norm;
+        const float hx = r00*mx + r01*my + r02*mz;
+        const float hy = r10*mx + r11*my + r12*mz;
+        // e += R^T * (h x b) with b = [||h||, 0, 0], which only has a z component: -atan2(hy, hx) * ||h||
+        if (hy != 0.0f) {
+            const float e_mag = -atan2f(hy, hx) * sqrtf(hx*hx + hy*hy);
+            ex += e_mag * r20;
+            ey += e_mag * r21;
+            ez += e_mag * r22;
+        }
+    }
 
-    updateOrientation(gyro, e);
+    updateOrientation(gyro, ex, ey, ez);
 }
 
 Eigen::Quaternionf Mahony::getOrientationAsQuaternion() const
@@ -54,12 +72,32 @@ Eigen::Quaternionf Mahony::getOrientationAsQuaternion() const
 
 Eigen::Vector3f Mahony::getOrientationAsRPYAngles() const
 {
-    return m_rpy;
+    // ||quat|| = 1
+    const float qw = m_quat.w(), qx = m_quat.x(), qy = m_quat.y(), qz = m_quat.z();
+    Eigen::Vector3f rpy;
+    // roll
+    rpy(0) = atan2f( qy*qz + qw*qx, 0.5f - ( qx*qx + qy*qy ) );
+    // pitch
+    float sinarg = -2.0f * ( qx*qz - qw*qy );
+    if (sinarg > 1.0f)
+        sinarg = 1.0f;
+    if (sinarg < -1.0f)
+        sinarg = -1.0f;
+    rpy(1) = asinf( sinarg );
+    // yaw
+    rpy(2) = atan2f( qx*qy + qw*qz, 0.5f - ( qy*qy + qz*qz ) );
+
+    return rpy;
 }
 
 float Mahony::getTiltAngle() const
 {
-    return m_tilt;
+    float cos_tilt = m_quat.w() * m_quat.w() - m_quat.x() * m_quat.x() - m_quat.y() * m_quat.y() + m_quat.z() * m_quat.z();
+    if (cos_tilt > 1.0f)
+        cos_tilt = 1.0f;
+    if (cos_tilt < -1.0f)
+        cos_tilt = -1.0f;
+    return acosf( cos_tilt );
 }
 
 void Mahony::setup(float kp, float ki, float Ts)
@@ -83,59 +121,51 @@ void Mahony::initialise()
 {
     m_quat.setIdentity();
     m_bias.setZero();
-    m_rpy.setZero();
-}
-
-Eigen::Vector3f Mahony::quat2rpy(Eigen::Quaternionf quat)
-{
-	// ||quat|| = 1
-	Eigen::Vector3f rpy;
-	// roll
-	rpy(0) = atan2f( quat.y() * quat.z() + quat.w() * quat.x(), 0.5f - ( quat.x() * quat.x() + quat.y() * quat.y() ) );
-	// pitch
-	float sinarg = -2.0f * ( quat.x() * quat.z() - quat.w() * quat.y() );
-	if (sinarg > 1.0f)
-		sinarg = 1.0f;
-	if (sinarg < -1.0f)
-		sinarg = -1.0f;
-	rpy(1) = asinf( sinarg );
-	// yaw
-	rpy(2) = atan2f( quat.x() * quat.y() + quat.w() * quat.z(), 0.5f - ( quat.y() * quat.y() + quat.z() * quat.z() ) );
-
-	return rpy;
 }
 
-Eigen::Vector3f Mahony::calcRotationError(Eigen::Vector3f v1, Eigen::Vector3f v2)
+void Mahony::calcRotationError(float v1x, float v1y, float v1z, float v2x, float v2y, float v2z, float& ex, float& ey, float& ez)
 {
     // https://stackoverflow.com/questions/5188561/signed-angle-between-two-3d-vectors-with-same-origin-within-the-same-plane
-    Eigen::Vector3f vn = v1.cross(v2);
-    float vn_norm = vn.norm();
-    if (vn_norm != 0.0f) {
-        vn /= vn_norm;
+    // e = atan2( ||v1 x v2||, v1 * v2 ) * (v1 x v2) / ||v1 x v2||
+    const float cx = v1y*v2z - v1z*v2y;
+    const float cy = v1z*v2x - v1x*v2z;
+    const float cz = v1x*v2y - v1y*v2x;
+    const float c_norm = sqrtf(cx*cx + cy*cy + cz*cz);
+    if (c_norm == 0.0f) {
+        ex = ey = ez = 0.0f;
+        return;
     }
-    float ang = atan2f(v1.cross(v2).dot(vn), v1.dot(v2));
-    return ang * vn;
+    const float scale = atan2f(c_norm, v1x*v2x + v1y*v2y + v1z*v2z) / c_norm;
+    ex = scale * cx;
+    ey = scale * cy;
+    ez = scale * cz;
 }
 
-void Mahony::updateOrientation(Eigen::Vector3f gyro, Eigen::Vector3f e)
+void Mahony::updateOrientation(const Eigen::Vector3f& gyro, float ex, float ey, float ez)
 {
-    m_bias += m_ki * e * m_Ts;
-    Eigen::Matrix<float, 4, 3> Q;
-    Q << -m_quat.x(), -m_quat.y(), -m_quat.z(),
-          m_quat.w(), -m_quat.z(),  m_quat.y(),
-          m_quat.z(),  m_quat.w(), -m_quat.x(),
-         -m_quat.y(),  m_quat.x(),  m_quat.w();
-
-    // carefull here, Eigen Quaternions have the internal storage order [x y z w] but you inilialise them with quat(w, x, y, z)
-    // so I rather type the following explicitly
-    Eigen::Vector4f dquat = m_Ts * 0.5f * Q * ( gyro + m_bias + m_kp * e );
-    m_quat.w() += dquat(0);
-    m_quat.x() += dquat(1);
-    m_quat.y() += dquat(2);
-    m_quat.z() += dquat(3);
-    m_quat.normalize();
-
-    m_rpy = quat2rpy(m_quat);
-
-    m_tilt = acosf( m_quat.w() * m_quat.w() - m_quat.x() * m_quat.x() - m_quat.y() * m_quat.y() + m_quat.z() * m_quat.z() );
+    const float kiTs = m_ki * m_Ts;
+    m_bias(0) += kiTs * ex;
+    m_bias(1) += kiTs * ey;
+    m_bias(2) += kiTs * ez;
+
+    const float wx = gyro(0) + m_bias(0) + m_kp * ex;
+    const float wy = gyro(1) + m_bias(1) + m_kp * ey;
+    const float wz = gyro(2) + m_bias(2) + m_kp * ez;
+
+    // dquat = Ts/2 * Q(quat) * w, carefull here, Eigen Quaternions have the internal storage order [x y z w]
+    const float qw = m_quat.w(), qx = m_quat.x(), qy = m_quat.y(), qz = m_quat.z();
+    const float hTs = 0.5f * m_Ts;
+    const float w = qw + hTs * ( -qx*wx - qy*wy - qz*wz );
+    const float x = qx + hTs * (  qw*wx - qz*wy + qy*wz );
+    const float y = qy + hTs * (  qz*wx + qw*wy - qx*wz );
+    const float z = qz + hTs * ( -qy*wx + qx*wy + qw*wz );
+
+    // the norm only changes by O((w*Ts)^2) per step, so one newton step for 1/sqrt(n) at n = 1 is enough,
+    // for larger changes (e.g. a badly chosen Ts) the exact normalisation is used
+    const float n = w*w + x*x + y*y + z*z;
+    const float inv_norm = (fabsf(n - 1.0f) < 1.0e-3f) ? 0.5f * (3.0f - n) : 1.0f / sqrtf(n);
+    m_quat.w() = w * inv_norm;
+    m_quat.x() = x * inv_norm;
+    m_quat.y() = y * inv_norm;
+    m_quat.z() = z * inv_norm;
 }
@@ -13,9 +13,10 @@ public:
     void setup(float kp, float ki, float Ts);
     void setGains(float kp, float ki);
     void setSamplingTime(float Ts);
-    void update(Eigen::Vector3f gyro, Eigen::Vector3f acc);
-    void update(Eigen::Vector3f gyro, Eigen::Vector3f acc, Eigen::Vector3f mag);
+    void update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc);
+    void update(const Eigen::Vector3f& gyro, const Eigen::Vector3f& acc, const Eigen::Vector3f& mag);
     Eigen::Quaternionf getOrientationAsQuaternion() const;
+    // rpy and tilt are only calculated when requested
     Eigen::Vector3f getOrientationAsRPYAngles() const;
     float getTiltAngle() const;
 
@@ -25,13 +26,10 @@ private:
     float m_Ts = 1.0f;
     Eigen::Quaternionf m_quat;
     Eigen::Vector3f m_bias;
-    Eigen::Vector3f m_rpy;
-    float m_tilt = 0.0f;
 
     void initialise();
-    void updateOrientation(Eigen::Vector3f gyro, Eigen::Vector3f e);
-    Eigen::Vector3f quat2rpy(Eigen::Quaternionf quat);
-    Eigen::Vector3f calcRotationError(Eigen::Vector3f v1, Eigen::Vector3f v2);
+    void updateOrientation(const Eigen::Vector3f& gyro, float ex, float ey, float ez);
+    static void calcRotationError(float v1x, float v1y, float v1z, float v2x, float v2y, float v2z, float& ex, float& ey, float& ez);
 };
 
 #endif /* MAHONY_H_ */
@@ -1,13 +1,19 @@
 #include "SDLogger.h"
 
+#include <new>
+
 SDLogger::SDLogger(PinName mosi,
                    PinName miso,
                    PinName sck,
                    PinName cs,
-                   uint8_t num_of_floats) : m_SDWriter(mosi, miso, sck, cs),
+                   uint8_t num_of_floats) : m_buffer(new uint8_t[BUFFER_SIZE]),
+                                            m_RingBuffer(m_buffer, BUFFER_SIZE),
+                                            m_SDWriter(mosi, miso, sck, cs),
                                             m_Thread(osPriorityLow, 4096),
                                             m_num_of_floats(num_of_floats)
 {
+    m_Timer.start();
+
     // start thread
     m_Thread.start(callback(this, &SDLogger::threadTask));
 
@@ -22,13 +28,58 @@ SDLogger::SDLogger(PinName mosi,
 
 SDLogger::~SDLogger()
 {
-    closeFile();
     m_Ticker.detach();
     m_Thread.terminate();
+    // the thread is the only consumer of the buffer, after it is stopped the rest can be written from here
+    flushBuffer(true);
+    closeFile();
+    delete m_LogFormat;
+    delete[] m_buffer;
+}
+
+bool SDLogger::addChannel(const char* name, uint8_t type, const char* unit, float rate, float scale)
+{
+    if (m_header_is_sent) {
+        printf("SDLogger: channels can only be added before the first send()\n");
+        return false;
+    }
+    if (!createLogFormat()) {
+        return false;
+    }
+    if (!m_LogFormat->schema.addChannel(name, type, unit, rate, scale)) {
+        printf("SDLogger: could not add channel %s\n", name);
+        return false;
+    }
+    // the records of the streams are placed one after the other in record
+    const uint8_t stream = m_LogFormat->schema.getNumOfStreams() - 1;
+    m_LogFormat->record_offsets[stream] = (stream == 0) ? 0 : m_LogFormat->record_offsets[stream - 1] + m_LogFormat->schema.getRecordSize(stream - 1);
+    m_use_log_format = true;
+    return true;
+}
+
+int SDLogger::addStream()
+{
+    if (m_header_is_sent) {
+        printf("SDLogger: streams can only be added before the first send()\n");
+        return -1;
+    }
+    if (!createLogFormat()) {
+        return -1;
+    }
+    const int stream = m_LogFormat->schema.addStream();
+    if (stream < 0) {
+        printf("SDLogger: could not add stream\n");
+    }
+    return stream;
 }
 
 void SDLogger::write(const float val)
 {
+    if (m_use_log_format) {
+        write(0, val);
+        return;
+    }
+
     // add val to the buffer
     m_data[m_float_cntr++] = val;
 
@@ -38,64 +89,187 @@ void SDLogger::write(const float val)
     }
 }
 
+void SDLogger::writeInt(const int32_t val)
+{
+    if (m_use_log_format) {
+        writeInt(0, val);
+        return;
+    }
+    write(static_cast<float>(val));
+}
+
+void SDLogger::write(uint8_t stream, const float val)
+{
+    if (!m_use_log_format || (stream >= m_LogFormat->schema.getNumOfStreams()))
+        return;
+
+    const uint8_t num_of_channels = m_LogFormat->schema.getStreamNumOfChannels(stream);
+    uint8_t& channel_cntr = m_LogFormat->channel_cntrs[stream];
+    if (channel_cntr < num_of_channels)
+        m_LogFormat->schema.encodeValue(&m_LogFormat->record[m_LogFormat->record_offsets[stream]], m_LogFormat->schema.getStreamFirstChannel(stream) + channel_cntr++, val);
+    if (channel_cntr == num_of_channels)
+        send(stream);
+}
+
+void SDLogger::writeInt(uint8_t stream, const int32_t val)
+{
+    if (!m_use_log_format || (stream >= m_LogFormat->schema.getNumOfStreams()))
+        return;
+
+    const uint8_t num_of_channels = m_LogFormat->schema.getStreamNumOfChannels(stream);
+    uint8_t& channel_cntr = m_LogFormat->channel_cntrs[stream];
+    if (channel_cntr < num_of_channels)
+        m_LogFormat->schema.encodeValue(&m_LogFormat->record[m_LogFormat->record_offsets[stream]], m_LogFormat->schema.getStreamFirstChannel(stream) + channel_cntr++, val);
+    if (channel_cntr == num_of_channels)
+        send(stream);
+}
+
 void SDLogger::send()
 {
+    if (m_use_log_format) {
+        send(0);
+        return;
+    }
+
     // return if there is no data to send
     if (m_float_cntr == 0)
         return;
 
-    static bool send_num_of_floats_once = false;
-    if (!send_num_of_floats_once) {
-        send_num_of_floats_once = true;
-        // write the "m_num_of_floats" as the first byte once
-        if (!m_SDWriter.writeByte(m_float_cntr)) {
-            printf("SDLogger: writing num_of_floats byte failed\n");
-        }
+#if SD_LOGGER_DO_USE_RECORD_TIME
+    const uint64_t time_us = ticker_read_us(get_us_ticker_data());
+#endif
+    if (!m_header_is_sent) {
+        m_header_is_sent = true;
+        // write the "m_num_of_floats" as the first byte once, it goes through the ring buffer so that
+        // only the thread writes to the file and the sectors of the file stay aligned with the buffer
+#if SD_LOGGER_DO_USE_RECORD_TIME
+        // followed by the time of the first record
+        uint8_t header[1 + sizeof(time_us)];
+        header[0] = m_float_cntr | LOG_FORMAT_PLAIN_TIME_FLAG;
+        memcpy(&header[1], &time_us, sizeof(time_us));
+        m_RingBuffer.push(header, sizeof(header));
+        m_time_us = time_us;
+#else
+        const uint8_t header = m_float_cntr;
+        m_RingBuffer.push(&header, 1);
+#endif
     }
 
     // write the data
+#if SD_LOGGER_DO_USE_RECORD_TIME
+    // the difference to the last record in the buffer, so a lost record does not shift the times of the following ones
+    const uint32_t time_diff_us = static_cast<uint32_t>(time_us - m_time_us);
+    if (logBytes(&time_diff_us, sizeof(time_diff_us), m_data, m_float_cntr * sizeof(float))) {
+        m_time_us = time_us;
+    }
+#else
     logFloats(m_data, m_float_cntr);
+#endif
     m_float_cntr = 0;
 }
 
+void SDLogger::send(uint8_t stream)
+{
+    if (!m_use_log_format || (stream >= m_LogFormat->schema.getNumOfStreams()) || (m_LogFormat->channel_cntrs[stream] == 0))
+        return;
+
+    m_header_is_sent = true;
+    // channels that were not written are zero, the thread writes the schema before the first block
+    uint8_t* record = &m_LogFormat->record[m_LogFormat->record_offsets[stream]];
+    const uint16_t record_size = m_LogFormat->schema.getRecordSize(stream);
+    if (m_LogFormat->channel_cntrs[stream] < m_LogFormat->schema.getStreamNumOfChannels(stream)) {
+        const uint16_t offset = m_LogFormat->schema.getChannelOffset(m_LogFormat->schema.getStreamFirstChannel(stream) + m_LogFormat->channel_cntrs[stream]);
+        memset(&record[offset], 0, record_size - offset);
+    }
+    m_LogFormat->channel_cntrs[stream] = 0;
+
+    // the index also counts lost records, so the reader sees the gaps
+    RecordHeader header;
+    header.stream = stream;
+    memset(header.reserved, 0, sizeof(header.reserved));
+    header.index = m_LogFormat->record_indices[stream]++;
+    header.time_us = ticker_read_us(get_us_ticker_data());
+    logBytes(&header, sizeof(header), record, record_size);
+}
+
 void SDLogger::logFloats(const float* data)
 {
     logFloats(data, m_num_of_floats);
 }
 
+void SDLogger::printStatistics() const
+{
+    const float time = std::chrono::duration_cast<std::chrono::microseconds>(m_Timer.elapsed_time()).count() * 1.0e-6f;
+    printf("SDLogger: %lu bytes, %.1f kB/s, buffer max %lu of %u bytes, write max %lu us, lost records %lu, dropped without file %lu\n",
+           (unsigned long)m_file_bytes,
+           (time > 0.0f) ? 1.0e-3f * static_cast<float>(m_file_bytes) / time : 0.0f,
+           (unsigned long)m_fill_max,
+           (unsigned)BUFFER_SIZE,
+           (unsigned long)m_write_time_max_us,
+           (unsigned long)m_overflow_cntr,
+           (unsigned long)m_no_file_cntr);
+}
+
 void SDLogger::logFloats(const float* data, size_t count)
 {
+    logBytes(nullptr, 0, data, count * sizeof(float));
+}
+
+bool SDLogger::logBytes(const void* header, size_t header_size, const void* data, size_t data_size)
+{
+    // this runs in the thread of the caller, so it never blocks and never prints
+    const size_t size = header_size + data_size;
     if (!m_file_open) {
-        printf("SDLogger: File not open—discarding data.\n");
-        return;
+        // no sd card or the file could not be opened, not a buffer overflow, the thread reports the dropped records
+        m_no_file_cntr++;
+        return false;
     }
-
-    // note: i leave this as an example
-    // core_util_critical_section_enter(); 
-    // bool ok = pushFloats(data, count);
-    // core_util_critical_section_exit();
-
-    m_Mutex.lock();
-    bool ok = pushFloats(data, count);
-    m_Mutex.unlock();
-
-    if (!ok) {
-        // buffer is full
-        printf("SDLogger: Buffer overflow, lost data!\n");
+    if (!m_RingBuffer.push(header, header_size, data, data_size)) {
+        // buffer is full, the thread reports the lost records
+        m_overflow_cntr++;
+        return false;
     }
+    const uint32_t fill = static_cast<uint32_t>(m_RingBuffer.size());
+    if (fill > m_fill_max)
+        m_fill_max = fill;
+
+    // wake up the thread as soon as a chunk is ready instead of waiting for the ticker, setting a thread flag does not block
+    if ((fill >= SD_LOGGER_WRITE_SIZE) && (fill - size < SD_LOGGER_WRITE_SIZE))
+        m_Thread.flags_set(m_ThreadFlag);
+    return true;
 }
 
 bool SDLogger::openFile()
 {
+#if SD_LOGGER_RAW_PARTITION
+    if (!m_SDWriter.openRaw(SD_LOGGER_RAW_PARTITION)) {
+        printf("SDLogger: openRaw failed\n");
+        return false;
+    }
+#else
     // attempt to mount & open
     if (!m_SDWriter.mount()) {
         printf("SDLogger: mount failed\n");
         return false;
     }
+    // the crash consistent mode preallocates the file with the schema, only the typed log format finds the end of the data
     if (!m_SDWriter.openNextFile()) {
         printf("SDLogger: openNextFile failed\n");
         return false;
     }
+#endif
+
+    // the session tells the blocks of this file from older blocks in the preallocated space or the raw region,
+    // in the raw region it is the session of the index, so raw_extract finds the blocks of a session that was cut off
+#if SD_LOGGER_RAW_PARTITION
+    m_session = static_cast<uint16_t>(m_SDWriter.getFileNumber());
+#else
+    const uint64_t seed[2] = {m_SDWriter.getFileNumber(), ticker_read_us(get_us_ticker_data())};
+    m_session = static_cast<uint16_t>(logCrc32(seed, sizeof(seed)));
+#endif
+    if (m_session == 0) {
+        m_session = 1;
+    }
     // note: i leave this in case it is needed in the future
     // // write the "m_num_of_floats" as the first byte once
     // if (!m_SDWriter.writeByte(m_num_of_floats)) {
@@ -115,50 +289,202 @@ void SDLogger::closeFile()
     }
 }
 
-void SDLogger::flushBuffer()
+void SDLogger::flushBuffer(bool write_all)
 {
     if (!m_file_open) {
+        reportLostRecords();
         return;
     }
 
-    // drain in chunks
-    static constexpr size_t CHUNK_SIZE = 256;
-    float tmp[CHUNK_SIZE];
-
-    while (!m_CircularBuffer.empty()) {
-        size_t count_to_pop = 0;
-
-        // note: i leave this as an example
-        // core_util_critical_section_enter();
-        // while ((count_to_pop < CHUNK_SIZE) && (!m_CircularBuffer.empty())) {
-        //     m_CircularBuffer.pop(tmp[count_to_pop]);
-        //     count_to_pop++;
-        // }
-        // core_util_critical_section_exit();
+    // the format is fixed before the first record enters the buffer, the block state is only used by the typed format
+    if (m_use_log_format) {
+        bool has_open_block = (m_LogFormat->block_index > 0);
+        for (uint8_t i = 0; i < LOG_FORMAT_NUM_OF_STREAMS_MAX; i++) {
+            has_open_block |= m_LogFormat->data_blocks[i].isStarted();
+        }
+        if ((m_RingBuffer.size() > 0) || has_open_block) {
+            flushBlocks(write_all);
+        }
+        return;
+    }
+    if (m_RingBuffer.size() == 0) {
+        return;
+    }
 
-        m_Mutex.lock();
-        while ((count_to_pop < CHUNK_SIZE) && (!m_CircularBuffer.empty())) {
-            m_CircularBuffer.pop(tmp[count_to_pop]);
-            count_to_pop++;
+    // every byte of the file goes through the buffer and BUFFER_SIZE is a multiple of the sector size, so the
+    // contiguous region at the tail always ends at a sector boundary of the file when it reaches the buffer end
+    if (!write_all && (m_RingBuffer.size() < SD_LOGGER_WRITE_SIZE)) {
+        return;
+    }
+    while (true) {
+        const uint8_t* data;
+        size_t size = m_RingBuffer.peek(data);
+        // the written chunk is released right after the write, so the buffer does not stay full during long writes
+        if (size > SD_LOGGER_WRITE_SIZE) {
+            size = SD_LOGGER_WRITE_SIZE;
+        }
+        if (!write_all) {
+            // only up to the last complete sector of the file
+            const uint32_t file_bytes_aligned = ((m_file_bytes + size) / SD_LOGGER_SECTOR_SIZE) * SD_LOGGER_SECTOR_SIZE;
+            size = (file_bytes_aligned > m_file_bytes) ? file_bytes_aligned - m_file_bytes : 0;
+        }
+        if (size == 0) {
+            break;
         }
-        m_Mutex.unlock();
 
-        // write that chunk
-        if (!m_SDWriter.writeFloats(tmp, count_to_pop)) {
-            printf("SDLogger: writeFloats failed\n");
+        // write that chunk directly from the buffer
+        const std::chrono::microseconds time_start = m_Timer.elapsed_time();
+        if (!m_SDWriter.writeBytes(data, size)) {
+            printf("SDLogger: writeBytes failed\n");
             // break (or keep trying)
             break;
         }
+        const uint32_t write_time_us = static_cast<uint32_t>((m_Timer.elapsed_time() - time_start).count());
+        if (write_time_us > m_write_time_max_us)
+            m_write_time_max_us = write_time_us;
+        m_RingBuffer.consume(size);
+        m_file_bytes += size;
+    }
+
+    reportLostRecords();
+}
+
+void SDLogger::flushBlocks(bool write_all)
+{
+    if (!write_all && (m_RingBuffer.size() < SD_LOGGER_WRITE_SIZE)) {
+        return;
+    }
+
+    if (!m_LogFormat->schema_is_written) {
+        m_LogFormat->schema_is_written = true;
+#if SD_LOGGER_DO_USE_CRASH_CONSISTENT_MODE && !SD_LOGGER_RAW_PARTITION
+        // not fatal, the file grows while it is written
+        m_SDWriter.preallocate(SD_LOGGER_PREALLOCATE_SIZE);
+#endif
+        for (uint8_t i = 0; i < m_LogFormat->schema.getNumOfStreams(); i++) {
+            m_LogFormat->data_blocks[i].setChannels(&m_LogFormat->schema.getChannel(m_LogFormat->schema.getStreamFirstChannel(i)),
+                                         m_LogFormat->schema.getStreamNumOfChannels(i), SD_LOGGER_DO_USE_COMPRESSION);
+        }
+        for (uint8_t i = 0; i < m_LogFormat->schema.getNumOfSchemaBlocks(); i++) {
+            m_LogFormat->schema.writeSchemaBlock(&m_LogFormat->blocks[m_LogFormat->block_index * LOG_FORMAT_BLOCK_SIZE], i, m_LogFormat->block_seq++);
+            if (++m_LogFormat->block_index == SD_LOGGER_WRITE_SIZE / LOG_FORMAT_BLOCK_SIZE)
+                writeBlocks();
+        }
+    }
+
+    // a header and its record are pushed as one entry, so the record is in the buffer if the header is
+    RecordHeader header;
+    while (m_RingBuffer.pop(&header, sizeof(header)) == sizeof(header)) {
+        m_RingBuffer.pop(m_LogFormat->record_thread, m_LogFormat->schema.getRecordSize(header.stream));
+        addRecordToBlock(header, m_LogFormat->record_thread);
+    }
+
+    if (write_all) {
+        for (uint8_t i = 0; i < m_LogFormat->schema.getNumOfStreams(); i++) {
+            if (m_LogFormat->data_blocks[i].isStarted()) {
+                finishDataBlock(i);
+            }
+        }
+        writeBlocks();
+    }
+
+    reportLostRecords();
+}
+
+void SDLogger::addRecordToBlock(const RecordHeader& header, const uint8_t* record)
+{
+    LogDataBlock& data_block = m_LogFormat->data_blocks[header.stream];
+
+    // the records of a block are consecutive, after lost records a new block starts with the index and time of the next one
+    if (data_block.isStarted() && (header.index != data_block.getNextRecord())) {
+        finishDataBlock(header.stream);
+    }
+    if (!data_block.isStarted()) {
+        data_block.begin(header.stream, m_session, header.index, header.time_us);
+    }
+    // a record is only added if it fits with its time, so the work per block is bounded
+    if (!data_block.add(record, header.time_us)) {
+        finishDataBlock(header.stream);
+        data_block.begin(header.stream, m_session, header.index, header.time_us);
+        data_block.add(record, header.time_us);
     }
 }
 
-bool SDLogger::pushFloats(const float* data, size_t count)
+void SDLogger::finishDataBlock(uint8_t stream)
 {
-    for (size_t i = 0; i < count; i++) {
-        if (m_CircularBuffer.full()) {
-            return false;
+    // the blocks of the streams are interleaved in the file in the order they are finished
+    m_LogFormat->data_blocks[stream].finish(&m_LogFormat->blocks[m_LogFormat->block_index * LOG_FORMAT_BLOCK_SIZE], m_LogFormat->block_seq++);
+    if (++m_LogFormat->block_index == SD_LOGGER_WRITE_SIZE / LOG_FORMAT_BLOCK_SIZE) {
+        writeBlocks();
+    }
+}
+
+void SDLogger::writeSyncBlock()
+{
+    if (!m_LogFormat->schema_is_written) {
+        return;
+    }
+    for (uint8_t i = 0; i < m_LogFormat->schema.getNumOfStreams(); i++) {
+        if (m_LogFormat->data_blocks[i].isStarted()) {
+            finishDataBlock(i);
         }
-        m_CircularBuffer.push(data[i]);
+    }
+
+    LogSyncHeader sync_header;
+    sync_header.session = m_session;
+    sync_header.reserved = 0;
+    sync_header.sync_index = m_LogFormat->sync_index++;
+    sync_header.time_us = ticker_read_us(get_us_ticker_data());
+    uint8_t* block = &m_LogFormat->blocks[m_LogFormat->block_index * LOG_FORMAT_BLOCK_SIZE];
+    memcpy(&block[LOG_FORMAT_BLOCK_HEADER_SIZE], &sync_header, sizeof(sync_header));
+    logFinishBlock(block, LOG_BLOCK_SYNC, sizeof(sync_header), m_LogFormat->block_seq++);
+    m_LogFormat->block_index++;
+    writeBlocks();
+}
+
+void SDLogger::writeBlocks()
+{
+    if (m_LogFormat->block_index == 0) {
+        return;
+    }
+
+    const size_t size = m_LogFormat->block_index * LOG_FORMAT_BLOCK_SIZE;
+    const std::chrono::microseconds time_start = m_Timer.elapsed_time();
+    // a failed write drops its blocks, the reader sees the gap in the sequence numbers
+    if (!m_SDWriter.writeBytes(m_LogFormat->blocks, size)) {
+        printf("SDLogger: writeBytes failed\n");
+    } else {
+        m_file_bytes += size;
+    }
+    const uint32_t write_time_us = static_cast<uint32_t>((m_Timer.elapsed_time() - time_start).count());
+    if (write_time_us > m_write_time_max_us)
+        m_write_time_max_us = write_time_us;
+    m_LogFormat->block_index = 0;
+}
+
+void SDLogger::reportLostRecords()
+{
+    const uint32_t overflow_cntr = m_overflow_cntr;
+    if (overflow_cntr != m_overflow_cntr_reported) {
+        printf("SDLogger: Buffer overflow, lost %lu records!\n", (unsigned long)(overflow_cntr - m_overflow_cntr_reported));
+        m_overflow_cntr_reported = overflow_cntr;
+    }
+    const uint32_t no_file_cntr = m_no_file_cntr;
+    if (no_file_cntr != m_no_file_cntr_reported) {
+        printf("SDLogger: No open file, dropped %lu records!\n", (unsigned long)(no_file_cntr - m_no_file_cntr_reported));
+        m_no_file_cntr_reported = no_file_cntr;
+    }
+}
+
+bool SDLogger::createLogFormat()
+{
+    if (m_LogFormat != nullptr) {
+        return true;
+    }
+    m_LogFormat = new (std::nothrow) LogFormatState();
+    if (m_LogFormat == nullptr) {
+        printf("SDLogger: not enough memory for the typed log format\n");
+        return false;
     }
     return true;
 }
@@ -171,14 +497,26 @@ void SDLogger::threadTask()
     while (true) {
         ThisThread::flags_wait_any(m_ThreadFlag);
 
-        // write any pending data
-        flushBuffer();
+        // write any pending complete sectors
+        flushBuffer(false);
 
         // flush the file so data is physically on sd card
+#if SD_LOGGER_DO_USE_CRASH_CONSISTENT_MODE
+        if (flush_timer.elapsed_time() >= std::chrono::milliseconds{SD_LOGGER_SYNC_PERIOD_MS}) {
+#else
         if (flush_timer.elapsed_time() >= 5s) {
+#endif
             flush_timer.reset();
 
             if (m_file_open) {
+                // also the incomplete last sector
+                flushBuffer(true);
+#if SD_LOGGER_DO_USE_CRASH_CONSISTENT_MODE
+                // everything before the sync block is on the card once the flush returns
+                if (m_use_log_format) {
+                    writeSyncBlock();
+                }
+#endif
                 bool ok = m_SDWriter.flush();
                 if (!ok) {
                     printf("SDLogger: fflush failed\n");
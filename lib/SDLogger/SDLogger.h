@@ -6,16 +6,46 @@
  * to an SD card in bursts from a low-priority thread. It manages thread creation, 
  * periodic flushing, and synchronization, providing a simple and efficient logging interface.
  *
+ * The ring buffer is a wait-free single producer single consumer byte ring, send() copies a
+ * whole record with one memcpy and never blocks the calling (control) thread. The thread writes
+ * whole 512 byte sectors of the file only (in chunks of SD_LOGGER_WRITE_SIZE bytes), so the FAT
+ * file system can write them directly as multi block writes, the rest is written with the
+ * periodic flush.
+ *
+ * If channels are declared with addChannel() before the first send(), the file is written in the
+ * typed log format of LogFormat.h instead: a schema with name, type, unit and rate per channel,
+ * then 512 byte data blocks with sequence number and CRC32, built by the thread. Channels can be
+ * grouped into streams with their own rate (addStream()), every data block holds the records of one
+ * stream with the index and the time of its first record. Narrow channel
+ * types (int8/int16/int32) cut the bandwidth, SD_LOGGER_DO_USE_COMPRESSION additionally compresses
+ * the data blocks lossless (XOR of floats, zigzag difference of integers). Without channels the
+ * file is the plain format of a "num_of_floats" byte followed by the float records.
+ *
+ * Every record is stamped with the 64 bit time in us of the mbed us ticker when it is sent (the
+ * time base of the SerialStream and the IMU), the data blocks store the difference to the previous
+ * record as varint, the plain format (SD_LOGGER_DO_USE_RECORD_TIME) the time of the first record
+ * and a uint32 difference per record, so the readers get the exact time of every record.
+ *
  * Maximum throughput depends on SD card speed and buffer size. If the buffer fills up, 
- * additional data is discarded. By default, data is flushed to disk every 5 seconds 
+ * additional data is discarded and counted. By default, data is flushed to disk every 5 seconds 
  * to reduce data loss in case of power failure.
  *
+ * SD_LOGGER_DO_USE_CRASH_CONSISTENT_MODE prepares for a power cut (brown out of the robot): a
+ * file of the typed log format is preallocated to SD_LOGGER_PREALLOCATE_SIZE bytes when the schema
+ * is written, so the file system has nothing to update while logging, and every
+ * SD_LOGGER_SYNC_PERIOD_MS the open blocks and a sync block with a running index are written and
+ * the file is synced. A closed file is truncated to the written size. The plain format is not
+ * preallocated, its readers can not tell the unused tail from records. With SD_LOGGER_RAW_PARTITION the blocks are
+ * written to a partition or the free space of the card without file system instead (see
+ * SDRawIndex.h). docs/cpp/log_recover extracts the intact blocks of every session from a damaged
+ * file or an image of the card, raw_extract the sessions of the raw region.
+ *
  * @dependencies
  * This class relies on:
  * - **SDWriter**: Handles SD card mounting, file creation, and binary writes.
- * - **CircularBuffer<float>**: Buffers incoming float data.
+ * - **SPSCRingBuffer**: Buffers incoming float data without locking.
+ * - **LogFormat**: Schema, block layout and CRC32 of the typed log format.
  * - **ThreadFlag** and **Ticker**: Schedule periodic buffer flushing.
- * - **Mutex**: Ensures thread-safe access to the buffer.
  *
  * @usage
  * 1. Create an `SDLogger` instance by specifying SPI pins and the number of floats per record.
@@ -35,6 +65,19 @@
  *
  * // send data to sd card
  * sd_logger.send();
+ *
+ * // typed log format, declare the channels once before the first send()
+ * sd_logger.addChannel("time", LOG_TYPE_FLOAT, "s", 500.0f);
+ * sd_logger.addChannel("angle", LOG_TYPE_INT16, "rad", 500.0f, 1.0e-4f);
+ * sd_logger.addChannel("mode", LOG_TYPE_INT8);
+ * // optional, a second stream at a lower rate
+ * const int slow = sd_logger.addStream();
+ * sd_logger.addChannel("battery", LOG_TYPE_INT16, "V", 10.0f, 1.0e-3f);
+ *
+ * sd_logger.write(time);
+ * sd_logger.write(angle);
+ * sd_logger.writeInt(mode); // the record of stream 0 is sent after its last channel
+ * sd_logger.write(slow, battery_voltage); // e.g. every 100th period
  * ```
  *
  * @author M. E. Peter
@@ -46,27 +89,41 @@
 
 #include "mbed.h"
 
+#include "LogFormat.h"
 #include "SDWriter.h"
+#include "SPSCRingBuffer.h"
 #include "ThreadFlag.h"
 
-#define SD_LOGGER_NUM_OF_FLOATS_MAX 100 // tested 22 floats at 500 Hz
+#define SD_LOGGER_NUM_OF_FLOATS_MAX 100 // tested 22 floats at 500 Hz, see docs/cpp/sdlogger_benchmark for the sustained rate
+#define SD_LOGGER_SECTOR_SIZE 512
+#define SD_LOGGER_DO_USE_COMPRESSION false // typed log format only: lossless compression of the data blocks in the logger thread, see LogFormat.h
+#define SD_LOGGER_WRITE_SIZE 2048 // the thread writes chunks of this many bytes (4 sectors), less often than every sector but frees the buffer while writing
+#define SD_LOGGER_DO_USE_CRASH_CONSISTENT_MODE false // preallocated file and sync blocks (typed log format only), fsync every SD_LOGGER_SYNC_PERIOD_MS
+#define SD_LOGGER_PREALLOCATE_SIZE (64UL * 1024UL * 1024UL) // 64 MB, about 25 min of 22 floats at 500 Hz, the file grows as usual beyond
+#define SD_LOGGER_SYNC_PERIOD_MS 1000
+#define SD_LOGGER_DO_USE_RECORD_TIME true // plain format: every record starts with the time difference in us to the previous one, see LogFormat.h
+#define SD_LOGGER_RAW_PARTITION 0 // 0: file /sd/data/xxx.bin, 1 ... 4: write to this primary partition without file system, 5 (SD_RAW_FREE_SPACE): to the space behind the last partition, needs the typed log format
 
 /**
  * A minimal thread-based SD logger that:
- * - Uses a larger CircularBuffer<float, BUFFER_SIZE>.
- * - Logs data in bursts from a low-priority thread.
- * - Flushes once per second so data is physically written.
- * - Prints a message if the buffer is full or if an SD write fails.
- * - Writes a "m_num_of_floats" byte at the file start (like a header).
+ * - Uses a lock free byte ring buffer of BUFFER_SIZE bytes on the heap, the state of the typed log
+ *   format is allocated with the first channel, so the object fits on the stack of main().
+ * - Logs data in bursts of whole sectors from a low-priority thread.
+ * - Flushes every 5 seconds so data is physically written.
+ * - Counts lost records if the buffer is full and prints them from the thread, prints if an SD write fails.
+ * - Counts records sent while no file is open separately, they are not a buffer overflow.
+ * - Writes a "m_num_of_floats" byte at the file start (like a header), or the schema and CRC checked
+ *   blocks of the typed log format if channels are declared.
  */
 class SDLogger
 {
 public:
-    // Increase buffer size for higher throughput / less overflow
-    // static const size_t BUFFER_SIZE = 8192; // 8k floats = 32kB
-    // static const size_t BUFFER_SIZE = 4096; // 4k floats = 16kB
-    static const size_t BUFFER_SIZE = 2048; // 2k floats = 8kB
-    // static const size_t BUFFER_SIZE = 1024; // e.g. 4kB
+    // Increase buffer size for higher throughput / less overflow, has to be a power of two and a multiple of the sector size
+    // 16kB bridge a card busy time of about 150 ms at 22 floats and 1 kHz, see docs/cpp/sdlogger_benchmark
+    // static const size_t BUFFER_SIZE = 32768; // 8k floats = 32kB
+    static const size_t BUFFER_SIZE = 16384; // 4k floats = 16kB
+    // static const size_t BUFFER_SIZE = 8192; // 2k floats = 8kB
+    // static const size_t BUFFER_SIZE = 4096; // e.g. 4kB
 
     /**
      * @param mosi          SPI MOSI pin
@@ -79,16 +136,56 @@ public:
     SDLogger(PinName mosi, PinName miso, PinName sck, PinName cs, uint8_t num_of_floats = SD_LOGGER_NUM_OF_FLOATS_MAX);
     ~SDLogger();
 
+    /**
+     * @brief Declare the next channel of a record for the typed log format, only before the first send().
+     *
+     * @param name  channel name, up to 15 characters
+     * @param type  LOG_TYPE_INT8, LOG_TYPE_INT16, LOG_TYPE_INT32 or LOG_TYPE_FLOAT
+     * @param unit  unit, up to 7 characters
+     * @param rate  nominal rate in Hz, 0 if unknown
+     * @param scale the stored value is round(value / scale), e.g. 1.0e-4f for an angle in rad as int16
+     * @return false if the channel is not added
+     */
+    bool addChannel(const char* name, uint8_t type = LOG_TYPE_FLOAT, const char* unit = "", float rate = 0.0f, float scale = 1.0f);
+
+    /**
+     * @brief Start a new stream for the typed log format, the following channels belong to it, only before the first send().
+     *
+     * A stream is a group of channels with its own record and rate, e.g. the battery voltage at 10 Hz
+     * besides the motor signals at 1 kHz, each record only carries the channels of its stream. Without
+     * addStream() all channels belong to stream 0.
+     *
+     * @return index of the stream for write(), writeInt() and send(), -1 if there are already 4 streams
+     */
+    int addStream();
+
     // write float values one by one (appends to the ring buffer automatically, but you need to write m_num_of_floats floats)
     void write(const float val);
+    // write an integer value to the next channel of the typed log format, int32 channels with scale 1 are exact
+    void writeInt(const int32_t val);
     // send the data immediately, this will be triggered automatically if you hav writte num_of_floats floats already
     void send();
 
+    // write to the next channel of a stream, the record of the stream is sent after its last channel
+    void write(uint8_t stream, const float val);
+    void writeInt(uint8_t stream, const int32_t val);
+    // send the record of a stream immediately, channels that were not written are zero
+    void send(uint8_t stream);
+    // number of channels of a stream of the typed log format, 0 without the typed log format or for an unknown stream
+    uint8_t getStreamNumOfChannels(uint8_t stream) const { return (m_use_log_format && (stream < m_LogFormat->schema.getNumOfStreams())) ? m_LogFormat->schema.getStreamNumOfChannels(stream) : 0; };
+
+    // number of records that were lost because the buffer was full
+    uint32_t getOverflowCount() const { return m_overflow_cntr; };
+    // number of records that were dropped because no file is open (no sd card, mount or open failed)
+    uint32_t getNoFileCount() const { return m_no_file_cntr; };
+    // prints the bytes written, the write rate, the max. fill level of the buffer, the max. write time and the lost records
+    void printStatistics() const;
+
 private:
     static constexpr int64_t PERIOD_MUS = 20000;
 
-    Mutex m_Mutex; // mutex to protect the ring buffer
-    CircularBuffer<float, BUFFER_SIZE> m_CircularBuffer;
+    uint8_t* m_buffer; // BUFFER_SIZE bytes on the heap, so the logger can be a local object of main()
+    SPSCRingBuffer m_RingBuffer; // written by the caller of send(), read by the thread
     SDWriter m_SDWriter;
 
     Thread m_Thread;
@@ -98,20 +195,75 @@ private:
     uint8_t m_num_of_floats;
     uint8_t m_float_cntr{0};
     bool m_file_open{false};
+    bool m_header_is_sent{false};
     float m_data[SD_LOGGER_NUM_OF_FLOATS_MAX];
 
+    // typed log format, allocated with the first channel (about 13 kB), the plain format does not carry it
+    struct LogFormatState {
+        LogSchema schema; // fixed before the first record enters the buffer
+        // the records of all streams, one after the other
+        uint8_t record[LOG_FORMAT_RECORD_SIZE_MAX];
+        uint16_t record_offsets[LOG_FORMAT_NUM_OF_STREAMS_MAX]{0};
+        uint8_t channel_cntrs[LOG_FORMAT_NUM_OF_STREAMS_MAX]{0};
+        uint32_t record_indices[LOG_FORMAT_NUM_OF_STREAMS_MAX]{0};
+
+        // the open data block of every stream, only used by the thread
+        LogDataBlock data_blocks[LOG_FORMAT_NUM_OF_STREAMS_MAX];
+        uint8_t record_thread[LOG_FORMAT_RECORD_SIZE_MAX];
+        // finished blocks, written in chunks of SD_LOGGER_WRITE_SIZE bytes
+        uint8_t blocks[SD_LOGGER_WRITE_SIZE];
+        uint8_t block_index{0};
+        uint32_t block_seq{0};
+        uint32_t sync_index{0};
+        bool schema_is_written{false};
+    };
+    LogFormatState* m_LogFormat{nullptr};
+    bool m_use_log_format{false};
+    uint16_t m_session{0}; // marks the blocks of this file, see LogFormat.h
+    uint64_t m_time_us{0}; // plain format: time of the last record in the buffer
+
+    // put in front of every record in the ring buffer, not written to the file
+    struct RecordHeader {
+        uint8_t stream;
+        uint8_t reserved[3];
+        uint32_t index; // counts the records of the stream, also the lost ones
+        uint64_t time_us;
+    };
+
+    // statistics, the producer side is only written by the caller of send(), the rest only by the thread
+    uint32_t m_overflow_cntr{0};
+    uint32_t m_overflow_cntr_reported{0};
+    uint32_t m_no_file_cntr{0};
+    uint32_t m_no_file_cntr_reported{0};
+    uint32_t m_fill_max{0};
+    uint32_t m_file_bytes{0};
+    uint32_t m_write_time_max_us{0};
+    Timer m_Timer;
+
     // log some float data (appends to ring buffer)
     void logFloats(const float* data);
     // log some float data (appends to ring buffer)
     void logFloats(const float* data, size_t count);
+    // appends a whole record (with an optional header) to the ring buffer, counts it as lost and returns false if it does not fit
+    bool logBytes(const void* header, size_t header_size, const void* data, size_t data_size);
     // opens a new file on the SD card, writes the "m_num_of_floats" as a header byte
     bool openFile();
     // closes the file
     void closeFile();
-    // helper to drain the buffer in chunks
-    void flushBuffer();
-    // helper to push floats into the ring buffer
-    bool pushFloats(const float* data, size_t count);
+    // helper to drain the buffer, only whole sectors of the file unless write_all is true
+    void flushBuffer(bool write_all);
+    // typed log format: packs the records of the buffer into the blocks of their streams, writes the incomplete blocks if write_all is true
+    void flushBlocks(bool write_all);
+    void addRecordToBlock(const RecordHeader& header, const uint8_t* record);
+    // finishes the data block of the stream, writes the blocks if all are used
+    void finishDataBlock(uint8_t stream);
+    // finishes all data blocks and writes them with a sync block behind them
+    void writeSyncBlock();
+    void writeBlocks();
+    // prints the records lost since the last call, buffer overflows and records without open file separately
+    void reportLostRecords();
+    // allocates the state of the typed log format, false if there is not enough memory
+    bool createLogFormat();
 
     void threadTask();
     void sendThreadFlag();
@@ -0,0 +1,69 @@
+/**
+ * @file SDRawIndex.h
+ * @brief Defines the index sector of the raw log region of the SDWriter.
+ *
+ * The raw region is a primary partition or the unpartitioned space behind the last partition of
+ * the SD card, it is written without file system. Block 0 of the region is the index, the other
+ * blocks are a ring of sessions (one session per start of the robot):
+ * - the index holds the last SD_RAW_NUM_OF_SESSIONS sessions with their first block and length,
+ *   a session is stored in the entry session % SD_RAW_NUM_OF_SESSIONS
+ * - the index is written when a session starts, at every flush, at least every
+ *   SD_RAW_INDEX_INTERVAL blocks and when the session is closed, a session that was cut off can
+ *   have up to SD_RAW_INDEX_INTERVAL blocks more than its entry tells
+ * - a new session starts behind the last one (SD_RAW_INDEX_INTERVAL blocks further if it was cut
+ *   off), at the end of the region it wraps around to block 1 and overwrites the oldest sessions
+ *
+ * The definitions do not depend on mbed, they are shared by the firmware and the host tools in
+ * docs/cpp.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef SD_RAW_INDEX_H_
+#define SD_RAW_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SD_RAW_BLOCK_SIZE 512
+#define SD_RAW_INDEX_MAGIC 0x58495250UL // "PRIX"
+#define SD_RAW_NUM_OF_SESSIONS 31
+#define SD_RAW_INDEX_INTERVAL 2048 // max. blocks (1 MB) written between two index updates
+#define SD_RAW_FREE_SPACE 5        // region: the unpartitioned space behind the last partition, 1 ... 4 are the primary partitions
+
+struct SDRawSession {
+    uint32_t session;       // running number starting with 1, 0 if the entry is unused
+    uint32_t first_block;   // relative to the region
+    uint32_t num_of_blocks; // the last block can be incomplete
+    uint32_t is_closed;     // 1 if the session was closed and num_of_blocks is exact
+};
+
+struct SDRawIndex {
+    uint32_t magic;
+    uint32_t num_of_blocks; // size of the region including the index, the index is reset if it changes
+    uint32_t last_session;
+    uint32_t checksum;      // sum of all other words, xor 0xFFFFFFFF
+    SDRawSession sessions[SD_RAW_NUM_OF_SESSIONS];
+};
+
+static_assert(sizeof(SDRawIndex) == SD_RAW_BLOCK_SIZE, "SDRawIndex has to be one block");
+
+inline uint32_t sdRawIndexChecksum(const SDRawIndex& index)
+{
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(&index);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sizeof(index) / sizeof(uint32_t); i++) {
+        if (i != offsetof(SDRawIndex, checksum) / sizeof(uint32_t))
+            sum += words[i];
+    }
+    return sum ^ 0xFFFFFFFFUL;
+}
+
+// next block of the ring of the region, block 0 is the index
+inline uint32_t sdRawWrapBlock(uint32_t block, uint32_t num_of_blocks)
+{
+    return 1 + (block - 1) % (num_of_blocks - 1);
+}
+
+#endif /* SD_RAW_INDEX_H_ */
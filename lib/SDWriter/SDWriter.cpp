@@ -31,36 +31,201 @@ bool SDWriter::mount()
     }
     ensureDirExists("/sd/data");
     m_mounted = true;
+    m_block_device_is_init = true;
     return true;
 }
 
 bool SDWriter::unmount()
 {
-    if (!m_mounted) {
-        return true;
-    }
     closeFile();
-    m_FATFileSystem.unmount();
-    m_SDBlockDevice.deinit();
-    m_mounted = false;
+    if (m_mounted) {
+        m_FATFileSystem.unmount();
+        m_mounted = false;
+    }
+    if (m_block_device_is_init) {
+        m_SDBlockDevice.deinit();
+        m_block_device_is_init = false;
+    }
     return true;
 }
 
-bool SDWriter::openNextFile()
+bool SDWriter::openNextFile(uint32_t preallocate_size)
 {
     if (!m_mounted) {
         printf("SDWriter: not mounted, can't open file\n");
         return false;
     }
     closeFile(); // in case one was open
-    return openNumberedFile();
+    if (!openNumberedFile()) {
+        return false;
+    }
+    if (preallocate_size > 0) {
+        // not fatal, the file grows while it is written
+        preallocate(preallocate_size);
+    }
+    return true;
+}
+
+bool SDWriter::openRaw(uint8_t region)
+{
+    if (m_mounted) {
+        printf("SDWriter: sd card is mounted, can't open a raw region\n");
+        return false;
+    }
+    if ((region < 1) || (region > SD_RAW_FREE_SPACE)) {
+        printf("SDWriter: region has to be a partition 1 ... 4 or SD_RAW_FREE_SPACE\n");
+        return false;
+    }
+    closeFile(); // in case one was open
+    if (!m_block_device_is_init) {
+        if (m_SDBlockDevice.init() != 0) {
+            printf("SDWriter: block device init failed\n");
+            return false;
+        }
+        if (m_SDBlockDevice.frequency(10000000) != 0) {
+            printf("SDWriter: set frequency failed (not fatal)\n");
+        }
+        m_block_device_is_init = true;
+    }
+
+    // partition table of the master boot record, four entries of 16 bytes at offset 446, a card that
+    // is formatted without partition table (superfloppy) has a fat boot sector in block 0 that also
+    // ends with 0x55 0xAA, its boot code would be read as partition entries
+    uint8_t block[SD_WRITER_BLOCK_SIZE];
+    if ((m_SDBlockDevice.read(block, 0, SD_WRITER_BLOCK_SIZE) != 0) || (block[510] != 0x55) || (block[511] != 0xAA)) {
+        printf("SDWriter: reading the partition table failed\n");
+        return false;
+    }
+    if ((memcmp(&block[54], "FAT", 3) == 0) || (memcmp(&block[82], "FAT", 3) == 0) || (memcmp(&block[3], "EXFAT", 5) == 0)) {
+        printf("SDWriter: block 0 is a fat boot sector, the card has no partition table\n");
+        return false;
+    }
+    const uint64_t card_blocks = m_SDBlockDevice.size() / SD_WRITER_BLOCK_SIZE;
+    uint32_t first_blocks[4];
+    uint32_t end_blocks[4];
+    uint8_t types[4];
+    uint8_t num_of_partitions = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        const uint8_t* entry = &block[446 + 16 * i];
+        uint32_t num_of_blocks;
+        memcpy(&first_blocks[i], &entry[8], sizeof(first_blocks[i]));
+        memcpy(&num_of_blocks, &entry[12], sizeof(num_of_blocks));
+        types[i] = entry[4];
+        end_blocks[i] = 0;
+        // the boot flag is 0x00 or 0x80, a used entry lies on the card behind block 0
+        const uint64_t end_block = static_cast<uint64_t>(first_blocks[i]) + num_of_blocks;
+        if (((entry[0] != 0x00) && (entry[0] != 0x80)) ||
+            ((types[i] != 0) && ((first_blocks[i] == 0) || (num_of_blocks == 0) || (end_block > card_blocks)))) {
+            printf("SDWriter: partition table entry %u is invalid\n", (unsigned)(i + 1));
+            return false;
+        }
+        if (types[i] == 0xEE) {
+            printf("SDWriter: the card has a gpt partition table, not supported\n");
+            return false;
+        }
+        if (types[i] != 0) {
+            end_blocks[i] = static_cast<uint32_t>(end_block);
+            num_of_partitions++;
+        }
+    }
+    if (num_of_partitions == 0) {
+        printf("SDWriter: the partition table is empty\n");
+        return false;
+    }
+
+    m_raw_first_block = 0;
+    m_raw_num_of_blocks = 0;
+    if (region == SD_RAW_FREE_SPACE) {
+        // behind the end of the last partition
+        for (uint8_t i = 0; i < 4; i++) {
+            if (end_blocks[i] > m_raw_first_block) {
+                m_raw_first_block = end_blocks[i];
+            }
+        }
+        m_raw_num_of_blocks = static_cast<uint32_t>(card_blocks - m_raw_first_block);
+    } else {
+        // never a partition with a file system or an extended partition, and it must not overlap another one
+        const uint8_t i = region - 1;
+        const uint8_t type = types[i];
+        if ((type == 0) || isFileSystemType(type)) {
+            printf("SDWriter: partition %u is unused or has a file system (type 0x%02X)\n", (unsigned)region, (unsigned)type);
+            return false;
+        }
+        for (uint8_t j = 0; j < 4; j++) {
+            if ((j != i) && (types[j] != 0) && (first_blocks[j] < end_blocks[i]) && (first_blocks[i] < end_blocks[j])) {
+                printf("SDWriter: partition %u overlaps partition %u\n", (unsigned)region, (unsigned)(j + 1));
+                return false;
+            }
+        }
+        m_raw_first_block = first_blocks[i];
+        m_raw_num_of_blocks = end_blocks[i] - first_blocks[i];
+    }
+    if ((m_raw_first_block == 0) || (m_raw_num_of_blocks < 2 * SD_RAW_INDEX_INTERVAL)) {
+        printf("SDWriter: raw region %u is missing or too small\n", (unsigned)region);
+        return false;
+    }
+
+    // the index is reset if it is invalid or the size of the region changed
+    const uint64_t index_addr = static_cast<uint64_t>(m_raw_first_block) * SD_WRITER_BLOCK_SIZE;
+    if (m_SDBlockDevice.read(&m_RawIndex, index_addr, SD_WRITER_BLOCK_SIZE) != 0) {
+        printf("SDWriter: reading the raw index failed\n");
+        return false;
+    }
+    if ((m_RawIndex.magic != SD_RAW_INDEX_MAGIC) || (m_RawIndex.checksum != sdRawIndexChecksum(m_RawIndex)) ||
+        (m_RawIndex.num_of_blocks != m_raw_num_of_blocks)) {
+        memset(&m_RawIndex, 0, sizeof(m_RawIndex));
+        m_RawIndex.magic = SD_RAW_INDEX_MAGIC;
+        m_RawIndex.num_of_blocks = m_raw_num_of_blocks;
+    }
+
+    // the new session starts behind the last one, a session that was cut off can have written up to
+    // SD_RAW_INDEX_INTERVAL blocks more than its entry tells
+    m_raw_block = 1;
+    if (m_RawIndex.last_session != 0) {
+        const SDRawSession& last = m_RawIndex.sessions[m_RawIndex.last_session % SD_RAW_NUM_OF_SESSIONS];
+        const uint32_t num_of_blocks = last.num_of_blocks + (last.is_closed ? 0 : SD_RAW_INDEX_INTERVAL);
+        m_raw_block = sdRawWrapBlock(last.first_block + num_of_blocks, m_raw_num_of_blocks);
+    }
+    m_file_number = m_RawIndex.last_session + 1;
+    SDRawSession& session = m_RawIndex.sessions[m_file_number % SD_RAW_NUM_OF_SESSIONS];
+    session.session = m_file_number;
+    session.first_block = m_raw_block;
+    session.num_of_blocks = 0;
+    session.is_closed = 0;
+    m_RawIndex.last_session = m_file_number;
+
+    m_raw_blocks_written = 0;
+    m_raw_sector_size = 0;
+    m_is_raw = true;
+    if (!writeRawIndex()) {
+        m_is_raw = false;
+        return false;
+    }
+    printf("SDWriter: opened raw region %u, session %lu at block %lu of %lu\n", (unsigned)region,
+           (unsigned long)m_file_number, (unsigned long)m_raw_block, (unsigned long)m_raw_num_of_blocks);
+    return true;
 }
 
 void SDWriter::closeFile()
 {
+    if (m_is_raw) {
+        // the length of a closed session is exact
+        m_RawIndex.sessions[m_file_number % SD_RAW_NUM_OF_SESSIONS].is_closed = 1;
+        flush();
+        m_is_raw = false;
+        printf("SDWriter: raw session closed\n");
+    }
     if (m_FilePtr) {
+        // the readers of the plain format have no framing, they would read the unused tail as records
+        if (m_preallocated_size > m_file_size) {
+            if ((fflush(m_FilePtr) != 0) || (ftruncate(fileno(m_FilePtr), m_file_size) != 0)) {
+                printf("SDWriter: truncating to %lu bytes failed\n", (unsigned long)m_file_size);
+            }
+        }
         fclose(m_FilePtr);
         m_FilePtr = nullptr;
+        m_file_size = 0;
+        m_preallocated_size = 0;
         printf("SDWriter: file closed\n");
     }
 }
@@ -71,6 +236,7 @@ bool SDWriter::writeByte(uint8_t b)
         return false;
     }
     size_t written = fwrite(&b, 1, 1, m_FilePtr);
+    m_file_size += written;
     if (written != 1) {
         printf("SDWriter: writeByte failed\n");
         return false;
@@ -99,6 +265,7 @@ bool SDWriter::writeFloats(const float* data, size_t count)
         return false;
     }
     size_t written = fwrite(data, sizeof(float), count, m_FilePtr);
+    m_file_size += written * sizeof(float);
     if (written != count) {
         printf("SDWriter: writeFloats failed (wrote %u of %u)\n",
                (unsigned)written, (unsigned)count);
@@ -107,8 +274,61 @@ bool SDWriter::writeFloats(const float* data, size_t count)
     return true;
 }
 
+bool SDWriter::writeBytes(const void* data, size_t size)
+{
+    if (m_is_raw) {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        // complete the incomplete last block first
+        if (m_raw_sector_size > 0) {
+            const size_t size_head = (size < SD_WRITER_BLOCK_SIZE - m_raw_sector_size) ? size : SD_WRITER_BLOCK_SIZE - m_raw_sector_size;
+            memcpy(&m_raw_sector[m_raw_sector_size], src, size_head);
+            m_raw_sector_size += size_head;
+            src += size_head;
+            size -= size_head;
+            if (m_raw_sector_size < SD_WRITER_BLOCK_SIZE) {
+                return true;
+            }
+            if (!writeRawBlocks(m_raw_sector, 1)) {
+                return false;
+            }
+            m_raw_sector_size = 0;
+        }
+        // whole blocks directly, the rest is kept until it is complete
+        const uint32_t num_of_blocks = static_cast<uint32_t>(size / SD_WRITER_BLOCK_SIZE);
+        if ((num_of_blocks > 0) && !writeRawBlocks(src, num_of_blocks)) {
+            return false;
+        }
+        m_raw_sector_size = size - num_of_blocks * SD_WRITER_BLOCK_SIZE;
+        memcpy(m_raw_sector, src + num_of_blocks * SD_WRITER_BLOCK_SIZE, m_raw_sector_size);
+        return true;
+    }
+    if (!m_FilePtr) {
+        return false;
+    }
+    size_t written = fwrite(data, 1, size, m_FilePtr);
+    m_file_size += written;
+    if (written != size) {
+        printf("SDWriter: writeBytes failed (wrote %u of %u)\n",
+               (unsigned)written, (unsigned)size);
+        return false;
+    }
+    return true;
+}
+
 bool SDWriter::flush()
 {
+    if (m_is_raw) {
+        // the incomplete last block is written again when it is complete
+        if (m_raw_sector_size > 0) {
+            memset(&m_raw_sector[m_raw_sector_size], 0, SD_WRITER_BLOCK_SIZE - m_raw_sector_size);
+            const uint64_t addr = static_cast<uint64_t>(m_raw_first_block + m_raw_block) * SD_WRITER_BLOCK_SIZE;
+            if (m_SDBlockDevice.program(m_raw_sector, addr, SD_WRITER_BLOCK_SIZE) != 0) {
+                printf("SDWriter: raw write failed\n");
+                return false;
+            }
+        }
+        return writeRawIndex();
+    }
     if (!m_FilePtr) {
         return false;
     }
@@ -116,7 +336,12 @@ bool SDWriter::flush()
         printf("SDWriter: fflush failed\n");
         return false;
     }
-    // on some systems, you could also call fsync(fileno(m_FilePtr)) if available.
+    // fflush only empties the stdio buffer, fsync writes the file size and the cluster chain, without it
+    // the file is empty after a power cut
+    if (fsync(fileno(m_FilePtr)) != 0) {
+        printf("SDWriter: fsync failed\n");
+        return false;
+    }
     return true;
 }
 
@@ -136,6 +361,10 @@ bool SDWriter::openNumberedFile()
             // this file doesn't exist yet, so create it:
             m_FilePtr = fopen(m_file_path, "wb");
             if (m_FilePtr) {
+                m_file_number = i;
+                // the file system buffers partial sectors itself, the stdio buffer would only add
+                // a copy and split large writes into small ones
+                setvbuf(m_FilePtr, nullptr, _IONBF, 0);
                 printf("SDWriter: opened %s\n", m_file_path);
                 return true;
             } else {
@@ -149,3 +378,85 @@ bool SDWriter::openNumberedFile()
     printf("SDWriter: no more file slots up to 999!\n");
     return false;
 }
+
+bool SDWriter::preallocate(uint32_t size)
+{
+    if (!m_FilePtr || (size <= m_file_size)) {
+        return false;
+    }
+    // writing the last byte allocates all clusters up to it, fsync writes them and the size to the card
+    const bool ok = (fseek(m_FilePtr, size - 1, SEEK_SET) == 0) && (fputc(0, m_FilePtr) != EOF) &&
+                    (fflush(m_FilePtr) == 0) && (fsync(fileno(m_FilePtr)) == 0);
+    if (!ok) {
+        printf("SDWriter: preallocating %lu bytes failed\n", (unsigned long)size);
+    }
+    // also after a failure, the file may be partly extended, closeFile() truncates it
+    m_preallocated_size = size;
+    fseek(m_FilePtr, m_file_size, SEEK_SET);
+    return ok;
+}
+
+bool SDWriter::writeRawBlocks(const uint8_t* data, uint32_t num_of_blocks)
+{
+    while (num_of_blocks > 0) {
+        // the index never lags more than SD_RAW_INDEX_INTERVAL blocks behind
+        if (m_raw_blocks_since_index >= SD_RAW_INDEX_INTERVAL) {
+            if (!writeRawIndex()) {
+                return false;
+            }
+        }
+        // one multi block write up to the end of the region
+        uint32_t n = num_of_blocks;
+        if (n > SD_RAW_INDEX_INTERVAL - m_raw_blocks_since_index) {
+            n = SD_RAW_INDEX_INTERVAL - m_raw_blocks_since_index;
+        }
+        if (n > m_raw_num_of_blocks - m_raw_block) {
+            n = m_raw_num_of_blocks - m_raw_block;
+        }
+        const uint64_t addr = static_cast<uint64_t>(m_raw_first_block + m_raw_block) * SD_WRITER_BLOCK_SIZE;
+        if (m_SDBlockDevice.program(data, addr, static_cast<uint64_t>(n) * SD_WRITER_BLOCK_SIZE) != 0) {
+            printf("SDWriter: raw write failed\n");
+            return false;
+        }
+        m_raw_block = sdRawWrapBlock(m_raw_block + n, m_raw_num_of_blocks);
+        m_raw_blocks_written += n;
+        m_raw_blocks_since_index += n;
+        data += n * SD_WRITER_BLOCK_SIZE;
+        num_of_blocks -= n;
+    }
+    return true;
+}
+
+bool SDWriter::writeRawIndex()
+{
+    // the incomplete last block belongs to the session
+    SDRawSession& session = m_RawIndex.sessions[m_file_number % SD_RAW_NUM_OF_SESSIONS];
+    session.num_of_blocks = m_raw_blocks_written + ((m_raw_sector_size > 0) ? 1 : 0);
+    m_RawIndex.checksum = sdRawIndexChecksum(m_RawIndex);
+    if (m_SDBlockDevice.program(&m_RawIndex, static_cast<uint64_t>(m_raw_first_block) * SD_WRITER_BLOCK_SIZE, SD_WRITER_BLOCK_SIZE) != 0) {
+        printf("SDWriter: writing the raw index failed\n");
+        return false;
+    }
+    m_raw_blocks_since_index = 0;
+    return true;
+}
+
+bool SDWriter::isFileSystemType(uint8_t type)
+{
+    switch (type) {
+        case 0x01: // fat12
+        case 0x04: // fat16 < 32 MB
+        case 0x05: // extended
+        case 0x06: // fat16
+        case 0x07: // exfat, ntfs
+        case 0x0B: // fat32 chs
+        case 0x0C: // fat32 lba
+        case 0x0E: // fat16 lba
+        case 0x0F: // extended lba
+        case 0x83: // linux
+        case 0x85: // linux extended
+            return true;
+        default:
+            return false;
+    }
+}
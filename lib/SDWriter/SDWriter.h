@@ -9,6 +9,23 @@
  *
  * Data is written in raw binary format for efficiency. The user can also call `flush()` 
  * to ensure data is physically committed, reducing the risk of corruption due to power loss.
+ * `flush()` also updates the size of the file in the directory (fsync), without it a power cut
+ * loses the whole file.
+ *
+ * Power loss resilience:
+ * - `openNextFile(preallocate_size)` extends the new file to its final size at once, the clusters
+ *   are allocated and the size is in the directory before the first write, so a power cut does
+ *   not lose data that is already on the card (FAT updates only happen when the file grows
+ *   beyond the preallocated size), the unused tail of the file is not cleared, `preallocate()` does
+ *   the same later, e.g. once the format of the file is known. `closeFile()` truncates a
+ *   preallocated file to the written size, after a power cut it keeps the preallocated size
+ * - `openRaw(region)` writes to a region of the card without a file system, a primary partition
+ *   (e.g. a second partition of type 0xDA next to the FAT partition) or the unpartitioned space
+ *   behind the last partition (SD_RAW_FREE_SPACE). There is no cluster allocation and no FAT or
+ *   directory update, the blocks are written sequentially with multi block writes. Block 0 of the
+ *   region is an index of the sessions (see SDRawIndex.h), every `openRaw()` starts a new session
+ *   behind the previous one. Writes are collected to whole blocks, `flush()` writes the incomplete
+ *   last block (it is written again when it is complete) and the index.
  *
  * @dependencies
  * This class relies on:
@@ -19,6 +36,7 @@
  * 1. Mount the SD card using `mount()`.
  * 2. Open a new sequential file using `openNextFile()`.
  * 3. Write binary float data using `writeFloats(...)` or a single byte using `writeByte(...)`.
+ *    Instead of 1. and 2. `openRaw(...)` opens a raw region, only `writeBytes(...)` is supported.
  * 4. Optionally, call `flush()` to ensure data is physically written.
  * 5. When done, close the file and unmount the SD card.
  *
@@ -55,6 +73,10 @@
 #include <SDBlockDevice.h>
 #include <FATFileSystem.h>
 
+#include "SDRawIndex.h"
+
+#define SD_WRITER_BLOCK_SIZE 512
+
 class SDWriter
 {
 public:
@@ -64,10 +86,21 @@ public:
     bool mount();
     bool unmount();
 
-    // opens a new file like /sd/data/001.bin, /sd/data/002.bin, etc.
-    bool openNextFile();
+    // opens a new file like /sd/data/001.bin, /sd/data/002.bin, etc., preallocate_size > 0 extends it to this size at once
+    bool openNextFile(uint32_t preallocate_size = 0);
+    // opens primary partition 1 ... 4 or the space behind the last partition (SD_RAW_FREE_SPACE) as raw blocks,
+    // the sd card is not mounted, starts a new session, returns false without a valid partition table (e.g. a
+    // card formatted without partitions) or for a partition with a file system
+    bool openRaw(uint8_t region);
+    // extends the open file to size bytes at once, the file position is kept
+    bool preallocate(uint32_t size);
+    // a preallocated file is truncated to the written size
     void closeFile();
 
+    bool isRaw() const { return m_is_raw; };
+    // number of the file (1 for 001.bin) or the session of the raw region
+    uint32_t getFileNumber() const { return m_file_number; };
+
     // write a single byte (e.g. "number of floats" header).
     bool writeByte(uint8_t b);
 
@@ -77,7 +110,11 @@ public:
     // write 'count' floats to the file in binary.
     bool writeFloats(const float* data, size_t count);
 
-    // flush data to SD so it's physically written.
+    // write 'size' bytes to the file, whole 512 byte sectors at a sector aligned file position are
+    // written directly to the card (the stdio buffer is disabled)
+    bool writeBytes(const void* data, size_t size);
+
+    // flush data to SD so it's physically written and update the file size in the directory (or the raw index).
     bool flush();
 
 private:
@@ -89,8 +126,27 @@ private:
 
     int   m_file_counter{0}; // for enumerating new files
     char  m_file_path[64];   // current file path
+    uint32_t m_file_number{0};
+    uint32_t m_file_size{0};        // bytes written to the file
+    uint32_t m_preallocated_size{0};
+
+    // raw region, the block numbers are relative to the start of the region, block 0 is the index
+    SDRawIndex m_RawIndex;
+    bool m_is_raw{false};
+    bool m_block_device_is_init{false};
+    uint32_t m_raw_first_block{0};
+    uint32_t m_raw_num_of_blocks{0};
+    uint32_t m_raw_block{0};              // next block to write
+    uint32_t m_raw_blocks_written{0};
+    uint32_t m_raw_blocks_since_index{0};
+    uint8_t m_raw_sector[SD_WRITER_BLOCK_SIZE]; // incomplete last block
+    size_t m_raw_sector_size{0};
 
     bool ensureDirExists(const char* path);
     bool openNumberedFile();
+    bool writeRawBlocks(const uint8_t* data, uint32_t num_of_blocks);
+    bool writeRawIndex();
+    // partition types with a file system or of an extended partition, never used as raw region
+    static bool isFileSystemType(uint8_t type);
 };
 #endif /* SD_WRITER_H_ */
@@ -0,0 +1,108 @@
+#include "SPSCRingBuffer.h"
+
+#include <string.h>
+
+SPSCRingBuffer::SPSCRingBuffer(uint8_t* buffer, size_t capacity) : m_buffer(buffer),
+                                                                   m_capacity(capacity),
+                                                                   m_mask(capacity - 1)
+{
+}
+
+size_t SPSCRingBuffer::size() const
+{
+    return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+}
+
+size_t SPSCRingBuffer::free() const
+{
+    return m_capacity - size();
+}
+
+bool SPSCRingBuffer::push(const void* data, size_t size)
+{
+    return push(data, size, nullptr, 0);
+}
+
+bool SPSCRingBuffer::push(const void* header, size_t header_size, const void* data, size_t size)
+{
+    const uint32_t head = m_head.load(std::memory_order_relaxed);
+    const uint32_t tail = m_tail.load(std::memory_order_acquire);
+    if (header_size + size > m_capacity - (head - tail))
+        return false;
+
+    copyIn(head, header, header_size);
+    copyIn(head + static_cast<uint32_t>(header_size), data, size);
+    // one release store, the consumer sees both parts or nothing
+    m_head.store(head + static_cast<uint32_t>(header_size + size), std::memory_order_release);
+    return true;
+}
+
+void SPSCRingBuffer::copyIn(uint32_t head, const void* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    // at most two copies, up to the end of the buffer and from the start
+    const size_t index = head & m_mask;
+    const size_t size_to_end = m_capacity - index;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    if (size <= size_to_end) {
+        memcpy(&m_buffer[index], src, size);
+    } else {
+        memcpy(&m_buffer[index], src, size_to_end);
+        memcpy(&m_buffer[0], src + size_to_end, size - size_to_end);
+    }
+}
+
+size_t SPSCRingBuffer::reserve(uint8_t*& data)
+{
+    const uint32_t head = m_head.load(std::memory_order_relaxed);
+    const uint32_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t index = head & m_mask;
+    const size_t size_free = m_capacity - (head - tail);
+    const size_t size_to_end = m_capacity - index;
+    data = &m_buffer[index];
+    return (size_free < size_to_end) ? size_free : size_to_end;
+}
+
+void SPSCRingBuffer::commit(size_t size)
+{
+    const uint32_t head = m_head.load(std::memory_order_relaxed);
+    m_head.store(head + static_cast<uint32_t>(size), std::memory_order_release);
+}
+
+size_t SPSCRingBuffer::peek(const uint8_t*& data) const
+{
+    const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint32_t head = m_head.load(std::memory_order_acquire);
+    const size_t index = tail & m_mask;
+    const size_t size_used = head - tail;
+    const size_t size_to_end = m_capacity - index;
+    data = &m_buffer[index];
+    return (size_used < size_to_end) ? size_used : size_to_end;
+}
+
+void SPSCRingBuffer::consume(size_t size)
+{
+    const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    m_tail.store(tail + static_cast<uint32_t>(size), std::memory_order_release);
+}
+
+size_t SPSCRingBuffer::pop(void* data, size_t size)
+{
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    size_t size_copied = 0;
+    // two rounds cover the wrap around
+    for (int i = 0; (i < 2) && (size_copied < size); i++) {
+        const uint8_t* src;
+        size_t size_chunk = peek(src);
+        if (size_chunk == 0)
+            break;
+        if (size_chunk > size - size_copied)
+            size_chunk = size - size_copied;
+        memcpy(dst + size_copied, src, size_chunk);
+        consume(size_chunk);
+        size_copied += size_chunk;
+    }
+    return size_copied;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file SPSCRingBuffer.h
+ * @brief Defines the SPSCRingBuffer class, a wait-free single producer single consumer byte ring buffer.
+ *
+ * The SPSCRingBuffer class passes bytes from exactly one producer thread (e.g. the control loop)
+ * to exactly one consumer thread (e.g. the SD card writer) without a mutex or a critical section:
+ * - the producer only writes the head index, the consumer only writes the tail index, both are
+ *   std::atomic with acquire/release ordering, so neither side can block the other
+ * - data is copied in bulk with memcpy, at most two copies per call if the region wraps around
+ * - reserve()/commit() on the producer side and peek()/consume() on the consumer side give direct
+ *   access to the contiguous regions, e.g. to write the buffer to a file without an extra copy
+ * - the indices run freely and the capacity is a power of two, so all bytes can be used
+ *
+ * @usage
+ * ```
+ * static uint8_t buffer[8192];
+ * SPSCRingBuffer ring(buffer, sizeof(buffer));
+ *
+ * // producer, returns false and writes nothing if there is not enough space
+ * ring.push(data, size);
+ *
+ * // consumer
+ * const uint8_t* ptr;
+ * const size_t size = ring.peek(ptr);
+ * fwrite(ptr, 1, size, file);
+ * ring.consume(size);
+ * ```
+ *
+ * The class does not depend on mbed.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef SPSC_RING_BUFFER_H_
+#define SPSC_RING_BUFFER_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class SPSCRingBuffer
+{
+public:
+    // capacity has to be a power of two
+    explicit SPSCRingBuffer(uint8_t* buffer, size_t capacity);
+    ~SPSCRingBuffer() = default;
+
+    size_t capacity() const { return m_capacity; };
+    // number of bytes in the buffer, exact for the consumer, a lower bound for the producer
+    size_t size() const;
+    // number of free bytes, exact for the producer, a lower bound for the consumer
+    size_t free() const;
+
+    // producer: copies all size bytes or nothing, returns false if there is not enough space
+    bool push(const void* data, size_t size);
+    // producer: copies a header and data as one entry, all or nothing
+    bool push(const void* header, size_t header_size, const void* data, size_t size);
+    // producer: returns the number of contiguous free bytes at the head, data points to them
+    size_t reserve(uint8_t*& data);
+    // producer: makes size bytes written after reserve() visible to the consumer
+    void commit(size_t size);
+
+    // consumer: returns the number of contiguous bytes at the tail, data points to them
+    size_t peek(const uint8_t*& data) const;
+    // consumer: releases size bytes after peek()
+    void consume(size_t size);
+    // consumer: copies up to size bytes, returns the number of bytes copied
+    size_t pop(void* data, size_t size);
+
+private:
+    uint8_t* m_buffer;
+    size_t m_capacity;
+    size_t m_mask;
+
+    std::atomic<uint32_t> m_head{0}; // written by the producer only
+    std::atomic<uint32_t> m_tail{0}; // written by the consumer only
+
+    void copyIn(uint32_t head, const void* data, size_t size);
+};
+
+#endif /* SPSC_RING_BUFFER_H_ */
@@ -1,11 +1,38 @@
 #include "SensorBar.h"
 
+constexpr SensorBarDecodeTable SensorBar::decodeTable;
+
 SensorBar::SensorBar(PinName sda,
                      PinName scl,
                      float bar_dist,
                      bool run_as_thread) : distAxisToSensor(bar_dist)
-                                         , i2c(sda, scl)
+                                         , i2cBus(I2CBus::acquire(sda, scl))
+                                         , ownsI2CBus(true)
                                          , thread(osPriorityAboveNormal2, 4096)
+{
+    init(run_as_thread);
+}
+
+SensorBar::SensorBar(I2CBus& i2c_bus,
+                     float bar_dist,
+                     bool run_as_thread) : distAxisToSensor(bar_dist)
+                                         , i2cBus(&i2c_bus)
+                                         , ownsI2CBus(false)
+                                         , thread(osPriorityAboveNormal2, 4096)
+{
+    init(run_as_thread);
+}
+
+SensorBar::~SensorBar()
+{
+    ticker.detach();
+    thread.terminate();
+    // the bus of the pins is shared with the other drivers on it
+    if (ownsI2CBus)
+        I2CBus::release(i2cBus);
+}
+
+void SensorBar::init(bool run_as_thread)
 {
     // Store the received parameters into member variables
     deviceAddress = 0x3E<<1;
@@ -15,7 +42,12 @@ SensorBar::SensorBar(PinName sda,
     invertBits = 0;
     barStrobe = 0;
 
-    lastBarRawValue = lastBarPositionValue = 0;
+    lastBarRawValue = 0;
+    lastBarBinaryPosition = 0;
+
+    for (int raw = 0; raw < 256; raw++) {
+        angleTable[raw] = calcAngleRad(decodeTable.binaryPosition[raw]);
+    }
 
     angle = avg_angle = 0;
     nrOfLedsActive = 0;
@@ -31,12 +63,6 @@ SensorBar::SensorBar(PinName sda,
     }
 }
 
-SensorBar::~SensorBar()
-{
-    ticker.detach();
-    thread.terminate();
-}
-
 //Call .setBarStrobing(); to only illuminate while reading line
 void SensorBar::setBarStrobe()
 {
@@ -74,7 +100,7 @@ uint8_t SensorBar::getRaw()
 
 int8_t SensorBar::getBinaryPosition()
 {
-    return -lastBarPositionValue;
+    return lastBarBinaryPosition;
 }
 
 float SensorBar::getAngleRad()
@@ -103,11 +129,29 @@ bool SensorBar::isAnyLedActive()
 
 void SensorBar::update()
 {
-    //Assign values to each bit, -127 to 127, sum, and divide
-    int16_t accumulator = 0;
-    uint8_t bitsCounted = 0;
-    int16_t i;
+    readRaw();
+
+    //Update member variables, all of them are precomputed per raw value
+    lastBarBinaryPosition = decodeTable.binaryPosition[lastBarRawValue];
+    nrOfLedsActive = decodeTable.nrOfLedsActive[lastBarRawValue];
+    angle = angleTable[lastBarRawValue];
+
+    if(nrOfLedsActive == 0) {
+        if(!is_first_avg) {
+            avg_filter.reset();
+            is_first_avg = true;
+        }
+    } else {
+        if(is_first_avg) {
+            is_first_avg = false;
+            avg_filter.reset(angle);
+        }
+        avg_angle = avg_filter.apply(angle);
+    }
+}
 
+uint8_t SensorBar::readRaw()
+{
     //Get the information from the wire, stores in lastBarRawValue
     if( barStrobe == 1 ) {
         writeByte(REG_DATA_B, 0x02); //Turn on IR
@@ -127,47 +171,7 @@ void SensorBar::update()
         writeByte(REG_DATA_B, 0x03); //Turn off IR and feedback when done
     }
 
-    //count bits
-    for ( i = 0; i < 8; i++ ) {
-        if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
-            bitsCounted++;
-        }
-    }
-
-    //Find the vector value of each positive bit and sum
-    for ( i = 7; i > 3; i-- ) { //iterate negative side bits
-        if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
-            accumulator += ((-32 * (i - 3)) + 1);
-        }
-    }
-    for ( i = 0; i < 4; i++ ) { //iterate positive side bits
-        if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
-            accumulator += ((32 * (4 - i)) - 1);
-        }
-    }
-
-    if ( bitsCounted > 0 ) {
-        lastBarPositionValue = accumulator / bitsCounted;
-    } else {
-        lastBarPositionValue = 0;
-    }
-
-    //Update member variables
-    angle = updateAngleRad();
-    nrOfLedsActive = updateNrOfLedsActive();
-
-    if(nrOfLedsActive == 0) {
-        if(!is_first_avg) {
-            avg_filter.reset();
-            is_first_avg = true;
-        }
-    } else {
-        if(is_first_avg) {
-            is_first_avg = false;
-            avg_filter.reset(angle);
-        }
-        avg_angle = avg_filter.apply(angle);
-    }
+    return lastBarRawValue;
 }
 
 //****************************************************************************//
@@ -219,10 +223,8 @@ void SensorBar::reset()
 //
 uint8_t SensorBar::readByte(uint8_t registerAddress)
 {
-    char readValue;
-    char data[2] = {registerAddress, 0};
-    i2c.write(deviceAddress, data, 1);
-    i2c.read(deviceAddress, &readValue, 1);
+    uint8_t readValue = 0;
+    i2cBus->readRegisters(deviceAddress, registerAddress, &readValue, 1, i2cFlag);
 
     return readValue;
 }
@@ -237,10 +239,8 @@ unsigned int SensorBar::readWord(uint8_t registerAddress)
     unsigned int readValue;
     unsigned int msb, lsb;
     //unsigned int timeout = RECEIVE_TIMEOUT_VALUE * 2;
-    char data[2] = {registerAddress, 0};
-    char r_data[2];
-    i2c.write(deviceAddress, data, 1);
-    i2c.read(deviceAddress, r_data, 2);
+    uint8_t r_data[2] = {0, 0};
+    i2cBus->readRegisters(deviceAddress, registerAddress, r_data, 2, i2cFlag);
     msb = ((unsigned int)r_data[0] & 0x00FF) << 8;
     lsb = ((unsigned int)r_data[1] & 0x00FF);
     readValue = msb | lsb;
@@ -256,9 +256,7 @@ unsigned int SensorBar::readWord(uint8_t registerAddress)
 //  - No return value.
 void SensorBar::readBytes(uint8_t firstRegisterAddress, char * destination, uint8_t length)
 {
-    char data[2] = {firstRegisterAddress, 0};
-    i2c.write(deviceAddress, data, 1);
-    i2c.read(deviceAddress, destination, length);
+    i2cBus->readRegisters(deviceAddress, firstRegisterAddress, reinterpret_cast<uint8_t*>(destination), length, i2cFlag);
 }
 
 // writeByte(uint8_t registerAddress, uint8_t writeValue)
@@ -268,8 +266,7 @@ void SensorBar::readBytes(uint8_t firstRegisterAddress, char * destination, uint
 //  - No return value.
 void SensorBar::writeByte(uint8_t registerAddress, uint8_t writeValue)
 {
-    char data[2] = {registerAddress, writeValue};
-    i2c.write(deviceAddress, data, 2);
+    i2cBus->writeRegisters(deviceAddress, registerAddress, &writeValue, 1, i2cFlag);
 }
 
 // writeWord(uint8_t registerAddress, ungisnged int writeValue)
@@ -282,8 +279,8 @@ void SensorBar::writeWord(uint8_t registerAddress, unsigned int writeValue)
     uint8_t msb, lsb;
     msb = ((writeValue & 0xFF00) >> 8);
     lsb = (writeValue & 0x00FF);
-    char data[3] = {registerAddress, msb, lsb};
-    i2c.write(deviceAddress, data, 3);
+    uint8_t data[2] = {msb, lsb};
+    i2cBus->writeRegisters(deviceAddress, registerAddress, data, 2, i2cFlag);
 }
 
 // writeBytes(uint8_t firstRegisterAddress, uint8_t * writeArray, uint8_t length)
@@ -295,12 +292,7 @@ void SensorBar::writeWord(uint8_t registerAddress, unsigned int writeValue)
 //  - no return value.
 void SensorBar::writeBytes(uint8_t firstRegisterAddress, uint8_t * writeArray, uint8_t length)
 {
-    char data[10] = {};
-    data[0] = firstRegisterAddress;
-    for(int i = 0; i < length; i++) {
-        data[1+i] = writeArray[i];
-    }
-    i2c.write(deviceAddress, data, length+1);
+    i2cBus->writeRegisters(deviceAddress, firstRegisterAddress, writeArray, length, i2cFlag);
 }
 
 void SensorBar::updateAsThread()
@@ -311,27 +303,12 @@ void SensorBar::updateAsThread()
     }
 }
 
-float SensorBar::updateAngleRad()
+float SensorBar::calcAngleRad(int8_t binaryPosition)
 {
-    int8_t binaryPosition  = getBinaryPosition();
     float position = static_cast<float>(binaryPosition) / 127.0f * 0.0445f; // 0.0445 m is half of sensor length
     return atan2f(position, distAxisToSensor);
 }
 
-uint8_t SensorBar::updateNrOfLedsActive()
-{
-    uint8_t bitsCounted = 0;
-    uint8_t i;
-
-    //count bits
-    for ( i = 0; i < 8; i++ ) {
-        if ( ((lastBarRawValue >> i) & 0x01) == 1 ) {
-            bitsCounted++;
-        }
-    }
-    return bitsCounted;
-}
-
 void SensorBar::sendThreadFlag()
 {
     thread.flags_set(threadFlag);
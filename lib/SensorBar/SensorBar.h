@@ -2,6 +2,8 @@
 #define SENSOR_BAR_H_
 
 #include "AvgFilter.h"
+#include "I2CBus.h"
+#include "SensorBarDecodeTable.h"
 #include "ThreadFlag.h"
 
 #define     REG_INPUT_DISABLE_B     0x00    //  RegInputDisableB Input buffer disable register _ I/O[15_8] (Bank B) 0000 0000
@@ -166,6 +168,10 @@ public:
                        PinName scl,
                        float bar_dist,
                        bool run_as_thread = true);
+    // use a shared (asynchronous) I2C bus, e.g. together with the IMU
+    explicit SensorBar(I2CBus& i2c_bus,
+                       float bar_dist,
+                       bool run_as_thread = true);
     ~SensorBar();
 
     static constexpr int64_t PERIOD_MUS = 4000;
@@ -181,14 +187,21 @@ public:
     float getAvgAngleRad();
     uint8_t getNrOfLedsActive();
     bool isAnyLedActive();
+    // reads the raw value and decodes it (position, angle, leds, average angle)
     void update();
+    // only reads the raw value, for users that decode it themselves (LineFollowerCntrl), the decoded values are not updated
+    uint8_t readRaw();
 
 private:
     // holding variables
     uint8_t lastBarRawValue;
-    uint8_t lastBarPositionValue;
+    int8_t lastBarBinaryPosition;
     float distAxisToSensor;
 
+    // lookup tables, the angle table depends on distAxisToSensor and is filled in the constructor
+    static constexpr SensorBarDecodeTable decodeTable{};
+    float angleTable[256];
+
     // settings
     uint8_t deviceAddress; // I2C Address of SX1509
     uint8_t barStrobe;     // 0 = always on, 1 = power saving by IR LED strobe
@@ -212,7 +225,9 @@ private:
     void writeWord(uint8_t registerAddress, unsigned int writeValue);
     void writeBytes(uint8_t firstRegisterAddress, uint8_t * writeArray, uint8_t length);
 
-    I2C i2c;
+    I2CBus* i2cBus;
+    bool ownsI2CBus; // acquired with the pins, released in the destructor
+    ThreadFlag i2cFlag;
 
     static const char REG_I_ON[16];
     static const char REG_T_ON[16];
@@ -229,9 +244,9 @@ private:
     AvgFilter avg_filter;
     bool is_first_avg;
 
+    void init(bool run_as_thread);
     void updateAsThread();
-    float updateAngleRad();
-    uint8_t updateNrOfLedsActive();
+    float calcAngleRad(int8_t binaryPosition);
     void sendThreadFlag();
 };
 
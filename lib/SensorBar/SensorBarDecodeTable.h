@@ -0,0 +1,35 @@
+#ifndef SENSOR_BAR_DECODE_TABLE_H_
+#define SENSOR_BAR_DECODE_TABLE_H_
+
+#include <stdint.h>
+
+/**
+ * Decoding of the 8 bit raw value of the sensor bar, evaluated at compile time.
+ *
+ * Each active led gets a weight, -127 ... 127 from the left to the right side, the
+ * binary position is the negative average of the weights of the active leds.
+ */
+struct SensorBarDecodeTable
+{
+    int8_t binaryPosition[256];
+    uint8_t nrOfLedsActive[256];
+
+    constexpr SensorBarDecodeTable() : binaryPosition(), nrOfLedsActive()
+    {
+        for (int raw = 0; raw < 256; raw++) {
+            int16_t accumulator = 0;
+            uint8_t bitsCounted = 0;
+            for (int i = 0; i < 8; i++) {
+                if (((raw >> i) & 0x01) == 1) {
+                    bitsCounted++;
+                    // negative side bits 7...4, positive side bits 3...0
+                    accumulator += (i > 3) ? ((-32 * (i - 3)) + 1) : ((32 * (4 - i)) - 1);
+                }
+            }
+            binaryPosition[raw] = (bitsCounted > 0) ? static_cast<int8_t>(-(accumulator / bitsCounted)) : 0;
+            nrOfLedsActive[raw] = bitsCounted;
+        }
+    }
+};
+
+#endif /* SENSOR_BAR_DECODE_TABLE_H_ */
@@ -0,0 +1,261 @@
+#include "SerialDma.h"
+
+#if SERIAL_DMA_HAS_STM32F4_DMA
+// dma stream of the uart transmitter (RM0390, DMA request mapping), the first entry of a uart is used
+typedef struct dma_stream_s {
+    UARTName uart;
+    DMA_TypeDef* dma;
+    DMA_Stream_TypeDef* stream;
+    uint8_t stream_num;
+    uint8_t channel;
+    IRQn_Type irq;
+} dma_stream_t;
+
+static const dma_stream_t s_dma_streams[] = {
+    {UART_1, DMA2, DMA2_Stream7, 7, 4, DMA2_Stream7_IRQn},
+    {UART_2, DMA1, DMA1_Stream6, 6, 4, DMA1_Stream6_IRQn},
+#if defined(USART3)
+    {UART_3, DMA1, DMA1_Stream3, 3, 4, DMA1_Stream3_IRQn},
+#endif
+#if defined(UART4)
+    {UART_4, DMA1, DMA1_Stream4, 4, 4, DMA1_Stream4_IRQn},
+#endif
+#if defined(UART5)
+    {UART_5, DMA1, DMA1_Stream7, 7, 4, DMA1_Stream7_IRQn},
+#endif
+#if defined(USART6)
+    {UART_6, DMA2, DMA2_Stream6, 6, 5, DMA2_Stream6_IRQn},
+#endif
+};
+static const int s_num_of_dma_streams = sizeof(s_dma_streams) / sizeof(s_dma_streams[0]);
+
+// owner of the dma stream, used by the interrupt
+static SerialDma* s_instances[6] = {nullptr};
+
+// the flags of a stream are at bit 0, 6, 16 or 22 of the low (stream 0 - 3) or high (stream 4 - 7) register
+#define SERIAL_DMA_FLAG_TC 0x20U
+#define SERIAL_DMA_FLAG_TE 0x08U
+#define SERIAL_DMA_FLAGS_ALL 0x3DU
+
+static uint32_t getFlagShift(const dma_stream_t& dma_stream)
+{
+    static const uint8_t shift[4] = {0, 6, 16, 22};
+    return shift[dma_stream.stream_num & 3];
+}
+
+static volatile uint32_t* getFlagClearRegister(const dma_stream_t& dma_stream)
+{
+    return (dma_stream.stream_num < 4) ? &dma_stream.dma->LIFCR : &dma_stream.dma->HIFCR;
+}
+
+static uint32_t getFlags(const dma_stream_t& dma_stream)
+{
+    const uint32_t flags = (dma_stream.stream_num < 4) ? dma_stream.dma->LISR : dma_stream.dma->HISR;
+    return (flags >> getFlagShift(dma_stream)) & SERIAL_DMA_FLAGS_ALL;
+}
+#endif
+
+SerialDma::SerialDma(PinName tx, PinName rx, int baudrate) : SerialBase(tx, rx, baudrate)
+{
+    // the uart is not clocked in deep sleep, also not while the dma is running
+    sleep_manager_lock_deep_sleep();
+
+#if SERIAL_DMA_HAS_STM32F4_DMA
+    // the vectors take a plain function, one per entry of the table
+    static void (*const dma_irqs[6])(void) = {
+        []() { dmaIrq(0); }, []() { dmaIrq(1); }, []() { dmaIrq(2); },
+        []() { dmaIrq(3); }, []() { dmaIrq(4); }, []() { dmaIrq(5); }
+    };
+
+    for (int i = 0; i < s_num_of_dma_streams; i++) {
+        if (s_dma_streams[i].uart == _serial.uart) {
+            m_dma_index = i;
+            break;
+        }
+    }
+    if (m_dma_index < 0 || s_instances[m_dma_index] != nullptr) {
+        printf("SerialDma: no free dma stream for this uart, using the asynchronous serial api\n");
+        m_dma_index = -1;
+        return;
+    }
+    s_instances[m_dma_index] = this;
+
+    const dma_stream_t& dma_stream = s_dma_streams[m_dma_index];
+    if (dma_stream.dma == DMA1)
+        __HAL_RCC_DMA1_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA2_CLK_ENABLE();
+
+    // memory to peripheral, byte wise, memory increment, direct mode (no fifo)
+    dma_stream.stream->CR = 0;
+    while (dma_stream.stream->CR & DMA_SxCR_EN) {};
+    dma_stream.stream->PAR = reinterpret_cast<uint32_t>(&reinterpret_cast<USART_TypeDef*>(dma_stream.uart)->DR);
+    dma_stream.stream->FCR = 0;
+    dma_stream.stream->CR = (static_cast<uint32_t>(dma_stream.channel) << DMA_SxCR_CHSEL_Pos) |
+                            DMA_SxCR_PL_0 | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    *getFlagClearRegister(dma_stream) = SERIAL_DMA_FLAGS_ALL << getFlagShift(dma_stream);
+
+    // the uart requests a byte from the dma whenever the data register is empty
+    reinterpret_cast<USART_TypeDef*>(dma_stream.uart)->CR3 |= USART_CR3_DMAT;
+
+    NVIC_SetVector(dma_stream.irq, reinterpret_cast<uint32_t>(dma_irqs[m_dma_index]));
+    NVIC_SetPriority(dma_stream.irq, SERIAL_DMA_IRQ_PRIORITY);
+    NVIC_EnableIRQ(dma_stream.irq);
+#endif
+}
+
+SerialDma::~SerialDma()
+{
+#if SERIAL_DMA_HAS_STM32F4_DMA
+    if (m_dma_index >= 0) {
+        const dma_stream_t& dma_stream = s_dma_streams[m_dma_index];
+        NVIC_DisableIRQ(dma_stream.irq);
+        dma_stream.stream->CR &= ~DMA_SxCR_EN;
+        reinterpret_cast<USART_TypeDef*>(dma_stream.uart)->CR3 &= ~USART_CR3_DMAT;
+        s_instances[m_dma_index] = nullptr;
+    }
+#endif
+#if DEVICE_SERIAL_ASYNCH
+    abort_write();
+#endif
+    sleep_manager_unlock_deep_sleep();
+}
+
+int SerialDma::writeable()
+{
+    core_util_critical_section_enter();
+    const int bytes_writeable = m_is_busy ? SERIAL_DMA_BUFFER_SIZE - m_pending_size : SERIAL_DMA_BUFFER_SIZE;
+    core_util_critical_section_exit();
+
+    return bytes_writeable;
+}
+
+int SerialDma::put(const void* buffer, int length, bool blocking)
+{
+    const char* ptr = static_cast<const char*>(buffer);
+    int count = length;
+    while (count > 0) {
+        // a frame larger than the buffer is only sent blocking, in pieces of the buffer size
+        const int size = (count < SERIAL_DMA_BUFFER_SIZE) ? count : SERIAL_DMA_BUFFER_SIZE;
+        if (queue(ptr, size)) {
+            ptr += size;
+            count -= size;
+        } else if (!blocking) {
+            m_dropped_cntr++;
+            break;
+        }
+    }
+
+    return length - count;
+}
+
+int SerialDma::readable()
+{
+    return SerialBase::readable() ? 1 : 0;
+}
+
+int SerialDma::get(void* buffer, int length, bool blocking)
+{
+    char* ptr = static_cast<char*>(buffer);
+    int count = 0;
+    while (count < length) {
+        if (SerialBase::readable())
+            ptr[count++] = static_cast<char>(_base_getc());
+        else if (!blocking)
+            break;
+    }
+
+    return count;
+}
+
+bool SerialDma::isDmaEnabled() const
+{
+#if SERIAL_DMA_HAS_STM32F4_DMA
+    return m_dma_index >= 0;
+#else
+    return false;
+#endif
+}
+
+#if SERIAL_DMA_HAS_STM32F4_DMA
+void SerialDma::dmaIrq(int index)
+{
+    const dma_stream_t& dma_stream = s_dma_streams[index];
+    const uint32_t flags = getFlags(dma_stream);
+    *getFlagClearRegister(dma_stream) = SERIAL_DMA_FLAGS_ALL << getFlagShift(dma_stream);
+
+    // after a transfer error the stream is disabled, the rest of the transfer is lost
+    if ((flags & (SERIAL_DMA_FLAG_TC | SERIAL_DMA_FLAG_TE)) && s_instances[index] != nullptr)
+        s_instances[index]->onTransferComplete();
+}
+#endif
+
+#if DEVICE_SERIAL_ASYNCH
+void SerialDma::onWriteComplete(int event)
+{
+    onTransferComplete();
+}
+#endif
+
+bool SerialDma::queue(const char* frame, int size)
+{
+    bool is_queued = true;
+
+    // the interrupt swaps the buffers, the copy of a frame (< 1 us) is done with the interrupts disabled
+    core_util_critical_section_enter();
+    if (!m_is_busy) {
+        memcpy(m_buffer[m_active], frame, size);
+        m_is_busy = true;
+        startTransfer(m_buffer[m_active], size);
+    } else if (m_pending_size + size <= SERIAL_DMA_BUFFER_SIZE) {
+        memcpy(&m_buffer[m_active ^ 1][m_pending_size], frame, size);
+        m_pending_size += size;
+    } else {
+        is_queued = false;
+    }
+    core_util_critical_section_exit();
+
+    if (is_queued)
+        m_frame_cntr++;
+
+    return is_queued;
+}
+
+void SerialDma::startTransfer(const char* buffer, int size)
+{
+    m_transfer_cntr++;
+
+#if SERIAL_DMA_HAS_STM32F4_DMA
+    if (m_dma_index >= 0) {
+        // the stream is disabled by the hardware at the end of the previous transfer
+        const dma_stream_t& dma_stream = s_dma_streams[m_dma_index];
+        *getFlagClearRegister(dma_stream) = SERIAL_DMA_FLAGS_ALL << getFlagShift(dma_stream);
+        dma_stream.stream->M0AR = reinterpret_cast<uint32_t>(buffer);
+        dma_stream.stream->NDTR = static_cast<uint32_t>(size);
+        dma_stream.stream->CR |= DMA_SxCR_EN;
+        return;
+    }
+#endif
+#if DEVICE_SERIAL_ASYNCH
+    SerialBase::write(reinterpret_cast<const uint8_t*>(buffer), size,
+                      callback(this, &SerialDma::onWriteComplete), SERIAL_EVENT_TX_COMPLETE);
+#else
+    // blocking, nothing is pending when the first buffer is started
+    for (int i = 0; i < size; i++)
+        _base_putc(buffer[i]);
+    onTransferComplete();
+#endif
+}
+
+void SerialDma::onTransferComplete()
+{
+    // start the frames queued in the meantime
+    if (m_pending_size > 0) {
+        const int size = m_pending_size;
+        m_active ^= 1;
+        m_pending_size = 0;
+        startTransfer(m_buffer[m_active], size);
+    } else {
+        m_is_busy = false;
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * @file SerialDma.h
+ * @brief Defines the SerialDma class, a serial port that transmits whole frames by DMA.
+ *
+ * The SerialDma class has the interface of the SerialPipe (writeable(), put(), readable(), get()),
+ * but it does not move the bytes to the UART in an interrupt per byte. A frame given to put() is
+ * copied into one of two buffers and transmitted by the DMA, the CPU is only interrupted when the
+ * DMA has moved the last byte of a transfer:
+ * - while the DMA transmits one buffer, frames are appended to the other buffer
+ * - the transfer complete interrupt starts the other buffer with all frames queued in the meantime,
+ *   so there is at most one interrupt per put() and the line stays busy without gaps
+ * - a frame is queued as a whole or not at all (frames up to SERIAL_DMA_BUFFER_SIZE bytes), a frame
+ *   that does not fit is dropped and counted, put() with blocking = true waits until it fits
+ *
+ * The DMA is programmed directly on the STM32F4 (e.g. USART2_TX is DMA1 stream 6 channel 4 on the
+ * Nucleo F446RE), the baud rate and the pins are configured by mbed. On other targets, or if the UART
+ * has no DMA stream, the mbed asynchronous serial API is used, which still interrupts the CPU per byte.
+ * The receiver is polled (readable(), get()), which is enough for single command bytes of the host.
+ *
+ * @dependencies
+ * This class relies on:
+ * - **SerialBase**: Configures the UART (pins, baud rate, format) and receives bytes.
+ * - **STM32F4 DMA**: Transfers the frames to the data register of the UART.
+ *
+ * @usage
+ * ```
+ * SerialDma serial_dma(PA_2, PA_3, 2000000);
+ *
+ * // in the control loop, the frame is copied and transmitted in the background
+ * if (serial_dma.writeable() >= sizeof(frame))
+ *     serial_dma.put(frame, sizeof(frame), false);
+ * ```
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef SERIAL_DMA_H_
+#define SERIAL_DMA_H_
+
+#include "mbed.h"
+
+#define SERIAL_DMA_BUFFER_SIZE 256 // bytes per buffer, 1.28 ms at 2 Mbaud
+#define SERIAL_DMA_IRQ_PRIORITY 6  // lower than the interrupts of the mbed drivers (0)
+
+#if defined(TARGET_STM32F4)
+    #define SERIAL_DMA_HAS_STM32F4_DMA true
+#else
+    #define SERIAL_DMA_HAS_STM32F4_DMA false
+#endif
+
+class SerialDma : public SerialBase
+{
+public:
+    SerialDma(PinName tx, PinName rx, int baudrate);
+    virtual ~SerialDma();
+
+    // number of bytes that can be queued, a frame of this size is accepted by put()
+    int writeable();
+    // queues the frame, returns the number of bytes queued (length or 0 if not blocking)
+    int put(const void* buffer, int length, bool blocking);
+
+    // number of received bytes (0 or 1, the receiver is polled)
+    int readable();
+    // reads up to length received bytes
+    int get(void* buffer, int length, bool blocking);
+
+    // true if the frames are transmitted by the DMA, false for the asynchronous serial API
+    bool isDmaEnabled() const;
+    uint32_t getNumOfFrames() const { return m_frame_cntr; };
+    // number of started transfers, also the number of interrupts
+    uint32_t getNumOfTransfers() const { return m_transfer_cntr; };
+    uint32_t getNumOfDroppedFrames() const { return m_dropped_cntr; };
+
+private:
+    char m_buffer[2][SERIAL_DMA_BUFFER_SIZE];
+    volatile uint8_t m_active{0};      // buffer that is transmitted
+    volatile int m_pending_size{0};    // bytes queued in the other buffer
+    volatile bool m_is_busy{false};
+
+    uint32_t m_frame_cntr{0};
+    volatile uint32_t m_transfer_cntr{0};
+    uint32_t m_dropped_cntr{0};
+
+#if SERIAL_DMA_HAS_STM32F4_DMA
+    int m_dma_index{-1}; // entry of the dma table, -1 if the uart has no dma stream
+
+    static void dmaIrq(int index);
+#endif
+#if DEVICE_SERIAL_ASYNCH
+    void onWriteComplete(int event);
+#endif
+
+    bool queue(const char* frame, int size);
+    void startTransfer(const char* buffer, int size);
+    void onTransferComplete();
+};
+
+#endif /* SERIAL_DMA_H_ */
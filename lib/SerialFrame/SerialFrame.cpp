@@ -0,0 +1,108 @@
+#include "SerialFrame.h"
+
+#include <string.h>
+
+uint16_t serialFrameCrc16(const void* data, size_t size, uint16_t crc)
+{
+    // nibble table, 32 bytes of flash instead of 512 bytes for the byte table
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        crc ^= static_cast<uint16_t>(ptr[i]) << 8;
+        crc = static_cast<uint16_t>((crc << 4) ^ table[crc >> 12]);
+        crc = static_cast<uint16_t>((crc << 4) ^ table[crc >> 12]);
+    }
+    return crc;
+}
+
+size_t serialFrameFinish(uint8_t* frame, uint8_t type, uint16_t seq, uint32_t time_us, size_t payload_size)
+{
+    frame[0] = type;
+    memcpy(&frame[1], &seq, sizeof(seq));
+    memcpy(&frame[3], &time_us, sizeof(time_us));
+
+    const size_t size = SERIAL_FRAME_HEADER_SIZE + payload_size;
+    const uint16_t crc = serialFrameCrc16(frame, size);
+    memcpy(&frame[size], &crc, sizeof(crc));
+    return size + SERIAL_FRAME_CRC_SIZE;
+}
+
+void serialFrameWriteInfo(uint8_t* payload, uint8_t num_of_floats, uint64_t time_us)
+{
+    payload[0] = SERIAL_FRAME_VERSION;
+    payload[1] = num_of_floats;
+    memcpy(&payload[2], &time_us, sizeof(time_us));
+}
+
+bool serialFrameReadInfo(const uint8_t* payload, size_t payload_size, uint8_t& num_of_floats, uint64_t& time_us)
+{
+    if ((payload_size < SERIAL_FRAME_INFO_SIZE) || (payload[0] == 0) || (payload[0] > SERIAL_FRAME_VERSION))
+        return false;
+
+    num_of_floats = payload[1];
+    memcpy(&time_us, &payload[2], sizeof(time_us));
+    return true;
+}
+
+size_t serialFrameEncode(const uint8_t* frame, size_t size, uint8_t* dst)
+{
+    // every code byte gives the distance to the next zero byte of the frame, 0xFF means 254 bytes without a zero
+    size_t code_index = 0;
+    size_t dst_index = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < size; i++) {
+        if (frame[i] != 0) {
+            dst[dst_index++] = frame[i];
+            code++;
+        }
+        if ((frame[i] == 0) || (code == 0xFF)) {
+            dst[code_index] = code;
+            code_index = dst_index++;
+            code = 1;
+        }
+    }
+    dst[code_index] = code;
+    dst[dst_index++] = 0;
+    return dst_index;
+}
+
+bool serialFrameDecode(const uint8_t* src, size_t size, uint8_t* frame, SerialFrameHeader& header,
+                       const uint8_t*& payload, size_t& payload_size)
+{
+    size_t frame_size = 0;
+    size_t i = 0;
+    while (i < size) {
+        const uint8_t code = src[i++];
+        if ((code == 0) || (i + code - 1 > size) || (frame_size + code - 1 > SERIAL_FRAME_SIZE_MAX))
+            return false;
+        for (uint8_t j = 1; j < code; j++) {
+            if (src[i] == 0)
+                return false;
+            frame[frame_size++] = src[i++];
+        }
+        // a code below 0xFF stands for a zero byte, except at the end of the frame
+        if ((code < 0xFF) && (i < size)) {
+            if (frame_size == SERIAL_FRAME_SIZE_MAX)
+                return false;
+            frame[frame_size++] = 0;
+        }
+    }
+
+    if ((frame_size < SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_CRC_SIZE) || (frame_size > SERIAL_FRAME_SIZE_MAX))
+        return false;
+
+    uint16_t crc;
+    memcpy(&crc, &frame[frame_size - SERIAL_FRAME_CRC_SIZE], sizeof(crc));
+    if (crc != serialFrameCrc16(frame, frame_size - SERIAL_FRAME_CRC_SIZE))
+        return false;
+
+    header.type = frame[0];
+    memcpy(&header.seq, &frame[1], sizeof(header.seq));
+    memcpy(&header.time_us, &frame[3], sizeof(header.time_us));
+    payload = &frame[SERIAL_FRAME_HEADER_SIZE];
+    payload_size = frame_size - SERIAL_FRAME_HEADER_SIZE - SERIAL_FRAME_CRC_SIZE;
+    return true;
+}
@@ -0,0 +1,80 @@
+/**
+ * @file SerialFrame.h
+ * @brief Defines the frames of the SerialStream protocol, shared by the firmware and the host receiver.
+ *
+ * Every record of the SerialStream is sent as one frame, so a lost or corrupted byte only affects
+ * its own frame and the receiver knows which records are missing:
+ * - frame: uint8 type, uint16 sequence number, uint32 time in us (low 32 bits of the us ticker of the
+ *   robot), the payload and the CRC16 (CCITT-FALSE, polynomial 0x1021, init 0xFFFF) of everything
+ *   before it, little endian
+ * - on the wire the frame is COBS coded (consistent overhead byte stuffing, one byte plus one byte per
+ *   254 bytes) and followed by a zero byte, a frame never contains a zero byte, so the receiver
+ *   starts a new frame after every zero byte, also after an error
+ * - info frame (SERIAL_FRAME_TYPE_INFO, once at the start, preceded by a zero byte to end the noise
+ *   the receiver might have seen before): uint8 version, uint8 number of floats per record and the
+ *   uint64 time in us of the start, sequence number 0
+ * - data frame (SERIAL_FRAME_TYPE_DATA): the floats of one record, the sequence number counts every
+ *   record of the stream, also the ones dropped by the robot because the serial buffer was full, so a
+ *   gap in the sequence numbers is a lost record wherever it was lost
+ *
+ * A record of 20 floats is a frame of 89 bytes and 91 bytes on the wire (2 kHz are 91 % of 2 Mbaud).
+ *
+ * The definitions do not depend on mbed, they are shared by the firmware and the host tools in
+ * docs/cpp.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef SERIAL_FRAME_H_
+#define SERIAL_FRAME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERIAL_FRAME_VERSION 1
+#define SERIAL_FRAME_TYPE_INFO 1
+#define SERIAL_FRAME_TYPE_DATA 2
+#define SERIAL_FRAME_HEADER_SIZE 7 // type, sequence number, time
+#define SERIAL_FRAME_CRC_SIZE 2
+#define SERIAL_FRAME_INFO_SIZE 10  // payload of the info frame
+#define SERIAL_FRAME_SIZE_MAX 256  // frame without coding, the receiver drops longer frames
+#define SERIAL_FRAME_PAYLOAD_SIZE_MAX (SERIAL_FRAME_SIZE_MAX - SERIAL_FRAME_HEADER_SIZE - SERIAL_FRAME_CRC_SIZE)
+// size on the wire of a frame of size bytes, including the zero byte
+#define SERIAL_FRAME_ENCODED_SIZE(size) ((size) + (size) / 254 + 2)
+
+struct SerialFrameHeader {
+    uint8_t type{0};
+    uint16_t seq{0};
+    uint32_t time_us{0};
+};
+
+// crc16 (ccitt-false, polynomial 0x1021, not reflected), continue with the returned value for more data
+uint16_t serialFrameCrc16(const void* data, size_t size, uint16_t crc = 0xFFFF);
+
+// writes the header in front of and the crc behind the payload at frame[SERIAL_FRAME_HEADER_SIZE], returns the frame size
+size_t serialFrameFinish(uint8_t* frame, uint8_t type, uint16_t seq, uint32_t time_us, size_t payload_size);
+
+// writes the payload of the info frame to payload (SERIAL_FRAME_INFO_SIZE bytes)
+void serialFrameWriteInfo(uint8_t* payload, uint8_t num_of_floats, uint64_t time_us);
+// returns false if the payload is not an info frame of a known version
+bool serialFrameReadInfo(const uint8_t* payload, size_t payload_size, uint8_t& num_of_floats, uint64_t& time_us);
+
+// cobs codes the frame and appends the zero byte, dst needs SERIAL_FRAME_ENCODED_SIZE(size) bytes, returns the size on the wire
+size_t serialFrameEncode(const uint8_t* frame, size_t size, uint8_t* dst);
+
+/**
+ * @brief Decodes the bytes between two zero bytes and checks the frame.
+ *
+ * @param src          cobs coded frame without the zero byte
+ * @param size         size of src
+ * @param frame        output, space for SERIAL_FRAME_SIZE_MAX bytes
+ * @param header       output, header of the frame
+ * @param payload      output, payload in frame
+ * @param payload_size output, size of the payload
+ * @return false if the coding, the size or the crc is invalid
+ */
+bool serialFrameDecode(const uint8_t* src, size_t size, uint8_t* frame, SerialFrameHeader& header,
+                       const uint8_t*& payload, size_t& payload_size);
+
+#endif /* SERIAL_FRAME_H_ */
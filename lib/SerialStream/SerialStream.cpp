@@ -4,9 +4,12 @@ SerialStream::SerialStream(uint8_t num_of_floats,
                            PinName tx,
                            PinName rx,
                            int baudrate) : _buffer_size(sizeof(float) * S_STREAM_CLAMP(num_of_floats))
-#if S_STREAM_DO_USE_SERIAL_PIPE
+#if S_STREAM_DO_USE_SERIAL_DMA
+                                         , _SerialDma(tx, rx, baudrate)
+{
+#elif S_STREAM_DO_USE_SERIAL_PIPE
                                          , _SerialPipe(tx, rx, baudrate, 1 + 1, // serial pipe extects 1 byte more
-                                                       sizeof(float) * S_STREAM_CLAMP(num_of_floats) + 1)
+                                                       S_STREAM_WIRE_SIZE(num_of_floats) + 1)
 {
 #else
                                          , _BufferedSerial(tx, rx, baudrate)
@@ -17,7 +20,7 @@ SerialStream::SerialStream(uint8_t num_of_floats,
 
 void SerialStream::write(const float val)
 {
-    memcpy(&_buffer[_byte_cntr], &val, sizeof(float));
+    memcpy(&_buffer[S_STREAM_HEADER_SIZE + _byte_cntr], &val, sizeof(float));
     _byte_cntr += sizeof(float);
 
     // send the data if the buffer is full immediately
@@ -31,19 +34,55 @@ void SerialStream::send()
     if (_byte_cntr == 0)
         return;
 
+    const uint64_t time_us = ticker_read_us(get_us_ticker_data());
+
     // blocking so that we guarantee that the number of floats is sent once
     // and it will not occupy the buffer for actual data to be sent
-    sendNumOfFloatsOnce();
+    sendNumOfFloatsOnce(time_us);
 
-#if S_STREAM_DO_USE_SERIAL_PIPE
-    // TODO: handle case where bytes_writeable < _byte_cntr
+#if S_STREAM_DO_USE_FRAMES
+    // the sequence number also counts a record that is dropped below, so the host sees it as lost
+    uint8_t* record = reinterpret_cast<uint8_t*>(_buffer);
+    const size_t record_size = serialFrameFinish(record, SERIAL_FRAME_TYPE_DATA, _seq++, static_cast<uint32_t>(time_us), _byte_cntr);
+    const int size = static_cast<int>(serialFrameEncode(record, record_size, _frame));
+    const void* data = _frame;
+#else
+#if S_STREAM_DO_USE_RECORD_TIME
+    // the difference to the last record sent, so a dropped record does not shift the times of the following ones
+    const uint32_t time_diff_us = static_cast<uint32_t>(time_us - _time_us);
+    memcpy(_buffer, &time_diff_us, sizeof(time_diff_us));
+#endif
+    const int size = S_STREAM_HEADER_SIZE + _byte_cntr;
+    const void* data = _buffer;
+#endif
+
+    // a record is sent completely or dropped, so the host stays aligned with the records
+#if S_STREAM_DO_USE_SERIAL_DMA
+    // the record is copied to the buffer of the DMA, it is transmitted in the background
+    if (_SerialDma.writeable() >= size) {
+        _SerialDma.put(data, size, false);
+        _time_us = time_us;
+    } else {
+        _dropped_cntr++;
+    }
+#elif S_STREAM_DO_USE_SERIAL_PIPE
     const int bytes_writeable = _SerialPipe.writeable();
-    if (bytes_writeable > 0)
-        _SerialPipe.put(&_buffer, _byte_cntr, false);
+    if (bytes_writeable >= size) {
+        _SerialPipe.put(data, size, false);
+        _time_us = time_us;
+    } else {
+        _dropped_cntr++;
+    }
 #else
-    // TODO: handle case where bytes_written < _byte_cntr
-    if (_BufferedSerial.writable())
-        ssize_t bytes_written = _BufferedSerial.write(_buffer, _byte_cntr);
+    if (_BufferedSerial.writable()) {
+        const ssize_t bytes_written = _BufferedSerial.write(data, size);
+        if (bytes_written == size)
+            _time_us = time_us;
+        else
+            _dropped_cntr++;
+    } else {
+        _dropped_cntr++;
+    }
 #endif
     _byte_cntr = 0;
 }
@@ -57,6 +96,11 @@ void SerialStream::reset()
 {
     memset(&_buffer, 0, sizeof(_buffer));
     _byte_cntr = 0;
+    _time_us = 0;
+    _dropped_cntr = 0;
+#if S_STREAM_DO_USE_FRAMES
+    _seq = 0;
+#endif
     resetByteMsg(_start);
     _send_num_of_floats_once = false;
 }
@@ -67,7 +111,12 @@ bool SerialStream::checkByteReceived(byte_msg_t& byte_msg, const uint8_t byte_ex
     if (byte_msg.byte == byte_expected)
         return true;
 
-#if S_STREAM_DO_USE_SERIAL_PIPE
+#if S_STREAM_DO_USE_SERIAL_DMA
+    if (!byte_msg.received && (_SerialDma.readable() > 0)) {
+        byte_msg.received = true;
+        _SerialDma.get(&byte_msg.byte, 1, false);
+    }
+#elif S_STREAM_DO_USE_SERIAL_PIPE
     const int bytes_readable = _SerialPipe.readable();
     if (!byte_msg.received && (bytes_readable > 0)) {
         byte_msg.received = true;
@@ -88,17 +137,38 @@ void SerialStream::resetByteMsg(byte_msg_t& byte_msg)
     byte_msg.received = false;
 }
 
-void SerialStream::sendNumOfFloatsOnce()
+void SerialStream::sendNumOfFloatsOnce(uint64_t time_us)
 {
     if (_send_num_of_floats_once)
         return;
     else {
         _send_num_of_floats_once = true;
-        const uint8_t num_of_floats = _byte_cntr / sizeof(float);
-#if S_STREAM_DO_USE_SERIAL_PIPE
-        _SerialPipe.put(&num_of_floats, 1, true);
+#if S_STREAM_DO_USE_FRAMES
+        // info frame, preceded by a zero byte that ends whatever the host has received before
+        uint8_t info[SERIAL_FRAME_HEADER_SIZE + SERIAL_FRAME_INFO_SIZE + SERIAL_FRAME_CRC_SIZE];
+        serialFrameWriteInfo(&info[SERIAL_FRAME_HEADER_SIZE], static_cast<uint8_t>(_byte_cntr / sizeof(float)), time_us);
+        const size_t info_size = serialFrameFinish(info, SERIAL_FRAME_TYPE_INFO, 0, static_cast<uint32_t>(time_us), SERIAL_FRAME_INFO_SIZE);
+        uint8_t header[1 + SERIAL_FRAME_ENCODED_SIZE(sizeof(info))];
+        header[0] = 0;
+        const size_t header_size = 1 + serialFrameEncode(info, info_size, &header[1]);
+        _time_us = time_us;
+#elif S_STREAM_DO_USE_RECORD_TIME
+        // followed by the time of the first record, its time difference is 0
+        uint8_t header[1 + sizeof(time_us)];
+        header[0] = static_cast<uint8_t>(_byte_cntr / sizeof(float)) | S_STREAM_TIME_FLAG;
+        memcpy(&header[1], &time_us, sizeof(time_us));
+        const size_t header_size = sizeof(header);
+        _time_us = time_us;
+#else
+        const uint8_t header[1] = {static_cast<uint8_t>(_byte_cntr / sizeof(float))};
+        const size_t header_size = sizeof(header);
+#endif
+#if S_STREAM_DO_USE_SERIAL_DMA
+        _SerialDma.put(header, header_size, true);
+#elif S_STREAM_DO_USE_SERIAL_PIPE
+        _SerialPipe.put(header, header_size, true);
 #else
-        _BufferedSerial.write(&num_of_floats, 1);
+        _BufferedSerial.write(header, header_size);
 #endif
     }
 }
@@ -1,8 +1,12 @@
 #pragma once
 
-#define S_STREAM_DO_USE_SERIAL_PIPE true
+// the records are transmitted by the DMA with one interrupt per record instead of one per byte (SerialPipe)
+#define S_STREAM_DO_USE_SERIAL_DMA true
+#define S_STREAM_DO_USE_SERIAL_PIPE true // used if the DMA is not used
 
-#if S_STREAM_DO_USE_SERIAL_PIPE
+#if S_STREAM_DO_USE_SERIAL_DMA
+    #include "SerialDma.h"
+#elif S_STREAM_DO_USE_SERIAL_PIPE
     #include "serial_pipe.h"
 #else
     #include "mbed.h"
@@ -11,6 +15,31 @@
 #define S_STREAM_NUM_OF_FLOATS_MAX 30 // tested at 2 kHz 20 floats
 #define S_STREAM_CLAMP(x) (x <= S_STREAM_NUM_OF_FLOATS_MAX ? x : S_STREAM_NUM_OF_FLOATS_MAX)
 #define S_STREAM_START_BYTE 255
+// every record is sent as a frame (see SerialFrame.h), COBS coded with sequence number, time and CRC16, so the host
+// finds the next record after a lost or corrupted byte and counts the lost records (docs/cpp/serial_receiver)
+#define S_STREAM_DO_USE_FRAMES true
+// without frames: every record starts with the uint32 time difference in us to the previous record, the "num_of_floats"
+// byte has S_STREAM_TIME_FLAG set and is followed by the uint64 time in us of the first record (plain format of the SDLogger)
+#define S_STREAM_DO_USE_RECORD_TIME true
+#define S_STREAM_TIME_FLAG 0x80
+#if S_STREAM_DO_USE_FRAMES
+    #include "SerialFrame.h"
+    #define S_STREAM_HEADER_SIZE SERIAL_FRAME_HEADER_SIZE
+    #define S_STREAM_TRAILER_SIZE SERIAL_FRAME_CRC_SIZE
+#elif S_STREAM_DO_USE_RECORD_TIME
+    #define S_STREAM_HEADER_SIZE 4
+    #define S_STREAM_TRAILER_SIZE 0
+#else
+    #define S_STREAM_HEADER_SIZE 0
+    #define S_STREAM_TRAILER_SIZE 0
+#endif
+#define S_STREAM_RECORD_SIZE(x) (S_STREAM_HEADER_SIZE + sizeof(float) * S_STREAM_CLAMP(x) + S_STREAM_TRAILER_SIZE)
+// bytes of a record on the wire
+#if S_STREAM_DO_USE_FRAMES
+    #define S_STREAM_WIRE_SIZE(x) SERIAL_FRAME_ENCODED_SIZE(S_STREAM_RECORD_SIZE(x))
+#else
+    #define S_STREAM_WIRE_SIZE(x) S_STREAM_RECORD_SIZE(x)
+#endif
 
 class SerialStream {
 public:
@@ -24,12 +53,24 @@ public:
     void send();
     bool startByteReceived();
     void reset();
+    uint8_t getNumOfFloats() const { return _buffer_size / sizeof(float); };
+    // number of records that were dropped because the transmit buffer was full
+    uint32_t getDroppedCount() const { return _dropped_cntr; };
 
 private:
-    char _buffer[sizeof(float) * S_STREAM_NUM_OF_FLOATS_MAX];
+    // the frame header or the time difference in front of the floats
+    char _buffer[S_STREAM_RECORD_SIZE(S_STREAM_NUM_OF_FLOATS_MAX)];
+#if S_STREAM_DO_USE_FRAMES
+    uint8_t _frame[S_STREAM_WIRE_SIZE(S_STREAM_NUM_OF_FLOATS_MAX)];
+    uint16_t _seq{0}; // counts every record, also the dropped ones
+#endif
     uint8_t _buffer_size;
     uint8_t _byte_cntr{0};
-#if S_STREAM_DO_USE_SERIAL_PIPE
+    uint64_t _time_us{0}; // time of the last record sent, the us ticker like the SDLogger
+    uint32_t _dropped_cntr{0};
+#if S_STREAM_DO_USE_SERIAL_DMA
+    SerialDma _SerialDma;
+#elif S_STREAM_DO_USE_SERIAL_PIPE
     SerialPipe _SerialPipe;
 #else
     BufferedSerial _BufferedSerial;
@@ -45,5 +86,5 @@ private:
 
     bool checkByteReceived(byte_msg_t& byte_msg, const uint8_t byte_expected);
     void resetByteMsg(byte_msg_t& byte_msg);
-    void sendNumOfFloatsOnce();
+    void sendNumOfFloatsOnce(uint64_t time_us);
 };
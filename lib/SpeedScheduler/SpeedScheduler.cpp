@@ -0,0 +1,217 @@
+#include "SpeedScheduler.h"
+
+SpeedScheduler::SpeedScheduler(float Ts, float bar_dist) : m_Ts(Ts),
+                                                           m_bar_dist(bar_dist)
+{
+    setReleaseTimeConstant(0.2f);
+    reset();
+}
+
+void SpeedScheduler::reset()
+{
+    m_curvature = 0.0f;
+    m_vel = 0.0f;
+    m_lap_state = LapState::IDLE;
+    m_is_lap_too_long = false;
+    m_distance = 0.0f;
+    m_lap_length = 0.0f;
+    m_num_of_bins = 0;
+}
+
+void SpeedScheduler::setLimits(float acc_lat_max, float acc_max, float dec_max)
+{
+    m_acc_lat_max = acc_lat_max;
+    m_acc_max = acc_max;
+    m_dec_max = fabsf(dec_max);
+}
+
+void SpeedScheduler::setReleaseTimeConstant(float tau_release)
+{
+    // discrete first order lowpass, 1 - exp(-Ts / tau)
+    m_release_coeff = (tau_release > 0.0f) ? 1.0f - expf(-m_Ts / tau_release) : 1.0f;
+}
+
+float SpeedScheduler::update(float vel_max, float angle, float v, float w, float curvature)
+{
+    // curvature of the line point at the sensor bar (pure pursuit) and of the current motion
+    float curvature_raw = curvature;
+    if (isnan(curvature_raw)) {
+        curvature_raw = fabsf(sinf(2.0f * angle)) / m_bar_dist;
+        if (fabsf(v) > 0.05f)
+            curvature_raw = fmaxf(curvature_raw, fabsf(w / v));
+    } else {
+        curvature_raw = fabsf(curvature_raw);
+    }
+
+    // fast attack, slow release
+    if (curvature_raw > m_curvature)
+        m_curvature = curvature_raw;
+    else
+        m_curvature += m_release_coeff * (curvature_raw - m_curvature);
+
+    m_distance += fabsf(v) * m_Ts;
+
+    float vel_target = calcCurvatureSpeedLimit(m_curvature, vel_max);
+
+    switch (m_lap_state) {
+        case LapState::RECORDING: {
+            const float bin_pos = m_distance / SPEED_SCHEDULER_BIN_LENGTH;
+            if (bin_pos >= static_cast<float>(SPEED_SCHEDULER_NUM_OF_BINS)) {
+                // the lap does not fit into the profile, a truncated profile would be wrong, stay reactive
+                m_is_lap_too_long = true;
+                m_lap_state = LapState::IDLE;
+                m_num_of_bins = 0;
+                break;
+            }
+            const uint16_t bin = static_cast<uint16_t>(bin_pos);
+            // record the unfiltered curvature, fill bins that were skipped at high velocity with the current value
+            while (m_num_of_bins <= bin)
+                m_profile[m_num_of_bins++] = curvature_raw;
+            m_profile[bin] = fmaxf(m_profile[bin], curvature_raw);
+            // vel_max drops while the robot turns, the profile is capped by the straight line velocity
+            m_vel_max_lap = fmaxf(m_vel_max_lap, vel_max);
+            break;
+        }
+        case LapState::REPLAYING:
+            // the distance drifts, if the lap is clearly longer than the recorded one the
+            // profile is not valid anymore and the scheduler falls back to the reactive limit
+            if (m_distance < 1.1f * m_lap_length) {
+                // look ahead by the distance travelled while the velocity controllers react
+                const float vel_profile = readProfile(m_distance + fabsf(v) * 5.0f * m_Ts);
+                // the reactive limit with some margin still catches large deviations from the recorded lap
+                vel_target = fminf(vel_profile, 1.25f * vel_target);
+            }
+            break;
+        default:
+            break;
+    }
+
+    // rate limit
+    const float dv = vel_target - m_vel;
+    if (dv > m_acc_max * m_Ts)
+        m_vel += m_acc_max * m_Ts;
+    else if (dv < -m_dec_max * m_Ts)
+        m_vel -= m_dec_max * m_Ts;
+    else
+        m_vel = vel_target;
+
+    // vel_max can drop faster than the deceleration limit (e.g. while the robot turns on the spot)
+    m_vel = fminf(m_vel, vel_max);
+
+    return m_vel;
+}
+
+void SpeedScheduler::enableLapProfile(bool enable)
+{
+    m_use_lap_profile = enable;
+    if (!enable) {
+        m_lap_state = LapState::IDLE;
+        m_is_lap_too_long = false;
+        m_num_of_bins = 0;
+    }
+}
+
+void SpeedScheduler::startLap()
+{
+    if (!m_use_lap_profile)
+        return;
+
+    switch (m_lap_state) {
+        case LapState::IDLE:
+            // first lap, start recording, unless the lap was already found to be too long
+            if (!m_is_lap_too_long) {
+                m_num_of_bins = 0;
+                m_vel_max_lap = 0.0f;
+                m_lap_state = LapState::RECORDING;
+            }
+            break;
+        case LapState::RECORDING:
+            if (m_num_of_bins > 0) {
+                m_lap_length = m_distance;
+                calcProfile(m_vel_max_lap);
+                m_lap_state = LapState::REPLAYING;
+            }
+            break;
+        default:
+            // replaying, only resynchronise the distance
+            break;
+    }
+    m_distance = 0.0f;
+}
+
+float SpeedScheduler::getCurvature() const
+{
+    return m_curvature;
+}
+
+float SpeedScheduler::getDistance() const
+{
+    return m_distance;
+}
+
+float SpeedScheduler::getLapLength() const
+{
+    return m_lap_length;
+}
+
+bool SpeedScheduler::isReplaying() const
+{
+    return m_lap_state == LapState::REPLAYING;
+}
+
+bool SpeedScheduler::isLapTooLong() const
+{
+    return m_is_lap_too_long;
+}
+
+float SpeedScheduler::calcCurvatureSpeedLimit(float curvature, float vel_max) const
+{
+    // v^2 * kappa <= acc_lat_max
+    if (curvature * vel_max * vel_max <= m_acc_lat_max)
+        return vel_max;
+    return sqrtf(m_acc_lat_max / curvature);
+}
+
+void SpeedScheduler::calcProfile(float vel_max)
+{
+    // curvature limit per bin
+    for (uint16_t i = 0; i < m_num_of_bins; i++)
+        m_profile[i] = calcCurvatureSpeedLimit(m_profile[i], vel_max);
+
+    // the lap is closed, so both passes run twice around the lap to propagate the limits over the start / finish
+    const float ds = SPEED_SCHEDULER_BIN_LENGTH;
+
+    // backward pass, brake before a bend: v_i^2 <= v_i+1^2 + 2 * dec_max * ds
+    for (int32_t k = 2 * m_num_of_bins - 1; k >= 0; k--) {
+        const uint16_t i = static_cast<uint16_t>(k % m_num_of_bins);
+        const uint16_t i_next = static_cast<uint16_t>((i + 1) % m_num_of_bins);
+        const float vel = sqrtf(m_profile[i_next] * m_profile[i_next] + 2.0f * m_dec_max * ds);
+        m_profile[i] = fminf(m_profile[i], vel);
+    }
+
+    // forward pass, accelerate out of a bend: v_i^2 <= v_i-1^2 + 2 * acc_max * ds
+    for (uint32_t k = 0; k < 2u * m_num_of_bins; k++) {
+        const uint16_t i = static_cast<uint16_t>(k % m_num_of_bins);
+        const uint16_t i_prev = static_cast<uint16_t>((i + m_num_of_bins - 1) % m_num_of_bins);
+        const float vel = sqrtf(m_profile[i_prev] * m_profile[i_prev] + 2.0f * m_acc_max * ds);
+        m_profile[i] = fminf(m_profile[i], vel);
+    }
+}
+
+float SpeedScheduler::readProfile(float distance) const
+{
+    // wrap around the start / finish
+    if (m_lap_length > 0.0f)
+        distance = fmodf(distance, m_lap_length);
+
+    // the profile values are the velocities at the start of the bins, interpolate v^2 (constant
+    // acceleration) in between, otherwise the robot would only start to brake one bin too late
+    const float bin_pos = distance / SPEED_SCHEDULER_BIN_LENGTH;
+    uint16_t bin = static_cast<uint16_t>(bin_pos);
+    if (bin >= m_num_of_bins)
+        bin = m_num_of_bins - 1;
+    const uint16_t bin_next = static_cast<uint16_t>((bin + 1) % m_num_of_bins);
+    const float frac = fminf(bin_pos - static_cast<float>(bin), 1.0f);
+    const float vel_sq = (1.0f - frac) * m_profile[bin] * m_profile[bin] + frac * m_profile[bin_next] * m_profile[bin_next];
+    return sqrtf(vel_sq);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file SpeedScheduler.h
+ * @brief Defines the SpeedScheduler class, a curvature aware translational speed scheduler.
+ *
+ * The SpeedScheduler estimates the curvature of the path and limits the translational
+ * velocity so that the lateral acceleration v^2 * kappa stays below a given limit. The
+ * commanded velocity is rate limited with separate acceleration and deceleration limits.
+ *
+ * The curvature is the larger of
+ * - the pure pursuit curvature of the line point seen by the sensor bar, sin(2 * angle) / bar_dist,
+ *   which looks ahead by the bar distance
+ * - the curvature of the current motion, w / v
+ * or is given externally (e.g. by the LineTracker). It is filtered with a fast attack and a
+ * slow release, so the robot brakes immediately but only accelerates once the bend is over.
+ *
+ * Lap profile mode: on the first lap (between two calls of startLap()) the curvature is
+ * recorded over the travelled distance. At the start of the next lap a speed profile is
+ * computed with a backward (deceleration) and a forward (acceleration) pass over the lap,
+ * so on later laps the robot already brakes before a bend and accelerates out of it. The
+ * profile is capped by the highest vel_max of the recorded lap (the straight line velocity).
+ * A lap longer than SPEED_SCHEDULER_NUM_OF_BINS * SPEED_SCHEDULER_BIN_LENGTH can not be
+ * recorded, the scheduler then stays in the reactive mode and isLapTooLong() returns true.
+ *
+ * The class does not depend on mbed, so it can also be used in host side tools.
+ *
+ * @author M. E. Peter
+ * @date 18.10.2026
+ */
+
+#ifndef SPEED_SCHEDULER_H_
+#define SPEED_SCHEDULER_H_
+
+#include <math.h>
+#include <stdint.h>
+
+#define SPEED_SCHEDULER_NUM_OF_BINS 512    // max. lap length is NUM_OF_BINS * bin length
+#define SPEED_SCHEDULER_BIN_LENGTH 0.05f   // m
+
+class SpeedScheduler
+{
+public:
+    explicit SpeedScheduler(float Ts, float bar_dist);
+    ~SpeedScheduler() = default;
+
+    void reset();
+
+    /**
+     * @param acc_lat_max max. lateral acceleration in m/s^2
+     * @param acc_max     max. translational acceleration in m/s^2
+     * @param dec_max     max. translational deceleration in m/s^2 (positive value)
+     */
+    void setLimits(float acc_lat_max, float acc_max, float dec_max);
+
+    // the curvature filter releases with this time constant in sec
+    void setReleaseTimeConstant(float tau_release);
+
+    /**
+     * @brief Calculate the scheduled translational velocity for one step.
+     *
+     * @param vel_max   max. translational velocity in m/s (e.g. limited by the wheel velocity)
+     * @param angle     angle of the line at the sensor bar in rad
+     * @param v         translational velocity of the last step in m/s
+     * @param w         rotational velocity of the last step in rad/s
+     * @param curvature external curvature estimate in 1/m, NAN to estimate it from angle, v and w
+     * @return float    scheduled translational velocity in m/s
+     */
+    float update(float vel_max, float angle, float v, float w, float curvature = NAN);
+
+    // enable the lap profile mode, the first startLap() call starts the recording
+    void enableLapProfile(bool enable = true);
+    // marks the start / finish of a lap, has to be called once per lap
+    void startLap();
+
+    float getCurvature() const;
+    float getDistance() const;
+    float getLapLength() const;
+    bool isReplaying() const;
+    bool isLapTooLong() const;
+
+private:
+    enum class LapState : uint8_t {
+        IDLE = 0,
+        RECORDING,
+        REPLAYING
+    };
+
+    float m_Ts;
+    float m_bar_dist;
+
+    float m_acc_lat_max{2.0f};
+    float m_acc_max{2.0f};
+    float m_dec_max{4.0f};
+    float m_release_coeff{0.0f};
+
+    float m_curvature{0.0f};
+    float m_vel{0.0f};
+    float m_vel_max_lap{0.0f}; // highest vel_max of the recorded lap
+
+    bool m_use_lap_profile{false};
+    LapState m_lap_state{LapState::IDLE};
+    bool m_is_lap_too_long{false};
+    float m_distance{0.0f};
+    float m_lap_length{0.0f};
+    uint16_t m_num_of_bins{0};
+    float m_profile[SPEED_SCHEDULER_NUM_OF_BINS]; // recorded curvature, replaced by the velocity profile
+
+    float calcCurvatureSpeedLimit(float curvature, float vel_max) const;
+    void calcProfile(float vel_max);
+    float readProfile(float distance) const;
+};
+
+#endif /* SPEED_SCHEDULER_H_ */
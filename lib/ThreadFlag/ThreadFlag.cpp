@@ -20,6 +20,7 @@ ThreadFlag::ThreadFlag()
     unsigned int n = 0;
     while ((((1 << n) & threadFlags) > 0) && (n < 30)) n++;
     threadFlag = (1 << n);
+    threadFlags |= threadFlag;
 
     mutex.unlock();
 }